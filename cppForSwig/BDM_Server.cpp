@@ -9,6 +9,25 @@
 #include "BDM_Server.h"
 #include "BDM_seder.h"
 
+///////////////////////////////////////////////////////////////////////////////
+static void serializeUtxo(BinaryWriter& bw, UnspentTxOut& utxo)
+{
+   //takes the hash and script from utxo, written as a BinaryDataObject
+   UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
+      move(utxo.txHash_), move(utxo.script_));
+
+   BinaryDataObject::serializeHeader(bw, entry.getSerializedSize());
+   entry.serialize(bw);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void serializeLedgers(BinaryWriter& bw, const vector<LedgerEntry>& leVec)
+{
+   //written as a LedgerEntryVector
+   LedgerEntryVector::serializeHeader(bw, leVec.size());
+   for (auto& le : leVec)
+      le.serialize(bw);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 void BDV_Server_Object::buildMethodMap()
@@ -64,24 +83,6 @@ void BDV_Server_Object::buildMethodMap()
       if (ids.size() < 2)
          throw runtime_error("unexpected id count");
 
-      auto toLedgerEntryVector = []
-         (vector<LedgerEntry>& leVec)->LedgerEntryVector
-      {
-         LedgerEntryVector lev;
-         for (auto& le : leVec)
-         {
-            LedgerEntryData led(le.getWalletID(),
-               le.getValue(), le.getBlockNum(), le.getTxHash(),
-               le.getIndex(), le.getTxTime(), le.isCoinbase(),
-               le.isSentToSelf(), le.isChangeBack(), 
-               le.isOptInRBF(), le.isChainedZC(), le.usesWitness(),
-               le.getScrAddrList());
-            lev.push_back(move(led));
-         }
-
-         return lev;
-      };
-
       auto& nextID = ids[1];
 
       //is it a ledger from a delegate?
@@ -96,7 +97,7 @@ void BDV_Server_Object::buildMethodMap()
          auto&& retVal = delegateObject.getHistoryPage(arg0.getVal());
 
          Arguments retarg;
-         retarg.push_back(move(toLedgerEntryVector(retVal)));
+         serializeLedgers(retarg.getWriter(), retVal);
          return retarg;
       }
       
@@ -124,46 +125,30 @@ void BDV_Server_Object::buildMethodMap()
             txHash = bdo.get();
          }
          
-         LedgerEntryVector resultLev;
+         Arguments retarg;
+         auto& bw = retarg.getWriter();
          if (pageId != UINT32_MAX)
          {
             auto&& retVal = theWallet->getHistoryPageAsVector(pageId);
-            resultLev = move(toLedgerEntryVector(retVal));
+            serializeLedgers(bw, retVal);
+            return retarg;
          }
-         else
+
+         pageId = 0;
+         while (1)
          {
-            pageId = 0;
-            while (1)
+            auto&& ledgerMap = theWallet->getHistoryPage(pageId++);
+            for (auto& lePair : ledgerMap)
             {
-               auto&& ledgerMap = theWallet->getHistoryPage(pageId++);
-               for (auto& lePair : ledgerMap)
+               auto& leHash = lePair.second.getTxHash();
+               if (leHash == txHash)
                {
-                  auto& leHash = lePair.second.getTxHash();
-                  if (leHash == txHash)
-                  {
-                     auto& le = lePair.second;
-
-                     LedgerEntryData led(le.getWalletID(),
-                        le.getValue(), le.getBlockNum(), le.getTxHash(),
-                        le.getIndex(), le.getTxTime(), le.isCoinbase(),
-                        le.isSentToSelf(), le.isChangeBack(),
-                        le.isOptInRBF(), le.isChainedZC(), le.usesWitness(),
-                        le.getScrAddrList());
-
-                     LedgerEntryVector lev;
-                     lev.push_back(move(led));
-
-                     Arguments retarg;
-                     retarg.push_back(move(lev));
-                     return retarg;
-                  }
+                  LedgerEntryVector::serializeHeader(bw, 1);
+                  lePair.second.serialize(bw);
+                  return retarg;
                }
             }
          }
-         
-         Arguments retarg;
-         retarg.push_back(move(resultLev));
-         return retarg;
       }
 
       throw runtime_error("invalid id");
@@ -378,18 +363,12 @@ void BDV_Server_Object::buildMethodMap()
       auto&& utxoVec = wltPtr->getSpendableTxOutListForValue(value);
 
       Arguments retarg;
+      auto& bw = retarg.getWriter();
       auto count = IntType(utxoVec.size());
       retarg.push_back(move(count));
 
       for (auto& utxo : utxoVec)
-      {
-         UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
-            move(utxo.txHash_), move(utxo.script_));
-
-         auto&& bdser = entry.serialize();
-         BinaryDataObject bdo(move(bdser));
-         retarg.push_back(move(bdo));
-      }
+         serializeUtxo(bw, utxo);
 
       return retarg;
    };
@@ -419,18 +398,12 @@ void BDV_Server_Object::buildMethodMap()
       auto&& utxoVec = wltPtr->getSpendableTxOutListZC();
 
       Arguments retarg;
+      auto& bw = retarg.getWriter();
       auto count = IntType(utxoVec.size());
       retarg.push_back(move(count));
 
       for (auto& utxo : utxoVec)
-      {
-         UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
-            move(utxo.txHash_), move(utxo.script_));
-
-         auto&& bdser = entry.serialize();
-         BinaryDataObject bdo(move(bdser));
-         retarg.push_back(move(bdo));
-      }
+         serializeUtxo(bw, utxo);
 
       return retarg;
    };
@@ -460,18 +433,12 @@ void BDV_Server_Object::buildMethodMap()
       auto&& utxoVec = wltPtr->getRBFTxOutList();
 
       Arguments retarg;
+      auto& bw = retarg.getWriter();
       auto count = IntType(utxoVec.size());
       retarg.push_back(move(count));
 
       for (auto& utxo : utxoVec)
-      {
-         UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
-            move(utxo.txHash_), move(utxo.script_));
-
-         auto&& bdser = entry.serialize();
-         BinaryDataObject bdo(move(bdser));
-         retarg.push_back(move(bdo));
-      }
+         serializeUtxo(bw, utxo);
 
       return retarg;
    };
@@ -509,18 +476,12 @@ void BDV_Server_Object::buildMethodMap()
       auto&& utxoVec = addrObj->getAllUTXOs(spentByZC);
 
       Arguments retarg;
+      auto& bw = retarg.getWriter();
       auto count = IntType(utxoVec.size());
       retarg.push_back(move(count));
 
       for (auto& utxo : utxoVec)
-      {
-         UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
-            move(utxo.txHash_), move(utxo.script_));
-
-         auto&& bdser = entry.serialize();
-         BinaryDataObject bdo(move(bdser));
-         retarg.push_back(move(bdo));
-      }
+         serializeUtxo(bw, utxo);
 
       return retarg;
    };
@@ -631,6 +592,24 @@ void BDV_Server_Object::buildMethodMap()
 
    methodMap_["getAddrBalances"] = getAddrBalances;
 
+   //getCombinedWalletState
+   auto getCombinedWalletState = [this]
+      (const vector<string>& ids, Arguments& args)->Arguments
+   {
+      if (ids.size() != 1)
+         throw runtime_error("unexpected id count");
+
+      auto&& wltIDs = args.get<BinaryDataVector>();
+      auto height = args.get<IntType>().getVal();
+      auto withAddrData = args.get<IntType>().getVal();
+      auto withUtxos = args.get<IntType>().getVal();
+
+      return this->getCombinedWalletState(
+         wltIDs.get(), height, withAddrData != 0, withUtxos != 0);
+   };
+
+   methodMap_["getCombinedWalletState"] = getCombinedWalletState;
+
 
    //getTxByHash
    auto getTxByHash = [this]
@@ -806,25 +785,18 @@ void BDV_Server_Object::buildMethodMap()
 
       auto&& wltGroup = this->getStandAloneWalletGroup(wltIDs.get(), ordering);
             
-      LedgerEntryVector lev;
+      //the entry count goes first, gather all pages before serializing
+      vector<LedgerEntry> leVec;
       for (unsigned y = 0; y < wltGroup.getPageCount(); y++)
       {
          auto&& histPage = wltGroup.getHistoryPage(y, false, false);
          for (auto& le : histPage)
-         {
-            LedgerEntryData led(le.getWalletID(),
-               le.getValue(), le.getBlockNum(), le.getTxHash(),
-               le.getIndex(), le.getTxTime(), le.isCoinbase(),
-               le.isSentToSelf(), le.isChangeBack(),
-               le.isOptInRBF(), le.isChainedZC(), le.usesWitness(),
-               le.getScrAddrList());
-            lev.push_back(move(led));
-         }
+            leVec.push_back(move(le));
       }
 
       Arguments retarg;
-      retarg.push_back(move(lev));
-      return move(retarg);
+      serializeLedgers(retarg.getWriter(), leVec);
+      return retarg;
    };
 
    methodMap_["getHistoryForWalletSelection"] = getHistoryForWalletSelection;
@@ -884,18 +856,12 @@ void BDV_Server_Object::buildMethodMap()
       auto&& utxoVec = this->getUnspentTxoutsForAddr160List(addrVec, false);
 
       Arguments retarg;
+      auto& bw = retarg.getWriter();
       auto count = IntType(utxoVec.size());
       retarg.push_back(move(count));
 
       for (auto& utxo : utxoVec)
-      {
-         UTXO entry(utxo.value_, utxo.txHeight_, utxo.txIndex_, utxo.txOutIndex_,
-            move(utxo.txHash_), move(utxo.script_));
-
-         auto&& bdser = entry.serialize();
-         BinaryDataObject bdo(move(bdser));
-         retarg.push_back(move(bdo));
-      }
+         serializeUtxo(bw, utxo);
 
       return retarg;
    };
@@ -935,6 +901,118 @@ void BDV_Server_Object::buildMethodMap()
 
    methodMap_["getRawHeaderForTxHash"] = getRawHeaderForTxHash;
 
+   /***
+   stream methods, see ResponseStream. Each mirrors a regular method but 
+   sends its results as they are pulled from DB instead of building the 
+   whole reply first.
+   ***/
+
+   auto streamUtxo = [](StreamBatch& batch, UnspentTxOut&& utxo)->void
+   {
+      serializeUtxo(batch.getWriter(), utxo);
+      batch.added();
+   };
+
+   //streamUTXOsForAddrList
+   auto streamUTXOsForAddrList = [this, streamUtxo]
+      (const vector<string>& ids, Arguments& args, ResponseStream& stream)->void
+   {
+      auto&& addrBdVec = args.get<BinaryDataVector>();
+
+      StreamBatch batch(stream);
+      auto pushUtxo = [&batch, &streamUtxo](UnspentTxOut&& utxo)->void
+      {
+         streamUtxo(batch, move(utxo));
+      };
+
+      this->getUnspentTxoutsForAddr160List(addrBdVec.get(), false, pushUtxo);
+      batch.finish();
+   };
+
+   streamMethodMap_["streamUTXOsForAddrList"] = streamUTXOsForAddrList;
+
+   //streamSpendableTxOutListForValue
+   auto streamSpendableTxOutListForValue = [this, streamUtxo]
+      (const vector<string>& ids, Arguments& args, ResponseStream& stream)->void
+   {
+      if (ids.size() != 2)
+         throw runtime_error("unexpected id count");
+
+      auto& walletId = ids[1];
+      BinaryData bdId((uint8_t*)walletId.c_str(), walletId.size());
+      shared_ptr<BtcWallet> wltPtr = nullptr;
+      for (unsigned i = 0; i < this->groups_.size(); i++)
+      {
+         auto wltIter = this->groups_[i].wallets_.find(bdId);
+         if (wltIter != this->groups_[i].wallets_.end())
+            wltPtr = wltIter->second;
+      }
+
+      if (wltPtr == nullptr)
+         throw runtime_error("unknown wallet or lockbox ID");
+
+      auto value = args.get<IntType>().getVal();
+
+      StreamBatch batch(stream);
+      auto pushUtxo = [&batch, &streamUtxo](UnspentTxOut&& utxo)->void
+      {
+         streamUtxo(batch, move(utxo));
+      };
+
+      wltPtr->getSpendableTxOutListForValue(value, pushUtxo);
+      batch.finish();
+   };
+
+   streamMethodMap_["streamSpendableTxOutListForValue"] = 
+      streamSpendableTxOutListForValue;
+
+   //streamHistoryForWalletSelection
+   auto streamHistoryForWalletSelection = [this]
+      (const vector<string>& ids, Arguments& args, ResponseStream& stream)->void
+   {
+      auto&& wltIDs = args.get<BinaryDataVector>();
+      auto orderingBdo = args.get<BinaryDataObject>().get();
+      auto orderingStr = string(orderingBdo.getCharPtr(), orderingBdo.getSize());
+
+      HistoryOrdering ordering;
+      if (orderingStr == "ascending")
+         ordering = order_ascending;
+      else if (orderingStr == "descending")
+         ordering = order_descending;
+      else
+         throw runtime_error("invalid ordering str");
+
+      auto&& wltGroup = this->getStandAloneWalletGroup(wltIDs.get(), ordering);
+
+      //one LedgerEntryVector per history page
+      StreamBatch batch(stream);
+      for (unsigned y = 0; y < wltGroup.getPageCount(); y++)
+      {
+         auto&& histPage = wltGroup.getHistoryPage(y, false, false);
+         serializeLedgers(batch.getWriter(), histPage);
+         batch.added();
+      }
+
+      batch.finish();
+   };
+
+   streamMethodMap_["streamHistoryForWalletSelection"] = 
+      streamHistoryForWalletSelection;
+
+   //stats only have entries for the listed methods
+   auto& methodNames = getMethodNames();
+   for (auto& methodPair : methodMap_)
+   {
+      if (methodNames.find(methodPair.first) == methodNames.end())
+         throw runtime_error("unlisted method " + methodPair.first);
+   }
+
+   for (auto& methodPair : streamMethodMap_)
+   {
+      if (methodNames.find(methodPair.first) == methodNames.end() ||
+         !isStreamMethod(methodPair.first))
+         throw runtime_error("unlisted method " + methodPair.first);
+   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1015,6 +1093,10 @@ Arguments Clients::runCommand(const string& cmdStr)
    {
       return registerBDV(cmdObj.args_);
    }
+   else if (cmdObj.method_ == "getServerStats")
+   {
+      return stats_.getStats();
+   }
    else if (cmdObj.method_ == "unregisterBDV")
    {
       if (cmdObj.ids_.size() != 1)
@@ -1030,6 +1112,9 @@ Arguments Clients::runCommand(const string& cmdStr)
 
    auto bdv = get(cmdObj.ids_[0]);
 
+   //throws if the client is over its budget
+   AdmissionSlot slot(admission_, cmdObj.ids_[0], cmdObj.method_);
+
    //execute command
    auto&& result = bdv->executeCommand(cmdObj.method_, cmdObj.ids_, cmdObj.args_);
    bdv->resetCounter();
@@ -1037,6 +1122,140 @@ Arguments Clients::runCommand(const string& cmdStr)
    return result;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+string Clients::runCommandSerialized(const string& cmdStr)
+{
+   //reply in the encoding the client used
+   auto encoding = WireFrame::getEncoding(cmdStr);
+
+   try
+   {
+      auto&& retVal = runCommand(cmdStr);
+      return retVal.serialize(encoding);
+   }
+   catch (exception& e)
+   {
+      ErrorType err(e.what());
+      Arguments arg;
+      arg.push_back(move(err));
+
+      return arg.serialize(encoding);
+   }
+   catch (DbErrorMsg &e)
+   {
+      ErrorType err(e.what());
+      Arguments arg;
+      arg.push_back(move(err));
+
+      return arg.serialize(encoding);
+   }
+   catch (...)
+   {
+      ErrorType err("unknown error");
+      Arguments arg;
+      arg.push_back(move(err));
+      
+      return arg.serialize(encoding);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Clients::runStreamCommand(const string& cmdStr, ResponseStream& stream)
+{
+   try
+   {
+      if (!run_.load(memory_order_relaxed))
+         throw runtime_error("server is shutting down");
+
+      Command cmdObj(cmdStr);
+      cmdObj.deserialize();
+
+      if (bdmT_->bdm()->hasException())
+         rethrow_exception(bdmT_->bdm()->getException());
+
+      if (cmdObj.ids_.size() == 0)
+         throw runtime_error("malformed command");
+
+      auto bdv = get(cmdObj.ids_[0]);
+      AdmissionSlot slot(admission_, cmdObj.ids_[0], cmdObj.method_);
+
+      bdv->executeStreamCommand(
+         cmdObj.method_, cmdObj.ids_, cmdObj.args_, stream);
+      bdv->resetCounter();
+   }
+   catch (exception& e)
+   {
+      stream.writeError(e.what());
+   }
+   catch (DbErrorMsg &e)
+   {
+      stream.writeError(e.what());
+   }
+   catch (...)
+   {
+      stream.writeError("unknown error");
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Clients::queuePipelined(
+   shared_ptr<ClientChannel> channel, uint32_t id, string&& cmdStr)
+{
+   string rejection;
+   if (Command::peekMethod(cmdStr) == "registerCallback")
+   {
+      //would tie up a worker, notifications are pushed on this channel
+      rejection = "registerCallback cannot be pipelined";
+   }
+   else if (channel->inflight_.fetch_add(1, memory_order_relaxed) >=
+      PIPELINE_MAX_INFLIGHT)
+   {
+      channel->inflight_.fetch_sub(1, memory_order_relaxed);
+      rejection = SERVER_BUSY_ERROR;
+   }
+
+   if (rejection.size() != 0)
+   {
+      ErrorType err(rejection);
+      Arguments arg;
+      arg.push_back(move(err));
+
+      channel->writeFrame(id, arg.serialize(WireFrame::getEncoding(cmdStr)));
+      return;
+   }
+
+   PipelinedCommand pc;
+   pc.channel_ = channel;
+   pc.id_ = id;
+   pc.command_ = move(cmdStr);
+   pc.queuedAt_ = chrono::steady_clock::now();
+   pipelineQueue_.push_back(move(pc));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Clients::pipelineWorker()
+{
+   while (1)
+   {
+      PipelinedCommand pc;
+      try
+      {
+         pc = move(pipelineQueue_.pop_front());
+      }
+      catch (StopBlockingLoop&)
+      {
+         break;
+      }
+
+      stats_.recordQueueWait(Command::peekMethod(pc.command_),
+         ServerStats::elapsedMicros(pc.queuedAt_));
+
+      auto&& retStr = runCommandSerialized(pc.command_);
+      pc.channel_->writeFrame(pc.id_, retStr);
+      pc.channel_->inflight_.fetch_sub(1, memory_order_relaxed);
+   }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Clients::shutdown()
 {
@@ -1069,6 +1288,18 @@ void Clients::exitRequestLoop()
    //cleanup all BDVs
    unregisterAllBDVs();
 
+   //BDVs have sent their terminate notification by now
+   if (notifServer_ != nullptr)
+      notifServer_->stop();
+
+   pipelineQueue_.terminate();
+   for (auto& thr : pipelineThreads_)
+   {
+      if (thr.joinable())
+         thr.join();
+   }
+   pipelineThreads_.clear();
+
    //shutdown node
    bdmT_->bdm()->shutdownNode();
 
@@ -1083,6 +1314,23 @@ void Clients::exitRequestLoop()
    fcgiShutdownCallback_();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+set<string> Clients::getStatsMethodNames()
+{
+   //commands handled by Clients::runCommand, then those of the BDVs
+   set<string> methods = {
+      "shutdown",
+      "shutdownNode",
+      "registerBDV",
+      "getServerStats",
+      "unregisterBDV"
+   };
+
+   auto& bdvMethods = BDV_Server_Object::getMethodNames();
+   methods.insert(bdvMethods.begin(), bdvMethods.end());
+   return methods;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Clients::unregisterAllBDVs()
 {
@@ -1112,6 +1360,8 @@ Arguments Clients::registerBDV(Arguments& arg)
 
    shared_ptr<BDV_Server_Object> newBDV
       = make_shared<BDV_Server_Object>(bdmT_);
+   newBDV->stats_ = &stats_;
+   newBDV->pool_ = &pool_;
 
    string newID(newBDV->getID());
 
@@ -1123,9 +1373,48 @@ Arguments Clients::registerBDV(Arguments& arg)
    Arguments args;
    BinaryDataObject bdo(newID);
    args.push_back(move(bdo));
+
+   //advertise the push channel, clients that don't know of it ignore this
+   auto notifPort = getNotificationPort();
+   if (notifPort != 0)
+      args.push_back(move(IntType(notifPort)));
+
    return args;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void Clients::startNotificationServer(const string& addr, const string& port)
+{
+   auto server = make_unique<NotificationServer>(this);
+   if (!server->start(addr, port))
+   {
+      LOGWARN << "notification port " << port << " is taken, " <<
+         "clients will fall back to polling for notifications";
+      return;
+   }
+
+   LOGINFO << "pushing notifications on port " << port;
+   notifServer_ = move(server);
+
+   auto workerLbd = [this](void)->void
+   {
+      pipelineWorker();
+   };
+
+   auto threadCount = bdmT_->bdm()->config().fcgiThreadCount_;
+   for (unsigned i = 0; i < threadCount; i++)
+      pipelineThreads_.push_back(thread(workerLbd));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned Clients::getNotificationPort() const
+{
+   if (notifServer_ == nullptr)
+      return 0;
+
+   return notifServer_->port();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Clients::unregisterBDV(const string& bdvId)
 {
@@ -1143,6 +1432,8 @@ void Clients::unregisterBDV(const string& bdvId)
       BDVs_.erase(bdvId);
    }
 
+   admission_.forget(bdvId);
+
    bdvPtr->haltThreads();
 
    //we are done
@@ -1157,8 +1448,20 @@ void Clients::maintenanceThread(void) const
    if (bdmT_ == nullptr)
       throw runtime_error("invalid BDM thread ptr");
 
+   auto statsInterval = bdmT_->bdm()->config().statsLogInterval_;
+   auto lastStatsLog = chrono::steady_clock::now();
+
    while (1)
    {
+      //the notification wait below caps the log dump resolution at 60s
+      if (statsInterval > 0 &&
+         chrono::steady_clock::now() - lastStatsLog >= 
+         chrono::seconds(statsInterval))
+      {
+         stats_.log();
+         lastStatsLog = chrono::steady_clock::now();
+      }
+
       bool timedout = true;
       shared_ptr<BDV_Notification> notifPtr;
 
@@ -1241,32 +1544,625 @@ void Clients::garbageCollectorThread(void)
 Arguments BDV_Server_Object::executeCommand(const string& method,
    const vector<string>& ids, Arguments& args)
 {
+   //stream methods are gathered in a single reply when called this way
+   if (isStreamMethod(method))
+   {
+      BufferedResponseStream stream;
+      executeStreamCommand(method, ids, args, stream);
+      return move(stream.reply_);
+   }
+
    //make sure the method exists
    auto iter = methodMap_.find(method);
    if (iter == methodMap_.end())
       throw runtime_error("error: unknown method");
 
-   return iter->second(ids, args);
+   if (stats_ == nullptr)
+      return iter->second(ids, args);
+
+   auto start = chrono::steady_clock::now();
+   try
+   {
+      auto&& result = iter->second(ids, args);
+      stats_->recordExecution(
+         method, ServerStats::elapsedMicros(start), false);
+      return result;
+   }
+   catch (...)
+   {
+      stats_->recordExecution(
+         method, ServerStats::elapsedMicros(start), true);
+      throw;
+   }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void FCGI_Server::init()
+void BDV_Server_Object::executeStreamCommand(const string& method,
+   const vector<string>& ids, Arguments& args, ResponseStream& stream)
 {
-   stringstream ss;
-#ifdef _WIN32
-   if (ip_ == "127.0.0.1" || ip_ == "localhost")
-      ss << "localhost:" << port_;
-   else
-      ss << ip_ << ":" << port_;
-#else
-   ss << ip_ << ":" << port_;
-#endif
-   
-   auto socketStr = ss.str();
-   sockfd_ = FCGX_OpenSocket(socketStr.c_str(), 10);
-   if (sockfd_ == -1)
-      throw runtime_error("failed to create FCGI listen socket");
-}
+   auto iter = streamMethodMap_.find(method);
+   if (iter == streamMethodMap_.end())
+      throw runtime_error("error: unknown method");
+
+   if (stats_ == nullptr)
+   {
+      iter->second(ids, args, stream);
+      return;
+   }
+
+   //includes the time spent writing to the stream
+   auto start = chrono::steady_clock::now();
+   try
+   {
+      iter->second(ids, args, stream);
+      stats_->recordExecution(
+         method, ServerStats::elapsedMicros(start), false);
+   }
+   catch (...)
+   {
+      stats_->recordExecution(
+         method, ServerStats::elapsedMicros(start), true);
+      throw;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool BDV_Server_Object::isStreamMethod(const string& method)
+{
+   //has to match the streamMethodMap_ entries
+   static const set<string> streamMethods = {
+      "streamUTXOsForAddrList",
+      "streamSpendableTxOutListForValue",
+      "streamHistoryForWalletSelection"
+   };
+
+   return streamMethods.find(method) != streamMethods.end();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+const set<string>& BDV_Server_Object::getMethodNames()
+{
+   //has to match the methodMap_ and streamMethodMap_ entries, checked by
+   //buildMethodMap
+   static const set<string> methods = {
+      "registerCallback",
+      "goOnline",
+      "getTopBlockHeight",
+      "getHistoryPage",
+      "registerWallet",
+      "registerLockbox",
+      "registerAddrList",
+      "getLedgerDelegateForWallets",
+      "getLedgerDelegateForLockboxes",
+      "getLedgerDelegateForScrAddr",
+      "getBalancesAndCount",
+      "hasHeaderWithHash",
+      "getSpendableTxOutListForValue",
+      "getSpendableZCList",
+      "getRBFTxOutList",
+      "getSpendableTxOutListForAddr",
+      "broadcastZC",
+      "getAddrTxnCounts",
+      "getAddrBalances",
+      "getCombinedWalletState",
+      "getTxByHash",
+      "getAddressFullBalance",
+      "getAddressTxioCount",
+      "getHeaderByHeight",
+      "createAddressBook",
+      "updateWalletsLedgerFilter",
+      "getNodeStatus",
+      "estimateFee",
+      "getHistoryForWalletSelection",
+      "getValueForTxOut",
+      "broadcastThroughRPC",
+      "getUTXOsForAddrList",
+      "getRawHeaderForTxHash",
+      "streamUTXOsForAddrList",
+      "streamSpendableTxOutListForValue",
+      "streamHistoryForWalletSelection"
+   };
+
+   return methods;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ResponseStream::writeError(const string& error)
+{
+   ErrorType err(error);
+   Arguments arg;
+   arg.push_back(move(err));
+
+   write(arg);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StreamBatch::flush()
+{
+   if (count_ == 0)
+      return;
+
+   Arguments batch;
+   batch.getWriter();
+   batch.push_back(move(IntType(count_)));
+   batch.merge(entries_);
+   stream_.write(batch);
+
+   entries_.clear();
+   count_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void StreamBatch::finish()
+{
+   flush();
+
+   Arguments batch;
+   batch.push_back(move(IntType(0)));
+   stream_.write(batch);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// LatencyHistogram
+//
+///////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram()
+{
+   for (auto& bucket : buckets_)
+      bucket.store(0, memory_order_relaxed);
+
+   count_.store(0, memory_order_relaxed);
+   sum_.store(0, memory_order_relaxed);
+   max_.store(0, memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned LatencyHistogram::bucketIndex(uint64_t val)
+{
+   /***
+   Shift the value until it fits in 2 * LATENCY_SUB_BUCKETS. Values below
+   that have a bucket each, the others land in the upper half of the sub
+   buckets of their shift.
+   ***/
+
+   unsigned shift = 0;
+   while ((val >> shift) >= 2 * LATENCY_SUB_BUCKETS)
+   {
+      if (++shift > LATENCY_MAX_SHIFT)
+         return BUCKET_COUNT - 1;
+   }
+
+   return shift * LATENCY_SUB_BUCKETS + (unsigned)(val >> shift);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t LatencyHistogram::bucketHighValue(unsigned index)
+{
+   if (index < 2 * LATENCY_SUB_BUCKETS)
+      return index;
+
+   unsigned shift = index / LATENCY_SUB_BUCKETS - 1;
+   uint64_t sub = index - shift * LATENCY_SUB_BUCKETS;
+   return ((sub + 1) << shift) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::record(uint64_t micros)
+{
+   buckets_[bucketIndex(micros)].fetch_add(1, memory_order_relaxed);
+   count_.fetch_add(1, memory_order_relaxed);
+   sum_.fetch_add(micros, memory_order_relaxed);
+
+   auto currentMax = max_.load(memory_order_relaxed);
+   while (micros > currentMax)
+   {
+      if (max_.compare_exchange_weak(currentMax, micros, 
+         memory_order_relaxed))
+         break;
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t LatencyHistogram::percentile(double pct) const
+{
+   //count from the buckets, count_ may be ahead of them
+   uint64_t total = 0;
+   for (auto& bucket : buckets_)
+      total += bucket.load(memory_order_relaxed);
+
+   if (total == 0)
+      return 0;
+
+   uint64_t target = (uint64_t)ceil(pct * total);
+   if (target == 0)
+      target = 1;
+
+   uint64_t seen = 0;
+   for (unsigned i = 0; i < BUCKET_COUNT; i++)
+   {
+      seen += buckets_[i].load(memory_order_relaxed);
+      if (seen >= target)
+      {
+         //the last bucket is open ended
+         if (i == BUCKET_COUNT - 1)
+            return max();
+
+         return std::min(bucketHighValue(i), max());
+      }
+   }
+
+   return max();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ServerStats
+//
+///////////////////////////////////////////////////////////////////////////////
+ServerStats::ServerStats(const set<string>& methods)
+{
+   for (auto& method : methods)
+      methods_.insert(make_pair(method, make_shared<MethodStats>()));
+
+   auto unknown = make_shared<MethodStats>();
+   unknown_ = unknown.get();
+   methods_.insert(make_pair("unknown", unknown));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MethodStats& ServerStats::getMethod(const string& method)
+{
+   auto iter = methods_.find(method);
+   if (iter == methods_.end())
+      return *unknown_;
+
+   return *iter->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ServerStats::recordQueueWait(const string& method, uint64_t micros)
+{
+   getMethod(method).queueWait_.record(micros);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ServerStats::recordExecution(
+   const string& method, uint64_t micros, bool failed)
+{
+   auto& methodStats = getMethod(method);
+   methodStats.calls_.fetch_add(1, memory_order_relaxed);
+   if (failed)
+      methodStats.errors_.fetch_add(1, memory_order_relaxed);
+
+   methodStats.execution_.record(micros);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+Arguments ServerStats::getStats() const
+{
+   vector<pair<const string*, const MethodStats*>> called;
+   for (auto& methodPair : methods_)
+   {
+      auto& methodStats = *methodPair.second;
+      if (methodStats.calls_.load(memory_order_relaxed) == 0 &&
+         methodStats.queueWait_.count() == 0)
+         continue;
+
+      called.push_back(make_pair(&methodPair.first, &methodStats));
+   }
+
+   Arguments retarg;
+   retarg.push_back(move(IntType(called.size())));
+
+   auto pushHistogram = [&retarg](const LatencyHistogram& hist)->void
+   {
+      retarg.push_back(move(IntType(hist.count())));
+      retarg.push_back(move(IntType(hist.sum())));
+      retarg.push_back(move(IntType(hist.max())));
+      retarg.push_back(move(IntType(hist.percentile(0.5))));
+      retarg.push_back(move(IntType(hist.percentile(0.9))));
+      retarg.push_back(move(IntType(hist.percentile(0.99))));
+      retarg.push_back(move(IntType(hist.percentile(0.999))));
+   };
+
+   for (auto& methodPair : called)
+   {
+      auto& methodStats = *methodPair.second;
+
+      retarg.push_back(move(BinaryDataObject(*methodPair.first)));
+      retarg.push_back(move(IntType(
+         methodStats.calls_.load(memory_order_relaxed))));
+      retarg.push_back(move(IntType(
+         methodStats.errors_.load(memory_order_relaxed))));
+
+      pushHistogram(methodStats.queueWait_);
+      pushHistogram(methodStats.execution_);
+   }
+
+   return retarg;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ServerStats::log() const
+{
+   bool header = false;
+   for (auto& methodPair : methods_)
+   {
+      auto& methodStats = *methodPair.second;
+      if (methodStats.calls_.load(memory_order_relaxed) == 0)
+         continue;
+
+      if (!header)
+      {
+         LOGINFO << "request stats (us), method: calls/errors, " <<
+            "exec p50/p99/max, wait p50/p99/max";
+         header = true;
+      }
+
+      auto& exec = methodStats.execution_;
+      auto& wait = methodStats.queueWait_;
+
+      LOGINFO << "   " << methodPair.first << ": " <<
+         methodStats.calls_.load(memory_order_relaxed) << "/" <<
+         methodStats.errors_.load(memory_order_relaxed) << ", " <<
+         exec.percentile(0.5) << "/" << exec.percentile(0.99) << "/" <<
+         exec.max() << ", " <<
+         wait.percentile(0.5) << "/" << wait.percentile(0.99) << "/" <<
+         wait.max();
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t ServerStats::elapsedMicros(chrono::steady_clock::time_point start)
+{
+   auto elapsed = chrono::steady_clock::now() - start;
+   return chrono::duration_cast<chrono::microseconds>(elapsed).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TokenBucket
+//
+///////////////////////////////////////////////////////////////////////////////
+bool TokenBucket::consume(double cost, double rate, double burst)
+{
+   unique_lock<mutex> lock(mu_);
+
+   auto now = chrono::steady_clock::now();
+   chrono::duration<double> elapsed = now - last_;
+   last_ = now;
+
+   tokens_ = std::min(burst, tokens_ + elapsed.count() * rate);
+   if (tokens_ < cost)
+      return false;
+
+   tokens_ -= cost;
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// FairScheduler
+//
+///////////////////////////////////////////////////////////////////////////////
+bool FairScheduler::acquire(
+   const string& id, unsigned cost, chrono::milliseconds timeout)
+{
+   unique_lock<mutex> lock(mu_);
+
+   //no need to queue if a slot is free and nobody is ahead
+   bool mustWait = running_ >= slots_ || waiting_.size() > 0;
+   auto& clientWaiting = clientWaiting_[id];
+   if (mustWait && (waiting_.size() >= maxWaiting_ ||
+      clientWaiting >= maxWaitingPerClient_))
+   {
+      if (clientWaiting == 0)
+         clientWaiting_.erase(id);
+      return false;
+   }
+
+   auto& finishTag = finishTags_[id];
+   auto startTag = std::max(virtualTime_, finishTag);
+   finishTag = startTag + cost;
+
+   auto ticket = make_pair(startTag, seq_++);
+   waiting_.insert(ticket);
+   ++clientWaiting;
+
+   auto isTurn = [this, &ticket](void)->bool
+   {
+      return running_ < slots_ && *waiting_.begin() == ticket;
+   };
+
+   bool gotSlot = cv_.wait_for(lock, timeout, isTurn);
+
+   waiting_.erase(ticket);
+   auto waitIter = clientWaiting_.find(id);
+   if (--waitIter->second == 0)
+      clientWaiting_.erase(waitIter);
+
+   if (!gotSlot)
+   {
+      //may have been the head of the queue
+      cv_.notify_all();
+      return false;
+   }
+
+   ++running_;
+   virtualTime_ = startTag;
+
+   //the next in line may fit in a free slot too
+   cv_.notify_all();
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FairScheduler::release()
+{
+   unique_lock<mutex> lock(mu_);
+   --running_;
+   cv_.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FairScheduler::forget(const string& id)
+{
+   unique_lock<mutex> lock(mu_);
+   finishTags_.erase(id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+size_t FairScheduler::waitingCount()
+{
+   unique_lock<mutex> lock(mu_);
+   return waiting_.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// AdmissionControl
+//
+///////////////////////////////////////////////////////////////////////////////
+AdmissionControl::AdmissionControl(const BlockDataManagerConfig& config) :
+   rate_(config.admissionRate_),
+   burst_(std::max((double)config.admissionBurst_, (double)MethodCost_Heavy)),
+   //at most half the rpc workers wait on a heavy slot, the others keep 
+   //serving lighter commands
+   scheduler_(config.heavyRequestSlots_, 
+      config.fcgiThreadCount_ / 2, HEAVY_WAITING_PER_CLIENT)
+{
+   rejected_.store(0, memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+MethodCost AdmissionControl::getMethodCost(const string& method)
+{
+   static const map<string, MethodCost> costMap =
+   {
+      //long poll, mostly idle
+      { "registerCallback", MethodCost_Free },
+
+      { "getHistoryPage", MethodCost_Moderate },
+      { "getAddrBalances", MethodCost_Moderate },
+      { "getAddrTxnCounts", MethodCost_Moderate },
+      { "getSpendableTxOutListForAddr", MethodCost_Moderate },
+      { "getSpendableZCList", MethodCost_Moderate },
+      { "getRBFTxOutList", MethodCost_Moderate },
+      { "getLedgerDelegateForWallets", MethodCost_Moderate },
+      { "getLedgerDelegateForLockboxes", MethodCost_Moderate },
+      { "getLedgerDelegateForScrAddr", MethodCost_Moderate },
+      { "getTxByHash", MethodCost_Moderate },
+      { "getRawHeaderForTxHash", MethodCost_Moderate },
+      { "registerWallet", MethodCost_Moderate },
+      { "registerLockbox", MethodCost_Moderate },
+      { "registerAddrList", MethodCost_Moderate },
+      { "updateWalletsLedgerFilter", MethodCost_Moderate },
+      { "broadcastZC", MethodCost_Moderate },
+
+      //wallet wide scans
+      { "getHistoryForWalletSelection", MethodCost_Heavy },
+      { "streamHistoryForWalletSelection", MethodCost_Heavy },
+      { "getCombinedWalletState", MethodCost_Heavy },
+      { "createAddressBook", MethodCost_Heavy },
+      { "getUTXOsForAddrList", MethodCost_Heavy },
+      { "streamUTXOsForAddrList", MethodCost_Heavy },
+      { "getSpendableTxOutListForValue", MethodCost_Heavy },
+      { "streamSpendableTxOutListForValue", MethodCost_Heavy }
+   };
+
+   auto iter = costMap.find(method);
+   if (iter == costMap.end())
+      return MethodCost_Cheap;
+
+   return iter->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+shared_ptr<TokenBucket> AdmissionControl::getBucket(const string& id)
+{
+   {
+      auto bucketMap = buckets_.get();
+      auto iter = bucketMap->find(id);
+      if (iter != bucketMap->end())
+         return iter->second;
+   }
+
+   //new clients start with a full bucket
+   buckets_.insert(make_pair(id, make_shared<TokenBucket>(burst_)));
+
+   auto bucketMap = buckets_.get();
+   return bucketMap->find(id)->second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AdmissionControl::reject(const string& id, const string& method)
+{
+   auto count = rejected_.fetch_add(1, memory_order_relaxed);
+   if (count % 1000 == 0)
+   {
+      LOGWARN << "client " << id << " over its budget or heavy queue full, " <<
+         "rejected " << method << ", " << count + 1 << 
+         " commands rejected so far";
+   }
+
+   throw ServerBusy();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool AdmissionControl::admit(const string& id, const string& method)
+{
+   auto cost = getMethodCost(method);
+   if (cost == MethodCost_Free)
+      return false;
+
+   if (rate_ > 0 && !getBucket(id)->consume(cost, rate_, burst_))
+      reject(id, method);
+
+   if (cost != MethodCost_Heavy)
+      return false;
+
+   if (!scheduler_.acquire(id, cost, chrono::seconds(HEAVY_WAIT_TIMEOUT)))
+      reject(id, method);
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void AdmissionControl::forget(const string& id)
+{
+   buckets_.erase(id);
+   scheduler_.forget(id);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::init()
+{
+   stringstream ss;
+#ifdef _WIN32
+   if (ip_ == "127.0.0.1" || ip_ == "localhost")
+      ss << "localhost:" << port_;
+   else
+      ss << ip_ << ":" << port_;
+#else
+   ss << ip_ << ":" << port_;
+#endif
+   
+   auto socketStr = ss.str();
+   sockfd_ = FCGX_OpenSocket(socketStr.c_str(), 10);
+   if (sockfd_ == -1)
+      throw runtime_error("failed to create FCGI listen socket");
+
+   //push notification channel
+   if (notifyPort_.size() != 0 && notifyPort_ != "0")
+   {
+      auto notifyAddr = ip_;
+      if (notifyAddr.size() == 0)
+         notifyAddr = "0.0.0.0";
+
+      clients_.startNotificationServer(notifyAddr, notifyPort_);
+   }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 void FCGI_Server::checkSocket() const
@@ -1299,7 +2195,7 @@ void FCGI_Server::haltFcgiLoop()
    run_ = 0;
 
    //spin lock until all requests are closed
-   while (liveThreads_.load(memory_order_relaxed) != 0);
+   while (lanes_.liveCount() != 0);
 
    //connect to own listen to trigger thread exit
    BinarySocket sock("127.0.0.1", port_);
@@ -1318,6 +2214,13 @@ void FCGI_Server::haltFcgiLoop()
 ///////////////////////////////////////////////////////////////////////////////
 void FCGI_Server::enterLoop()
 {
+   lanes_.start();
+   LOGINFO << "serving requests on " <<
+      lanes_.threadCount(FcgiLane_RPC) << " rpc threads and " <<
+      lanes_.threadCount(FcgiLane_Callback) << " callback threads";
+
+   startKeepAlive();
+
    while (run_)
    {
       FCGX_Request* request = new FCGX_Request;
@@ -1333,95 +2236,343 @@ void FCGI_Server::enterLoop()
 #endif
          LOGERR << "Accept failed with error number: " << err_i;
          LOGERR << "error message is: " << strerror(err_i);
+
+         stopKeepAlive();
+         lanes_.stop();
          throw runtime_error("accept error");
       }
 
-      auto processRequestLambda = [this](FCGX_Request* req)->void
-      {
-         this->processRequest(req);
-      };
+      dispatchRequest(request);
+   }
+
+   stopKeepAlive();
+   lanes_.stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::dispatchRequest(FCGX_Request* request)
+{
+   //the body is read by the worker, this runs on the accept and keep-alive
+   //threads and must not block on the client
+   lanes_.push(request);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool FCGI_Server::readBody(FCGX_Request* request, string& content)
+{
+   //extract the string command from the fgci request
+   char* content_length = FCGX_GetParam("CONTENT_LENGTH", request->envp);
+   if (content_length == nullptr)
+   {
+      LOGERR << "empty content_length";
+      return false;
+   }
+
+   auto a = atoi(content_length);
+   if (a > MAX_CONTENT_LENGTH)
+   {
+      LOGERR << "content_length too large: " << a;
+      return false;
+   }
+
+   if (a > 0)
+   {
+      content.resize(a);
+      if (FCGX_GetStr(&content[0], a, request->in) != a)
+      {
+         LOGERR << "fcgi request body cut short";
+         return false;
+      }
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::startKeepAlive()
+{
+#ifndef _WIN32
+   //the pipe wakes the keep-alive thread up when a connection goes idle
+   if (wakeFds_[0] == -1 && pipe(wakeFds_) != 0)
+   {
+      wakeFds_[0] = wakeFds_[1] = -1;
+      LOGWARN << "failed to create keep-alive pipe, " <<
+         "connections will be closed after each request";
+      return;
+   }
+
+   //a full pipe already guarantees a wake up, never block on it
+   fcntl(wakeFds_[0], F_SETFL, O_NONBLOCK);
+   fcntl(wakeFds_[1], F_SETFL, O_NONBLOCK);
+
+   keepAlive_.store(true, memory_order_release);
+
+   auto keepAliveLambda = [this](void)->void
+   {
+      this->keepAliveLoop();
+   };
+
+   keepAliveThread_ = thread(keepAliveLambda);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::stopKeepAlive()
+{
+#ifndef _WIN32
+   if (!keepAlive_.load(memory_order_acquire))
+      return;
+
+   keepAlive_.store(false, memory_order_release);
+   wakeKeepAlive();
+
+   if (keepAliveThread_.joinable())
+      keepAliveThread_.join();
+
+   //connections queued past this point are closed by finishRequest
+   closeIdleQueue();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::wakeKeepAlive()
+{
+#ifndef _WIN32
+   char wake = 0;
+   if (write(wakeFds_[1], &wake, 1) != 1 && errno != EAGAIN)
+      LOGWARN << "failed to wake keep-alive thread";
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::closeIdleQueue()
+{
+   try
+   {
+      while (1)
+         closeConnection(idleQueue_.pop_front());
+   }
+   catch (IsEmpty&)
+   {}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::keepAliveLoop()
+{
+#ifndef _WIN32
+   struct IdleConnection
+   {
+      FCGX_Request* req_;
+      chrono::steady_clock::time_point since_;
+   };
+
+   vector<IdleConnection> idleConns;
+   vector<struct pollfd> pfds;
+   auto timeout = chrono::seconds(FCGI_KEEPALIVE_TIMEOUT);
+
+   while (keepAlive_.load(memory_order_acquire))
+   {
+      //grab connections released by the workers
+      auto now = chrono::steady_clock::now();
+      try
+      {
+         while (1)
+         {
+            IdleConnection conn;
+            conn.req_ = idleQueue_.pop_front();
+            conn.since_ = now;
+            idleConns.push_back(conn);
+         }
+      }
+      catch (IsEmpty&)
+      {}
+
+      pfds.resize(idleConns.size() + 1);
+      pfds[0].fd = wakeFds_[0];
+      pfds[0].events = POLLIN;
+      pfds[0].revents = 0;
+
+      for (unsigned i = 0; i < idleConns.size(); i++)
+      {
+         auto& pfd = pfds[i + 1];
+         pfd.fd = idleConns[i].req_->ipcFd;
+         pfd.events = POLLIN;
+         pfd.revents = 0;
+      }
+
+      auto status = poll(&pfds[0], pfds.size(), 1000);
+      if (status == -1)
+      {
+         if (errno == EINTR)
+            continue;
+
+         LOGERR << "poll() error in keepAliveLoop: " << errno;
+         break;
+      }
+
+      if (pfds[0].revents & POLLIN)
+      {
+         char buf[64];
+         while (read(wakeFds_[0], buf, sizeof(buf)) > 0);
+      }
+
+      if (!keepAlive_.load(memory_order_acquire))
+         break;
+
+      now = chrono::steady_clock::now();
+      vector<IdleConnection> stillIdle;
+
+      for (unsigned i = 0; i < idleConns.size(); i++)
+      {
+         auto& conn = idleConns[i];
+         auto revents = pfds[i + 1].revents;
+
+         if (revents & POLLIN)
+         {
+            //a readable connection with nothing to peek was closed by 
+            //the client
+            char peek;
+            if (recv(conn.req_->ipcFd, &peek, 1, MSG_PEEK) <= 0)
+            {
+               closeConnection(conn.req_);
+               continue;
+            }
+
+            /***
+            FCGX_Accept_r reads the next request off a kept connection. 
+            Should that fail it falls back to accepting on the listen 
+            socket, which would block this thread. Invalidate the listen
+            socket on this request object so that it errors out instead.
+            ***/
+            conn.req_->listen_sock = -1;
+            if (FCGX_Accept_r(conn.req_) != 0)
+            {
+               closeConnection(conn.req_);
+               continue;
+            }
+
+            dispatchRequest(conn.req_);
+            continue;
+         }
+
+         if (revents & (POLLERR | POLLHUP | POLLNVAL) ||
+            now - conn.since_ > timeout)
+         {
+            closeConnection(conn.req_);
+            continue;
+         }
+
+         stillIdle.push_back(conn);
+      }
+
+      idleConns = move(stillIdle);
+   }
+
+   for (auto& conn : idleConns)
+      closeConnection(conn.req_);
+   closeIdleQueue();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::finishRequest(FCGX_Request* req)
+{
+   //FCGX_Finish_r leaves the connection open if the client set 
+   //FCGI_KEEP_CONN, hand it over to the keep-alive thread in that case
+   if (!keepAlive_.load(memory_order_acquire))
+      req->keepConnection = 0;
+
+   FCGX_Finish_r(req);
+   if (req->keepConnection == 0 || req->ipcFd < 0)
+   {
+      delete req;
+      return;
+   }
+
+   idleQueue_.push_back(move(req));
+   wakeKeepAlive();
 
-      liveThreads_.fetch_add(1, memory_order_relaxed);
-      thread thr(processRequestLambda, request);
-      if (thr.joinable())
-         thr.detach();
+   //the keep-alive thread may have exited in the meantime, in which case 
+   //nobody is left to service the queue
+   if (!keepAlive_.load(memory_order_acquire))
+      closeIdleQueue();
+}
 
-      //TODO: implement thread recycling
-   }
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::closeConnection(FCGX_Request* req)
+{
+   req->keepConnection = 0;
+   FCGX_Finish_r(req);
+   delete req;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void FCGI_Server::processRequest(FCGX_Request* req)
+void FCGI_Server::rejectRequest(
+   FCGX_Request* req, FcgiLane laneID, const string& content)
 {
-   //extract the string command from the fgci request
-   stringstream ss;
-   stringstream retStream;
-   char* content = nullptr;
- 
-   //pass to clients_
-   char* content_length = FCGX_GetParam("CONTENT_LENGTH", req->envp);
-   if (content_length != nullptr)
+   auto count = lanes_.getRejectedCount(laneID);
+   if (count % 1000 == 1)
    {
-      auto a = atoi(content_length);
-      content = new char[a + 1];
-      FCGX_GetStr(content, a, req->in);
-      content[a] = 0;
+      LOGWARN << "request queue full, rejected " << count <<
+         (laneID == FcgiLane_Callback ? " callback" : " rpc") <<
+         " requests so far";
+   }
 
-      string contentStr(content);
+   //a request rejected before its body was read leaves the connection
+   //with unread input, it can't be kept alive. Hex replies are understood
+   //by all clients
+   auto encoding = WireEncoding_Hex;
+   if (content.size() == 0)
+      req->keepConnection = 0;
+   else
+      encoding = WireFrame::getEncoding(content);
 
-      //print HTML header
-      ss << "HTTP/1.1 200 OK\r\n";
-      ss << "Content-Type: text/html; charset=UTF-8\r\n";
+   ErrorType err(SERVER_BUSY_ERROR);
+   Arguments arg;
+   arg.push_back(move(err));
 
-      try
-      {
-         auto&& retVal = clients_.runCommand(contentStr);
-         retStream << retVal.serialize();
+   writeResponse(req, arg.serialize(encoding));
+}
 
-      }
-      catch (exception& e)
-      {
-         ErrorType err(e.what());
-         Arguments arg;
-         arg.push_back(move(err));
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::processRequest(FcgiLanes::Request& fcgiReq)
+{
+   auto&& method = Command::peekMethod(fcgiReq.content_);
+   clients_.stats().recordQueueWait(
+      method, ServerStats::elapsedMicros(fcgiReq.queuedAt_));
 
-         retStream << arg.serialize();
-      }
-      catch (DbErrorMsg &e)
-      {
-         ErrorType err(e.what());
-         Arguments arg;
-         arg.push_back(move(err));
+   //pass to clients_
+   if (BDV_Server_Object::isStreamMethod(method))
+   {
+      FcgiResponseStream stream(fcgiReq.handle_, 
+         WireFrame::getEncoding(fcgiReq.content_));
+      clients_.runStreamCommand(fcgiReq.content_, stream);
+      stream.finish();
 
-         retStream << arg.serialize();
-      }
-      catch (...)
-      {
-         ErrorType err("unknown error");
-         Arguments arg;
-         arg.push_back(move(err));
-         
-         retStream << arg.serialize();
-      }
-      
-      //complete HTML header
-      ss << "Content-Length: " << retStream.str().size();
-      ss << "\r\n\r\n";
+      finishRequest(fcgiReq.handle_);
    }
    else
    {
-      LOGERR << "empty content_length";
-      FCGX_Finish_r(req);
-      delete req;
-
-      liveThreads_.fetch_sub(1, memory_order_relaxed);
-      return;
+      auto&& retStr = clients_.runCommandSerialized(fcgiReq.content_);
+      writeResponse(fcgiReq.handle_, retStr);
    }
 
-   delete[] content;
-   
+   fcgiReq.handle_ = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FCGI_Server::writeResponse(FCGX_Request* req, const string& body)
+{
+   stringstream ss;
+
+   //print HTML header
+   ss << "HTTP/1.1 200 OK\r\n";
+   ss << "Content-Type: text/html; charset=UTF-8\r\n";
+   ss << "Content-Length: " << body.size();
+   ss << "\r\n\r\n";
+
    //print serialized retVal
-   ss << retStream.str();
+   ss << body;
 
    auto&& retStr = ss.str();
    vector<pair<size_t, size_t>> msgOffsetVec;
@@ -1449,13 +2600,48 @@ void FCGI_Server::processRequest(FCGX_Request* req)
    for (auto& offsetPair : msgOffsetVec)
       FCGX_PutStr(ptr + offsetPair.first, offsetPair.second, req->out);
 
-   FCGX_Finish_r(req);
+   finishRequest(req);
+}
 
-   delete req;
+///////////////////////////////////////////////////////////////////////////////
+void FcgiResponseStream::putStr(const string& str)
+{
+   FCGX_PutStr(str.c_str(), str.size(), req_->out);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FcgiResponseStream::sendHeader()
+{
+   if (headerSent_)
+      return;
+
+   stringstream ss;
+   ss << "HTTP/1.1 200 OK\r\n";
+   ss << "Content-Type: text/html; charset=UTF-8";
+   ss << "\r\n\r\n";
+
+   putStr(ss.str());
+   headerSent_ = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void FcgiResponseStream::write(Arguments& batch)
+{
+   sendHeader();
 
-   liveThreads_.fetch_sub(1, memory_order_relaxed);
+   auto& body = batch.serialize(encoding_);
+   putStr(WireFrame::streamHeader(body.size()));
+   putStr(body);
+
+   FCGX_FFlush(req_->out);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void FcgiResponseStream::finish()
+{
+   sendHeader();
+   putStr(WireFrame::streamHeader(0));
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 BDV_Server_Object::BDV_Server_Object(
@@ -1481,7 +2667,7 @@ BDV_Server_Object::BDV_Server_Object(
    
    cb_ = make_shared<SocketCallback>(isReadyLambda);
 
-   bdvID_ = SecureBinaryData().GenerateRandom(10).toHexStr();
+   bdvID_ = SecureBinaryData().GenerateRandom(BDV_ID_LENGTH / 2).toHexStr();
    buildMethodMap();
 
    //register with ZC container
@@ -1826,6 +3012,123 @@ bool BDV_Server_Object::registerLockbox(
    return bdvPtr->registerLockbox(scrAddrVec, IDstr, wltIsNew) != nullptr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+Arguments BDV_Server_Object::getCombinedWalletState(
+   const vector<BinaryData>& walletIDs, unsigned height,
+   bool withAddrData, bool withUtxos)
+{
+   /***
+   Batch counterpart to getBalancesAndCount, getAddrTxnCounts, 
+   getAddrBalances and getSpendableTxOutListForValue. Wallets are resolved
+   in a single pass over the groups, then their states are computed in 
+   parallel on the WorkerPool shared by all BDVs.
+
+   Reply is the wallet count followed by one entry per wallet, in request 
+   order:
+      id, full, spendable & unconfirmed balance, txn count
+      if withAddrData: txn count map, then balance map, as per 
+         getAddrTxnCounts and getAddrBalances
+      if withUtxos: utxo count then serialized UTXOs
+   ***/
+
+   vector<shared_ptr<BtcWallet>> wltVec(walletIDs.size());
+   //wallets are processed concurrently, each can only appear once
+   map<BinaryData, unsigned> idMap;
+   for (unsigned i = 0; i < walletIDs.size(); i++)
+   {
+      if (!idMap.insert(make_pair(walletIDs[i], i)).second)
+         throw runtime_error("duplicate wallet ID");
+   }
+
+   for (auto& group : groups_)
+   {
+      for (auto& wlt : group.wallets_)
+      {
+         auto idIter = idMap.find(wlt.first);
+         if (idIter == idMap.end())
+            continue;
+
+         wltVec[idIter->second] = wlt.second;
+      }
+   }
+
+   for (auto& wltPtr : wltVec)
+   {
+      if (wltPtr == nullptr)
+         throw runtime_error("unknown wallet or lockbox ID");
+   }
+
+   auto topHeight = getTopBlockHeight();
+   auto updateID = updateID_;
+
+   auto getWalletState = [&](unsigned id)->Arguments
+   {
+      auto& wltPtr = wltVec[id];
+
+      Arguments retarg;
+      auto& bw = retarg.getWriter();
+      retarg.push_back(move(BinaryDataObject(walletIDs[id])));
+      retarg.push_back(move(IntType(wltPtr->getFullBalance())));
+      retarg.push_back(move(IntType(wltPtr->getSpendableBalance(height))));
+      retarg.push_back(move(IntType(wltPtr->getUnconfirmedBalance(height))));
+      retarg.push_back(move(IntType(wltPtr->getWltTotalTxnCount())));
+
+      if (withAddrData)
+      {
+         auto&& countMap = wltPtr->getAddrTxnCounts(updateID);
+         retarg.push_back(move(IntType(countMap.size())));
+         for (auto& count : countMap)
+         {
+            retarg.push_back(move(BinaryDataObject(count.first)));
+            retarg.push_back(move(IntType(count.second)));
+         }
+
+         auto&& balanceMap = wltPtr->getAddrBalances(updateID, topHeight);
+         retarg.push_back(move(IntType(balanceMap.size())));
+         for (auto& balances : balanceMap)
+         {
+            retarg.push_back(move(BinaryDataObject(balances.first)));
+            retarg.push_back(move(IntType(get<0>(balances.second))));
+            retarg.push_back(move(IntType(get<1>(balances.second))));
+            retarg.push_back(move(IntType(get<2>(balances.second))));
+         }
+      }
+
+      if (withUtxos)
+      {
+         auto&& utxoVec = wltPtr->getSpendableTxOutListForValue(UINT64_MAX);
+         retarg.push_back(move(IntType(utxoVec.size())));
+         for (auto& utxo : utxoVec)
+            serializeUtxo(bw, utxo);
+      }
+
+      return retarg;
+   };
+
+   vector<Arguments> stateVec(wltVec.size());
+   auto task = [&](unsigned id)->void
+   {
+      stateVec[id] = move(getWalletState(id));
+   };
+
+   if (pool_ != nullptr)
+   {
+      pool_->run(wltVec.size(), task);
+   }
+   else
+   {
+      for (unsigned i = 0; i < wltVec.size(); i++)
+         task(i);
+   }
+
+   Arguments retarg;
+   retarg.push_back(move(IntType(stateVec.size())));
+   for (auto& state : stateVec)
+      retarg.merge(state);
+
+   return retarg;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 Arguments SocketCallback::respond(const string& command)
 {
@@ -1949,3 +3252,284 @@ Arguments SocketCallback::respond(const string& command)
    //send it
    return move(arg);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketCallback::callback(Arguments&& cmd, OrderType type)
+{
+   //grab the lock even without a channel, so that an order can't be 
+   //queued after attachChannel flushed the queue
+   unique_lock<mutex> lock(pushMu_);
+
+   if (channel_ != nullptr)
+   {
+      if (pushOrder(cmd, type) && type != OrderTerminate)
+         return;
+
+      //client is gone or the bdv is shutting down, orders go to the long
+      //poll queue from here on
+      channel_->shutdown();
+      channel_.reset();
+      hasPushSock_.store(false, memory_order_release);
+
+      if (type == OrderTerminate)
+         return;
+   }
+
+   Callback::callback(move(cmd), type);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool SocketCallback::pushOrder(Arguments& order, OrderType type)
+{
+   Arguments terminateArg;
+   auto argPtr = &order;
+
+   if (type == OrderTerminate)
+   {
+      BinaryDataObject bdo("terminate");
+      terminateArg.push_back(move(bdo));
+      argPtr = &terminateArg;
+   }
+
+   return channel_->writeFrame(0, argPtr->serialize(WireEncoding_Binary));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketCallback::attachChannel(shared_ptr<ClientChannel> channel)
+{
+   unique_lock<mutex> lock(pushMu_);
+
+   if (!cbStack_.isValid())
+   {
+      //bdv is shutting down
+      channel->shutdown();
+      return;
+   }
+
+   //one subscriber per bdv, the latest one wins
+   if (channel_ != nullptr)
+      channel_->shutdown();
+
+   channel_ = channel;
+   hasPushSock_.store(true, memory_order_release);
+   count_.store(0, memory_order_relaxed);
+
+   //flush what was queued before the client subscribed
+   try
+   {
+      while (1)
+      {
+         auto&& order = cbStack_.Stack<OrderStruct>::pop_front(false);
+         if (!pushOrder(order.order_, order.otype_))
+         {
+            channel_->shutdown();
+            channel_.reset();
+            hasPushSock_.store(false, memory_order_release);
+            break;
+         }
+      }
+   }
+   catch (IsEmpty&)
+   {}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketCallback::detachChannel(const ClientChannel* channel)
+{
+   //nullptr detaches whichever channel is attached
+   unique_lock<mutex> lock(pushMu_);
+   if (channel_ == nullptr)
+      return;
+
+   if (channel != nullptr && channel_.get() != channel)
+      return;
+
+   channel_->shutdown();
+   channel_.reset();
+   hasPushSock_.store(false, memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// ClientChannel
+//
+///////////////////////////////////////////////////////////////////////////////
+bool ClientChannel::writeFrame(uint32_t id, const string& packet)
+{
+   BinaryWriter bw(packet.size() + 8);
+   bw.put_uint32_t(packet.size() + 4);
+   bw.put_uint32_t(id);
+   bw.put_BinaryData((uint8_t*)packet.c_str(), packet.size());
+   auto frame = bw.getDataRef();
+
+   unique_lock<mutex> lock(mu_);
+   if (!open_)
+      return false;
+
+   try
+   {
+      sock_->writeToSocket((void*)frame.getPtr(), frame.getSize());
+   }
+   catch (SocketError&)
+   {
+      open_ = false;
+      return false;
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ClientChannel::close()
+{
+   unique_lock<mutex> lock(mu_);
+   open_ = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// NotificationServer
+//
+///////////////////////////////////////////////////////////////////////////////
+bool NotificationServer::start(const string& addr, const string& port)
+{
+   auto connectLbd = [this](
+      shared_ptr<DedicatedBinarySocket> sock)->ReadCallback
+   {
+      return this->subscribe(sock);
+   };
+
+   try
+   {
+      listenServer_ = make_unique<ListenServer>(addr, port);
+      listenServer_->start(ListenServer::ConnectCallback(connectLbd));
+   }
+   catch (SocketError&)
+   {
+      listenServer_.reset();
+      return false;
+   }
+
+   port_ = atoi(port.c_str());
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void NotificationServer::stop()
+{
+   if (listenServer_ == nullptr)
+      return;
+
+   listenServer_->stop();
+   listenServer_.reset();
+   port_ = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+ReadCallback NotificationServer::subscribe(
+   shared_ptr<DedicatedBinarySocket> sock)
+{
+   struct Subscription
+   {
+      string buffer_;
+      bool subscribed_ = false;
+      weak_ptr<SocketCallback> cb_;
+   };
+
+   auto sub = make_shared<Subscription>();
+   auto channel = make_shared<ClientChannel>(sock);
+
+   auto readLbd = [this, sub, channel](
+      vector<uint8_t> data, exception_ptr eptr)->bool
+   {
+      //socket is closing, let go of it
+      if (data.size() == 0 || eptr != nullptr)
+      {
+         channel->close();
+
+         auto cbPtr = sub->cb_.lock();
+         if (cbPtr != nullptr)
+            cbPtr->detachChannel(channel.get());
+
+         return true;
+      }
+
+      sub->buffer_.append((char*)&data[0], data.size());
+
+      if (!sub->subscribed_)
+      {
+         string bdvID;
+         try
+         {
+            BinaryRefReader brr(
+               (uint8_t*)sub->buffer_.c_str(), sub->buffer_.size());
+            auto len = brr.get_var_int();
+
+            //the client isn't authenticated yet, don't buffer more than 
+            //a bdv id for it
+            if (len > BDV_ID_LENGTH)
+            {
+               LOGWARN << "invalid subscription, closing channel";
+               return true;
+            }
+
+            if (len > brr.getSizeRemaining())
+               return false;
+
+            auto idRef = brr.get_BinaryDataRef(len);
+            bdvID = string((char*)idRef.getPtr(), len);
+            sub->buffer_.erase(0, brr.getPosition());
+         }
+         catch (runtime_error&)
+         {
+            //wait on the rest of the subscription
+            return false;
+         }
+
+         shared_ptr<SocketCallback> cbPtr;
+         try
+         {
+            auto bdvPtr = clients_->get(bdvID);
+            cbPtr = bdvPtr->getCallback();
+         }
+         catch (runtime_error&)
+         {
+         }
+
+         if (cbPtr == nullptr)
+            return true;
+
+         sub->subscribed_ = true;
+         sub->cb_ = cbPtr;
+         cbPtr->attachChannel(channel);
+      }
+
+      //pipelined commands
+      size_t offset = 0;
+      while (sub->buffer_.size() - offset >= 8)
+      {
+         BinaryRefReader brr(
+            (uint8_t*)sub->buffer_.c_str() + offset, 8);
+         auto len = brr.get_uint32_t();
+         auto id = brr.get_uint32_t();
+
+         if (len < 4 || len > MAX_CONTENT_LENGTH || id == 0)
+         {
+            LOGWARN << "malformed pipelined command, closing channel";
+            return true;
+         }
+
+         if (sub->buffer_.size() - offset - 4 < len)
+            break;
+
+         clients_->queuePipelined(
+            channel, id, sub->buffer_.substr(offset + 8, len - 4));
+         offset += len + 4;
+      }
+
+      sub->buffer_.erase(0, offset);
+      return false;
+   };
+
+   return readLbd;
+}
@@ -14,6 +14,8 @@
 #include <mutex>
 #include <thread>
 #include <future>
+#include <set>
+#include <condition_variable>
 
 #include "BitcoinP2p.h"
 #include "./fcgi/include/fcgiapp.h"
@@ -28,7 +30,18 @@
 #include "FcgiMessage.h"
 
 #define MAX_CONTENT_LENGTH 1024*1024*1024
+#define BDV_ID_LENGTH 20
 #define CALLBACK_EXPIRE_COUNT 5
+#define FCGI_KEEPALIVE_TIMEOUT 30
+#define PIPELINE_MAX_INFLIGHT 256
+#define STREAM_BATCH_SIZE 1000
+
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_MAX_SHIFT 36
+
+#define SERVER_BUSY_ERROR "busy"
+#define HEAVY_WAITING_PER_CLIENT 2
+#define HEAVY_WAIT_TIMEOUT 30
 
 enum WalletType
 {
@@ -36,27 +49,88 @@ enum WalletType
    TypeLockbox
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class ClientChannel
+{
+   /***
+   Write side of a NotificationServer connection. Notifications and replies
+   to pipelined commands share the socket, writes are serialized.
+   ***/
+
+private:
+   mutex mu_;
+   shared_ptr<DedicatedBinarySocket> sock_;
+   bool open_ = true;
+
+public:
+   //pipelined commands queued or being processed
+   atomic<unsigned> inflight_;
+
+public:
+   ClientChannel(shared_ptr<DedicatedBinarySocket> sock) :
+      sock_(sock)
+   {
+      inflight_.store(0, memory_order_relaxed);
+   }
+
+   //false if the socket could not be written to
+   bool writeFrame(uint32_t id, const string& packet);
+
+   //wakes up the read loop, which closes the socket
+   void shutdown(void) { sock_->shutdown(); }
+
+   //no more writes past this point, the socket is about to be closed
+   void close(void);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class SocketCallback : public Callback
 {
+   /***
+   Notifications are queued for registerCallback long polls, unless the 
+   client subscribed through the NotificationServer. In that case they are
+   written to its channel as they come. Orders queued before the client 
+   subscribed are flushed to the channel on subscription.
+   ***/
+
 private:
    mutex mu_;
    atomic<unsigned> count_;
 
    function<unsigned(void)> isReady_;
 
+   mutex pushMu_;
+   shared_ptr<ClientChannel> channel_;
+   atomic<bool> hasPushSock_;
+
+private:
+   //false if the socket could not be written to
+   bool pushOrder(Arguments&, OrderType);
+
 public:
    SocketCallback(function<unsigned(void)> isReady) :
       Callback(), isReady_(isReady)
    {
       count_.store(0, memory_order_relaxed);
+      hasPushSock_.store(false, memory_order_relaxed);
    }
 
    void emit(void);
    Arguments respond(const string&);
+   void callback(Arguments&&, OrderType type = OrderOther);
+
+   void attachChannel(shared_ptr<ClientChannel>);
+   void detachChannel(const ClientChannel*);
 
    bool isValid(void)
    {
+      //a subscribed client is alive for as long as its socket is
+      if (hasPushSock_.load(memory_order_acquire))
+      {
+         count_.store(0, memory_order_relaxed);
+         return true;
+      }
+
       unique_lock<mutex> lock(mu_, defer_lock);
 
       if (lock.try_lock())
@@ -72,6 +146,7 @@ public:
    ~SocketCallback(void)
    {
       Callback::shutdown();
+      detachChannel(nullptr);
 
       //after signaling shutdown, grab the mutex to make sure 
       //all responders threads have terminated
@@ -84,6 +159,167 @@ public:
    }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class LatencyHistogram
+{
+   /***
+   HDR style histogram of latencies in microseconds. Values are bucketed 
+   by power of 2, each power being split in LATENCY_SUB_BUCKETS linear 
+   buckets, which keeps the error within ~6% from 1us to days. 
+
+   Recording is a handful of relaxed atomic ops, it takes no lock. Reads
+   are not a consistent snapshot, which is fine for reporting.
+   ***/
+
+public:
+   static const unsigned BUCKET_COUNT = 
+      (LATENCY_MAX_SHIFT + 2) * LATENCY_SUB_BUCKETS;
+
+private:
+   atomic<uint64_t> buckets_[BUCKET_COUNT];
+   atomic<uint64_t> count_;
+   atomic<uint64_t> sum_;
+   atomic<uint64_t> max_;
+
+private:
+   static unsigned bucketIndex(uint64_t);
+   static uint64_t bucketHighValue(unsigned);
+
+public:
+   LatencyHistogram(void);
+
+   void record(uint64_t micros);
+
+   uint64_t count(void) const { return count_.load(memory_order_relaxed); }
+   uint64_t sum(void) const { return sum_.load(memory_order_relaxed); }
+   uint64_t max(void) const { return max_.load(memory_order_relaxed); }
+
+   //upper bound of the bucket holding the percentile, 0 if empty
+   uint64_t percentile(double) const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct MethodStats
+{
+   atomic<uint64_t> calls_;
+   atomic<uint64_t> errors_;
+
+   //time spent waiting on a worker, then running the method
+   LatencyHistogram queueWait_;
+   LatencyHistogram execution_;
+
+   MethodStats(void)
+   {
+      calls_.store(0, memory_order_relaxed);
+      errors_.store(0, memory_order_relaxed);
+   }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class ServerStats
+{
+   /***
+   Request counters and latencies per method. Served by getServerStats and
+   dumped to the log every statsLogInterval_ seconds.
+
+   Entries are made at construction for the methods the server knows of
+   and are not added to afterwards, so lookups take no lock. Method names 
+   come from clients, all others are accounted for under "unknown". 
+   Methods that were never called are left out of the stats.
+   ***/
+
+private:
+   map<string, shared_ptr<MethodStats>> methods_;
+   MethodStats* unknown_;
+
+private:
+   MethodStats& getMethod(const string&);
+
+public:
+   ServerStats(const set<string>& methods);
+
+   void recordQueueWait(const string& method, uint64_t micros);
+   void recordExecution(const string& method, uint64_t micros, bool failed);
+
+   /***
+   method count, then for each method:
+      name, calls, errors,
+      queue wait: count, sum, max, p50, p90, p99, p999
+      execution: same as above
+   times are in microseconds
+   ***/
+   Arguments getStats(void) const;
+   void log(void) const;
+
+   static uint64_t elapsedMicros(chrono::steady_clock::time_point);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class ResponseStream
+{
+   /***
+   Sink for the replies of stream methods. These are sent as a sequence of
+   batches, each a standalone Arguments object: an entry count followed by
+   as many entries. A batch with a count of 0 ends the stream. Errors are 
+   sent as a batch holding a single ErrorType, and end the stream as well.
+   ***/
+
+public:
+   virtual ~ResponseStream(void) {}
+   virtual void write(Arguments&) = 0;
+
+   void writeError(const string&);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class BufferedResponseStream : public ResponseStream
+{
+   //gathers the batches in a single reply, for transports that cannot stream
+
+public:
+   Arguments reply_;
+
+   void write(Arguments& batch) { reply_.merge(batch); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class StreamBatch
+{
+   //fills batches, sends them every STREAM_BATCH_SIZE entries
+
+private:
+   ResponseStream& stream_;
+   Arguments entries_;
+   unsigned count_ = 0;
+
+public:
+   StreamBatch(ResponseStream& stream) :
+      stream_(stream)
+   {
+      entries_.getWriter();
+   }
+
+   template<typename T> void push_back(T&& obj)
+   {
+      entries_.push_back(move(obj));
+      added();
+   }
+
+   //for entries serialized in place, call added() after each of them
+   BinaryWriter& getWriter(void) { return entries_.getWriter(); }
+
+   void added(void)
+   {
+      if (++count_ >= STREAM_BATCH_SIZE)
+         flush();
+   }
+
+   void flush(void);
+
+   //flushes the last entries then ends the stream
+   void finish(void);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class BDV_Server_Object : public BlockDataViewer
 {
@@ -92,6 +328,8 @@ class BDV_Server_Object : public BlockDataViewer
 private:
    map<string, function<Arguments(
       const vector<string>&, Arguments&)>> methodMap_;
+   map<string, function<void(
+      const vector<string>&, Arguments&, ResponseStream&)>> streamMethodMap_;
    
    thread tID_, initT_;
    shared_ptr<SocketCallback> cb_;
@@ -99,6 +337,13 @@ private:
    string bdvID_;
    BlockDataManagerThread* bdmT_;
 
+   //set by Clients, null if no stats are kept
+   ServerStats* stats_ = nullptr;
+
+   //set by Clients, shared by all BDVs. Batch methods run serially 
+   //without it
+   WorkerPool* pool_ = nullptr;
+
    map<string, LedgerDelegate> delegateMap_;
 
    struct walletRegStruct
@@ -133,6 +378,9 @@ private:
       vector<BinaryData> const& scrAddrVec, string IDstr, bool wltIsNew);
    void registerAddrVec(const string&, vector<BinaryData> const& scrAddrVec);
 
+   Arguments getCombinedWalletState(const vector<BinaryData>& walletIDs,
+      unsigned height, bool withAddrData, bool withUtxos);
+
    void pushNotification(unique_ptr<BDV_Notification> notifPtr)
    {
       notificationStack_.push_back(move(notifPtr));
@@ -152,12 +400,19 @@ public:
    }
 
    const string& getID(void) const { return bdvID_; }
+   shared_ptr<SocketCallback> getCallback(void) const { return cb_; }
    void maintenanceThread(void);
    void init(void);
 
    Arguments executeCommand(const string& method, 
                               const vector<string>& ids, 
                               Arguments& args);
+   void executeStreamCommand(const string& method,
+      const vector<string>& ids, Arguments& args, ResponseStream& stream);
+   static bool isStreamMethod(const string& method);
+
+   //methodMap_ and streamMethodMap_ entries
+   static const set<string>& getMethodNames(void);
   
    void zcCallback(
       map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> zcMap);
@@ -168,6 +423,198 @@ public:
    void haltThreads(void);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class Clients;
+
+class NotificationServer
+{
+   /***
+   Streams BDV notifications over persistent sockets, in place of 
+   registerCallback long polls.
+
+   Clients connect to the port advertised in the registerBDV reply and 
+   send their bdv id, var_int length prefixed. Notifications are then 
+   written as they happen.
+
+   The connection also carries pipelined commands. Any number of them can
+   be in flight, they run concurrently on the Clients pipeline workers and
+   are answered in completion order.
+
+   Frames in both directions are a uint32 LE length, a uint32 LE request id
+   and a WireFrame packet, the length covers the id and the packet. Client 
+   frames longer than MAX_CONTENT_LENGTH close the channel. Clients
+   send Command packets under ids of their choosing, replies carry the id 
+   of the command. Id 0 is reserved for notifications.
+   ***/
+
+private:
+   Clients* clients_;
+   unique_ptr<ListenServer> listenServer_;
+   unsigned port_ = 0;
+
+private:
+   ReadCallback subscribe(shared_ptr<DedicatedBinarySocket>);
+
+public:
+   NotificationServer(Clients* clients) :
+      clients_(clients)
+   {}
+
+   ~NotificationServer(void)
+   {
+      stop();
+   }
+
+   //returns false if the port is taken
+   bool start(const string& addr, const string& port);
+   void stop(void);
+
+   unsigned port(void) const { return port_; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+struct ServerBusy : public runtime_error
+{
+   ServerBusy(void) : 
+      runtime_error(SERVER_BUSY_ERROR)
+   {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+enum MethodCost
+{
+   MethodCost_Free = 0,
+   MethodCost_Cheap = 1,
+   MethodCost_Moderate = 5,
+   MethodCost_Heavy = 50
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class TokenBucket
+{
+private:
+   mutex mu_;
+   double tokens_;
+   chrono::steady_clock::time_point last_;
+
+public:
+   TokenBucket(double tokens) :
+      tokens_(tokens), last_(chrono::steady_clock::now())
+   {}
+
+   //refills then takes cost tokens, false if there are not enough
+   bool consume(double cost, double rate, double burst);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class FairScheduler
+{
+   /***
+   Caps how many heavy commands run at once. Commands contending for a slot
+   are served in start time fair queuing order keyed by client: each client
+   is charged the cost of its commands, and the one with the lowest charge
+   goes first. A client flooding heavy requests delays its own, not the
+   others'.
+
+   Waiting commands hold the worker thread that runs them. The queue is 
+   capped per client and in total so that waiters can't take up all the 
+   workers, commands past either cap are turned down right away.
+   ***/
+
+private:
+   mutex mu_;
+   condition_variable cv_;
+
+   const unsigned slots_;
+   const unsigned maxWaiting_;
+   const unsigned maxWaitingPerClient_;
+   unsigned running_ = 0;
+   uint64_t seq_ = 0;
+
+   //start tag of the last dispatched command
+   uint64_t virtualTime_ = 0;
+   map<string, uint64_t> finishTags_;
+
+   //start tag, arrival order
+   set<pair<uint64_t, uint64_t>> waiting_;
+   map<string, unsigned> clientWaiting_;
+
+public:
+   FairScheduler(unsigned slots, 
+      unsigned maxWaiting, unsigned maxWaitingPerClient) :
+      slots_(slots), maxWaiting_(maxWaiting), 
+      maxWaitingPerClient_(maxWaitingPerClient)
+   {}
+
+   //false if the queue is full or the wait times out
+   bool acquire(const string& id, unsigned cost, chrono::milliseconds timeout);
+   void release(void);
+
+   //drops the client's charge
+   void forget(const string& id);
+   size_t waitingCount(void);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class AdmissionControl
+{
+   /***
+   Sits in front of BDV commands. Each client (bdv id) has a token bucket 
+   refilled at admission-rate cost units per second, up to admission-burst.
+   Heavy methods also need a FairScheduler slot. Commands that can't be 
+   admitted are answered with a SERVER_BUSY_ERROR instead of tying up a
+   worker and a db read transaction.
+   ***/
+
+private:
+   const double rate_;
+   const double burst_;
+   TransactionalMap<string, shared_ptr<TokenBucket>> buckets_;
+   FairScheduler scheduler_;
+   atomic<uint64_t> rejected_;
+
+private:
+   shared_ptr<TokenBucket> getBucket(const string& id);
+   void reject(const string& id, const string& method);
+
+public:
+   AdmissionControl(const BlockDataManagerConfig&);
+
+   static MethodCost getMethodCost(const string& method);
+
+   //throws ServerBusy. Returns true if a scheduler slot was taken, give it 
+   //back with done()
+   bool admit(const string& id, const string& method);
+   void done(void) { scheduler_.release(); }
+
+   void forget(const string& id);
+   uint64_t getRejectedCount(void) const 
+   { return rejected_.load(memory_order_relaxed); }
+   FairScheduler& scheduler(void) { return scheduler_; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class AdmissionSlot
+{
+   //admits a command for the lifetime of the object, throws ServerBusy
+
+private:
+   AdmissionControl& admission_;
+   const bool hasSlot_;
+
+public:
+   AdmissionSlot(AdmissionControl& admission, 
+      const string& id, const string& method) :
+      admission_(admission), hasSlot_(admission.admit(id, method))
+   {}
+
+   ~AdmissionSlot(void)
+   {
+      if (hasSlot_)
+         admission_.done();
+   }
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class Clients
 {
@@ -183,16 +630,50 @@ private:
    thread mainteThr_;
    thread gcThread_;
 
+   unique_ptr<NotificationServer> notifServer_;
+
+   struct PipelinedCommand
+   {
+      shared_ptr<ClientChannel> channel_;
+      uint32_t id_ = 0;
+      string command_;
+      chrono::steady_clock::time_point queuedAt_;
+   };
+
+   BlockingStack<PipelinedCommand> pipelineQueue_;
+   vector<thread> pipelineThreads_;
+
+   ServerStats stats_;
+   AdmissionControl admission_;
+
+   //for batch methods that spread their work over threads
+   WorkerPool pool_;
+
 private:
    void maintenanceThread(void) const;
    void garbageCollectorThread(void);
    void unregisterAllBDVs(void);
+   void pipelineWorker(void);
+
+   //methods that get an entry in stats_
+   static set<string> getStatsMethodNames(void);
+
+   static unsigned getPoolThreadCount(const BlockDataManagerConfig& config)
+   {
+      //callers of WorkerPool::run take work as well
+      if (config.threadCount_ == 0)
+         return 0;
+      return config.threadCount_ - 1;
+   }
 
 public:
 
    Clients(BlockDataManagerThread* bdmT,
       function<void(void)> shutdownLambda) :
-      bdmT_(bdmT), fcgiShutdownCallback_(shutdownLambda)
+      bdmT_(bdmT), fcgiShutdownCallback_(shutdownLambda),
+      stats_(getStatsMethodNames()),
+      admission_(bdmT->bdm()->config()),
+      pool_(getPoolThreadCount(bdmT->bdm()->config()))
    {
       run_.store(true, memory_order_relaxed);
 
@@ -217,11 +698,269 @@ public:
 
    const shared_ptr<BDV_Server_Object>& get(const string& id) const;
    Arguments runCommand(const string& cmd);
+
+   //runs the command and serializes the reply in the command's encoding,
+   //errors are serialized as ErrorType
+   string runCommandSerialized(const string& cmd);
+
+   //runs a stream method, errors are written to the stream
+   void runStreamCommand(const string& cmd, ResponseStream&);
    Arguments processShutdownCommand(Command&);
    Arguments registerBDV(Arguments& arg);
    void unregisterBDV(const string& bdvId);
    void shutdown(void);
    void exitRequestLoop(void);
+
+   void startNotificationServer(const string& addr, const string& port);
+   unsigned getNotificationPort(void) const;
+
+   ServerStats& stats(void) { return stats_; }
+   AdmissionControl& admission(void) { return admission_; }
+
+   //queues a command received over a ClientChannel, the reply is written
+   //to the channel under the same id
+   void queuePipelined(shared_ptr<ClientChannel>, uint32_t id, string&& cmd);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class FcgiResponseStream : public ResponseStream
+{
+   /***
+   Sends batches back to back in the WireFrame stream format. The reply 
+   has no length and no transfer encoding, batches delimit themselves. Each
+   one is flushed on its own so that it goes out as FCGI_STDOUT records 
+   right away, the proxy must not buffer them (fastcgi_buffering off).
+   ***/
+
+private:
+   FCGX_Request* req_;
+   const WireEncoding encoding_;
+   bool headerSent_ = false;
+
+private:
+   void putStr(const string&);
+   void sendHeader(void);
+
+public:
+   FcgiResponseStream(FCGX_Request* req, WireEncoding encoding) :
+      req_(req), encoding_(encoding)
+   {}
+
+   void write(Arguments&);
+
+   //ends the stream, the request still has to be finished
+   void finish(void);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+enum FcgiLane
+{
+   FcgiLane_RPC,
+   FcgiLane_Callback,
+   FcgiLane_Count
+};
+
+///////////////////////////////////////////////////////////////////////////////
+template<typename T> class RequestLanes
+{
+   /***
+   Fixed pool of worker threads serving FCGI_Server requests, split in lanes.
+
+   Accepted requests are queued to the rpc lane before their body is read,
+   so that a slow or half sent request ties up a worker rather than the 
+   threads accepting connections. The worker reads the body, then hands 
+   registerCallback long polls over to the callback lane so that they cannot
+   starve short RPCs of workers.
+
+   A request that finds its lane's queue full is rejected right away.
+   ***/
+
+public:
+   struct Request
+   {
+      T handle_ = T();
+      FcgiLane lane_ = FcgiLane_RPC;
+      string content_;
+      chrono::steady_clock::time_point queuedAt_;
+   };
+
+   //reads the body of the request, false on failure
+   typedef function<bool(T, string&)> ReadBody;
+   typedef function<void(Request&)> Process;
+
+   //the body is empty if the request was rejected before it was read
+   typedef function<void(T, FcgiLane, const string&)> Reject;
+
+   //for requests which body could not be read
+   typedef function<void(T)> Drop;
+
+private:
+   struct Lane
+   {
+      BlockingStack<Request> queue_;
+      vector<thread> workers_;
+      unsigned threadCount_ = 1;
+      unsigned maxQueued_ = 1;
+      atomic<uint64_t> rejected_;
+
+      Lane(void)
+      {
+         rejected_.store(0, memory_order_relaxed);
+      }
+   };
+
+   Lane lanes_[FcgiLane_Count];
+
+   //requests that are queued or being processed
+   atomic<uint32_t> live_;
+
+   const ReadBody readBody_;
+   const Process process_;
+   const Reject reject_;
+   const Drop drop_;
+
+private:
+   bool queue(FcgiLane laneID, Request& req)
+   {
+      auto& lane = lanes_[laneID];
+      if (lane.queue_.count() >= lane.maxQueued_)
+      {
+         lane.rejected_.fetch_add(1, memory_order_relaxed);
+         reject_(req.handle_, laneID, req.content_);
+         return false;
+      }
+
+      req.lane_ = laneID;
+      live_.fetch_add(1, memory_order_relaxed);
+      lane.queue_.push_back(move(req));
+      return true;
+   }
+
+   void serve(Request& req)
+   {
+      if (req.lane_ == FcgiLane_RPC)
+      {
+         //fresh off the accept thread, the body hasn't been read yet
+         if (!readBody_(req.handle_, req.content_))
+         {
+            drop_(req.handle_);
+            return;
+         }
+
+         auto laneID = getLane(req.content_);
+         if (laneID != FcgiLane_RPC)
+         {
+            queue(laneID, req);
+            return;
+         }
+      }
+
+      process_(req);
+   }
+
+   void workerLoop(Lane& lane)
+   {
+      while (1)
+      {
+         Request req;
+         try
+         {
+            req = move(lane.queue_.pop_front());
+         }
+         catch (StopBlockingLoop&)
+         {
+            break;
+         }
+
+         serve(req);
+         live_.fetch_sub(1, memory_order_relaxed);
+      }
+   }
+
+public:
+   RequestLanes(ReadBody readBody, Process process, Reject reject, Drop drop) :
+      readBody_(readBody), process_(process), reject_(reject), drop_(drop)
+   {
+      live_.store(0, memory_order_relaxed);
+   }
+
+   ~RequestLanes(void)
+   {
+      stop();
+   }
+
+   void setLane(FcgiLane laneID, unsigned threadCount, unsigned maxQueued)
+   {
+      lanes_[laneID].threadCount_ = threadCount;
+      lanes_[laneID].maxQueued_ = maxQueued;
+   }
+
+   void start(void)
+   {
+      for (auto& lane : lanes_)
+      {
+         auto laneLambda = [this, &lane](void)->void
+         {
+            this->workerLoop(lane);
+         };
+
+         for (unsigned i = 0; i < lane.threadCount_; i++)
+            lane.workers_.push_back(thread(laneLambda));
+      }
+   }
+
+   void stop(void)
+   {
+      /***
+      Let the workers drain their queues before exiting. The rpc lane goes
+      first, its workers may still hand requests over to the other lanes.
+      ***/
+      for (auto& lane : lanes_)
+      {
+         lane.queue_.completed();
+
+         for (auto& thr : lane.workers_)
+         {
+            if (thr.joinable())
+               thr.join();
+         }
+
+         lane.workers_.clear();
+         lane.queue_.clear();
+      }
+   }
+
+   //queues a freshly accepted request, false if it was rejected
+   bool push(T handle)
+   {
+      Request req;
+      req.handle_ = handle;
+      req.queuedAt_ = chrono::steady_clock::now();
+      return queue(FcgiLane_RPC, req);
+   }
+
+   static FcgiLane getLane(const string& content)
+   {
+      if (Command::peekMethod(content) == "registerCallback")
+         return FcgiLane_Callback;
+
+      return FcgiLane_RPC;
+   }
+
+   unsigned threadCount(FcgiLane laneID) const
+   {
+      return lanes_[laneID].threadCount_;
+   }
+
+   uint32_t liveCount(void) const
+   {
+      return live_.load(memory_order_relaxed);
+   }
+
+   uint64_t getRejectedCount(FcgiLane laneID) const
+   {
+      return lanes_[laneID].rejected_.load(memory_order_relaxed);
+   }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -231,18 +970,39 @@ class FCGI_Server
    Figure if it should use a socket or a named pipe.
    Force it to listen only to localhost if we use a socket 
    (both in *nix and win32 code files)
+
+   Accepted requests are served by a RequestLanes worker pool, which also
+   reads their body.
+
+   Connections opened with FCGI_KEEP_CONN are handed to a keep-alive thread
+   once their request is answered. It polls them for the next request and 
+   queues it like a freshly accepted one. Idle connections are dropped after
+   FCGI_KEEPALIVE_TIMEOUT seconds.
+
+   Stream methods are answered with a streamed reply, see 
+   FcgiResponseStream.
    ***/
 
+private:
+   typedef RequestLanes<FCGX_Request*> FcgiLanes;
+
 private:
    SOCKET sockfd_ = -1;
    mutex mu_;
    int run_ = true;
-   atomic<uint32_t> liveThreads_;
-
+   
    const string port_;
    const string ip_;
+   string notifyPort_;
 
    Clients clients_;
+   FcgiLanes lanes_;
+
+   //kept alive connections waiting on their next request
+   Stack<FCGX_Request*> idleQueue_;
+   thread keepAliveThread_;
+   atomic<bool> keepAlive_;
+   int wakeFds_[2];
 
 private:
    function<void(void)> getShutdownCallback(void)
@@ -255,24 +1015,74 @@ private:
       return shutdownCallback;
    }
 
+   static bool readBody(FCGX_Request*, string&);
+   void rejectRequest(FCGX_Request*, FcgiLane, const string&);
+   void writeResponse(FCGX_Request*, const string&);
+   void processRequest(FcgiLanes::Request&);
+   void dispatchRequest(FCGX_Request*);
+
+   void startKeepAlive(void);
+   void stopKeepAlive(void);
+   void keepAliveLoop(void);
+   void wakeKeepAlive(void);
+   void finishRequest(FCGX_Request*);
+   void closeIdleQueue(void);
+   static void closeConnection(FCGX_Request*);
+
 public:
    FCGI_Server(BlockDataManagerThread* bdmT, string port, bool listen_all) :
+      port_(port), ip_(listen_all ? "" : "127.0.0.1"),
       clients_(bdmT, getShutdownCallback()),
-      ip_(listen_all ? "" : "127.0.0.1"), port_(port)
+      lanes_(readBody, 
+         [this](FcgiLanes::Request& req)->void
+         { this->processRequest(req); },
+         [this](FCGX_Request* req, FcgiLane laneID, const string& content)->void
+         { this->rejectRequest(req, laneID, content); },
+         closeConnection)
    {
       LOGINFO << "Listening on port " << port;
       if (listen_all)
          LOGWARN << "Listening to all incoming connections";
 
-      liveThreads_.store(0, memory_order_relaxed);
+      keepAlive_.store(false, memory_order_relaxed);
+      wakeFds_[0] = wakeFds_[1] = -1;
+
+      auto& config = bdmT->bdm()->config();
+      notifyPort_ = config.notifyPort_;
+      if (notifyPort_.size() == 0)
+      {
+         auto portInt = atoi(port.c_str());
+         if (portInt > 0 && portInt < 65535)
+            notifyPort_ = to_string(portInt + 1);
+      }
+
+      lanes_.setLane(FcgiLane_RPC, 
+         config.fcgiThreadCount_, config.fcgiQueueDepth_);
+      lanes_.setLane(FcgiLane_Callback, 
+         config.fcgiCallbackThreadCount_, config.fcgiQueueDepth_);
+   }
+
+   ~FCGI_Server(void)
+   {
+#ifndef _WIN32
+      if (wakeFds_[0] != -1)
+      {
+         close(wakeFds_[0]);
+         close(wakeFds_[1]);
+      }
+#endif
    }
 
    void init(void);
    void enterLoop(void);
-   void processRequest(FCGX_Request* req);
    void haltFcgiLoop(void);
    void shutdown(void) { clients_.shutdown(); }
    void checkSocket(void) const;
+
+   uint64_t getRejectedCount(FcgiLane lane) const
+   {
+      return lanes_.getRejectedCount(lane);
+   }
 };
 
 #endif
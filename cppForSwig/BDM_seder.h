@@ -39,6 +39,50 @@ public:
 
    void serialize(BinaryWriter &bw) const;
    static LedgerEntryVector deserialize(BinaryRefReader& bdr);
+
+   /***
+   In place writers, for servers to serialize their own ledger objects 
+   without converting them to LedgerEntryData first. Write the header with 
+   the entry count, then each entry.
+   ***/
+   static void serializeHeader(BinaryWriter& bw, size_t count);
+
+   template<typename T> static void serializeEntry(BinaryWriter& bw,
+      const BinaryDataRef& id, int64_t value, uint32_t blockNum,
+      const BinaryData& txHash, uint32_t index, uint32_t txTime,
+      bool isCoinbase, bool isSentToSelf, bool isChangeBack, 
+      bool optInRBF, bool isChainedZC, bool isWitness, 
+      const T& scrAddrs)
+   {
+      auto idSize = id.getSize();
+      bw.put_var_int(idSize + 53);
+
+      bw.put_var_int(idSize);
+      bw.put_BinaryDataRef(id);
+
+      bw.put_uint64_t(value);
+      bw.put_uint32_t(blockNum);
+      bw.put_BinaryData(txHash);
+      bw.put_uint32_t(index);
+      bw.put_uint32_t(txTime);
+
+      //same layout as a BitPacker<uint8_t>, first flag is the high bit
+      uint8_t flags = 0;
+      flags |= (uint8_t)isCoinbase << 7;
+      flags |= (uint8_t)isSentToSelf << 6;
+      flags |= (uint8_t)isChangeBack << 5;
+      flags |= (uint8_t)optInRBF << 4;
+      flags |= (uint8_t)isChainedZC << 3;
+      flags |= (uint8_t)isWitness << 2;
+      bw.put_uint8_t(flags);
+
+      bw.put_var_int(scrAddrs.size());
+      for (auto& scrAddr : scrAddrs)
+      {
+         bw.put_var_int(scrAddr.getSize());
+         bw.put_BinaryData(scrAddr);
+      }
+   }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -72,11 +116,14 @@ public:
    string toStr(void) const
    {
       string str(bd_.toCharPtr(), bd_.getSize());
-      return move(str);
+      return str;
    }
 
    void serialize(BinaryWriter& bw) const;
    static BinaryDataObject deserialize(BinaryRefReader& bdr);
+
+   //for objects written in place right after, size is their length
+   static void serializeHeader(BinaryWriter& bw, size_t size);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -833,20 +833,10 @@ bool ZeroConfContainer::hasTxByHash(const BinaryData& txHash) const
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-set<BinaryData> ZeroConfContainer::purge()
+ZeroConfContainer::NewBlockData ZeroConfContainer::getNewBlockData() const
 {
-   if (!db_)
-      return set<BinaryData>();
-
-   /***
-   For ZC chains to be parsed properly, it is important ZC transactions are
-   parsed in the order they appeared.
-   ***/
-   LMDBEnv::Transaction tx;
-   db_->beginDBTransaction(&tx, ZERO_CONF, LMDB::ReadOnly);
+   NewBlockData blockData;
 
-   //get all txhashes for the new blocks
-   set<BinaryData> minedHashes;
    auto bcPtr = db_->blockchain();
    try
    {
@@ -856,36 +846,66 @@ set<BinaryData> ZeroConfContainer::purge()
       while (!lastKnownHeader->isMainBranch())
       {
          //trace back to the branch point
+         blockData.reorg_ = true;
          auto&& bhash = lastKnownHeader->getPrevHash();
          lastKnownHeader = bcPtr->getHeaderByHash(bhash);
       }
 
-      //get the next header
-      auto height = lastKnownHeader->getBlockHeight() + 1;
-      lastKnownHeader = bcPtr->getHeaderByHeight(height);
-
-      while (lastKnownHeader != nullptr)
+      //grab every block past the last parsed one
+      auto topHeight = bcPtr->top()->getBlockHeight();
+      for (auto height = lastKnownHeader->getBlockHeight() + 1;
+         height <= topHeight; height++)
       {
-         //grab block
+         auto header = bcPtr->getHeaderByHeight(height);
+
          StoredHeader sbh;
-         db_->getStoredHeader(sbh,
-            lastKnownHeader->getBlockHeight(),
-            lastKnownHeader->getDuplicateID(),
-            false);
+         if (!db_->getStoredHeader(sbh,
+            header->getBlockHeight(),
+            header->getDuplicateID()))
+         {
+            throw runtime_error("failed to grab block");
+         }
 
-         //build up hash set
          for (auto& stx : sbh.stxMap_)
-            minedHashes.insert(stx.second.thisHash_);
+         {
+            blockData.minedHashes_.insert(stx.second.thisHash_);
 
-         //next block
-         auto& bhash = lastKnownHeader->getNextHash();
-         lastKnownHeader = bcPtr->getHeaderByHash(bhash);
+            //keep track of the outpoints this block consumes
+            auto&& tx = stx.second.getTxCopy();
+            uint8_t const * txStartPtr = tx.getPtr();
+            for (unsigned iin = 0; iin < tx.getNumTxIn(); iin++)
+            {
+               OutPoint op;
+               op.unserialize(txStartPtr + tx.getTxInOffset(iin), 36);
+
+               auto& idSet = blockData.spentOutPoints_[op.getTxHash()];
+               idSet.insert(op.getTxOutIndex());
+            }
+         }
       }
    }
    catch (...)
    {
+      //can't tell which blocks are new, reparse the whole mempool
+      blockData.reorg_ = true;
    }
 
+   return blockData;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+set<BinaryData> ZeroConfContainer::purge(const NewBlockData& blockData)
+{
+   if (!db_)
+      return set<BinaryData>();
+
+   /***
+   For ZC chains to be parsed properly, it is important ZC transactions are
+   parsed in the order they appeared.
+   ***/
+   LMDBEnv::Transaction tx;
+   db_->beginDBTransaction(&tx, ZERO_CONF, LMDB::ReadOnly);
+
    set<BinaryData> keysToDelete;
    vector<BinaryData> ktdVec;
 
@@ -893,7 +913,7 @@ set<BinaryData> ZeroConfContainer::purge()
       auto txhashmap = txHashToDBKey_.get();
 
       //compare minedHashes to allZCTxHashes_
-      for (auto& minedHash : minedHashes)
+      for (auto& minedHash : blockData.minedHashes_)
       {
          auto iter = allZcTxHashes_.find(minedHash);
          if (iter != allZcTxHashes_.end())
@@ -919,16 +939,270 @@ set<BinaryData> ZeroConfContainer::purge()
    outPointsSpentByKey_.clear();
 
    //delete keys from DB
-   auto deleteKeys = [&](void)->void
+   updateZCinDB(vector<BinaryData>(), ktdVec);
+
+   return keysToDelete;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+map<BinaryData, Tx> ZeroConfContainer::purgeIncremental(
+   const NewBlockData& blockData)
+{
+   /***
+   Only the zc touched by the new blocks are affected by them:
+      - mined zc are dropped, their txios are now in the db
+      - zc spending an outpoint consumed by the new blocks are conflicted
+        and dropped along with their descendants
+      - zc spending the outputs of a mined tx have to point to the db key
+        of that output. These are dropped from the containers and returned
+        to be parsed again, under the same zc key.
+
+   Everything else stays in place, as do the txio maps of unaffected
+   scrAddr.
+   ***/
+
+   unique_lock<mutex> lock(parserMutex_);
+
+   auto txmapPtr = txMap_.get();
+   auto txhashmapPtr = txHashToDBKey_.get();
+
+   //get the zc key of every mined zc
+   set<BinaryData> minedKeys;
+   for (auto& minedHash : blockData.minedHashes_)
    {
-      this->updateZCinDB(vector<BinaryData>(), ktdVec);
+      auto hashIter = txhashmapPtr->find(minedHash);
+      if (hashIter != txhashmapPtr->end())
+         minedKeys.insert(hashIter->second);
+
+      allZcTxHashes_.erase(minedHash);
+   }
+
+   //zc spending the same outpoints as the new blocks are conflicted
+   set<BinaryData> droppedKeys;
+   for (auto& spentPair : blockData.spentOutPoints_)
+   {
+      auto opIter = outPointsSpentByKey_.find(spentPair.first);
+      if (opIter == outPointsSpentByKey_.end())
+         continue;
+
+      for (auto& opId : spentPair.second)
+      {
+         auto idIter = opIter->second.find(opId);
+         if (idIter == opIter->second.end())
+            continue;
+
+         if (minedKeys.find(idIter->second) == minedKeys.end())
+            droppedKeys.insert(idIter->second);
+      }
+   }
+
+   //zc keys spending the outputs of a given tx
+   auto getChildKeys = [this](const BinaryData& txHash)->set<BinaryData>
+   {
+      set<BinaryData> childKeys;
+
+      auto opIter = outPointsSpentByKey_.find(txHash);
+      if (opIter == outPointsSpentByKey_.end())
+         return childKeys;
+
+      for (auto& idPair : opIter->second)
+         childKeys.insert(idPair.second);
+
+      return childKeys;
    };
 
-   thread deleteKeyThread(deleteKeys);
-   if (deleteKeyThread.joinable())
-      deleteKeyThread.join();
+   auto getZcHash = [txmapPtr](const BinaryData& zcKey)->BinaryData
+   {
+      auto txIter = txmapPtr->find(zcKey);
+      if (txIter == txmapPtr->end())
+         return BinaryData();
 
-   return keysToDelete;
+      return txIter->second.getThisHash();
+   };
+
+   //descendants of conflicted zc are invalid as well
+   vector<BinaryData> keyStack(droppedKeys.begin(), droppedKeys.end());
+   while (keyStack.size() > 0)
+   {
+      auto&& childKeys = getChildKeys(getZcHash(keyStack.back()));
+      keyStack.pop_back();
+
+      for (auto& childKey : childKeys)
+      {
+         if (droppedKeys.insert(childKey).second)
+            keyStack.push_back(childKey);
+      }
+   }
+
+   /***
+   Zc spending the outputs of mined txs need their txios rekeyed to the db
+   keys of these outputs. Their own descendants are reparsed as well, as a
+   reparsed zc overwrites the txios of its outputs.
+   ***/
+   set<BinaryData> reparseKeys;
+   for (auto& minedHash : blockData.minedHashes_)
+   {
+      auto&& childKeys = getChildKeys(minedHash);
+      keyStack.insert(keyStack.end(), childKeys.begin(), childKeys.end());
+   }
+
+   while (keyStack.size() > 0)
+   {
+      auto zcKey = keyStack.back();
+      keyStack.pop_back();
+
+      if (minedKeys.find(zcKey) != minedKeys.end() ||
+         droppedKeys.find(zcKey) != droppedKeys.end())
+         continue;
+
+      if (!reparseKeys.insert(zcKey).second)
+         continue;
+
+      auto&& childKeys = getChildKeys(getZcHash(zcKey));
+      keyStack.insert(keyStack.end(), childKeys.begin(), childKeys.end());
+   }
+
+   map<BinaryData, Tx> reparseMap;
+   for (auto& zcKey : reparseKeys)
+   {
+      auto txIter = txmapPtr->find(zcKey);
+      if (txIter != txmapPtr->end())
+         reparseMap.insert(*txIter);
+   }
+
+   set<BinaryData> purgeKeys;
+   purgeKeys.insert(minedKeys.begin(), minedKeys.end());
+   purgeKeys.insert(droppedKeys.begin(), droppedKeys.end());
+   purgeKeys.insert(reparseKeys.begin(), reparseKeys.end());
+
+   if (purgeKeys.size() == 0)
+      return reparseMap;
+
+   //clean up the containers
+   auto keytospentsaPtr = keyToSpentScrAddr_.get();
+   auto txiomapPtr = txioMap_.get();
+
+   set<BinaryData> affectedScrAddrs;
+   vector<BinaryData> hashesToDelete;
+   vector<BinaryData> keyVec(purgeKeys.begin(), purgeKeys.end());
+
+   for (auto& zcKey : purgeKeys)
+   {
+      auto spentIter = keytospentsaPtr->find(zcKey);
+      if (spentIter != keytospentsaPtr->end())
+         affectedScrAddrs.insert(
+            spentIter->second.begin(), spentIter->second.end());
+
+      auto fundedIter = keyToFundedScrAddr_.find(zcKey);
+      if (fundedIter != keyToFundedScrAddr_.end())
+      {
+         affectedScrAddrs.insert(
+            fundedIter->second.begin(), fundedIter->second.end());
+         keyToFundedScrAddr_.erase(fundedIter);
+      }
+
+      auto txIter = txmapPtr->find(zcKey);
+      if (txIter == txmapPtr->end())
+         continue;
+
+      //release the outpoints this zc consumed
+      auto& zctx = txIter->second;
+      uint8_t const * txStartPtr = zctx.getPtr();
+      for (unsigned iin = 0; iin < zctx.getNumTxIn(); iin++)
+      {
+         OutPoint op;
+         op.unserialize(txStartPtr + zctx.getTxInOffset(iin), 36);
+
+         auto opIter = outPointsSpentByKey_.find(op.getTxHash());
+         if (opIter == outPointsSpentByKey_.end())
+            continue;
+
+         auto idIter = opIter->second.find(op.getTxOutIndex());
+         if (idIter != opIter->second.end() && idIter->second == zcKey)
+            opIter->second.erase(idIter);
+
+         if (opIter->second.size() == 0)
+            outPointsSpentByKey_.erase(opIter);
+      }
+
+      auto&& txHash = zctx.getThisHash();
+      if (reparseKeys.find(zcKey) == reparseKeys.end())
+         allZcTxHashes_.erase(txHash);
+      hashesToDelete.push_back(move(txHash));
+   }
+
+   //strip the purged keys from the affected txio maps
+   map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>> updateMap;
+   vector<BinaryData> delScrAddrs;
+   vector<BinaryData> txoutsToDelete;
+
+   auto isPurged = [&purgeKeys](const BinaryData& key)->bool
+   {
+      if (key.getSize() < 6)
+         return false;
+
+      return purgeKeys.find(key.getSliceRef(0, 6)) != purgeKeys.end();
+   };
+
+   for (auto& sa : affectedScrAddrs)
+   {
+      auto mapIter = txiomapPtr->find(sa);
+      if (mapIter == txiomapPtr->end())
+         continue;
+
+      auto newmap = make_shared<map<BinaryData, TxIOPair>>();
+      for (auto& txioPair : *mapIter->second)
+      {
+         bool spentByPurged = txioPair.second.hasTxIn() &&
+            isPurged(txioPair.second.getDBKeyOfInput());
+
+         if (spentByPurged)
+            txoutsToDelete.push_back(txioPair.first);
+
+         if (spentByPurged || isPurged(txioPair.first))
+            continue;
+
+         newmap->insert(txioPair);
+      }
+
+      if (newmap->size() == mapIter->second->size())
+         continue;
+
+      if (newmap->size() == 0)
+         delScrAddrs.push_back(sa);
+      else
+         updateMap[sa] = newmap;
+   }
+
+   //outputs of purged zc can't be spent by zc anymore
+   {
+      auto txoutset = txOutsSpentByZC_.get();
+      for (auto& txoutkey : *txoutset)
+      {
+         if (isPurged(txoutkey))
+            txoutsToDelete.push_back(txoutkey);
+      }
+   }
+
+   txOutsSpentByZC_.erase(txoutsToDelete);
+   keyToSpentScrAddr_.erase(keyVec);
+   txMap_.erase(keyVec);
+   txHashToDBKey_.erase(hashesToDelete);
+
+   txioMap_.erase(delScrAddrs);
+   txioMap_.update(updateMap);
+
+   //rekeyed zc stay in the DB under their current key
+   vector<BinaryData> keysToDelete;
+   for (auto& zcKey : purgeKeys)
+   {
+      if (reparseKeys.find(zcKey) == reparseKeys.end())
+         keysToDelete.push_back(zcKey);
+   }
+
+   updateZCinDB(vector<BinaryData>(), keysToDelete);
+
+   return reparseMap;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1058,14 +1332,7 @@ void ZeroConfContainer::dropZC(const set<BinaryData>& txHashes)
    txioMap_.update(updateMap);
 
    //delete keys from DB
-   auto deleteKeys = [&](void)->void
-   {
-      this->updateZCinDB(vector<BinaryData>(), keysToDelete);
-   };
-
-   thread deleteKeyThread(deleteKeys);
-   if (deleteKeyThread.joinable())
-      deleteKeyThread.join();
+   updateZCinDB(vector<BinaryData>(), keysToDelete);
 
    if (childHashes.size() > 0)
       dropZC(childHashes);
@@ -1074,17 +1341,29 @@ void ZeroConfContainer::dropZC(const set<BinaryData>& txHashes)
 ///////////////////////////////////////////////////////////////////////////////
 void ZeroConfContainer::parseNewZC(void)
 {
+   ZcActionStruct nextAction;
+   bool hasNextAction = false;
+
    while (1)
    {
       ZcActionStruct zcAction;
       map<BinaryData, Tx> zcMap;
-      try
+
+      if (hasNextAction)
       {
-         zcAction = move(newZcStack_.pop_front());
+         zcAction = move(nextAction);
+         hasNextAction = false;
       }
-      catch (StopBlockingLoop&)
+      else
       {
-         break;
+         try
+         {
+            zcAction = move(newZcStack_.pop_front());
+         }
+         catch (StopBlockingLoop&)
+         {
+            break;
+         }
       }
 
       bool notify = true;
@@ -1093,22 +1372,31 @@ void ZeroConfContainer::parseNewZC(void)
       {
       case Zc_Purge:
       {
+         auto&& blockData = getNewBlockData();
+         if (!blockData.reorg_)
          {
-            auto txmap = txMap_.get();
-            zcAction.zcMap_ = *txmap;
+            //only reparse the zc rekeyed by the new blocks
+            zcAction.zcMap_ = purgeIncremental(blockData);
          }
-
-         auto&& keysToDelete = purge();
-         auto keyIter = zcAction.zcMap_.begin();
-         while (keyIter != zcAction.zcMap_.end())
+         else
          {
-            if (keysToDelete.find(keyIter->first)
-               != keysToDelete.end())
             {
-               zcAction.zcMap_.erase(keyIter++);
+               auto txmap = txMap_.get();
+               zcAction.zcMap_ = *txmap;
+            }
+
+            auto&& keysToDelete = purge(blockData);
+            auto keyIter = zcAction.zcMap_.begin();
+            while (keyIter != zcAction.zcMap_.end())
+            {
+               if (keysToDelete.find(keyIter->first)
+                  != keysToDelete.end())
+               {
+                  zcAction.zcMap_.erase(keyIter++);
+               }
+               else
+                  ++keyIter;
             }
-            else
-               ++keyIter;
          }
 
          flaggedBDVs_.clear();
@@ -1120,14 +1408,53 @@ void ZeroConfContainer::parseNewZC(void)
          break;
 
       case Zc_Shutdown:
-         purge();
+         purge(getNewBlockData());
          return;
 
       default:
          continue;
       }
 
+      if (zcAction.action_ == Zc_NewTx && 
+         zcAction.finishedPromise_ == nullptr)
+      {
+         /***
+         Under load, zc queue up faster than they are parsed one by one.
+         Grab the pending ones to parse them as a single batch. Stop at the 
+         first action that isn't a plain new zc, it runs next.
+         ***/
+         while (zcMap.size() < ZC_PARSE_BATCH_SIZE && newZcStack_.count() > 0)
+         {
+            ZcActionStruct pendingAction;
+            try
+            {
+               pendingAction = 
+                  move(newZcStack_.Stack<ZcActionStruct>::pop_front(false));
+            }
+            catch (IsEmpty&)
+            {
+               break;
+            }
+
+            if (pendingAction.action_ != Zc_NewTx ||
+               pendingAction.finishedPromise_ != nullptr)
+            {
+               nextAction = move(pendingAction);
+               hasNextAction = true;
+               break;
+            }
+
+            zcMap.insert(
+               pendingAction.zcMap_.begin(), pendingAction.zcMap_.end());
+         }
+      }
+
       parseNewZC(move(zcMap), true, notify);
+
+      //the db reflects the new chain state before the block is announced
+      if (zcAction.action_ == Zc_Purge)
+         flushZCinDB();
+
       if(zcAction.finishedPromise_ != nullptr)
          zcAction.finishedPromise_->set_value(true);
    }
@@ -1198,14 +1525,27 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
          return global_iter->second;
       };
 
-      for (auto& newZCPair : zcMap)
+      /***
+      A zc only depends on the rest of the batch through the parents it
+      spends from, and through the earlier zc it double spends. Sort the
+      batch in generations over these dependencies: zc within a generation
+      are filtered in parallel, then merged in key order, so children see
+      their parents and replacements happen in arrival order.
+      ***/
+
+      vector<map<BinaryData, Tx>::iterator> batch;
+      map<BinaryData, unsigned> batchIdByHash;
+
+      for (auto zcIter = zcMap.begin(); zcIter != zcMap.end(); ++zcIter)
       {
-         const BinaryData&& txHash = newZCPair.second.getThisHash();
+         //this also caches the hash, the filter threads share these Tx 
+         //objects read only
+         const BinaryData&& txHash = zcIter->second.getThisHash();
          if (txhashmap_ptr->find(txHash) != txhashmap_ptr->end())
             continue; //already have this ZC
 
          //flag RBF on whole tx
-         auto& zctx = newZCPair.second;
+         auto& zctx = zcIter->second;
          zctx.setChainedZC(false);
          auto datacopy = zctx.getPtr();
          unsigned txinCount = zctx.getNumTxIn();
@@ -1246,16 +1586,77 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
             }
          }
 
+         batchIdByHash[txHash] = batch.size();
+         batch.push_back(zcIter);
+      }
+
+      vector<unsigned> parentCount(batch.size(), 0);
+      vector<vector<unsigned>> children(batch.size());
+      map<BinaryData, unsigned> spenderIdByOutPoint;
+
+      for (unsigned i = 0; i < batch.size(); i++)
+      {
+         auto& zctx = batch[i]->second;
+         auto datacopy = zctx.getPtr();
+
+         set<unsigned> parents;
+         for (unsigned y = 0; y < zctx.getNumTxIn(); y++)
+         {
+            BinaryDataRef outpoint(datacopy + zctx.getTxInOffset(y), 36);
+
+            auto idIter = batchIdByHash.find(outpoint.getSliceRef(0, 32));
+            if (idIter != batchIdByHash.end())
+               parents.insert(idIter->second);
+
+            auto spenderIter = spenderIdByOutPoint.find(outpoint);
+            if (spenderIter != spenderIdByOutPoint.end())
+               parents.insert(spenderIter->second);
+
+            spenderIdByOutPoint[outpoint] = i;
+         }
+
+         parents.erase(i);
+         parentCount[i] = parents.size();
+         for (auto& parentId : parents)
+            children[parentId].push_back(i);
+      }
+
+      vector<unsigned> generation;
+      for (unsigned i = 0; i < batch.size(); i++)
+      {
+         if (parentCount[i] == 0)
+            generation.push_back(i);
+      }
+
+      while (generation.size() > 0)
+      {
+         //TODO: cover replacement case where ZC gets doubled spent to an address we 
+         //don't control (and thus don't scan ZCs for)
+
+         vector<BulkFilterData> bulkDataVec(generation.size());
+         auto filterZc = [&](unsigned id)->void
+         {
+            auto& zcPair = *batch[generation[id]];
+            bulkDataVec[id] = move(ZCisMineBulkFilter(
+               zcPair.second, zcPair.first,
+               zcPair.second.getTxTime(),
+               getzckeyfortxhash, getzctxforkey));
+         };
+
+         parserPool_.run(generation.size(), filterZc);
+
+         vector<unsigned> nextGeneration;
+         for (unsigned i = 0; i < generation.size(); i++)
          {
-            //TODO: cover replacement case where ZC gets doubled spent to an address we 
-            //don't control (and thus don't scan ZCs for)
+            auto& newZCPair = *batch[generation[i]];
+            auto& bulkData = bulkDataVec[i];
+            const BinaryData&& txHash = newZCPair.second.getThisHash();
 
-            auto&& bulkData =
-               ZCisMineBulkFilter(newZCPair.second,
-               newZCPair.first,
-               newZCPair.second.getTxTime(), 
-               getzckeyfortxhash,
-               getzctxforkey);
+            for (auto& childId : children[generation[i]])
+            {
+               if (--parentCount[childId] == 0)
+                  nextGeneration.push_back(childId);
+            }
 
             //check for replacement
             {
@@ -1367,6 +1768,10 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
                }
             }
          }
+
+         //batch ids follow key order
+         sort(nextGeneration.begin(), nextGeneration.end());
+         generation = move(nextGeneration);
       }
    }
 
@@ -1374,35 +1779,28 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
    txMap_.update(txmap_update);
 
 
-   if (updateDB && keysToWrite.size() > 0)
-   {
-      //write ZC in the new thread to guaranty we can get a RW tx
-      auto writeNewZC = [&, this](void)->void
-      { this->updateZCinDB(keysToWrite, vector<BinaryData>()); };
-
-      thread writeNewZCthread(writeNewZC);
-      writeNewZCthread.join();
-   }
-
    lastParsedBlockHash_ = db_->getTopBlockHash();
 
-   //notify bdvs
-   if (!hasChanges)
-      return;
-
-   if (!notify)
+   if (!hasChanges || !notify)
+   {
+      //queued to the zc db writer, doesn't wait on the commit
+      if (updateDB && keysToWrite.size() > 0)
+         updateZCinDB(keysToWrite, vector<BinaryData>());
       return;
+   }
 
+   //grab the notifications now, the txioMap_ may have moved on by the time
+   //the zc are committed
    auto txiomapPtr = txioMap_.get();
-   auto bdvcallbacks = bdvCallbacks_.get();
+   auto notifications = make_shared<
+      map<string, map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>>>();
 
    for (auto& bdvMap : flaggedBDVs_)
    {
       if (!bdvMap.second.first)
          continue;
 
-      map<BinaryData, shared_ptr<map<BinaryData, TxIOPair>>>
-         notificationMap;
+      auto& notificationMap = (*notifications)[bdvMap.first];
       for (auto& sa : bdvMap.second.second)
       {
          auto saIter = txiomapPtr->find(sa);
@@ -1413,13 +1811,36 @@ void ZeroConfContainer::parseNewZC(map<BinaryData, Tx> zcMap,
       }
 
       bdvMap.second.first = false;
+   }
 
-      auto callbackIter = bdvcallbacks->find(bdvMap.first);
-      if (callbackIter == bdvcallbacks->end())
-         continue;
+   auto notifyBDVs = [this, notifications](void)->void
+   {
+      unique_lock<mutex> lock(bdvCallbacksMutex_);
+      auto bdvcallbacks = bdvCallbacks_.get();
 
-      callbackIter->second.newZcCallback_(move(notificationMap));
+      for (auto& notifPair : *notifications)
+      {
+         auto callbackIter = bdvcallbacks->find(notifPair.first);
+         if (callbackIter == bdvcallbacks->end())
+            continue;
+
+         callbackIter->second.newZcCallback_(move(notifPair.second));
+      }
+   };
+
+   //bdvs are notified once the zc are committed, ledgers pull them from 
+   //the db
+   if (zcDBThread_.joinable())
+   {
+      if (!updateDB)
+         keysToWrite.clear();
+      updateZCinDB(keysToWrite, vector<BinaryData>(), notifyBDVs);
+      return;
    }
+
+   if (updateDB && keysToWrite.size() > 0)
+      updateZCinDB(keysToWrite, vector<BinaryData>());
+   notifyBDVs();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1429,15 +1850,21 @@ ZeroConfContainer::ZCisMineBulkFilter(const Tx & tx,
    function<bool(const BinaryData&, BinaryData&)> getzckeyfortxhash,
    function<const Tx&(const BinaryData&)> getzctxforkey)
 {
-   auto mainAddressSet = scrAddrMap_->get();
+   auto&& mapAndFilter = scrAddrMap_->get_with_index();
+   auto& mainAddressSet = mapAndFilter.first;
+   auto& addrBloomFilter = mapAndFilter.second;
 
    auto bdvcallbacks = bdvCallbacks_.get();
-   auto filter = [&mainAddressSet, &bdvcallbacks]
+   auto filter = [&mainAddressSet, &addrBloomFilter, &bdvcallbacks]
       (const BinaryData& addr)->pair<bool, set<string>>
    {
       pair<bool, set<string>> flaggedBDVs;
       flaggedBDVs.first = false;
 
+      //most ZC outputs aren't ours, skip the tree lookup for those
+      if (!addrBloomFilter->mayContain(addr.getRef()))
+         return flaggedBDVs;
+
       auto addrIter = mainAddressSet->find(addr);
       if (addrIter == mainAddressSet->end())
          return flaggedBDVs;
@@ -1743,36 +2170,211 @@ const shared_ptr<map<BinaryData, set<BinaryData>>>
 
 ///////////////////////////////////////////////////////////////////////////////
 void ZeroConfContainer::updateZCinDB(const vector<BinaryData>& keysToWrite, 
-   const vector<BinaryData>& keysToDelete)
+   const vector<BinaryData>& keysToDelete, function<void(void)> onCommit)
 {
-   //TODO: bulk writes
+   /***
+   Queues the updates for the zc db writer. Updates to the same key are
+   coalesced, only the last one is written.
 
-   //should run in its own thread to make sure we can get a write tx
-   DB_SELECT dbs = ZERO_CONF;
+   Each batch is committed in a single RW transaction and batches are
+   committed in order, so after a crash the db holds the mempool as it was
+   at the end of an earlier batch. Pending writes are lost, these zc will
+   come back from the node. Pending deletes leave mined or replaced zc in
+   the db, loadZeroConfMempool drops them on the next start.
 
+   onCommit runs on the writer thread once the updates queued so far are
+   committed. Ledgers read zc from the db, so bdvs are notified this way.
+   ***/
+
+   if (keysToWrite.size() == 0 && keysToDelete.size() == 0 && 
+      onCommit == nullptr)
+      return;
+
+   //grab the txs now, the txMap_ may have moved on by the time they are
+   //written
    auto txmap = txMap_.get();
 
-   LMDBEnv::Transaction tx;
-   db_->beginDBTransaction(&tx, dbs, LMDB::ReadWrite);
+   unique_lock<mutex> lock(zcDBMutex_);
+   if (zcDBQueue_.size() == 0)
+      zcDBBatchStart_ = chrono::steady_clock::now();
 
    for (auto& key : keysToWrite)
    {
+      ZcDBUpdate update;
+
       auto iter = txmap->find(key);
       if (iter != txmap->end())
       {
-         StoredTx zcTx;
-         zcTx.createFromTx((*txmap)[key], true, true);
-         db_->putStoredZC(zcTx, key);
+         update.hasTx_ = true;
+         update.tx_ = iter->second;
       }
-      else
+
+      zcDBQueue_[key] = move(update);
+   }
+
+   for (auto& key : keysToDelete)
+   {
+      ZcDBUpdate update;
+      update.put_ = false;
+      zcDBQueue_[key] = move(update);
+   }
+
+   if (onCommit != nullptr)
+      zcDBCallbacks_.push_back(move(onCommit));
+
+   ++zcDBQueuedId_;
+   zcDBCondVar_.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::flushZCinDB()
+{
+   unique_lock<mutex> lock(zcDBMutex_);
+   auto queuedId = zcDBQueuedId_;
+
+   if (!zcDBThread_.joinable())
+   {
+      //no writer to wait on, write in a new thread to guaranty we can get
+      //a RW tx
+      auto batch = move(zcDBQueue_);
+      zcDBQueue_.clear();
+      auto callbacks = move(zcDBCallbacks_);
+      zcDBCallbacks_.clear();
+      lock.unlock();
+
+      thread writeThread([this, &batch](void)->void
+         { this->writeZcBatch(batch); });
+      writeThread.join();
+
+      for (auto& callback : callbacks)
+         callback();
+      return;
+   }
+
+   zcDBFlush_ = true;
+   zcDBCondVar_.notify_all();
+
+   while (zcDBWrittenId_ < queuedId)
+      zcDBCondVar_.wait(lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::zcDBWriterThread()
+{
+   unique_lock<mutex> lock(zcDBMutex_);
+
+   while (1)
+   {
+      if (zcDBQueue_.size() == 0 && zcDBCallbacks_.size() == 0)
+      {
+         zcDBFlush_ = false;
+         zcDBWrittenId_ = zcDBQueuedId_;
+         zcDBCondVar_.notify_all();
+
+         if (!zcDBRun_)
+            break;
+
+         zcDBCondVar_.wait(lock);
+         continue;
+      }
+
+      //group commit: wait for the batch to fill up or to age out
+      auto deadline = 
+         zcDBBatchStart_ + chrono::milliseconds(ZC_DB_FLUSH_MS);
+      if (zcDBRun_ && !zcDBFlush_ && zcDBQueue_.size() > 0 &&
+         zcDBQueue_.size() < ZC_DB_BATCH_SIZE &&
+         chrono::steady_clock::now() < deadline)
+      {
+         zcDBCondVar_.wait_until(lock, deadline);
+         continue;
+      }
+
+      auto batch = move(zcDBQueue_);
+      zcDBQueue_.clear();
+      auto callbacks = move(zcDBCallbacks_);
+      zcDBCallbacks_.clear();
+      auto queuedId = zcDBQueuedId_;
+      lock.unlock();
+
+      try
       {
-         //if the key is not to be found in the txMap_, this is a ZC txhash
-         db_->putValue(ZERO_CONF, key, BinaryData());
+         writeZcBatch(batch);
       }
+      catch (exception& e)
+      {
+         LOGERR << "failed to write zc batch: " << e.what();
+      }
+
+      for (auto& callback : callbacks)
+         callback();
+
+      lock.lock();
+      zcDBWrittenId_ = queuedId;
+      zcDBCondVar_.notify_all();
    }
+}
 
-   for (auto& key : keysToDelete)
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::stopZcDBWriter()
+{
+   {
+      unique_lock<mutex> lock(zcDBMutex_);
+      zcDBRun_ = false;
+      zcDBCondVar_.notify_all();
+   }
+
+   //the writer drains the queue before exiting
+   if (zcDBThread_.joinable())
+      zcDBThread_.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned ZeroConfContainer::getParserThreadCount(unsigned maxZcThread)
+{
+   unsigned threadCount = maxZcThread;
+   auto coreCount = thread::hardware_concurrency();
+   if (coreCount > 0 && coreCount < threadCount)
+      threadCount = coreCount;
+
+   //the parser thread takes work as well
+   if (threadCount == 0)
+      return 0;
+   return threadCount - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::writeZcBatch(map<BinaryData, ZcDBUpdate>& batch)
+{
+   if (batch.size() == 0)
+      return;
+
+   DB_SELECT dbs = ZERO_CONF;
+
+   LMDBEnv::Transaction tx;
+   db_->beginDBTransaction(&tx, dbs, LMDB::ReadWrite);
+
+   for (auto& updatePair : batch)
    {
+      auto& key = updatePair.first;
+      auto& update = updatePair.second;
+
+      if (update.put_)
+      {
+         if (update.hasTx_)
+         {
+            StoredTx zcTx;
+            zcTx.createFromTx(update.tx_, true, true);
+            db_->putStoredZC(zcTx, key);
+         }
+         else
+         {
+            //if the key is not to be found in the txMap_, this is a ZC txhash
+            db_->putValue(ZERO_CONF, key, BinaryData());
+         }
+
+         continue;
+      }
+
       BinaryData keyWithPrefix;
       if (key.getSize() == 6)
       {
@@ -1878,8 +2480,32 @@ void ZeroConfContainer::loadZeroConfMempool(bool clearMempool)
       auto& topZcKey = lastEntry->first;
       topId_.store(READ_UINT32_BE(topZcKey.getSliceCopy(2, 4)) +1);
 
+      vector<pair<BinaryData, BinaryData>> loadedKeys;
+      for (auto& zcPair : zcMap)
+         loadedKeys.push_back(make_pair(
+            zcPair.first, zcPair.second.getThisHash()));
+
       //no need to update the db nor notify bdvs on init
       parseNewZC(move(zcMap), false, false);
+
+      /***
+      Zc mined or replaced before their deletion was committed linger in
+      the db after a crash. The parser rejects these, as well as zc that
+      no longer hit registered addresses. None of them can make it back
+      into the container, clean them up.
+      ***/
+      vector<BinaryData> keysToDelete;
+      if (scrAddrMap_->size() > 0)
+      {
+         auto txhashmap = txHashToDBKey_.get();
+         for (auto& keyPair : loadedKeys)
+         {
+            if (txhashmap->find(keyPair.second) == txhashmap->end())
+               keysToDelete.push_back(keyPair.first);
+         }
+      }
+
+      updateZCinDB(vector<BinaryData>(), keysToDelete);
    }
 
    enabled_ = true;
@@ -1891,6 +2517,12 @@ void ZeroConfContainer::init(shared_ptr<ScrAddrFilter> saf, bool clearMempool)
    LOGINFO << "Enabling zero-conf tracking";
 
    scrAddrMap_ = saf->getScrAddrTransactionalMap();
+
+   //start zc db writer
+   zcDBRun_ = true;
+   zcDBThread_ = thread([this](void)->void
+      { this->zcDBWriterThread(); });
+
    loadZeroConfMempool(clearMempool);
 
    //start Zc parser thread
@@ -1901,106 +2533,195 @@ void ZeroConfContainer::init(shared_ptr<ScrAddrFilter> saf, bool clearMempool)
 
    parserThreads_.push_back(thread(processZcThread));
 
+   //start inv tx fetcher
+   invTxWheel_.resize(ZC_GETDATA_WHEEL_SIZE);
+   invTxRun_ = true;
+   invTxThread_ = thread([this](void)->void
+      { this->invTxFetcherThread(); });
+
    zcEnabled_.store(true, memory_order_relaxed);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ZeroConfContainer::processInvTxVec(vector<InvEntry> invVec, bool extend)
+void ZeroConfContainer::processInvTxVec(vector<InvEntry> invVec)
 {
    if (!isEnabled())
       return;
 
    //skip this entirely if there are no addresses to scan the ZCs against
-   if (scrAddrMap_->size() == 0 && extend)
+   if (scrAddrMap_->size() == 0)
       return;
 
-   for (unsigned i = 0; i < invVec.size(); i++)
+   unique_lock<mutex> lock(invTxMutex_);
+   invTxQueue_.insert(invTxQueue_.end(), invVec.begin(), invVec.end());
+   invTxCondVar_.notify_all();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::invTxFetcherThread()
+{
+   /***
+   Fetches the tx for inv entries from the node. New entries are requested 
+   as they come in, ZC_GETDATA_BATCH_SIZE per getdata packet. Hashes that 
+   are known zc or already requested are skipped.
+
+   Outstanding requests are slotted in a timer wheel of ZC_GETDATA_TICK_MS 
+   ticks. A request is sent again after 1, 2, 4... ticks, the node may not
+   have accepted a tx we just broadcast yet, and dropped after 
+   TXGETDATA_TIMEOUT_MS. Replies are matched by processPayloadTx.
+   ***/
+
+   const uint64_t timeoutTicks = TXGETDATA_TIMEOUT_MS / ZC_GETDATA_TICK_MS;
+   auto tickDuration = chrono::milliseconds(ZC_GETDATA_TICK_MS);
+   auto nextTick = chrono::steady_clock::now() + tickDuration;
+
+   auto schedule = [this](const BinaryData& txHash, uint64_t tick)->void
    {
-      auto& entry = invVec[i];
-      try
+      invTxWheel_[tick % ZC_GETDATA_WHEEL_SIZE].push_back(txHash);
+   };
+
+   unique_lock<mutex> lock(invTxMutex_);
+
+   while (invTxRun_)
+   {
+      vector<InvEntry> toRequest;
+
+      //new entries
+      if (invTxQueue_.size() > 0)
       {
-         auto&& newtxpromise = newInvTxStack_.pop_front();
-         newtxpromise.set_value(move(entry));
+         auto txhashmap = txHashToDBKey_.get();
+         for (auto& entry : invTxQueue_)
+         {
+            BinaryData txHash(entry.hash, 32);
+            if (txhashmap->find(txHash) != txhashmap->end())
+               continue;
+
+            if (invTxRequests_.find(txHash) != invTxRequests_.end())
+               continue;
+
+            entry.invtype_ = Inv_Msg_Witness_Tx;
+
+            InvTxRequest request;
+            request.entry_ = entry;
+            request.deadline_ = invTxTick_ + timeoutTicks;
+            invTxRequests_.insert(make_pair(txHash, request));
+
+            schedule(txHash, invTxTick_ + 1);
+            toRequest.push_back(entry);
+         }
+
+         invTxQueue_.clear();
       }
-      catch (IsEmpty&)
+
+      //resends and timeouts
+      while (chrono::steady_clock::now() >= nextTick)
       {
-         if (!extend)
-            continue;
+         ++invTxTick_;
+         nextTick += tickDuration;
 
-         if (parserThreads_.count() > maxZcThreadCount_)
-            continue;
+         auto& slot = invTxWheel_[invTxTick_ % ZC_GETDATA_WHEEL_SIZE];
+         auto hashVec = move(slot);
+         slot.clear();
 
-         //zc parser thread queue is depleted, let's add a thread and try again
-         auto txthread = [this](void)->void
+         for (auto& txHash : hashVec)
          {
-            processInvTxThread();
-         };
-
-         parserThreads_.push_back(thread(txthread));
-         --i;
+            //no entry means the tx was received
+            auto reqIter = invTxRequests_.find(txHash);
+            if (reqIter == invTxRequests_.end())
+               continue;
 
-         auto threadcount = parserThreads_.count() - 1;
-         if (threadcount % 5 == 0)
-            LOGWARN << "running " << threadcount << " zc parser threads";
-      }
-   }
-}
+            auto& request = reqIter->second;
+            if (invTxTick_ >= request.deadline_)
+            {
+               invTxRequests_.erase(reqIter);
+               continue;
+            }
 
-///////////////////////////////////////////////////////////////////////////////
-void ZeroConfContainer::processInvTxThread(void)
-{
-   while (1)
-   {
-      promise<InvEntry> newtxpromise;
-      auto newtxfuture = newtxpromise.get_future();
-      newInvTxStack_.push_back(move(newtxpromise));
+            toRequest.push_back(request.entry_);
 
-      try
-      {
-         auto&& entry = newtxfuture.get();
-         
-         //thread exit condition: prcessInvTxThread returns false
-         if (!processInvTxThread(move(entry), TXGETDATA_TIMEOUT_MS))
-            return;
+            request.interval_ *= 2;
+            auto resendTick = invTxTick_ + request.interval_;
+            if (resendTick > request.deadline_)
+               resendTick = request.deadline_;
+            schedule(txHash, resendTick);
+         }
       }
-      catch (BitcoinP2P_Exception&)
+
+      if (toRequest.size() > 0)
       {
-         //ignore any p2p connection related exceptions
+         lock.unlock();
+
+         auto iter = toRequest.begin();
+         while (iter != toRequest.end())
+         {
+            auto batchEnd = iter;
+            if ((size_t)(toRequest.end() - iter) > ZC_GETDATA_BATCH_SIZE)
+               batchEnd += ZC_GETDATA_BATCH_SIZE;
+            else
+               batchEnd = toRequest.end();
+
+            try
+            {
+               Payload_GetData payload(vector<InvEntry>(iter, batchEnd));
+               networkNode_->sendMessage(move(payload));
+            }
+            catch (exception&)
+            {
+               //ignore p2p connection errors, the requests time out
+            }
+
+            iter = batchEnd;
+         }
+
+         lock.lock();
          continue;
       }
-      catch (future_error&)
+
+      if (invTxQueue_.size() > 0)
+         continue;
+
+      //sleep on the next tick if there are requests to track
+      if (invTxRequests_.size() > 0)
+         invTxCondVar_.wait_until(lock, nextTick);
+      else
       {
-         return;
+         invTxCondVar_.wait(lock);
+         nextTick = chrono::steady_clock::now() + tickDuration;
       }
    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-bool ZeroConfContainer::processInvTxThread(InvEntry entry, unsigned timeout_ms)
+void ZeroConfContainer::processPayloadTx(shared_ptr<Payload_Tx> payloadTx)
 {
-   if (entry.invtype_ == Inv_Terminate)
-      return false;
+   auto& txHash = payloadTx->getHash256();
 
-   entry.invtype_ = Inv_Msg_Witness_Tx;
-   auto payload = networkNode_->getTx(entry, timeout_ms);
+   {
+      //only take the tx we asked for
+      unique_lock<mutex> lock(invTxMutex_);
+      auto reqIter = invTxRequests_.find(txHash);
+      if (reqIter == invTxRequests_.end())
+         return;
 
-   auto payloadtx = dynamic_pointer_cast<Payload_Tx>(payload);
-   if (payloadtx == nullptr)
-      return true;
+      invTxRequests_.erase(reqIter);
+   }
 
    //push raw tx with current time
-   pair<BinaryData, Tx> zcpair;
-   zcpair.first = getNewZCkey();
-   auto& rawTx = payloadtx->getRawTx();
-   zcpair.second.unserialize(&rawTx[0], rawTx.size());
-   zcpair.second.setTxTime(time(0));
+   auto& rawTx = payloadTx->getRawTx();
+   pushZcToParser(BinaryData(&rawTx[0], rawTx.size()));
+}
 
-   ZcActionStruct actionstruct;
-   actionstruct.zcMap_.insert(move(zcpair));
-   actionstruct.action_ = Zc_NewTx;
-   newZcStack_.push_back(move(actionstruct));
+///////////////////////////////////////////////////////////////////////////////
+void ZeroConfContainer::stopInvTxFetcher()
+{
+   {
+      unique_lock<mutex> lock(invTxMutex_);
+      invTxRun_ = false;
+      invTxCondVar_.notify_all();
+   }
 
-   return true;
+   if (invTxThread_.joinable())
+      invTxThread_.join();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -2026,6 +2747,7 @@ void ZeroConfContainer::insertBDVcallback(string id, BDV_Callbacks callback)
 ///////////////////////////////////////////////////////////////////////////////
 void ZeroConfContainer::eraseBDVcallback(string id)
 {
+   unique_lock<mutex> lock(bdvCallbacksMutex_);
    bdvCallbacks_.erase(id);
 }
 
@@ -2136,14 +2858,11 @@ void ZeroConfContainer::broadcastZC(const BinaryData& rawzc,
    if(PEER_USES_WITNESS)
       entry.invtype_ = Inv_Msg_Witness_Tx;
 
-   auto grabtxlambda = [this, timeout_ms](InvEntry inventry)->void
    {
-      processInvTxThread(move(inventry), timeout_ms);
-   };
-
-   thread grabtxthread(grabtxlambda, move(entry));
-   if (grabtxthread.joinable())
-      grabtxthread.detach();
+      unique_lock<mutex> lock(invTxMutex_);
+      invTxQueue_.push_back(entry);
+      invTxCondVar_.notify_all();
+   }
 
    LOGINFO << "grabbing tx from node";
 
@@ -2180,17 +2899,8 @@ void ZeroConfContainer::shutdown()
 {
    newZcStack_.completed();
 
-   //shutdow invtx processing threads by pushing inventries of 
-   //inv_terminate type
-   InvEntry terminateEntry;
-   vector<InvEntry> vecIE;
-   terminateEntry.invtype_ = Inv_Terminate;
-
-   for (unsigned i = 0; i < parserThreads_.count(); i++)
-      vecIE.push_back(terminateEntry);
-
-   processInvTxVec(vecIE, false);
    zcEnabled_.store(false, memory_order_relaxed);
+   stopInvTxFetcher();
 
    while (parserThreads_.count() > 0)
    {
@@ -2198,4 +2908,6 @@ void ZeroConfContainer::shutdown()
       if (thr.joinable())
          thr.join();
    }
+
+   stopZcDBWriter();
 }
@@ -18,6 +18,8 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <chrono>
+#include <condition_variable>
 
 #include "ThreadSafeClasses.h"
 #include "BitcoinP2p.h"
@@ -27,6 +29,18 @@
 
 #define GETZC_THREADCOUNT 5
 #define TXGETDATA_TIMEOUT_MS 10000
+#define ZC_PARSE_BATCH_SIZE 1000
+
+//inv tx fetcher: max entries per getdata, timer wheel tick and slot count.
+//the wheel has to span TXGETDATA_TIMEOUT_MS
+#define ZC_GETDATA_BATCH_SIZE 128
+#define ZC_GETDATA_TICK_MS 100
+#define ZC_GETDATA_WHEEL_SIZE 128
+
+//zc db writes are committed once this many keys are pending
+#define ZC_DB_BATCH_SIZE 256
+//or once the oldest pending write is this old
+#define ZC_DB_FLUSH_MS 50
 
 enum ZcAction
 {
@@ -175,6 +189,10 @@ public:
          return this->scrAddr_.getRef() < rhs;
       }
    };
+
+   //registered scrAddr, carries a bloom filter rebuilt with every update
+   typedef TransactionalMap<AddrAndHash, int, ScrAddrBloomFilter> 
+      ScrAddrTransactionalMap;
    
 public:
    mutex mergeLock_;
@@ -186,7 +204,7 @@ private:
    static atomic<unsigned> keyCounter_;
    static atomic<bool> run_;
 
-   shared_ptr<TransactionalMap<AddrAndHash, int>>   scrAddrMap_;
+   shared_ptr<ScrAddrTransactionalMap>   scrAddrMap_;
 
    LMDBBlockDatabase *const       lmdb_;
 
@@ -206,7 +224,7 @@ private:
 private:
    static void cleanUpPreviousChildren(LMDBBlockDatabase* lmdb);
 
-   shared_ptr<TransactionalMap<AddrAndHash, int>>
+   shared_ptr<ScrAddrTransactionalMap>
       getScrAddrTransactionalMap(void) const
    {
       return scrAddrMap_;
@@ -234,7 +252,7 @@ public:
       if (uniqueKey_ == 0) 
          cleanUpPreviousChildren(lmdb);
 
-      scrAddrMap_ = make_shared<TransactionalMap<AddrAndHash, int>>();
+      scrAddrMap_ = make_shared<ScrAddrTransactionalMap>();
       scanThreadProgressCallback_ = 
          [](const vector<string>&, double, unsigned)->void {};
    }
@@ -243,7 +261,7 @@ public:
       : lmdb_(sca.lmdb_), armoryDbType_(sca.armoryDbType_),
       uniqueKey_(getUniqueKey()) //even copies' keys are unique
    {
-      scrAddrMap_ = make_shared<TransactionalMap<AddrAndHash, int>>();
+      scrAddrMap_ = make_shared<ScrAddrTransactionalMap>();
    }
    
    virtual ~ScrAddrFilter() { }
@@ -260,23 +278,19 @@ public:
       return scrAddrMap_->get(); 
    }
 
-   shared_ptr<map<TxOutScriptRef, int>> getOutScrRefMap(void)
+   shared_ptr<TxOutScriptRefMap> getOutScrRefMap(void)
    {
       getScrAddrCurrentSyncState();
-      auto outset = make_shared<map<TxOutScriptRef, int>>();
 
-      auto scrAddrMap = scrAddrMap_->get();
+      auto&& mapAndFilter = scrAddrMap_->get_with_index();
+      auto& scrAddrMap = mapAndFilter.first;
+      auto outset = make_shared<TxOutScriptRefMap>(scrAddrMap->size());
 
       for (auto& scrAddr : *scrAddrMap)
-      {
-         if (scrAddr.first.scrAddr_.getSize() == 0)
-            continue;
+         outset->insert(scrAddr.first.scrAddr_, scrAddr.second);
 
-         TxOutScriptRef scrRef;
-         scrRef.setRef(scrAddr.first.scrAddr_);
-
-         outset->insert(move(make_pair(scrRef, scrAddr.second)));
-      }
+      //reject most unrelated txouts before probing the map
+      outset->setPrefilter(mapAndFilter.second);
 
       return outset;
    }
@@ -377,6 +391,19 @@ private:
       bool isEmpty(void) { return scrAddrTxioMap_.size() == 0; }
    };
 
+   struct NewBlockData
+   {
+      //hashes of all txs in the blocks appended since the last parse
+      set<BinaryData> minedHashes_;
+
+      //<txHash, outpoint ids> consumed by these blocks
+      map<BinaryData, set<unsigned>> spentOutPoints_;
+
+      //the last parsed block left the main branch, outpoints spent by
+      //zc may have been invalidated anywhere in the mempool
+      bool reorg_ = false;
+   };
+
 public:
    struct BDV_Callbacks
    {
@@ -400,6 +427,26 @@ public:
       }
    };
 
+private:
+   struct ZcDBUpdate
+   {
+      //false for deletions
+      bool put_ = true;
+
+      //keys missing from txMap_ are written with an empty value
+      bool hasTx_ = false;
+      Tx tx_;
+   };
+
+   struct InvTxRequest
+   {
+      InvEntry entry_;
+
+      //in fetcher ticks
+      uint64_t deadline_;
+      unsigned interval_ = 1;
+   };
+
 private:
    TransactionalMap<HashString, HashString>     txHashToDBKey_;      //<txHash, dbKey>
    TransactionalMap<HashString, Tx>             txMap_;              //<zcKey, zcTx>
@@ -426,18 +473,46 @@ private:
 
    set<BinaryData> emptySetBinData_;
 
-   //stacks inv tx packets from node
    shared_ptr<BitcoinP2P> networkNode_;
-   Stack<promise<InvEntry>> newInvTxStack_;
-   
+
    TransactionalMap<string, BDV_Callbacks> bdvCallbacks_;
+
+   //zc notifications run on the db writer, bdvs can't go away mid call
+   mutex bdvCallbacksMutex_;
+
    mutex parserMutex_;
 
    Stack<thread> parserThreads_;
    atomic<bool> zcEnabled_;
    const unsigned maxZcThreadCount_;
 
-   shared_ptr<TransactionalMap<ScrAddrFilter::AddrAndHash, int>> scrAddrMap_;
+   //filters the zc of a parser generation in parallel
+   WorkerPool parserPool_;
+
+   shared_ptr<ScrAddrFilter::ScrAddrTransactionalMap> scrAddrMap_;
+
+   //pending zc db updates, coalesced per key
+   map<BinaryData, ZcDBUpdate> zcDBQueue_;
+   vector<function<void(void)>> zcDBCallbacks_;
+   chrono::steady_clock::time_point zcDBBatchStart_;
+   uint64_t zcDBQueuedId_ = 0;
+   uint64_t zcDBWrittenId_ = 0;
+   bool zcDBFlush_ = false;
+   bool zcDBRun_ = false;
+   mutex zcDBMutex_;
+   condition_variable zcDBCondVar_;
+   thread zcDBThread_;
+
+   //inv tx fetcher state: entries yet to request, outstanding requests by
+   //tx hash and the timer wheel their resends and timeouts are slotted in
+   vector<InvEntry> invTxQueue_;
+   map<BinaryData, InvTxRequest> invTxRequests_;
+   vector<vector<BinaryData>> invTxWheel_;
+   uint64_t invTxTick_ = 0;
+   bool invTxRun_ = false;
+   mutex invTxMutex_;
+   condition_variable invTxCondVar_;
+   thread invTxThread_;
 
 private:
    BulkFilterData ZCisMineBulkFilter(const Tx & tx,
@@ -447,10 +522,19 @@ private:
       function<const Tx&(const BinaryData&)> getzctxbykey);
 
    void loadZeroConfMempool(bool clearMempool);
-   set<BinaryData> purge(void);
+   NewBlockData getNewBlockData(void) const;
+   set<BinaryData> purge(const NewBlockData&);
+   map<BinaryData, Tx> purgeIncremental(const NewBlockData&);
+
+   void invTxFetcherThread(void);
+   void stopInvTxFetcher(void);
+   void processPayloadTx(shared_ptr<Payload_Tx>);
 
-   void processInvTxThread(void);
-   bool processInvTxThread(InvEntry, unsigned timeout_ms);
+   void zcDBWriterThread(void);
+   void writeZcBatch(map<BinaryData, ZcDBUpdate>&);
+   void stopZcDBWriter(void);
+
+   static unsigned getParserThreadCount(unsigned maxZcThread);
 
 public:
    //stacks new zc Tx objects from node
@@ -460,7 +544,8 @@ public:
 public:
    ZeroConfContainer(LMDBBlockDatabase* db, 
       shared_ptr<BitcoinP2P> node, unsigned maxZcThread) :
-      topId_(0), db_(db), maxZcThreadCount_(maxZcThread), networkNode_(node)
+      topId_(0), db_(db), maxZcThreadCount_(maxZcThread), networkNode_(node),
+      parserPool_(getParserThreadCount(maxZcThread))
    {
       zcEnabled_.store(false, memory_order_relaxed);
 
@@ -471,6 +556,20 @@ public:
       };
 
       networkNode_->registerInvTxLambda(processInvTx);
+
+      //requested tx callback
+      auto processTx = [this](shared_ptr<Payload_Tx> payloadTx)->void
+      {
+         this->processPayloadTx(payloadTx);
+      };
+
+      networkNode_->registerGetTxLambda(processTx);
+   }
+
+   ~ZeroConfContainer(void)
+   {
+      stopInvTxFetcher();
+      stopZcDBWriter();
    }
 
    bool hasTxByHash(const BinaryData& txHash) const;
@@ -495,9 +594,11 @@ public:
    const shared_ptr<map<BinaryData, set<HashString>>> getKeyToSpentScrAddrMap(void) const;
 
    void updateZCinDB(
-      const vector<BinaryData>& keysToWrite, const vector<BinaryData>& keysToDel);
+      const vector<BinaryData>& keysToWrite, const vector<BinaryData>& keysToDel,
+      function<void(void)> onCommit = nullptr);
+   void flushZCinDB(void);
 
-   void processInvTxVec(vector<InvEntry>, bool extend = true);
+   void processInvTxVec(vector<InvEntry>);
 
    void init(shared_ptr<ScrAddrFilter>, bool clearMempool);
    void shutdown();
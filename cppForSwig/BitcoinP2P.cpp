@@ -165,290 +165,204 @@ vector<uint8_t> Payload::serialize(uint32_t magic_word) const
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-vector<size_t> Payload::processPacket(
-   vector<uint8_t>& data, uint32_t magic_word)
+unique_ptr<Payload> Payload::instantiate(
+   const char* messagetype, uint8_t* payloadptr, size_t len)
 {
-   vector<size_t> retvec;   
-   if (data.size() < MESSAGE_HEADER_LEN)
-      return retvec;
+   //instantiate relevant Payload child class and return it
+   auto payloadIter = BitcoinP2P::strToPayload_.find(messagetype);
+   if (payloadIter == BitcoinP2P::strToPayload_.end())
+      return make_unique<Payload_Unknown>(payloadptr, len);
 
-   size_t offset = 0, totalsize = data.size();
-
-
-   while (offset < totalsize)
+   switch (payloadIter->second)
    {
-      uint8_t* ptr = &data[offset];
-
-      //check magic word
-      uint32_t* magicword = (uint32_t*)(ptr + MAGIC_WORD_OFFSET);
-      if (*magicword != magic_word)
-      {
-         //invalid magic word, search remainder of the packet for another one
-         auto sizeRemaining = totalsize - offset;
-         auto mwFirstByte = *(uint8_t*)(&magic_word);
-         unsigned i;
-         for (i = 4; i < sizeRemaining; i++)
-         {
-            if (ptr[i] == mwFirstByte)
-            {
-               auto mwPtr = (uint32_t*)(ptr + i);
-               if (*mwPtr == magic_word)
-                  break;
-            }
-         }
-
-         offset += i;
-         continue;
-      }
-
-      //get message type
-      char* messagetype = (char*)(ptr + MESSAGE_TYPE_OFFSET);
+   case Payload_version:
+      return make_unique<Payload_Version>(payloadptr, len);
 
-      //messagetype should be null terminated and no longer than 12 bytes
-      int i;
-      for (i = 0; i < MESSAGE_TYPE_LEN; i++)
-      {
-         if (messagetype[i] == 0)
-            break;
-      }
+   case Payload_verack:
+      return make_unique<Payload_Verack>();
 
-      if (i == MESSAGE_TYPE_LEN)
-      {
-         offset += 4; //skip the current mw before reentering the loop
-         continue;
-      }
+   case Payload_ping:
+      return make_unique<Payload_Ping>(payloadptr, len);
 
-      //get and verify length
-      uint32_t* length = (uint32_t*)(ptr + PAYLOAD_LENGTH_OFFSET);
-      auto localOffset = offset;
+   case Payload_pong:
+      return make_unique<Payload_Pong>(payloadptr, len);
 
-      //at this point we don't want to reparse this message if the the
-      //deser operation fails
-      offset += 4;
+   case Payload_inv:
+      return make_unique<Payload_Inv>(payloadptr, len);
 
-      if (*length + MESSAGE_HEADER_LEN > totalsize - localOffset)
-         return retvec;
+   case Payload_tx:
+      return make_unique<Payload_Tx>(payloadptr, len);
 
+   case Payload_getdata:
+      return make_unique<Payload_GetData>(payloadptr, len);
 
-      //get checksum
-      uint32_t* checksum = (uint32_t*)(ptr + CHECKSUM_OFFSET);
+   case Payload_reject:
+      return make_unique<Payload_Reject>(payloadptr, len);
 
-      //grab payload
-      BinaryDataRef payloadRef(ptr + MESSAGE_HEADER_LEN, *length);
+   default:
+      return make_unique<Payload_Unknown>(payloadptr, len);
+   }
+}
 
-      //verify checksum
-      auto&& payloadHash = BtcUtils::getHash256(payloadRef);
-      uint32_t* hashChecksum = (uint32_t*)payloadHash.getPtr();
+////////////////////////////////////////////////////////////////////////////////
+////
+//// P2PMessageBuffer
+////
+////////////////////////////////////////////////////////////////////////////////
+P2PMessageBuffer::P2PMessageBuffer(uint32_t magic_word, size_t capacity) :
+   magic_word_(magic_word)
+{
+   buffer_.resize(capacity);
+}
 
-      if (*hashChecksum != *checksum)
-         continue;
+////////////////////////////////////////////////////////////////////////////////
+void P2PMessageBuffer::compact()
+{
+   if (head_ == 0)
+      return;
 
-      retvec.push_back(localOffset);
-      offset += MESSAGE_HEADER_LEN + *length - 4;
-   }
+   auto remaining = tail_ - head_;
+   if (remaining > 0)
+      memmove(&buffer_[0], &buffer_[head_], remaining);
 
-   return retvec;
+   head_ = 0;
+   tail_ = remaining;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-shared_ptr<Payload::DeserializedPayloads> Payload::deserialize(
-   vector<uint8_t>& data, uint32_t magic_word,
-   shared_ptr<DeserializedPayloads> prevPacket)
+pair<uint8_t*, size_t> P2PMessageBuffer::getWriteSpace(size_t minLen)
 {
-   size_t bytesConsumed = 0;
-
-   auto parsepayloads = [&bytesConsumed](vector<uint8_t>& data, vector<size_t>& offsetVec)->
-      shared_ptr<DeserializedPayloads>
+   if (buffer_.size() - tail_ < minLen)
    {
-      auto result = make_shared<DeserializedPayloads>();
-
-      auto& payloadVec = result->payloads_;
+      //reclaim the consumed bytes before growing
+      compact();
 
-      for (unsigned y = 0; y < offsetVec.size(); y++)
+      if (buffer_.size() - tail_ < minLen)
       {
-         auto offset = offsetVec[y];         
-         bytesConsumed = offset;
-
-         auto length = (uint32_t*)(&data[offset] + PAYLOAD_LENGTH_OFFSET);
-
-         size_t localBytesConsumed = *length + MESSAGE_HEADER_LEN;
-         if (localBytesConsumed + offset > data.size())
-            break;
+         auto newSize = max(buffer_.size() * 2, tail_ + minLen);
+         buffer_.resize(newSize);
+      }
+   }
 
-         auto messagetype = (char*)(&data[offset] + MESSAGE_TYPE_OFFSET);
+   return make_pair(&buffer_[tail_], buffer_.size() - tail_);
+}
 
-         try
-         {
-            uint8_t* payloadptr = nullptr;
-            if (*length > 0)
-               payloadptr = &data[offset] + MESSAGE_HEADER_LEN;
+////////////////////////////////////////////////////////////////////////////////
+bool P2PMessageBuffer::commit(size_t len)
+{
+   tail_ += len;
+   if (!payloadCallback_)
+      return false;
 
-            //instantiate relevant Payload child class and return it
-            auto payloadIter = BitcoinP2P::strToPayload_.find(messagetype);
-            if (payloadIter != BitcoinP2P::strToPayload_.end())
-            {
-               switch (payloadIter->second)
-               {
-               case Payload_version:
-                  payloadVec.push_back(move(make_unique<Payload_Version>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_verack:
-                  payloadVec.push_back(move(make_unique<Payload_Verack>()));
-                  break;
-
-               case Payload_ping:
-                  payloadVec.push_back(move(make_unique<Payload_Ping>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_pong:
-                  payloadVec.push_back(move(make_unique<Payload_Pong>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_inv:
-                  payloadVec.push_back(move(make_unique<Payload_Inv>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_tx:
-                  payloadVec.push_back(move(make_unique<Payload_Tx>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_getdata:
-                  payloadVec.push_back(move(make_unique<Payload_GetData>(
-                     payloadptr, *length)));
-                  break;
-
-               case Payload_reject:
-                  payloadVec.push_back(move(make_unique<Payload_Reject>(
-                     payloadptr, *length)));
-               }
-            }
-            else
-            {
-               payloadVec.push_back(move(make_unique<Payload_Unknown>(
-                  payloadptr, *length)));
-            }
+   auto&& payloads = deserialize();
+   if (payloads.size() > 0)
+      payloadCallback_(move(payloads));
 
-            bytesConsumed += localBytesConsumed;
-         }
-         catch (PayloadDeserError&)
-         {
-            continue;
-         }
-      }
+   return false;
+}
 
-      if (bytesConsumed < data.size())
-      {
-         result->spillOffset_ = bytesConsumed;
-         result->data_ = move(data);
-      }
+////////////////////////////////////////////////////////////////////////////////
+void P2PMessageBuffer::completed(exception_ptr ePtr)
+{
+   if (completedCallback_)
+      completedCallback_(ePtr);
+}
 
-      return result;
-   };
+////////////////////////////////////////////////////////////////////////////////
+vector<unique_ptr<Payload>> P2PMessageBuffer::deserialize()
+{
+   vector<unique_ptr<Payload>> payloadVec;
 
-   auto patchspill = [&parsepayloads, &bytesConsumed](
-                     shared_ptr<DeserializedPayloads> prevpacket, 
-                     const vector<uint8_t>& data,
-                     const vector<size_t> offsets) -> shared_ptr<DeserializedPayloads>
+   while (tail_ - head_ >= MESSAGE_HEADER_LEN)
    {
-      if (prevpacket == nullptr)
-         return nullptr;
-
-      size_t spillSize = 0;
-      if (offsets.size() == 0)
-         spillSize = data.size();
-      else
-         spillSize = offsets[0];
+      uint8_t* ptr = &buffer_[head_];
+      auto remaining = tail_ - head_;
 
-      if (spillSize == 0)
+      //check magic word
+      uint32_t* magicword = (uint32_t*)(ptr + MAGIC_WORD_OFFSET);
+      if (*magicword != magic_word_)
       {
-         /*LOGERR << "+++ not enough data in this packet to complete left over";
-         LOGERR << "+++ dumping " << prevpacket->data_.size() << " bytes of data";
-
-         auto length = (uint32_t*)(&prevpacket->data_[prevpacket->spillOffset_] + PAYLOAD_LENGTH_OFFSET);
-         auto messagetype = (char*)(&prevpacket->data_[prevpacket->spillOffset_] + MESSAGE_TYPE_OFFSET);	
+         //invalid magic word, search the remainder for another one. The 
+         //trailing bytes may be the start of a magic word, keep them
+         size_t i;
+         for (i = 1; i + 4 <= remaining; i++)
+         {
+            auto mwPtr = (uint32_t*)(ptr + i);
+            if (*mwPtr == magic_word_)
+               break;
+         }
 
-         LOGERR << "+++ packet length is: " << *length << " bytes";
-         LOGERR << "+++ packet offset is: " << prevpacket->spillOffset_;
-         LOGERR << "+++ packet message is: " << messagetype;*/
-         return nullptr;
+         head_ += i;
+         continue;
       }
 
-      prevpacket->data_.insert(prevpacket->data_.end(),
-         data.begin(), data.begin() + spillSize);
-
-      vector<size_t> offvec;
-      offvec.push_back(prevpacket->spillOffset_);
+      //get message type
+      char* messagetype = (char*)(ptr + MESSAGE_TYPE_OFFSET);
 
-      auto spillResult = parsepayloads(prevpacket->data_, offvec);
-      if (spillResult->spillOffset_ != SIZE_MAX)
+      //messagetype should be null terminated and no longer than 12 bytes
+      int i;
+      for (i = 0; i < MESSAGE_TYPE_LEN; i++)
       {
-         spillResult->iterCount_ = prevpacket->iterCount_;
-         //spillResult->data_ = move(prevpacket->data_);
-
-         /*LOGWARN << "--- failed to complete spilled packet";
-         LOGWARN << "--- iter #" << spillResult->iterCount_++;
-         LOGWARN << "--- spilled size is: " << spillSize;
-         LOGWARN << "--- total data size is: " << spillResult->data_.size();
-         LOGWARN << "--- spill offset is: " << spillResult->spillOffset_;
-
-         auto length = (uint32_t*)(&spillResult->data_[spillResult->spillOffset_] + PAYLOAD_LENGTH_OFFSET);
-         auto messagetype = (char*)(&spillResult->data_[spillResult->spillOffset_] + MESSAGE_TYPE_OFFSET);
-         LOGWARN << "--- packet length: " << *length;
-         LOGWARN << "--- msgtype: " << messagetype;*/
+         if (messagetype[i] == 0)
+            break;
       }
-      else
+
+      if (i == MESSAGE_TYPE_LEN)
       {
-         if (prevpacket->iterCount_ > 0)
-            LOGWARN << "[[[ succesfully completed spill packet after " <<
-               spillResult->iterCount_ << " iterations";
+         head_ += 4; //skip the current mw before reentering the loop
+         continue;
       }
 
-      bytesConsumed += spillSize;
-      return spillResult;
-   };
-
-   auto&& offsetVec = processPacket(data, magic_word);
-   auto&& extraPacket = patchspill(prevPacket, data, offsetVec);
-
-   auto result = parsepayloads(data, offsetVec);
-   if (extraPacket != nullptr)
-   {
-      if (result->payloads_.size() == 0 && result->spillOffset_ == SIZE_MAX)
+      //get and verify length
+      uint32_t length = *(uint32_t*)(ptr + PAYLOAD_LENGTH_OFFSET);
+      if (length > P2P_MAX_PAYLOAD_LEN)
       {
-         //LOGWARN << "returning extraPacket with iter: " << extraPacket->iterCount_;
-         return extraPacket;
+         head_ += 4;
+         continue;
       }
 
-      typedef vector<unique_ptr<Payload>>::iterator vecUP;
+      //partial message, wait on the next read
+      if (length + MESSAGE_HEADER_LEN > remaining)
+         break;
 
-      vector<unique_ptr<Payload>> newvec;
-      newvec.insert(newvec.end(), 
-         move_iterator<vecUP>(extraPacket->payloads_.begin()),
-         move_iterator<vecUP>(extraPacket->payloads_.end()));
+      //verify checksum
+      uint8_t* payloadptr = nullptr;
+      if (length > 0)
+         payloadptr = ptr + MESSAGE_HEADER_LEN;
 
-      newvec.insert(newvec.end(),
-         move_iterator<vecUP>(result->payloads_.begin()),
-         move_iterator<vecUP>(result->payloads_.end()));
+      BinaryDataRef payloadRef(payloadptr, length);
+      auto&& payloadHash = BtcUtils::getHash256(payloadRef);
+      uint32_t* hashChecksum = (uint32_t*)payloadHash.getPtr();
+      uint32_t* checksum = (uint32_t*)(ptr + CHECKSUM_OFFSET);
 
-      result->payloads_ = move(newvec);
-      result->iterCount_ = extraPacket->iterCount_;
+      if (*hashChecksum != *checksum)
+      {
+         head_ += 4;
+         continue;
+      }
 
-      if (extraPacket->spillOffset_ != SIZE_MAX)
+      //deserialize straight from the buffer
+      try
+      {
+         payloadVec.push_back(
+            move(Payload::instantiate(messagetype, payloadptr, length)));
+      }
+      catch (PayloadDeserError&)
       {
-         LOGWARN << "*** got valid payloads without completing spill packet";
-         LOGWARN << "*** dumping " << extraPacket->data_.size() << " bytes of spill data";
       }
+
+      head_ += MESSAGE_HEADER_LEN + length;
    }
 
-   return result;
-}
+   //the buffer is drained, start over from the front
+   if (head_ == tail_)
+   {
+      head_ = 0;
+      tail_ = 0;
+   }
 
+   return payloadVec;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 void BitcoinNetAddr::deserialize(BinaryRefReader brr)
@@ -884,7 +798,7 @@ void BitcoinP2P::connectLoop(void)
    while (run_.load(memory_order_relaxed))
    {
       //clean up stacks
-      dataStack_ = make_shared<BlockingStack<vector<uint8_t>>>();
+      payloadStack_ = make_shared<BlockingStack<vector<unique_ptr<Payload>>>>();
 
       verackPromise_ = make_unique<promise<bool>>();
       auto verackFuture = verackPromise_->get_future();
@@ -981,22 +895,23 @@ void BitcoinP2P::pollSocketThread()
    if (!lock.try_lock())
       throw SocketError("another poll thread is already running");
 
-   auto dataStack = dataStack_;
+   auto payloadStack = payloadStack_;
 
-   auto callback = [dataStack](
-      vector<uint8_t> socketdata, exception_ptr ePtr)->bool
+   auto payloadCallback = [payloadStack](
+      vector<unique_ptr<Payload>> payloads)->void
    {
-      if (ePtr == nullptr && socketdata.size() > 0)
-      {
-         dataStack->push_back(move(socketdata));
-         return false;
-      }
+      payloadStack->push_back(move(payloads));
+   };
 
-      dataStack->terminate(ePtr);
-      return true;
+   auto completedCallback = [payloadStack](exception_ptr ePtr)->void
+   {
+      payloadStack->terminate(ePtr);
    };
 
-   binSocket_.readFromSocket(callback);
+   auto buffer = make_shared<P2PMessageBuffer>(magic_word_);
+   buffer->setCallbacks(payloadCallback, completedCallback);
+
+   binSocket_.readIntoBuffer(buffer);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1004,22 +919,10 @@ void BitcoinP2P::processDataStackThread()
 {
    try
    {
-      shared_ptr<Payload::DeserializedPayloads> packetPtr;
-
       while (1)
       {
-         shared_ptr<Payload::DeserializedPayloads> prevPacket = packetPtr;
-         packetPtr.reset();
-
-         auto&& data = dataStack_->pop_front();
-         auto&& processedPacket = Payload::deserialize(data, magic_word_, prevPacket);
-
-         if (processedPacket->spillOffset_ != SIZE_MAX)
-         {
-            packetPtr = processedPacket;
-         }
-
-         processPayload(move(processedPacket->payloads_));
+         auto&& payloads = payloadStack_->pop_front();
+         processPayload(move(payloads));
       }
    }
    catch (SocketError& e)
@@ -1262,6 +1165,9 @@ void BitcoinP2P::processGetTx(unique_ptr<Payload> payload)
       return;
    }
 
+   if (getTxLambda_)
+      getTxLambda_(payloadtx);
+
    auto& txHash = payloadtx->getHash256();
    auto gettxcallbackmap = getTxCallbackMap_.get();
    auto callbackIter = gettxcallbackmap->find(txHash);
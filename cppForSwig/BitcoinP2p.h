@@ -36,6 +36,10 @@ using namespace std;
 #define PAYLOAD_LENGTH_OFFSET 16
 #define CHECKSUM_OFFSET       20
 
+//receive buffer
+#define P2P_BUFFER_DEFAULT_SIZE  1024 * 1024
+#define P2P_MAX_PAYLOAD_LEN      32 * 1024 * 1024
+
 //netaddr
 #define NETADDR_WITHTIME   30
 #define NETADDR_NOTIME     26
@@ -149,22 +153,11 @@ class Payload
 {
 protected:
    virtual size_t serialize_inner(uint8_t*) const = 0;
-   static vector<size_t> processPacket(
-      vector<uint8_t>& data, uint32_t magic_word);
-
-public:
-   struct DeserializedPayloads
-   {
-      vector<uint8_t> data_;
-      vector<unique_ptr<Payload>> payloads_;
-      size_t spillOffset_ = SIZE_MAX;
-      int iterCount_ = 0;
-   };
 
 public:
-   static shared_ptr<DeserializedPayloads> deserialize(
-      vector<uint8_t>& data, uint32_t magic_word, 
-      shared_ptr<DeserializedPayloads> prevPacket);
+   //instantiates the Payload child class matching the message type
+   static unique_ptr<Payload> instantiate(
+      const char* messagetype, uint8_t* dataptr, size_t len);
 
 public:
    virtual ~Payload() 
@@ -359,6 +352,10 @@ public:
       invVector_.push_back(inventry);
    }
 
+   Payload_GetData(vector<InvEntry> invvec) :
+      invVector_(move(invvec))
+   {}
+
    void deserialize(uint8_t* dataptr, size_t len);
 
    PayloadType type(void) const { return Payload_getdata; }
@@ -456,6 +453,54 @@ public:
    string typeStr(void) const { return "reject"; }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class P2PMessageBuffer : public SocketReadBuffer
+{
+   /***
+   Receive buffer for the node socket. The socket recvs straight into the 
+   free tail of the buffer and complete messages are deserialized in place, 
+   partial ones wait for the next read. Consumed bytes are reclaimed by 
+   moving the unparsed remainder to the front, the buffer only grows when a 
+   single message does not fit in it.
+   ***/
+
+private:
+   const uint32_t magic_word_;
+
+   vector<uint8_t> buffer_;
+   size_t head_ = 0;
+   size_t tail_ = 0;
+
+   function<void(vector<unique_ptr<Payload>>)> payloadCallback_;
+   function<void(exception_ptr)> completedCallback_;
+
+private:
+   void compact(void);
+
+public:
+   P2PMessageBuffer(uint32_t magic_word,
+      size_t capacity = P2P_BUFFER_DEFAULT_SIZE);
+
+   void setCallbacks(
+      function<void(vector<unique_ptr<Payload>>)> payloadCallback,
+      function<void(exception_ptr)> completedCallback)
+   {
+      payloadCallback_ = move(payloadCallback);
+      completedCallback_ = move(completedCallback);
+   }
+
+   //SocketReadBuffer
+   pair<uint8_t*, size_t> getWriteSpace(size_t minLen);
+   bool commit(size_t len);
+   void completed(exception_ptr ePtr);
+
+   //parses all complete messages, partial ones are left in the buffer
+   vector<unique_ptr<Payload>> deserialize(void);
+
+   size_t capacity(void) const { return buffer_.size(); }
+   size_t pending(void) const { return tail_ - head_; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 class GetDataStatus
 {
@@ -511,7 +556,7 @@ private:
    atomic<bool> nodeConnected_;
 
    //to pass payloads between the poll thread and the processing one
-   shared_ptr<BlockingStack<vector<uint8_t>>> dataStack_;
+   shared_ptr<BlockingStack<vector<unique_ptr<Payload>>>> payloadStack_;
 
    exception_ptr select_except_ = nullptr;
    exception_ptr process_except_ = nullptr;
@@ -519,12 +564,12 @@ private:
    //callback lambdas
    Stack<function<void(const vector<InvEntry>&)>> invBlockLambdas_;
    function<void(vector<InvEntry>&)> invTxLambda_ = {};
+   function<void(shared_ptr<Payload_Tx>)> getTxLambda_ = {};
    function<void(void)> nodeStatusLambda_;
 
    //stores callback by txhash for getdata packet we send to the node
    TransactionalMap<BinaryData, shared_ptr<GetDataStatus>> getTxCallbackMap_;
 
-   atomic<bool> run_;
    future<bool> shutdownFuture_;
 
    uint32_t topBlock_ = UINT32_MAX;
@@ -542,14 +587,18 @@ public:
    static const map<string, PayloadType> strToPayload_;
 
 protected:
+   atomic<bool> run_;
+
    void processInvBlock(vector<InvEntry>);
+   void processInvTx(vector<InvEntry>);
+   void processGetTx(unique_ptr<Payload>);
+   void processPayload(vector<unique_ptr<Payload>>);
 
 private:
    void connectLoop(void);
 
    void pollSocketThread();
    void processDataStackThread(void);
-   void processPayload(vector<unique_ptr<Payload>>);
 
    void checkServices(unique_ptr<Payload>);
    
@@ -559,9 +608,7 @@ private:
    void replyPong(unique_ptr<Payload>);
 
    void processInv(unique_ptr<Payload>);
-   void processInvTx(vector<InvEntry>);
    void processGetData(unique_ptr<Payload>);
-   void processGetTx(unique_ptr<Payload>);
    void processReject(unique_ptr<Payload>);
 
    int64_t getTimeStamp() const;
@@ -578,7 +625,7 @@ public:
 
    virtual void connectToNode(bool async);
    virtual void shutdown(void);
-   void sendMessage(Payload&&);
+   virtual void sendMessage(Payload&&);
 
    shared_ptr<Payload> getTx(const InvEntry&, uint32_t timeout);
 
@@ -598,6 +645,15 @@ public:
       invTxLambda_ = move(func);
    }
 
+   //sees every tx the node sends us, ahead of the getTx callbacks
+   void registerGetTxLambda(function<void(shared_ptr<Payload_Tx>)> func)
+   {
+      if (!run_.load(memory_order_relaxed))
+         throw runtime_error("node has been shutdown");
+
+      getTxLambda_ = move(func);
+   }
+
    void registerGetTxCallback(const BinaryDataRef&, shared_ptr<GetDataStatus>);
    void unregisterGetTxCallback(const BinaryDataRef&);
 
@@ -611,9 +667,16 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 class NodeUnitTest : public BitcoinP2P
 {
+private:
+   mutex getDataMutex_;
+   vector<vector<InvEntry>> getDataVec_;
+
+   //stand-in for the node socket
+   P2PMessageBuffer rawBuffer_;
+
 public:
    NodeUnitTest(const string& addr, const string& port, uint32_t magic_word) :
-      BitcoinP2P(addr, port, magic_word)
+      BitcoinP2P(addr, port, magic_word), rawBuffer_(magic_word)
    {}
 
    void mockNewBlock(void)
@@ -627,11 +690,60 @@ public:
       processInvBlock(move(vecIE));
    }
 
+   void mockInvTx(vector<InvEntry> invVec)
+   {
+      processInvTx(move(invVec));
+   }
+
+   void mockTx(const BinaryData& rawTx)
+   {
+      auto payload = make_unique<Payload_Tx>(
+         (uint8_t*)rawTx.getPtr(), rawTx.getSize());
+      processGetTx(move(payload));
+   }
+
+   void mockRawData(const uint8_t* dataptr, size_t len)
+   {
+      //feed raw bytes as the socket would, in recv sized chunks
+      while (len > 0)
+      {
+         auto&& space = rawBuffer_.getWriteSpace(8192);
+         auto chunk = min(len, space.second);
+         memcpy(space.first, dataptr, chunk);
+         rawBuffer_.commit(chunk);
+
+         dataptr += chunk;
+         len -= chunk;
+
+         processPayload(rawBuffer_.deserialize());
+      }
+   }
+
+   vector<vector<InvEntry>> getDataRequests(void)
+   {
+      unique_lock<mutex> lock(getDataMutex_);
+      return getDataVec_;
+   }
+
    void connectToNode(bool async)
    {}
 
+   void sendMessage(Payload&& payload)
+   {
+      //there is no node, record the getdata requests
+      if (payload.type() != Payload_getdata)
+         return;
+
+      auto& getdata = (Payload_GetData&)payload;
+      unique_lock<mutex> lock(getDataMutex_);
+      getDataVec_.push_back(getdata.getInvVector());
+   }
+
    void shutdown(void)
    {
+      //reject lambdas registered past this point, as BitcoinP2P does
+      run_.store(false, memory_order_relaxed);
+
       //clean up remaining lambdas
       vector<InvEntry> ieVec;
       InvEntry entry;
@@ -210,6 +210,36 @@ void BlockDataManagerConfig::parseArgs(int argc, char* argv[])
    --zcthread-count: defines the maximum number on threads the zc parser can
    create for processing incoming transcations from the network node
 
+   --fcgi-threads: number of worker threads serving client requests. 
+   Defaults to 16.
+
+   --fcgi-callback-threads: number of worker threads serving registerCallback
+   long polls. Each connected client holds one while polling. Defaults to 512.
+
+   --fcgi-queue-depth: how many requests can wait for a worker, per lane. 
+   Requests past that are rejected with a "busy" error. 
+   Defaults to 1024.
+
+   --admission-rate: command budget each client gets per second. Cheap
+   methods cost 1, history and utxo queries 5, wallet wide history and utxo
+   sets 50. Commands past the budget are rejected with a "busy" error. 
+   Defaults to 500, 0 disables the budget.
+
+   --admission-burst: how much unused budget a client can accumulate. 
+   Defaults to 2000.
+
+   --heavy-request-slots: how many wallet wide history and utxo queries can
+   run at once. Clients waiting on a slot are served fairly. Up to half the
+   fcgi threads wait on a slot, and no more than 2 per client, past that
+   queries are turned down as busy. Defaults to 4.
+
+   --stats-log-interval: seconds between dumps of the per method request 
+   stats to the log. Defaults to 600, 0 disables them.
+
+   --notify-port: port clients subscribe to for pushed notifications, in
+   place of registerCallback long polls. Defaults to the fcgi port + 1. 
+   Set to 0 to disable push notifications.
+
    --db-type: sets the db type:
    DB_BARE: tracks wallet history only. Smallest DB.
    DB_FULL: tracks wallet history and resolves all relevant tx hashes.
@@ -228,6 +258,10 @@ void BlockDataManagerConfig::parseArgs(int argc, char* argv[])
 
    --clear-mempool: delete all zero confirmation transactions from the DB.
 
+   --txhash-index: maintain a global tx hash index in DB_FULL mode. Speeds up
+   hash resolution at the cost of disk space. Only covers blk files parsed 
+   after it is enabled, use --rebuild to index the whole chain.
+
    --satoshirpc-port: set node rpc port
 
    --listen-all: listen to all incoming IPs (not just localhost)
@@ -417,6 +451,21 @@ void BlockDataManagerConfig::processArgs(const map<string, string>& args,
       listen_all_ = true;
    }
 
+   iter = args.find("notify-port");
+   if (iter != args.end())
+   {
+      notifyPort_ = stripQuotes(iter->second);
+      int portInt = -1;
+      stringstream portSS(notifyPort_);
+      portSS >> portInt;
+
+      if (portInt < 0 || portInt > 65535)
+      {
+         cout << "Invalid notify port, falling back to default" << endl;
+         notifyPort_ = "";
+      }
+   }
+
    iter = args.find("satoshi-port");
    if (iter != args.end())
    {
@@ -486,6 +535,10 @@ void BlockDataManagerConfig::processArgs(const map<string, string>& args,
    if (iter != args.end())
       clearMempool_ = true;
 
+   iter = args.find("txhash-index");
+   if (iter != args.end())
+      txHashIndex_ = true;
+
    //db type
    iter = args.find("db-type");
    if (iter != args.end())
@@ -565,6 +618,118 @@ void BlockDataManagerConfig::processArgs(const map<string, string>& args,
          zcThreadCount_ = val;
    }
 
+   iter = args.find("fcgi-threads");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         fcgiThreadCount_ = val;
+   }
+
+   iter = args.find("fcgi-callback-threads");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         fcgiCallbackThreadCount_ = val;
+   }
+
+   iter = args.find("fcgi-queue-depth");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         fcgiQueueDepth_ = val;
+   }
+
+   iter = args.find("admission-rate");
+   if (iter != args.end())
+   {
+      int val = -1;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val >= 0)
+         admissionRate_ = val;
+   }
+
+   iter = args.find("admission-burst");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         admissionBurst_ = val;
+   }
+
+   iter = args.find("heavy-request-slots");
+   if (iter != args.end())
+   {
+      int val = 0;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val > 0)
+         heavyRequestSlots_ = val;
+   }
+
+   iter = args.find("stats-log-interval");
+   if (iter != args.end())
+   {
+      int val = -1;
+      try
+      {
+         val = stoi(iter->second);
+      }
+      catch (...)
+      {
+      }
+
+      if (val >= 0)
+         statsLogInterval_ = val;
+   }
+
    //cookie
    iter = args.find("cookie");
    if (iter != args.end())
@@ -28,6 +28,13 @@
 #endif
 
 #define DEFAULT_ZCTHREAD_COUNT 100
+#define DEFAULT_FCGI_THREAD_COUNT 16
+#define DEFAULT_FCGI_CALLBACK_THREAD_COUNT 512
+#define DEFAULT_FCGI_QUEUE_DEPTH 1024
+#define DEFAULT_STATS_LOG_INTERVAL 600
+#define DEFAULT_ADMISSION_RATE 500
+#define DEFAULT_ADMISSION_BURST 2000
+#define DEFAULT_HEAVY_REQUEST_SLOTS 4
 
 ////////////////////////////////////////////////////////////////////////////////
 struct BlockDataManagerConfig
@@ -60,6 +67,9 @@ struct BlockDataManagerConfig
    string btcPort_;
    string fcgiPort_;
    bool listen_all_ = false;
+
+   //push notification port, fcgi port + 1 if empty, "0" disables it
+   string notifyPort_;
    string rpcPort_;
 
    bool customFcgiPort_ = false;
@@ -70,12 +80,27 @@ struct BlockDataManagerConfig
    unsigned threadCount_ = thread::hardware_concurrency();
    unsigned zcThreadCount_ = DEFAULT_ZCTHREAD_COUNT;
 
+   //fcgi request worker pool, see FCGI_Server
+   unsigned fcgiThreadCount_ = DEFAULT_FCGI_THREAD_COUNT;
+   unsigned fcgiCallbackThreadCount_ = DEFAULT_FCGI_CALLBACK_THREAD_COUNT;
+   unsigned fcgiQueueDepth_ = DEFAULT_FCGI_QUEUE_DEPTH;
+
+   //seconds between request stats dumps to the log, 0 disables them
+   unsigned statsLogInterval_ = DEFAULT_STATS_LOG_INTERVAL;
+
+   //per client command budget, see AdmissionControl. A rate of 0 disables 
+   //the budget
+   unsigned admissionRate_ = DEFAULT_ADMISSION_RATE;
+   unsigned admissionBurst_ = DEFAULT_ADMISSION_BURST;
+   unsigned heavyRequestSlots_ = DEFAULT_HEAVY_REQUEST_SLOTS;
+
    exception_ptr exceptionPtr_ = nullptr;
 
    bool reportProgress_ = true;
 
    bool checkChain_ = false;
    bool clearMempool_ = false;
+   bool txHashIndex_ = false;
 
    const string cookie_;
    bool useCookie_ = false;
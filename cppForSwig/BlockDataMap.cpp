@@ -25,7 +25,7 @@ void BlockData::deserialize(const uint8_t* data, size_t size,
    BinaryDataRef bdr(data, HEADER_SIZE);
    BlockHeader bh(bdr);
 
-   blockHash_ = bh.thisHash_;
+   blockHash_ = bh.getThisHash();
 
    BinaryRefReader brr(data + HEADER_SIZE, size - HEADER_SIZE);
    auto numTx = (unsigned)brr.get_var_int();
@@ -107,13 +107,12 @@ shared_ptr<BlockHeader> BlockData::createBlockHeader(void) const
    auto bhPtr = make_shared<BlockHeader>();
    auto& bh = *bhPtr;
 
-   bh.dataCopy_ = move(BinaryData(data_, HEADER_SIZE));
+   memcpy(bh.rawHeader_, data_, HEADER_SIZE);
 
    bh.difficultyDbl_ = BtcUtils::convertDiffBitsToDouble(
       BinaryDataRef(data_ + 72, 4));
 
    bh.isInitialized_ = true;
-   bh.nextHash_ = BinaryData(0);
    bh.blockHeight_ = UINT32_MAX;
    bh.difficultySum_ = -1;
    bh.isMainBranch_ = false;
@@ -124,7 +123,7 @@ shared_ptr<BlockHeader> BlockData::createBlockHeader(void) const
 
    bh.blkFileNum_ = fileID_;
    bh.blkFileOffset_ = offset_;
-   bh.thisHash_ = blockHash_;
+   memcpy(bh.thisHash_, blockHash_.getPtr(), 32);
    bh.uniqueID_ = uniqueID_;
 
    return bhPtr;
@@ -316,3 +315,260 @@ BlockDataFileMap::BlockDataFileMap(const string& filename)
       }
    }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// BlockIndexFile
+//
+////////////////////////////////////////////////////////////////////////////////
+const size_t BlockIndexFile::FILE_HEADER_LENGTH;
+const size_t BlockIndexFile::RECORD_LENGTH;
+const uint32_t BlockIndexFile::VERSION;
+
+////////////////////////////////////////////////////////////////////////////////
+uint32_t BlockIndexFile::checksum(const uint8_t* ptr, size_t len)
+{
+   //FNV-1a, only meant to catch torn or garbled records
+   uint32_t hash = 2166136261U;
+   for (size_t i = 0; i < len; i++)
+   {
+      hash ^= ptr[i];
+      hash *= 16777619U;
+   }
+
+   return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t BlockIndexFile::getFileSize(const string& path)
+{
+#ifdef _WIN32
+   int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+   if (fd == -1)
+      return 0;
+
+   size_t size = _lseek(fd, 0, SEEK_END);
+   _close(fd);
+#else
+   int fd = open(path.c_str(), O_RDONLY);
+   if (fd == -1)
+      return 0;
+
+   size_t size = lseek(fd, 0, SEEK_END);
+   close(fd);
+#endif
+
+   return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockIndexFile::writeToFile(
+   const string& path, const BinaryData& data, bool append)
+{
+   //write and flush to disk before returning
+#ifdef _WIN32
+   int flags = _O_WRONLY | _O_BINARY | _O_CREAT;
+   flags |= append ? _O_APPEND : _O_TRUNC;
+   int fd = _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+   int flags = O_WRONLY | O_CREAT;
+   flags |= append ? O_APPEND : O_TRUNC;
+   int fd = open(path.c_str(), flags, 0644);
+#endif
+
+   if (fd == -1)
+      throw runtime_error("failed to open block index file");
+
+   size_t written = 0;
+   bool failed = false;
+   while (written < data.getSize())
+   {
+#ifdef _WIN32
+      auto count = _write(fd, data.getPtr() + written, 
+         data.getSize() - written);
+#else
+      auto count = write(fd, data.getPtr() + written, 
+         data.getSize() - written);
+#endif
+      if (count <= 0)
+      {
+         failed = true;
+         break;
+      }
+
+      written += count;
+   }
+
+#ifdef _WIN32
+   if (!failed && _commit(fd) != 0)
+      failed = true;
+   _close(fd);
+#else
+   if (!failed && fsync(fd) != 0)
+      failed = true;
+   close(fd);
+#endif
+
+   if (failed)
+      throw runtime_error("failed to write block index file");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData BlockIndexFile::getFileHeader() const
+{
+   BinaryWriter bw;
+   bw.put_BinaryData(BinaryData::CreateFromHex("41524d424c4b4958")); //ARMBLKIX
+   bw.put_uint32_t(VERSION);
+   bw.put_BinaryData(magicBytes_);
+
+   if (bw.getSize() != FILE_HEADER_LENGTH)
+      throw runtime_error("invalid magic bytes for block index file");
+
+   return bw.getData();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockIndexFile::serializeRecord(
+   BinaryWriter& bw, const BlockHeader& header) const
+{
+   auto start = bw.getSize();
+
+   bw.put_BinaryData(header.getThisHash());
+   bw.put_BinaryData(header.serialize());
+   bw.put_uint16_t(header.getBlockFileNum());
+   bw.put_uint64_t(header.getOffset());
+   bw.put_uint32_t(header.getBlockSize());
+   bw.put_uint32_t(header.getNumTx());
+   bw.put_uint32_t(header.getBlockHeight());
+   bw.put_uint8_t(header.getDuplicateID());
+   bw.put_uint32_t(header.getThisID());
+
+   if (bw.getSize() - start != RECORD_LENGTH - 4)
+      throw runtime_error("invalid block index record");
+
+   bw.put_uint32_t(checksum(
+      bw.getData().getPtr() + start, RECORD_LENGTH - 4));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool BlockIndexFile::load(const function<void(
+   shared_ptr<BlockHeader>, uint32_t, uint8_t)>& callback) const
+{
+   auto fileSize = getFileSize(path_);
+   if (fileSize < FILE_HEADER_LENGTH)
+      return false;
+
+   if ((fileSize - FILE_HEADER_LENGTH) % RECORD_LENGTH != 0)
+   {
+      LOGWARN << "block index file has a partial record";
+      return false;
+   }
+
+   BlockDataFileMap fileMap(path_);
+   auto ptr = fileMap.getPtr();
+   if (ptr == nullptr || fileMap.size() != fileSize)
+      return false;
+
+   auto&& fileHeader = getFileHeader();
+   if (memcmp(ptr, fileHeader.getPtr(), FILE_HEADER_LENGTH) != 0)
+   {
+      LOGWARN << "block index file header mismatch";
+      return false;
+   }
+
+   //verify all records first, keep the last one for each hash
+   map<BinaryDataRef, const uint8_t*> records;
+   for (size_t offset = FILE_HEADER_LENGTH; offset < fileSize;
+      offset += RECORD_LENGTH)
+   {
+      auto recordPtr = ptr + offset;
+      auto recordSum = READ_UINT32_LE(recordPtr + RECORD_LENGTH - 4);
+      if (recordSum != checksum(recordPtr, RECORD_LENGTH - 4))
+      {
+         LOGWARN << "corrupt record in block index file";
+         return false;
+      }
+
+      records[BinaryDataRef(recordPtr, 32)] = recordPtr;
+   }
+
+   //all headers share a single allocation
+   auto arena = make_shared<vector<BlockHeader>>(records.size());
+   size_t arenaID = 0;
+
+   for (auto& record : records)
+   {
+      BinaryRefReader brr(record.second + 32, RECORD_LENGTH - 36);
+
+      shared_ptr<BlockHeader> header(arena, &(*arena)[arenaID++]);
+      header->unserialize(
+         brr.get_BinaryDataRef(HEADER_SIZE).getPtr(), HEADER_SIZE,
+         record.first);
+
+      header->setBlockFileNum(brr.get_uint16_t());
+      header->setBlockFileOffset(brr.get_uint64_t());
+      header->setBlockSize(brr.get_uint32_t());
+      header->setNumTx(brr.get_uint32_t());
+
+      auto height = brr.get_uint32_t();
+      auto dupID = brr.get_uint8_t();
+
+      unsigned uniqueID = brr.get_uint32_t();
+      header->setUniqueID(uniqueID);
+
+      callback(header, height, dupID);
+   }
+
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockIndexFile::append(const vector<shared_ptr<BlockHeader>>& headers)
+{
+   if (headers.size() == 0)
+      return;
+
+   BinaryWriter bw;
+   if (getFileSize(path_) < FILE_HEADER_LENGTH)
+      bw.put_BinaryData(getFileHeader());
+
+   for (auto& header : headers)
+      serializeRecord(bw, *header);
+
+   writeToFile(path_, bw.getData(), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockIndexFile::rewrite(
+   const vector<shared_ptr<BlockHeader>>& headers)
+{
+   //write to a swap file then rename it, so that a crash never leaves a 
+   //truncated index behind
+   BinaryWriter bw;
+   bw.put_BinaryData(getFileHeader());
+
+   for (auto& header : headers)
+   {
+      //skip the genesis placeholder and headers that aren't in the db yet
+      if (!header->isInitialized() || 
+          header->getBlockHeight() == UINT32_MAX)
+         continue;
+
+      serializeRecord(bw, *header);
+   }
+
+   auto swapPath = path_;
+   swapPath.append(".tmp");
+   writeToFile(swapPath, bw.getData(), false);
+
+   remove(path_.c_str());
+   if (rename(swapPath.c_str(), path_.c_str()) != 0)
+      throw runtime_error("failed to replace block index file");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockIndexFile::wipe()
+{
+   remove(path_.c_str());
+}
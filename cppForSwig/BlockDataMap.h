@@ -24,6 +24,7 @@
 #include <iomanip>
 
 #include <map>
+#include <functional>
 
 using namespace std;
 
@@ -31,6 +32,7 @@ using namespace std;
 #include <Windows.h>
 #include <io.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #else
 #include <errno.h>
 #include <sys/mman.h>
@@ -368,4 +370,61 @@ public:
    shared_ptr<BlockDataFileMap> get(uint32_t fileid);
 };
 
+/////////////////////////////////////////////////////////////////////////////
+class BlockIndexFile
+{
+   /***
+   Flat file mirror of the HEADERS db: one fixed size record per header,
+   carrying the raw header, its hash, its location in the blk files, its 
+   height and dupID. Loading it takes a single mmap and a linear walk, 
+   instead of iterating the HEADERS db and rehashing every header.
+
+   The file is only appended to, and synced to disk, after the matching
+   headers were committed to the HEADERS db. A later record for the same 
+   hash supersedes the earlier ones. Records carry a checksum, a file with 
+   a bad record (i.e. a torn append) fails to load and should be rewritten
+   from the HEADERS db.
+
+   file layout:
+      magic (8) | version (4) | network magic bytes (4) | records...
+   record layout:
+      hash (32) | raw header (80) | fileID (2) | offset (8) | size (4) |
+      numTx (4) | height (4) | dupID (1) | uniqueID (4) | checksum (4)
+   ***/
+
+public:
+   static const size_t FILE_HEADER_LENGTH = 16;
+   static const size_t RECORD_LENGTH = 143;
+   static const uint32_t VERSION = 1;
+
+private:
+   const string path_;
+   const BinaryData magicBytes_;
+
+private:
+   static uint32_t checksum(const uint8_t* ptr, size_t len);
+   static size_t getFileSize(const string& path);
+   static void writeToFile(const string& path, 
+      const BinaryData& data, bool append);
+
+   BinaryData getFileHeader(void) const;
+   void serializeRecord(BinaryWriter&, const BlockHeader&) const;
+
+public:
+   BlockIndexFile(const string& path, const BinaryData& magicBytes) :
+      path_(path), magicBytes_(magicBytes)
+   {}
+
+   //returns false if the file is missing, belongs to another network or
+   //has a bad record. Callback order is not height order.
+   bool load(const function<void(
+      shared_ptr<BlockHeader>, uint32_t, uint8_t)>&) const;
+
+   void append(const vector<shared_ptr<BlockHeader>>&);
+   void rewrite(const vector<shared_ptr<BlockHeader>>&);
+   void wipe(void);
+
+   const string& path(void) const { return path_; }
+};
+
 #endif
@@ -457,6 +457,26 @@ shared_ptr<BlockHeader> BlockDataViewer::getHeaderByHash(
 vector<UnspentTxOut> BlockDataViewer::getUnspentTxoutsForAddr160List(
    const vector<BinaryData>& scrAddrVec, bool ignoreZc) const
 {
+   vector<UnspentTxOut> UTXOs;
+   auto pushUtxo = [&UTXOs](UnspentTxOut&& utxo)->void
+   {
+      UTXOs.push_back(move(utxo));
+   };
+
+   getUnspentTxoutsForAddr160List(scrAddrVec, ignoreZc, pushUtxo);
+   return UTXOs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockDataViewer::getUnspentTxoutsForAddr160List(
+   const vector<BinaryData>& scrAddrVec, bool ignoreZc,
+   const function<void(UnspentTxOut&&)>& callback) const
+{
+   /***
+   Hands out utxos as they are pulled from DB rather than gathering them 
+   all first, so that callers can stream them out.
+   ***/
+
    ScrAddrFilter* saf = bdmPtr_->getScrAddrFilter().get();
 
    auto scrAddrMap = saf_->getScrAddrMap();
@@ -471,8 +491,6 @@ vector<UnspentTxOut> BlockDataViewer::getUnspentTxoutsForAddr160List(
       }
    }
 
-   vector<UnspentTxOut> UTXOs;
-
    for (const auto& scrAddr : scrAddrVec)
    {
       const auto& zcTxioMap = zeroConfCont_->getUnspentZCforScrAddr(scrAddr);
@@ -480,18 +498,18 @@ vector<UnspentTxOut> BlockDataViewer::getUnspentTxoutsForAddr160List(
       StoredScriptHistory ssh;
       db_->getStoredScriptHistory(ssh, scrAddr);
 
-      map<BinaryData, UnspentTxOut> scrAddrUtxoMap;
-      db_->getFullUTXOMapForSSH(ssh, scrAddrUtxoMap);
-
-      for (const auto& utxoPair : scrAddrUtxoMap)
+      auto filterZcSpent = [&zcTxioMap, &callback]
+         (const BinaryData& txoKey, UnspentTxOut&& utxo)->void
       {
-         auto zcIter = zcTxioMap.find(utxoPair.first);
+         auto zcIter = zcTxioMap.find(txoKey);
          if (zcIter != zcTxioMap.end())
             if (zcIter->second.hasTxInZC())
-               continue;
+               return;
 
-         UTXOs.push_back(utxoPair.second);
-      }
+         callback(move(utxo));
+      };
+
+      db_->getFullUTXOsForSSH(ssh, filterZcSpent);
 
       if (ignoreZc)
          continue;
@@ -505,13 +523,9 @@ vector<UnspentTxOut> BlockDataViewer::getUnspentTxoutsForAddr160List(
             continue;
 
          TxOut txout = zcTxio.second.getTxOutCopy(db_);
-         UnspentTxOut UTXO = UnspentTxOut(db_, txout, UINT32_MAX);
-
-         UTXOs.push_back(UTXO);
+         callback(UnspentTxOut(db_, txout, UINT32_MAX));
       }
    }
-
-   return UTXOs;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -142,6 +142,9 @@ public:
    vector<UnspentTxOut> 
       getUnspentTxoutsForAddr160List(
       const vector<BinaryData>&, bool ignoreZc) const;
+   void getUnspentTxoutsForAddr160List(
+      const vector<BinaryData>&, bool ignoreZc, 
+      const function<void(UnspentTxOut&&)>&) const;
 
    bool isBDMRunning(void) const 
    { 
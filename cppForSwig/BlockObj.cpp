@@ -27,12 +27,23 @@ void BlockHeader::unserialize(uint8_t const * ptr, uint32_t size)
 {
    if (size < HEADER_SIZE)
       throw BlockDeserializingException();
-   dataCopy_.copyFrom(ptr, HEADER_SIZE);
-   BtcUtils::getHash256(dataCopy_.getPtr(), HEADER_SIZE, thisHash_);
+   BinaryData hash(32);
+   BtcUtils::getHash256_NoSafetyCheck(ptr, HEADER_SIZE, hash);
+   unserialize(ptr, size, hash.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockHeader::unserialize(uint8_t const * ptr, uint32_t size,
+   BinaryDataRef const & hash)
+{
+   if (size < HEADER_SIZE || hash.getSize() != 32)
+      throw BlockDeserializingException();
+   memcpy(rawHeader_, ptr, HEADER_SIZE);
+   memcpy(thisHash_, hash.getPtr(), 32);
    difficultyDbl_ = BtcUtils::convertDiffBitsToDouble( 
-                              BinaryDataRef(dataCopy_.getPtr()+72, 4));
+                              BinaryDataRef(rawHeader_+72, 4));
    isInitialized_ = true;
-   nextHash_ = BinaryData(0);
+   memset(nextHash_, 0, 32);
    blockHeight_ = UINT32_MAX;
    difficultySum_ = -1;
    isMainBranch_ = false;
@@ -39,6 +39,16 @@ class TxOut;
 ////////////////////////////////////////////////////////////////////////////////
 template<typename T> class TxFilter
 {
+   /***
+   On disk, a filter is laid out as:
+      size (4 bytes) | block key (4 bytes) | count (4 bytes) | payload
+
+   The legacy payload is the hash prefixes in tx order, which forces
+   a linear scan per lookup. The sorted payload carries the prefixes in
+   ascending order followed by their tx indexes (uint32_t each), so that
+   lookups are a binary search. The size field tells the layouts apart.
+   ***/
+
    template <typename U> friend class TxFilterPool;
 
 private:
@@ -48,6 +58,7 @@ private:
    uint32_t blockKey_ = UINT32_MAX;
    size_t len_ = SIZE_MAX;
    bool isValid_ = false;
+   bool isSorted_ = true;
 
 private:
    void update(const BinaryData& hash)
@@ -70,6 +81,16 @@ private:
       return *(uint32_t*)(ptr + 8);
    }
 
+   static size_t getLinearSize(size_t len)
+   {
+      return len * sizeof(T) + 12;
+   }
+
+   static size_t getSortedSize(size_t len)
+   {
+      return len * (sizeof(T) + sizeof(uint32_t)) + 12;
+   }
+
    bool checkPtrLen(const uint8_t* ptr)
    {
       if (ptr == nullptr)
@@ -80,24 +101,53 @@ private:
          throw runtime_error("invalid txfilter ptr");
 
       auto len = (uint32_t*)(ptr + 8);
-      auto total = *len * sizeof(T) + 12;
-      if (total != *size)
+      if (*size != getSortedSize(*len) && *size != getLinearSize(*len))
          throw runtime_error("invalid txfilter ptr");
 
       return true;
    }
 
+   static bool isSortedPtr(const uint8_t* ptr)
+   {
+      auto size = (uint32_t*)ptr;
+      auto len = (uint32_t*)(ptr + 8);
+      return *size == getSortedSize(*len);
+   }
+
    void deserialize(uint8_t* ptr)
    {
       auto size = (uint32_t*)ptr;
       blockKey_ = *(uint32_t*)(ptr + 4);
       len_ = *(uint32_t*)(ptr + 8);
 
-      if (*size != len_ * sizeof(T) + 12)
-         throw runtime_error("deser error");
-      
       filterVector_.resize(len_);
-      memcpy(&filterVector_[0], ptr + 12, len_ * sizeof(T));
+
+      if (*size == getSortedSize(len_))
+      {
+         //undo the permutation, filterVector_ is always in tx order
+         auto keys = (T*)(ptr + 12);
+         auto ids = (uint32_t*)(keys + len_);
+
+         for (unsigned i = 0; i < len_; i++)
+         {
+            if (ids[i] >= len_)
+               throw runtime_error("deser error");
+
+            filterVector_[ids[i]] = keys[i];
+         }
+
+         isSorted_ = true;
+      }
+      else if (*size == getLinearSize(len_))
+      {
+         if (len_ > 0)
+            memcpy(&filterVector_[0], ptr + 12, len_ * sizeof(T));
+         isSorted_ = false;
+      }
+      else
+      {
+         throw runtime_error("deser error");
+      }
 
       isValid_ = true;
    }
@@ -121,18 +171,21 @@ public:
       len_(getLenFromPtr(ptr))
    {
       filterPtr_ = ptr;
+      isSorted_ = isSortedPtr(ptr);
    }
 
    TxFilter(const TxFilter<T>& obj) :
+      filterPtr_(obj.filterPtr_),
       blockKey_(obj.blockKey_), len_(obj.len_),
-      isValid_(obj.isValid_), filterPtr_(obj.filterPtr_)
+      isValid_(obj.isValid_), isSorted_(obj.isSorted_)
    {
       filterVector_ = obj.filterVector_;
    }
 
    TxFilter(TxFilter<T>&& mv) :
+      filterPtr_(mv.filterPtr_),
       blockKey_(mv.blockKey_), len_(mv.len_),
-      isValid_(mv.isValid_), filterPtr_(mv.filterPtr_)
+      isValid_(mv.isValid_), isSorted_(mv.isSorted_)
    {
       filterVector_ = move(mv.filterVector_);
    }
@@ -143,6 +196,7 @@ public:
       len_ = rhs.len_;
       filterVector_ = rhs.filterVector_;
       filterPtr_ = rhs.filterPtr_;
+      isSorted_ = rhs.isSorted_;
 
       isValid_ = true;
 
@@ -151,6 +205,9 @@ public:
 
    bool isValid(void) const { return isValid_; }
 
+   //false if this filter was read from a legacy (unsorted) db entry
+   bool isSorted(void) const { return isSorted_; }
+
    void update(const vector<BinaryData>& hashVec)
    {
       if (!isValid())
@@ -182,9 +239,22 @@ public:
       else if (filterPtr_ != nullptr)
       {
          auto ptr = (T*)(filterPtr_ + 12);
-         for (unsigned i = 0; i < len_; i++)
-            if (ptr[i] == key)
-               resultSet.insert(i);
+         if (isSorted_)
+         {
+            auto ids = (uint32_t*)(ptr + len_);
+            auto iter = lower_bound(ptr, ptr + len_, key);
+            while (iter != ptr + len_ && *iter == key)
+            {
+               resultSet.insert(ids[iter - ptr]);
+               ++iter;
+            }
+         }
+         else
+         {
+            for (unsigned i = 0; i < len_; i++)
+               if (ptr[i] == key)
+                  resultSet.insert(i);
+         }
       }
       else
          throw runtime_error("invalid filter");
@@ -193,20 +263,40 @@ public:
    }
 
    uint32_t getBlockKey(void) const { return blockKey_; }
+   const vector<T>& getFilterVector(void) const { return filterVector_; }
 
    void serialize(BinaryWriter& bw) const
    {
       if (blockKey_ == UINT32_MAX)
          throw runtime_error("invalid block key");
 
-      uint32_t size = 12 + filterVector_.size() * sizeof(T);
+      //always write the sorted layout
+      vector<uint32_t> order(filterVector_.size());
+      for (unsigned i = 0; i < order.size(); i++)
+         order[i] = i;
+
+      sort(order.begin(), order.end(), 
+         [this](const uint32_t& lhs, const uint32_t& rhs)->bool
+      {
+         if (filterVector_[lhs] == filterVector_[rhs])
+            return lhs < rhs;
+
+         return filterVector_[lhs] < filterVector_[rhs];
+      });
+
+      uint32_t size = getSortedSize(filterVector_.size());
       bw.put_uint32_t(size);
       bw.put_uint32_t(blockKey_);
       bw.put_uint32_t(filterVector_.size());
       
-      BinaryDataRef bdr(
-         (uint8_t*)&filterVector_[0], filterVector_.size() * sizeof(T));
-      bw.put_BinaryData(bdr);
+      for (auto& id : order)
+      {
+         BinaryDataRef bdr((uint8_t*)&filterVector_[id], sizeof(T));
+         bw.put_BinaryData(bdr);
+      }
+
+      for (auto& id : order)
+         bw.put_uint32_t(id);
    }
 
    bool operator < (const TxFilter& rhs) const
@@ -244,9 +334,9 @@ public:
    BlockHeader & unserialize_1_(BinaryData const & str) { unserialize(str); return *this; }
 
    uint32_t           getVersion(void) const      { return READ_UINT32_LE(getPtr() );   }
-   BinaryData const & getThisHash(void) const     { return thisHash_;                   }
+   BinaryData         getThisHash(void) const     { return BinaryData(thisHash_, 32);   }
    BinaryData         getPrevHash(void) const     { return BinaryData(getPtr()+4 ,32);  }
-   BinaryData const & getNextHash(void) const     { return nextHash_;                   }
+   BinaryData         getNextHash(void) const     { return BinaryData(nextHash_, 32);   }
    BinaryData         getMerkleRoot(void) const   { return BinaryData(getPtr()+36,32);  }
    BinaryData         getDiffBits(void) const     { return BinaryData(getPtr()+72,4 );  }
    uint32_t           getTimestamp(void) const    { return READ_UINT32_LE(getPtr()+68); }
@@ -258,9 +348,9 @@ public:
    double             getDifficultySum(void) const{ return difficultySum_;              }
 
    /////////////////////////////////////////////////////////////////////////////
-   BinaryDataRef  getThisHashRef(void) const   { return thisHash_.getRef();            }
+   BinaryDataRef  getThisHashRef(void) const   { return BinaryDataRef(thisHash_, 32);  }
    BinaryDataRef  getPrevHashRef(void) const   { return BinaryDataRef(getPtr()+4, 32); }
-   BinaryDataRef  getNextHashRef(void) const   { return nextHash_.getRef();            }
+   BinaryDataRef  getNextHashRef(void) const   { return BinaryDataRef(nextHash_, 32);  }
    BinaryDataRef  getMerkleRootRef(void) const { return BinaryDataRef(getPtr()+36,32); }
    BinaryDataRef  getDiffBitsRef(void) const   { return BinaryDataRef(getPtr()+72,4 ); }
    uint32_t       getNumTx(void) const         { return numTx_; }
@@ -271,11 +361,11 @@ public:
    /////////////////////////////////////////////////////////////////////////////
    uint8_t const * getPtr(void) const  {
       assert(isInitialized_);
-      return dataCopy_.getPtr();
+      return rawHeader_;
    }
    size_t        getSize(void) const {
       assert(isInitialized_);
-      return dataCopy_.getSize();
+      return HEADER_SIZE;
    }
    bool            isInitialized(void) const { return isInitialized_; }
    uint32_t        getBlockSize(void) const { return numBlockBytes_; }
@@ -292,7 +382,12 @@ public:
    void          pprintAlot(ostream & os=cout);
 
    /////////////////////////////////////////////////////////////////////////////
-   const BinaryData& serialize(void) const   { return dataCopy_; }
+   BinaryData serialize(void) const   
+   { 
+      if (!isInitialized_)
+         return BinaryData(0);
+      return BinaryData(rawHeader_, HEADER_SIZE); 
+   }
 
    bool hasFilePos(void) const { return blkFileNum_ != UINT32_MAX; }
 
@@ -302,6 +397,9 @@ public:
 
    /////////////////////////////////////////////////////////////////////////////
    void unserialize(uint8_t const * ptr, uint32_t size);
+   //skips hashing, for headers coming from a trusted store
+   void unserialize(uint8_t const * ptr, uint32_t size, 
+      BinaryDataRef const & hash);
    void unserialize(BinaryData const & str) { unserialize(str.getRef()); }
    void unserialize(BinaryDataRef const & str);
    void unserialize(BinaryRefReader & brr);
@@ -311,8 +409,6 @@ public:
    uint8_t getDuplicateID(void) const { return duplicateID_; }
    void    setDuplicateID(uint8_t d)  { duplicateID_ = d; }
 
-   void clearDataCopy() {dataCopy_.resize(0);}
-
    BinaryData getBlockDataKey(void) const
    {
       return DBUtils::getBlkDataKeyNoPrefix(blockHeight_, duplicateID_);
@@ -322,7 +418,9 @@ public:
    void setUniqueID(unsigned int& ID) { uniqueID_ = ID; }
 
 private:
-   BinaryData     dataCopy_;
+   // The raw header and hashes are kept inline, a header carries no heap
+   // allocation of its own. The chain can hold several 100k of these.
+   uint8_t        rawHeader_[HEADER_SIZE] = {};
    bool           isInitialized_ = false;
    bool           isMainBranch_ = false;
    bool           isOrphan_ = true;
@@ -335,11 +433,11 @@ private:
    uint32_t       numBlockBytes_; // includes header + nTx + sum(Tx)
    
    // Derived properties - we expect these to be set after construct/copy
-   BinaryData     thisHash_;
+   uint8_t        thisHash_[32] = {};
    double         difficultyDbl_ = 0.0;
 
    // Need to compute these later
-   BinaryData     nextHash_;
+   uint8_t        nextHash_[32] = {};
    double         difficultySum_ = 0.0;
 
    string         blkFile_;
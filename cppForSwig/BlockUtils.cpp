@@ -166,7 +166,7 @@ public:
       Blockchain &bc
    ) 
    {
-      auto& allHeaders = bc.allHeaders();
+      auto allHeaders = bc.allHeaders();
       
       size_t index=0;
       
@@ -174,7 +174,7 @@ public:
       {
          const BinaryData hash = getFirstHash(blkFiles_[index]);
 
-         if (allHeaders.find(hash) == allHeaders.end())
+         if (allHeaders->find(hash.getRef()) == BlockHeaderStore::INVALID_HANDLE)
          { // not found in this file
             if (index == 0)
                return { 0, 0 };
@@ -210,16 +210,16 @@ public:
          block.unserialize(brr);
          
          const HashString blockhash = block.getThisHash();
-         auto bhIter = allHeaders.find(blockhash);
+         auto bhPtr = allHeaders->getByHash(blockhash.getRef());
          
-         if(bhIter == allHeaders.end())
+         if(bhPtr == nullptr)
             throw StopReading();
 
-         if (bhIter->second->getThisHash() == topBlockHash)
+         if (bhPtr->getThisHash() == topBlockHash)
             foundTopBlock = true;
 
-         bhIter->second->setBlockFileNum(pos.first);
-         bhIter->second->setBlockFileOffset(pos.second);
+         bhPtr->setBlockFileNum(pos.first);
+         bhPtr->setBlockFileOffset(pos.second);
       };
       
       uint64_t returnedOffset = UINT64_MAX;
@@ -867,7 +867,7 @@ BlockDataManager::BlockDataManager(
    blockchain_ = make_shared<Blockchain>(config_.genesisBlockHash_);
 
    iface_ = new LMDBBlockDatabase(blockchain_, 
-      config_.blkFileLocation_, config_.armoryDbType_);
+      config_.blkFileLocation_, config_.armoryDbType_, config_.txHashIndex_);
 
    readBlockHeaders_ = make_shared<BitcoinQtBlockFiles>(
       config_.blkFileLocation_,
@@ -18,6 +18,108 @@
 #undef max
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//
+// BlockHeaderStore
+//
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const BlockHeaderStore::Handle BlockHeaderStore::INVALID_HANDLE;
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockHeaderStore::clear()
+{
+   headers_.clear();
+   hashes_.clear();
+   handlesById_.clear();
+   hashSlots_.assign(1024, INVALID_HANDLE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BlockHeaderStore::growHashTable()
+{
+   hashSlots_.assign(hashSlots_.size() * 2, INVALID_HANDLE);
+   auto mask = hashSlots_.size() - 1;
+
+   for (Handle handle = 0; handle < headers_.size(); handle++)
+   {
+      auto slot = getSlot(getHashPtr(handle));
+      while (hashSlots_[slot] != INVALID_HANDLE)
+         slot = (slot + 1) & mask;
+      hashSlots_[slot] = handle;
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockHeaderStore::Handle BlockHeaderStore::find(
+   const BinaryDataRef& hash) const
+{
+   if (hash.getSize() != 32)
+      return INVALID_HANDLE;
+
+   auto mask = hashSlots_.size() - 1;
+   auto slot = getSlot(hash.getPtr());
+   while (hashSlots_[slot] != INVALID_HANDLE)
+   {
+      auto handle = hashSlots_[slot];
+      if (memcmp(getHashPtr(handle), hash.getPtr(), 32) == 0)
+         return handle;
+
+      slot = (slot + 1) & mask;
+   }
+
+   return INVALID_HANDLE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockHeaderStore::Handle BlockHeaderStore::put(
+   const BinaryDataRef& hash, shared_ptr<BlockHeader> header)
+{
+   if (hash.getSize() != 32)
+      throw runtime_error("invalid block hash length");
+
+   auto handle = find(hash);
+   if (handle != INVALID_HANDLE)
+   {
+      headers_[handle] = header;
+      return handle;
+   }
+
+   //keep the table at most half full
+   if ((headers_.size() + 1) * 2 > hashSlots_.size())
+      growHashTable();
+
+   handle = headers_.size();
+   headers_.push_back(header);
+   hashes_.insert(hashes_.end(), hash.getPtr(), hash.getPtr() + 32);
+
+   auto mask = hashSlots_.size() - 1;
+   auto slot = getSlot(hash.getPtr());
+   while (hashSlots_[slot] != INVALID_HANDLE)
+      slot = (slot + 1) & mask;
+   hashSlots_[slot] = handle;
+
+   return handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool BlockHeaderStore::setIdHandle(uint32_t id, Handle handle, bool overwrite)
+{
+   //headers without an id aren't indexed
+   if (id == UINT32_MAX)
+      return true;
+
+   if (id >= handlesById_.size())
+      handlesById_.resize(id + 1, INVALID_HANDLE);
+
+   if (handlesById_[id] != INVALID_HANDLE && !overwrite)
+      return false;
+
+   handlesById_[id] = handle;
+   return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -34,34 +136,90 @@ Blockchain::Blockchain(const HashString &genesisHash)
 
 void Blockchain::clear()
 {
+   unique_lock<mutex> lock(mu_);
+
    newlyParsedBlocks_.clear();
-   headersByHeight_.resize(0);
-   headersById_.clear();
-   headerMap_.clear();
-   headerMap_[genesisHash_] = make_shared<BlockHeader>();
-   topBlockPtr_ = headerMap_[genesisHash_];
-   topBlockId_ = 0;
+   headersByHeight_.clear();
+   headerStore_ = make_shared<BlockHeaderStore>();
+   topHandle_ = headerStore_->put(
+      genesisHash_.getRef(), make_shared<BlockHeader>());
 
    topID_.store(0, memory_order_relaxed);
+   publishView();
 }
 
-void Blockchain::addBlock(
+////////////////////////////////////////////////////////////////////////////////
+BlockHeaderStore& Blockchain::getStoreForWrite()
+{
+   //copy on write, a published view or an allHeaders() snapshot may still 
+   //be reading the current store
+   if (headerStore_.use_count() > 1)
+      headerStore_ = make_shared<BlockHeaderStore>(*headerStore_);
+
+   return *headerStore_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockHeader* Blockchain::getHeaderForWrite(BlockHeaderStore::Handle handle)
+{
+   //copy on write, a view, a reader or the caller that added the header
+   //may still hold it. Only the live store can hand out new references and
+   //it is only accessed under mu_, so a use count of 1 can't go up under us
+   auto& store = getStoreForWrite();
+   if (store.at(handle).use_count() > 1)
+      store.replace(handle, make_shared<BlockHeader>(*store.at(handle)));
+
+   return store.at(handle).get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void Blockchain::publishView()
+{
+   auto view = make_shared<ChainView>();
+   view->store_ = headerStore_;
+   view->headersByHeight_ = headersByHeight_;
+   view->top_ = headerStore_->at(topHandle_);
+
+   atomic_store(&view_, shared_ptr<const ChainView>(view));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+shared_ptr<const BlockHeaderStore> Blockchain::allHeaders() const
+{
+   unique_lock<mutex> lock(mu_);
+   return headerStore_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BlockHeaderStore::Handle Blockchain::addBlockNoLock(
       const HashString &blockhash,
       const shared_ptr<BlockHeader> header,
       bool suppressVerbose
    )
 {
-   if (hasHeaderWithHash(blockhash) && blockhash != genesisHash_ &&
-      !suppressVerbose)
+   auto& store = getStoreForWrite();
+   if (store.find(blockhash.getRef()) != BlockHeaderStore::INVALID_HANDLE && 
+      blockhash != genesisHash_ && !suppressVerbose)
    { // we don't show this error for the genesis block
       LOGWARN << "Somehow tried to add header that's already in map";
       LOGWARN << "    Header Hash: " << blockhash.copySwapEndian().toHexStr();
    }
    
-   headerMap_[blockhash] = header;
-   auto insertIter = headersById_.insert(make_pair(header->getThisID(), header));
-   if (insertIter.second == false)
+   auto handle = store.put(blockhash.getRef(), header);
+   if (!store.setIdHandle(header->getThisID(), handle, false))
       LOGWARN << "block id duplicate: " << header->getThisID();
+
+   return handle;
+}
+
+void Blockchain::addBlock(
+      const HashString &blockhash,
+      const shared_ptr<BlockHeader> header,
+      bool suppressVerbose
+   )
+{
+   unique_lock<mutex> lock(mu_);
+   addBlockNoLock(blockhash, header, suppressVerbose);
 }
 
 void Blockchain::addBlock(
@@ -69,7 +227,8 @@ void Blockchain::addBlock(
    const shared_ptr<BlockHeader> header,
    uint32_t height, uint8_t dupId)
 {
-   addBlock(blockhash, header, false);
+   unique_lock<mutex> lock(mu_);
+   addBlockNoLock(blockhash, header, false);
    header->blockHeight_ = height;
    header->duplicateID_ = dupId;
 
@@ -83,40 +242,58 @@ void Blockchain::addNewBlock(
    const shared_ptr<BlockHeader> header,
    bool suppressVerbose)
 {
-   addBlock(blockhash, header, suppressVerbose);
-   newlyParsedBlocks_.push_back(header);
+   unique_lock<mutex> lock(mu_);
+   auto handle = addBlockNoLock(blockhash, header, suppressVerbose);
+   newlyParsedBlocks_.push_back(handle);
 }
 
 Blockchain::ReorganizationState Blockchain::organize(bool verbose)
 {
+   unique_lock<mutex> lock(mu_);
+
+   //resolve the handles after organizing, headers may have been replaced
    ReorganizationState st;
-   st.prevTop_ = top();
-   st.reorgBranchPoint_ = organizeChain(false, verbose);
+   auto prevTopHandle = topHandle_;
+   auto branchPoint = organizeChain(false, verbose);
+   st.prevTop_ = headerStore_->at(prevTopHandle);
+   if (branchPoint != BlockHeaderStore::INVALID_HANDLE)
+      st.reorgBranchPoint_ = headerStore_->at(branchPoint);
    st.prevTopStillValid_ = (st.reorgBranchPoint_ == nullptr);
-   st.hasNewTop_ = (st.prevTop_ != top());
-   st.newTop_ = top();
+   st.hasNewTop_ = (prevTopHandle != topHandle_);
+   st.newTop_ = headerStore_->at(topHandle_);
+
+   publishView();
    return st;
 }
 
 Blockchain::ReorganizationState Blockchain::forceOrganize()
 {
+   unique_lock<mutex> lock(mu_);
+
    ReorganizationState st;
-   st.prevTop_ = top();
-   st.reorgBranchPoint_ = organizeChain(true);
+   auto prevTopHandle = topHandle_;
+   auto branchPoint = organizeChain(true);
+   st.prevTop_ = headerStore_->at(prevTopHandle);
+   if (branchPoint != BlockHeaderStore::INVALID_HANDLE)
+      st.reorgBranchPoint_ = headerStore_->at(branchPoint);
    st.prevTopStillValid_ = (st.reorgBranchPoint_ == nullptr);
-   st.hasNewTop_ = (st.prevTop_ != top());
-   st.newTop_ = top();
+   st.hasNewTop_ = (prevTopHandle != topHandle_);
+   st.newTop_ = headerStore_->at(topHandle_);
+
+   publishView();
    return st;
 }
 
 void Blockchain::setDuplicateIDinRAM(
    LMDBBlockDatabase* iface)
 {
-   for (const auto& block : headerMap_)
+   unique_lock<mutex> lock(mu_);
+
+   for (const auto& block : headerStore_->headers())
    {
-      if (block.second->isMainBranch_)
+      if (block->isMainBranch_)
          iface->setValidDupIDForHeight(
-            block.second->blockHeight_, block.second->duplicateID_);
+            block->blockHeight_, block->duplicateID_);
    }
 }
 
@@ -149,75 +326,102 @@ Blockchain::findReorgPointFromBlock(const BinaryData& blkHash)
 
 shared_ptr<BlockHeader> Blockchain::top() const
 {
-   return topBlockPtr_;
+   return getView()->top_;
 }
 
 shared_ptr<BlockHeader> Blockchain::getGenesisBlock() const
 {
-   auto iter = headerMap_.find(genesisHash_);
-   if (iter == headerMap_.end())
+   auto genesis = getView()->store_->getByHash(genesisHash_.getRef());
+   if (genesis == nullptr)
       throw runtime_error("missing genesis block header");
 
-   return iter->second;
+   return genesis;
 }
 
 shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(unsigned index)
 {
-   if(index>=headersByHeight_.size())
+   auto view = getView();
+   if(index>=view->headersByHeight_.size())
       throw std::range_error("Cannot get block at height " + to_string(index));
 
-   return headersByHeight_[index];
+   return view->store_->at(view->headersByHeight_[index]);
 }
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderByHeight(unsigned index) const
 {
-   auto headerIter = headersByHeight_.cbegin() + index;
-   if (headerIter == headersByHeight_.cend())
+   auto view = getView();
+   if (index >= view->headersByHeight_.size())
       throw std::range_error("Cannot get block at height " + to_string(index));
 
-   return (*headerIter);
+   return view->store_->at(view->headersByHeight_[index]);
 }
 
 
 bool Blockchain::hasHeaderByHeight(unsigned height) const
 {
-   if (height >= headersByHeight_.size())
+   if (height >= getView()->headersByHeight_.size())
       return false;
 
    return true;
 }
 
+shared_ptr<BlockHeader> Blockchain::getHeaderByHashNoView(
+   const BinaryDataRef& blkHash) const
+{
+   unique_lock<mutex> lock(mu_);
+   return headerStore_->getByHash(blkHash);
+}
+
 const shared_ptr<BlockHeader> Blockchain::getHeaderByHash(HashString const & blkHash) const
 {
-   auto it = headerMap_.find(blkHash);
-   if(ITER_NOT_IN_MAP(it, headerMap_))
+   auto header = getView()->store_->getByHash(blkHash.getRef());
+   if (header == nullptr)
+      header = getHeaderByHashNoView(blkHash.getRef());
+
+   if(header == nullptr)
       throw std::range_error("Cannot find block with hash " + blkHash.copySwapEndian().toHexStr());
    else
-      return it->second;
+      return header;
 }
 shared_ptr<BlockHeader> Blockchain::getHeaderByHash(HashString const & blkHash)
 {
-   auto it = headerMap_.find(blkHash);
-   if(ITER_NOT_IN_MAP(it, headerMap_))
+   auto header = getView()->store_->getByHash(blkHash.getRef());
+   if (header == nullptr)
+      header = getHeaderByHashNoView(blkHash.getRef());
+
+   if(header == nullptr)
       throw std::range_error("Cannot find block with hash " + blkHash.copySwapEndian().toHexStr());
    else
-      return it->second;
+      return header;
 }
 shared_ptr<BlockHeader> Blockchain::getHeaderById(uint32_t id) const
 {
-   auto headerIter = headersById_.find(id);
-   if (headerIter == headersById_.end())
+   {
+      auto view = getView();
+      auto handle = view->store_->findById(id);
+      if (handle != BlockHeaderStore::INVALID_HANDLE)
+         return view->store_->at(handle);
+   }
+
+   //not in the view yet, try the live store
+   unique_lock<mutex> lock(mu_);
+   auto handle = headerStore_->findById(id);
+   if (handle == BlockHeaderStore::INVALID_HANDLE)
    {
       LOGERR << "cannot find block for id: " << id;
       throw std::range_error("Cannot find block by id");
    }
 
-   return headerIter->second;
+   return headerStore_->at(handle);
 }
 
 bool Blockchain::hasHeaderWithHash(BinaryData const & txHash) const
 {
-   return KEY_IN_MAP(txHash, headerMap_);
+   if (getView()->store_->find(txHash.getRef()) != 
+      BlockHeaderStore::INVALID_HANDLE)
+      return true;
+
+   return getHeaderByHashNoView(txHash.getRef()) != nullptr;
 }
 
 const shared_ptr<BlockHeader> Blockchain::getHeaderPtrForTxRef(const TxRef &txr) const
@@ -236,12 +440,17 @@ const shared_ptr<BlockHeader> Blockchain::getHeaderPtrForTxRef(const TxRef &txr)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Returns nullptr if the new top block is a direct follower of
+// Returns INVALID_HANDLE if the new top block is a direct follower of
 // the previous top. Returns the branch point if we had to reorg
 // TODO:  Figure out if there is an elegant way to deal with a forked 
 //        blockchain containing two equal-length chains
-shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbose)
+// Headers are modified through getHeaderForWrite, the ones the published
+// view or a reader still holds are replaced by copies.
+BlockHeaderStore::Handle Blockchain::organizeChain(
+   bool forceRebuild, bool verbose)
 {
+   typedef BlockHeaderStore::Handle Handle;
+
    if (verbose)
    {
       TIMER_START("orgChain");
@@ -255,27 +464,28 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
    // means part of blockchain that was previously valid, has become
    // invalid.  Rather than get fancy, just rebuild all which takes less
    // than a second, anyway.
+   auto& store = getStoreForWrite();
    if(forceRebuild)
    {
-      map<HashString, shared_ptr<BlockHeader>>::iterator iter;
-      for( iter  = headerMap_.begin(); 
-           iter != headerMap_.end(); 
-           iter++)
+      for (Handle handle = 0; handle < store.size(); handle++)
       {
-         iter->second->difficultySum_  = -1;
-         iter->second->blockHeight_ = 0;
-         iter->second->isFinishedCalc_ = false;
-         iter->second->nextHash_ = BtcUtils::EmptyHash();
-         iter->second->isMainBranch_ = false;
+         auto header = getHeaderForWrite(handle);
+         header->difficultySum_  = -1;
+         header->blockHeight_ = 0;
+         header->isFinishedCalc_ = false;
+         memset(header->nextHash_, 0, 32);
+         header->isMainBranch_ = false;
       }
-      topBlockPtr_ = NULL;
       topID_.store(0, memory_order_relaxed);
    }
 
    unsigned topID = topID_.load(memory_order_relaxed);
 
    // Set genesis block
-   auto genBlock = getGenesisBlock();
+   auto genHandle = store.find(genesisHash_.getRef());
+   if (genHandle == BlockHeaderStore::INVALID_HANDLE)
+      throw runtime_error("missing genesis block header");
+   auto genBlock = getHeaderForWrite(genHandle);
    genBlock->blockHeight_ = 0;
    genBlock->difficultyDbl_ = 1.0;
    genBlock->difficultySum_ = 1.0;
@@ -285,28 +495,23 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
    genBlock->isInitialized_ = true;
 
    // If this is the first run, the topBlock is the genesis block
-   auto topblock_iter = headersById_.find(topBlockId_);
-   if (topblock_iter != headersById_.end())
-   { 
-      topBlockPtr_ = topblock_iter->second;
-   }
-   else
-   {
-      topBlockPtr_ = genBlock;
-   }
+   if (topHandle_ >= store.size())
+      topHandle_ = genHandle;
 
-   const auto prevTopBlock = top();
+   const auto prevTopHandle = topHandle_;
    
+   // *** Walk down the chain following prevHash fields, until
+   //     you find a "solved" block.  Then walk back up and 
+   //     fill in the difficulty-sum values (do not set next-
+   //     hash ptrs, as we don't know if this is the main branch)
+   traceChainsDown();
+
    // Iterate over all blocks, track the maximum difficulty-sum block
-   double   maxDiffSum     = prevTopBlock->getDifficultySum();
-   for( auto &header : values(headerMap_))
+   double   maxDiffSum     = store.at(prevTopHandle)->getDifficultySum();
+   for (Handle handle = 0; handle < store.size(); handle++)
    {
-      // *** Walk down the chain following prevHash fields, until
-      //     you find a "solved" block.  Then walk back up and 
-      //     fill in the difficulty-sum values (do not set next-
-      //     hash ptrs, as we don't know if this is the main branch)
-      //     Method returns instantly if block is already "solved"
-      double thisDiffSum = traceChainDown(header);
+      auto& header = store.at(handle);
+      double thisDiffSum = header->difficultySum_;
 
       if (header->isOrphan_)
       {
@@ -317,39 +522,40 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
       else if(thisDiffSum > maxDiffSum)
       {
          maxDiffSum     = thisDiffSum;
-         topBlockPtr_   = header;
-         topBlockId_    = header->getThisID();
+         topHandle_     = handle;
       }
    }
 
    
    // Walk down the list one more time, set nextHash fields
    // Also set headersByHeight_;
-   bool prevChainStillValid = (topBlockPtr_ == prevTopBlock);
-   topBlockPtr_->nextHash_ = BtcUtils::EmptyHash();
-   auto thisHeaderPtr = topBlockPtr_;
-   headersByHeight_.resize(topBlockPtr_->getBlockHeight()+1);
+   bool prevChainStillValid = (topHandle_ == prevTopHandle);
+   auto thisHandle = topHandle_;
+   auto thisHeaderPtr = getHeaderForWrite(thisHandle);
+   memset(thisHeaderPtr->nextHash_, 0, 32);
+   headersByHeight_.resize(thisHeaderPtr->getBlockHeight()+1);
    while( !thisHeaderPtr->isFinishedCalc_ )
    {
       thisHeaderPtr->isFinishedCalc_ = true;
       thisHeaderPtr->isMainBranch_   = true;
       thisHeaderPtr->isOrphan_       = false;
-      headersByHeight_[thisHeaderPtr->getBlockHeight()] = thisHeaderPtr;
+      headersByHeight_[thisHeaderPtr->getBlockHeight()] = thisHandle;
 
       if (thisHeaderPtr->uniqueID_ > topID)
          topID = thisHeaderPtr->uniqueID_;
 
-      HashString & childHash    = thisHeaderPtr->thisHash_;
-      thisHeaderPtr             = headerMap_[thisHeaderPtr->getPrevHash()];
-      thisHeaderPtr->nextHash_  = childHash;
+      auto childPtr             = thisHeaderPtr;
+      thisHandle                = store.find(thisHeaderPtr->getPrevHashRef());
+      thisHeaderPtr             = getHeaderForWrite(thisHandle);
+      memcpy(thisHeaderPtr->nextHash_, childPtr->thisHash_, 32);
 
-      if(thisHeaderPtr == prevTopBlock)
+      if(thisHandle == prevTopHandle)
          prevChainStillValid = true;
 
    }
    // Last header in the loop didn't get added (the genesis block on first run)
    thisHeaderPtr->isMainBranch_ = true;
-   headersByHeight_[thisHeaderPtr->getBlockHeight()] = thisHeaderPtr;
+   headersByHeight_[thisHeaderPtr->getBlockHeight()] = thisHandle;
 
    topID_.store(topID + 1, memory_order_relaxed);
 
@@ -360,7 +566,7 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
       LOGWARN << "Reorg detected!";
 
       organizeChain(true); // force-rebuild blockchain (takes less than 1s)
-      return thisHeaderPtr;
+      return thisHandle;
    }
 
    if (verbose)
@@ -370,67 +576,84 @@ shared_ptr<BlockHeader> Blockchain::organizeChain(bool forceRebuild, bool verbos
       LOGINFO << "Organized chain in " << duration << "s";
    }
 
-   return 0;
+   return BlockHeaderStore::INVALID_HANDLE;
 }
 
 
 /////////////////////////////////////////////////////////////////////////////
-// Start from a node, trace down to the highest solved block, accumulate
-// difficulties and difficultySum values.  Return the difficultySum of 
-// this block.
-double Blockchain::traceChainDown(shared_ptr<BlockHeader> bhpStart)
-{
-   if(bhpStart->difficultySum_ > 0)
-      return bhpStart->difficultySum_;
-
-   // Prepare some data structures for walking down the chain
-   vector<shared_ptr<BlockHeader>>   headerPtrStack(headerMap_.size());
-   vector<double>         difficultyStack(headerMap_.size());
-   uint32_t blkIdx = 0;
-
-   // Walk down the chain of prevHash_ values, until we find a block
-   // that has a definitive difficultySum value (i.e. >0). 
-   auto thisPtr = bhpStart;
-   while( thisPtr->difficultySum_ < 0)
+// For all unsolved headers, trace down to the highest solved block, then 
+// accumulate difficulties, difficultySum values and heights on the way back.
+void Blockchain::traceChainsDown()
+{
+   typedef BlockHeaderStore::Handle Handle;
+   auto& store = getStoreForWrite();
+
+   //orphaned handles, so that their chains are only walked once
+   vector<uint8_t> orphans(store.size(), 0);
+   vector<Handle> handleStack;
+
+   for (Handle i = 0; i < store.size(); i++)
    {
-      double thisDiff         = thisPtr->difficultyDbl_;
-      difficultyStack[blkIdx] = thisDiff;
-      headerPtrStack[blkIdx]  = thisPtr;
-      blkIdx++;
+      auto& header = store.at(i);
+      if (header->difficultySum_ > 0 || !header->isInitialized_ || orphans[i])
+         continue;
+
+      // Walk down the chain of prevHash_ values, until we find a block
+      // that has a definitive difficultySum value (i.e. >0). 
+      handleStack.clear();
+      BlockHeader* seedPtr = nullptr;
+      auto thisHandle = i;
 
-      auto iter = headerMap_.find(thisPtr->getPrevHash());
-      if(ITER_IN_MAP(iter, headerMap_))
+      while (1)
       {
-         thisPtr = iter->second;
+         handleStack.push_back(thisHandle);
+         auto parentHandle = store.find(
+            store.at(thisHandle)->getPrevHashRef());
+         if (parentHandle == BlockHeaderStore::INVALID_HANDLE)
+            break;
+
+         auto parentPtr = store.at(parentHandle).get();
+         if (parentPtr->difficultySum_ > 0)
+         {
+            seedPtr = parentPtr;
+            break;
+         }
+
+         if (!parentPtr->isInitialized_ || orphans[parentHandle])
+            break;
+
+         thisHandle = parentHandle;
       }
-      else
+
+      if (seedPtr == nullptr)
       {
-         thisPtr->isOrphan_ = true;
-         // this block is an orphan, possibly caused by a HeadersFirst
-         // blockchain. Nothing to do about that
-         return numeric_limits<double>::max();
+         // this chain is an orphan, possibly caused by a HeadersFirst
+         // blockchain. Nothing to do about that. Orphans are walked on 
+         // every run, only copy the ones that aren't flagged yet
+         for (auto& handle : handleStack)
+         {
+            orphans[handle] = 1;
+            if (!store.at(handle)->isOrphan_)
+               getHeaderForWrite(handle)->isOrphan_ = true;
+         }
+
+         continue;
       }
-   }
-
 
-   // Now we have a stack of difficulties and pointers.  Walk back up
-   // (by pointer) and accumulate the difficulty values 
-   double   seedDiffSum = thisPtr->difficultySum_;
-   uint32_t blkHeight   = thisPtr->blockHeight_;
-   for(int32_t i=blkIdx-1; i>=0; i--)
-   {
-      seedDiffSum += difficultyStack[i];
-      blkHeight++;
-      thisPtr                 = headerPtrStack[i];
-      thisPtr->difficultyDbl_ = difficultyStack[i];
-      thisPtr->difficultySum_ = seedDiffSum;
-      thisPtr->blockHeight_   = blkHeight;
-      thisPtr->isOrphan_ = false;
+      // Now we have a stack of handles. Walk back up and accumulate the 
+      // difficulty values 
+      double   seedDiffSum = seedPtr->difficultySum_;
+      uint32_t blkHeight   = seedPtr->blockHeight_;
+      for (auto rIter = handleStack.rbegin(); rIter != handleStack.rend(); ++rIter)
+      {
+         auto thisPtr = getHeaderForWrite(*rIter);
+         seedDiffSum += thisPtr->difficultyDbl_;
+         blkHeight++;
+         thisPtr->difficultySum_ = seedDiffSum;
+         thisPtr->blockHeight_   = blkHeight;
+         thisPtr->isOrphan_ = false;
+      }
    }
-   
-   // Finally, we have all the difficulty sums calculated, return this one
-   return bhpStart->difficultySum_;
-  
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -446,64 +669,77 @@ void Blockchain::putBareHeaders(LMDBBlockDatabase *db, bool updateDupID)
    consider the next dup to be the first unknown block in DB until a new
    block file is created by Core.
    ***/
-   for (auto& block : headerMap_)
+   unique_lock<mutex> lock(mu_);
+   auto& store = getStoreForWrite();
+
+   for (BlockHeaderStore::Handle handle = 0; handle < store.size(); handle++)
    {
       StoredHeader sbh;
-      sbh.createFromBlockHeader(*(block.second));
+      sbh.createFromBlockHeader(*store.at(handle));
       uint8_t dup = db->putBareHeader(sbh, updateDupID);
-      block.second->setDuplicateID(dup);  // make sure headerMap_ and DB agree
+
+      // make sure headerStore_ and DB agree
+      if (store.at(handle)->getDuplicateID() != dup)
+         getHeaderForWrite(handle)->setDuplicateID(dup);
    }
+
+   publishView();
 }
 
 /////////////////////////////////////////////////////////////////////////////
-void Blockchain::putNewBareHeaders(LMDBBlockDatabase *db)
+vector<shared_ptr<BlockHeader>> Blockchain::putNewBareHeaders(
+   LMDBBlockDatabase *db)
 {
    unique_lock<mutex> lock(mu_);
 
+   //returns the headers that were committed
+   vector<shared_ptr<BlockHeader>> putHeaders;
    if (newlyParsedBlocks_.size() == 0)
-      return;
+      return putHeaders;
 
    //create transaction here to batch the write
    LMDBEnv::Transaction tx;
    db->beginDBTransaction(&tx, HEADERS, LMDB::ReadWrite);
 
-   vector<shared_ptr<BlockHeader>> unputHeaders;
-   for (auto& block : newlyParsedBlocks_)
+   auto& store = getStoreForWrite();
+   vector<BlockHeaderStore::Handle> unputHeaders;
+   for (auto& handle : newlyParsedBlocks_)
    {
-      if (block->blockHeight_ != UINT32_MAX)
+      if (store.at(handle)->blockHeight_ != UINT32_MAX)
       {
          StoredHeader sbh;
-         sbh.createFromBlockHeader(*block);
+         sbh.createFromBlockHeader(*store.at(handle));
          //don't update SDBI, we'll do it here once instead
          uint8_t dup = db->putBareHeader(sbh, true, false);
-         block->setDuplicateID(dup);  // make sure headerMap_ and DB agree
+
+         // make sure headerStore_ and DB agree
+         if (store.at(handle)->getDuplicateID() != dup)
+            getHeaderForWrite(handle)->setDuplicateID(dup);
+         putHeaders.push_back(store.at(handle));
       }
       else
       {
-         unputHeaders.push_back(block);
+         unputHeaders.push_back(handle);
       }
    }
 
+   //once commited to the DB, they aren't considered new anymore, 
+   //so clean up the container
+   newlyParsedBlocks_ = unputHeaders;
+   publishView();
+
    //update SDBI, keep within the batch transaction
    auto&& sdbiH = db->getStoredDBInfo(HEADERS, 0);
 
-   if (topBlockPtr_ == nullptr)
+   auto& topBlock = store.at(topHandle_);
+   if (topBlock->blockHeight_ >= sdbiH.topBlkHgt_)
    {
-      LOGINFO << "No known top block, didn't update SDBI";
-      return;
-   }
-
-   if (topBlockPtr_->blockHeight_ >= sdbiH.topBlkHgt_)
-   {
-      sdbiH.topBlkHgt_ = topBlockPtr_->blockHeight_;
-      sdbiH.topScannedBlkHash_ = topBlockPtr_->thisHash_;
+      sdbiH.topBlkHgt_ = topBlock->blockHeight_;
+      sdbiH.topScannedBlkHash_ = topBlock->getThisHash();
       db->putStoredDBInfo(HEADERS, sdbiH, 0);
    }
 
-
-   //once commited to the DB, they aren't considered new anymore, 
-   //so clean up the container
-   newlyParsedBlocks_ = unputHeaders;
+   return putHeaders;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -512,20 +748,21 @@ set<uint32_t> Blockchain::addBlocksInBulk(
 {
    set<uint32_t> returnSet;
    unique_lock<mutex> lock(mu_);
+   auto& store = getStoreForWrite();
 
    for (auto& header_pair : bhMap)
    {
-      auto iter = headerMap_.insert(header_pair);
-      if (!iter.second)
-      {
-         if (iter.first->second->dataCopy_.getSize() == HEADER_SIZE)
-            continue;
-
-         iter.first->second = header_pair.second;
-      }
-
-      headersById_[header_pair.second->getThisID()] = header_pair.second;
-      newlyParsedBlocks_.push_back(header_pair.second);
+      //only the genesis placeholder is stored under a hash that isn't its own
+      auto existing = store.getByHash(header_pair.first.getRef());
+      if (existing != nullptr && 
+          existing->getThisHashRef() == header_pair.first.getRef())
+         continue;
+
+      auto handle = store.put(
+         header_pair.first.getRef(), header_pair.second);
+      store.setIdHandle(
+         header_pair.second->getThisID(), handle, true);
+      newlyParsedBlocks_.push_back(handle);
       returnSet.insert(header_pair.second->getThisID());
    }
 
@@ -537,14 +774,15 @@ void Blockchain::forceAddBlocksInBulk(
    const map<HashString, shared_ptr<BlockHeader>>& bhMap)
 {
    unique_lock<mutex> lock(mu_);
+   auto& store = getStoreForWrite();
 
    for (auto& headerPair : bhMap)
    {
-      auto header = headerMap_[headerPair.first];
-      header = headerPair.second;
+      auto& header = headerPair.second;
+      auto handle = store.put(headerPair.first.getRef(), header);
 
-      headersById_[header->getThisID()] = header;
-      newlyParsedBlocks_.push_back(header);
+      store.setIdHandle(header->getThisID(), handle, true);
+      newlyParsedBlocks_.push_back(handle);
    }
 }
 
@@ -555,10 +793,13 @@ map<unsigned, set<unsigned>> Blockchain::mapIDsPerBlockFile(void) const
 
    map<unsigned, set<unsigned>> resultMap;
 
-   for (auto& header : headersById_)
+   for (auto& header : headerStore_->headers())
    {
-      auto& result_set = resultMap[header.second->blkFileNum_];
-      result_set.insert(header.second->uniqueID_);
+      if (header->uniqueID_ == UINT32_MAX)
+         continue;
+
+      auto& result_set = resultMap[header->blkFileNum_];
+      result_set.insert(header->uniqueID_);
    }
 
    return resultMap;
@@ -567,14 +808,18 @@ map<unsigned, set<unsigned>> Blockchain::mapIDsPerBlockFile(void) const
 /////////////////////////////////////////////////////////////////////////////
 map<unsigned, HeightAndDup> Blockchain::getHeightAndDupMap(void) const
 {
+   unique_lock<mutex> lock(mu_);
    map<unsigned, HeightAndDup> hd_map;
 
-   for (auto& block_pair : headersById_)
+   for (auto& header : headerStore_->headers())
    {
+      if (header->uniqueID_ == UINT32_MAX)
+         continue;
+
       hd_map.insert(make_pair(
-         block_pair.first,
-         HeightAndDup(block_pair.second->getBlockHeight(),
-                      block_pair.second->getDuplicateID())));
+         header->uniqueID_,
+         HeightAndDup(header->getBlockHeight(),
+                      header->getDuplicateID())));
    }
 
    return hd_map;
@@ -32,13 +32,120 @@ struct HeightAndDup
    {}
 };
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Struct of arrays store for the chain's headers. Each header gets a dense
+// handle on insertion, hash and id lookups resolve to flat array lookups on
+// those handles. The hash column is probed through an open addressing table
+// so a lookup never touches the header objects. The shared_ptr column is the
+// adapter for callers that deal in BlockHeader objects.
+//
+class BlockHeaderStore
+{
+public:
+   typedef uint32_t Handle;
+   static const Handle INVALID_HANDLE = UINT32_MAX;
+
+private:
+   //columns, indexed by handle
+   vector<shared_ptr<BlockHeader>> headers_;
+   vector<uint8_t> hashes_;
+
+   //hash table over the hash column, keyed by the leading 8 bytes
+   vector<Handle> hashSlots_;
+
+   //unique id to handle
+   vector<Handle> handlesById_;
+
+private:
+   const uint8_t* getHashPtr(Handle handle) const
+   {
+      return &hashes_[handle * 32];
+   }
+
+   size_t getSlot(const uint8_t* hash) const
+   {
+      uint64_t key;
+      memcpy(&key, hash, 8);
+      return (size_t)key & (hashSlots_.size() - 1);
+   }
+
+   void growHashTable(void);
+
+public:
+   BlockHeaderStore(void) { clear(); }
+
+   void clear(void);
+   size_t size(void) const { return headers_.size(); }
+
+   //inserts the header under hash, or replaces the header already
+   //stored under that hash. Returns the handle
+   Handle put(const BinaryDataRef& hash, shared_ptr<BlockHeader>);
+   
+   //returns false if the id is already indexed and overwrite is false
+   bool setIdHandle(uint32_t id, Handle, bool overwrite);
+
+   Handle find(const BinaryDataRef& hash) const;
+   Handle findById(uint32_t id) const
+   {
+      if (id >= handlesById_.size())
+         return INVALID_HANDLE;
+      return handlesById_[id];
+   }
+
+   const shared_ptr<BlockHeader>& at(Handle handle) const
+   {
+      return headers_[handle];
+   }
+
+   //swaps the header object under handle, the hash and id stay the same
+   void replace(Handle handle, shared_ptr<BlockHeader> header)
+   {
+      headers_[handle] = move(header);
+   }
+
+   //nullptr if the hash is missing
+   shared_ptr<BlockHeader> getByHash(const BinaryDataRef& hash) const
+   {
+      auto handle = find(hash);
+      if (handle == INVALID_HANDLE)
+         return nullptr;
+      return headers_[handle];
+   }
+
+   const vector<shared_ptr<BlockHeader>>& headers(void) const 
+   { 
+      return headers_; 
+   }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Manages the blockchain, keeping track of all the block headers
 // and our longest cord
 //
+// Writes go through mu_. Header queries read a view of the chain that is
+// published after each organize(), the view is swapped atomically so 
+// readers never take mu_ for headers the view knows about.
+// Both the store and the headers in it are copy on write: the writer
+// clones the store before mutating it if a view (or an allHeaders() caller)
+// still references it, and clones a header before changing its chain state
+// (height, branch, next hash, difficulty sum, dupID) if anything besides 
+// the live store holds it. A header a reader got from the chain is never
+// modified under it, it keeps the state of the view it came from. Headers
+// are replaced across organize() calls, compare them by hash rather than
+// by pointer.
+//
 class Blockchain
 {
+public:
+   struct ChainView
+   {
+      shared_ptr<const BlockHeaderStore> store_;
+      vector<BlockHeaderStore::Handle> headersByHeight_;
+      shared_ptr<BlockHeader> top_;
+   };
+
 public:
    Blockchain(const HashString &genesisHash);
    void clear();
@@ -93,17 +200,15 @@ public:
       return getHeaderPtrForTxRef(txObj.getTxRef());
    }
    
-   map<HashString, shared_ptr<BlockHeader>>& allHeaders()
-   {
-      return headerMap_;
-   }
-   const map<HashString, shared_ptr<BlockHeader>>& allHeaders() const
+   //snapshot of all headers, including the ones not organized yet
+   shared_ptr<const BlockHeaderStore> allHeaders() const;
+   shared_ptr<const ChainView> getView(void) const
    {
-      return headerMap_;
+      return atomic_load(&view_);
    }
 
    void putBareHeaders(LMDBBlockDatabase *db, bool updateDupID=true);
-   void putNewBareHeaders(LMDBBlockDatabase *db);
+   vector<shared_ptr<BlockHeader>> putNewBareHeaders(LMDBBlockDatabase *db);
    const set<shared_ptr<BlockHeader>>& getBlockHeightsForFileNum(uint32_t) const;
 
    unsigned int getNewUniqueID(void) { return topID_.fetch_add(1, memory_order_relaxed); }
@@ -112,29 +217,38 @@ public:
    map<unsigned, HeightAndDup> getHeightAndDupMap(void) const;
 
 private:
-   shared_ptr<BlockHeader> organizeChain(bool forceRebuild = false, bool verbose = false);
+   //these have to be called under mu_
+   BlockHeaderStore::Handle addBlockNoLock(const HashString &blockhash,
+      shared_ptr<BlockHeader>, bool suppressVerbose);
+   BlockHeaderStore& getStoreForWrite(void);
+   BlockHeader* getHeaderForWrite(BlockHeaderStore::Handle);
+   void publishView(void);
+   //lookup in the live store, for headers the view doesn't have yet
+   shared_ptr<BlockHeader> getHeaderByHashNoView(const BinaryDataRef&) const;
+
+   //returns the branch point handle on a reorg, INVALID_HANDLE otherwise
+   BlockHeaderStore::Handle organizeChain(
+      bool forceRebuild = false, bool verbose = false);
    /////////////////////////////////////////////////////////////////////////////
    // Update/organize the headers map (figure out longest chain, mark orphans)
-   // Start from a node, trace down to the highest solved block, accumulate
-   // difficulties and difficultySum values.  Return the difficultySum of 
-   // this block.
-   double traceChainDown(shared_ptr<BlockHeader> bhpStart);
+   // For every header without a difficultySum, trace down to the highest 
+   // solved block, then accumulate difficulties and heights on the way back
+   // up. Parents are resolved through the header store handles.
+   void traceChainsDown(void);
 
 private:
-   //TODO: make this whole class thread safe
-
    const HashString genesisHash_;
-   map<HashString, shared_ptr<BlockHeader>> headerMap_;
-   vector<shared_ptr<BlockHeader>> newlyParsedBlocks_;
-   deque<shared_ptr<BlockHeader>> headersByHeight_;
-   map<uint32_t, shared_ptr<BlockHeader>> headersById_;
-   shared_ptr<BlockHeader> topBlockPtr_;
-   unsigned topBlockId_ = 0;
+   shared_ptr<BlockHeaderStore> headerStore_;
+   vector<BlockHeaderStore::Handle> newlyParsedBlocks_;
+   vector<BlockHeaderStore::Handle> headersByHeight_;
+   BlockHeaderStore::Handle topHandle_ = 0;
    Blockchain(const Blockchain&); // not defined
 
    atomic<unsigned int> topID_;
 
    mutable mutex mu_;
+   //published chain view, only accessed through atomic_load/atomic_store
+   shared_ptr<const ChainView> view_;
 };
 
 #endif
@@ -515,11 +515,11 @@ void BlockchainScanner::processOutputsThread(ParserBatch* batch)
             auto&& scrRef = BtcUtils::getTxOutScrAddrNoCopy(
                brr.get_BinaryDataRef(scriptSize));
 
-            auto saIter = batch->scriptRefMap_->find(scrRef);
-            if (saIter == batch->scriptRefMap_->end())
+            auto scanFromPtr = batch->scriptRefMap_->find(scrRef);
+            if (scanFromPtr == nullptr)
                continue;
 
-            if (saIter->second >= (int)blockdata->header()->getBlockHeight())
+            if (*scanFromPtr >= (int)blockdata->header()->getBlockHeight())
                continue;
 
             //if we got this far, this txout is ours
@@ -1307,7 +1307,9 @@ void BlockchainScanner::undo(Blockchain::ReorganizationState& reorgState)
 
    auto scrAddrMap = scrAddrFilter_->getScrAddrMap();
 
-   while (blockPtr != reorgState.reorgBranchPoint_)
+   //headers are replaced as the chain is organized, compare hashes
+   auto branchPointHash = reorgState.reorgBranchPoint_->getThisHash();
+   while (blockPtr->getThisHashRef() != branchPointHash.getRef())
    {
       int currentHeight = blockPtr->getBlockHeight();
       auto currentDupId  = blockPtr->getDuplicateID();
@@ -1530,9 +1532,50 @@ void BlockchainScanner::undo(Blockchain::ReorganizationState& reorgState)
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+set<uint32_t> BlockchainScanner::getTxHashIndexHits(
+   const set<BinaryData>& hashSet,
+   map<uint32_t, set<TxFilterResults>>& resultMap)
+{
+   //returns the blk files fully covered by the index, these do not
+   //need their filter pool scanned
+   set<uint32_t> indexedFiles;
+   if (!db_->hasTxHashIndex())
+      return indexedFiles;
+
+   for (unsigned i = 0; i < totalBlockFileCount_; i++)
+   {
+      if (db_->isTxHashIndexed(i))
+         indexedFiles.insert(i);
+   }
+
+   if (indexedFiles.size() == 0)
+      return indexedFiles;
+
+   for (auto& hash : hashSet)
+   {
+      auto&& fileHits = db_->getTxHashIndexHits(hash);
+      for (auto& filePair : fileHits)
+      {
+         if (indexedFiles.find(filePair.first) == indexedFiles.end())
+            continue;
+
+         TxFilterResults filterResult;
+         filterResult.hash_ = hash;
+         filterResult.filterHits_ = move(filePair.second);
+
+         resultMap[filePair.first].insert(move(filterResult));
+      }
+   }
+
+   LOGINFO << indexedFiles.size() << " blk files resolved through txhash index";
+   return indexedFiles;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void BlockchainScanner::getFilterHitsThread(
    const set<BinaryData>& hashSet,
+   const set<uint32_t>& indexedFiles,
    atomic<int>& counter,
    map<uint32_t, set<TxFilterResults>>& resultMap)
 {
@@ -1549,6 +1592,9 @@ void BlockchainScanner::getFilterHitsThread(
          if (fileNum < 0)
             break;
 
+         if (indexedFiles.find(fileNum) != indexedFiles.end())
+            continue;
+
          try
          {
             auto&& pool = db_->getFilterPoolRefForFileNum<TxFilterType>(fileNum);
@@ -1795,9 +1841,11 @@ bool BlockchainScanner::resolveTxHashes()
    vector<thread> filterThreads;
    map<uint32_t, set<TxFilterResults>> resultMap;
 
+   auto&& indexedFiles = getTxHashIndexHits(missingHashes, resultMap);
+
    auto filterThr = [&](void)->void
    {
-      getFilterHitsThread(missingHashes, counter, resultMap);
+      getFilterHitsThread(missingHashes, indexedFiles, counter, resultMap);
    };
 
    for (unsigned i = 1; i < totalThreadCount_; i++)
@@ -54,14 +54,14 @@ public:
    map<BinaryData, map<BinaryData, StoredSubHistory>> sshMap_;
    vector<StoredTxOut> spentOutputs_;
 
-   const shared_ptr<map<TxOutScriptRef, int>> scriptRefMap_;
+   const shared_ptr<TxOutScriptRefMap> scriptRefMap_;
    promise<bool> completedPromise_;
    unsigned count_;
 
 public:
    ParserBatch(unsigned start, unsigned end, 
       unsigned startID, unsigned endID,
-      shared_ptr<map<TxOutScriptRef, int>> scriptRefMap) :
+      shared_ptr<TxOutScriptRefMap> scriptRefMap) :
       start_(start), end_(end), 
       startBlockFileID_(startID), targetBlockFileID_(endID),
       scriptRefMap_(scriptRefMap)
@@ -128,9 +128,14 @@ private:
 
    void getFilterHitsThread(
       const set<BinaryData>& hashSet,
+      const set<uint32_t>& indexedFiles,
       atomic<int>& counter,
       map<uint32_t, set<TxFilterResults>>& resultMap);
 
+   set<uint32_t> getTxHashIndexHits(
+      const set<BinaryData>& hashSet,
+      map<uint32_t, set<TxFilterResults>>& resultMap);
+
    void processFilterHitsThread(
       map<uint32_t, map<uint32_t, 
       set<const TxFilterResults*>>>& filtersResultMap,
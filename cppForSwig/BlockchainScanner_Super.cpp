@@ -1268,7 +1268,9 @@ void BlockchainScanner_Super::undo(Blockchain::ReorganizationState& reorgState)
    map<BinaryData, StoredScriptHistory> sshMap;
    set<BinaryData> undoSpentness;
 
-   while (blockPtr != reorgState.reorgBranchPoint_)
+   //headers are replaced as the chain is organized, compare hashes
+   auto branchPointHash = reorgState.reorgBranchPoint_->getThisHash();
+   while (blockPtr->getThisHashRef() != branchPointHash.getRef())
    {
       int currentHeight = blockPtr->getBlockHeight();
       auto currentDupId = blockPtr->getDuplicateID();
@@ -12,6 +12,7 @@
 #include "base64.h"
 #include "EncryptionUtils.h"
 #include "BlockDataManagerConfig.h"
+#include <mutex>
 
 
 const BinaryData BtcUtils::BadAddress_ = BinaryData::CreateFromHex("0000000000000000000000000000000000000000");
@@ -361,4 +362,29 @@ string BtcUtils::base64_decode(const string& in)
    base64e.MessageEnd();
 
    return output;
-}
\ No newline at end of file
+}
+////////////////////////////////////////////////////////////////////////////////
+uint32_t BtcUtils::getCRC32C(const uint8_t* data, size_t len)
+{
+   //reflected Castagnoli polynomial, table is built on first use
+   static uint32_t table[256];
+   static once_flag tableFlag;
+
+   call_once(tableFlag, [](void)->void
+   {
+      for (uint32_t i = 0; i < 256; i++)
+      {
+         uint32_t crc = i;
+         for (unsigned y = 0; y < 8; y++)
+            crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+
+         table[i] = crc;
+      }
+   });
+
+   uint32_t crc = 0xFFFFFFFF;
+   for (size_t i = 0; i < len; i++)
+      crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+   return crc ^ 0xFFFFFFFF;
+}
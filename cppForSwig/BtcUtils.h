@@ -2048,6 +2048,9 @@ public:
    static string base64_encode(const string&);
    static string base64_decode(const string&);
 
+   //Castagnoli crc, used to checksum binary client/server packets
+   static uint32_t getCRC32C(const uint8_t*, size_t);
+
    /////////////////////////////////////////////////////////////////////////////
    static BinaryData getHash256_RunTwice(const BinaryData& data)
    {
@@ -319,6 +319,25 @@ vector<UnspentTxOut> BtcWallet::getSpendableTxOutListForValue(uint64_t val)
    grabbing all UTXOs in the wallet
    ***/
 
+   vector<UnspentTxOut> utxoList;
+   auto pushUtxo = [&utxoList](UnspentTxOut&& utxo)->void
+   {
+      utxoList.push_back(move(utxo));
+   };
+
+   getSpendableTxOutListForValue(val, pushUtxo);
+   return move(utxoList);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void BtcWallet::getSpendableTxOutListForValue(uint64_t val,
+   const function<void(UnspentTxOut&&)>& callback)
+{
+   /***
+   Hands out the TxOuts as they are pulled from DB, for callers streaming 
+   them out. See above for the selection rules.
+   ***/
+
    prepareTxOutHistory(val);
    LMDBBlockDatabase *db = bdvPtr_->getDB();
 
@@ -326,31 +345,36 @@ vector<UnspentTxOut> BtcWallet::getSpendableTxOutListForValue(uint64_t val)
    LMDBEnv::Transaction tx;
    db->beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
 
-   vector<UnspentTxOut> utxoList;
    uint32_t blk = bdvPtr_->getTopBlockHeight();
 
    auto addrMap = scrAddrMap_.get();
 
-   for (const auto& scrAddr : *addrMap)
+   try
    {
-      const auto& utxoMap = scrAddr.second->getPreparedTxOutList();
-
-      for (const auto& txioPair : utxoMap)
+      for (const auto& scrAddr : *addrMap)
       {
-         if (!txioPair.second.isSpendable(db, blk))
-            continue;
+         const auto& utxoMap = scrAddr.second->getPreparedTxOutList();
+
+         for (const auto& txioPair : utxoMap)
+         {
+            if (!txioPair.second.isSpendable(db, blk))
+               continue;
 
-         TxOut txout = txioPair.second.getTxOutCopy(db);
-         UnspentTxOut UTXO = UnspentTxOut(db, txout, blk);
-         utxoList.push_back(UTXO);
+            TxOut txout = txioPair.second.getTxOutCopy(db);
+            callback(UnspentTxOut(db, txout, blk));
+         }
       }
    }
+   catch (...)
+   {
+      resetTxOutHistory();
+      throw;
+   }
 
    //Shipped a list of TxOuts, time to reset the entire TxOut history, since 
    //we dont know if any TxOut will be spent
 
    resetTxOutHistory();
-   return move(utxoList);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -94,6 +94,8 @@ public:
    void prepareTxOutHistory(uint64_t val);
    void prepareFullTxOutHistory(bool ignoreZC);
    vector<UnspentTxOut> getSpendableTxOutListForValue(uint64_t val = UINT64_MAX);
+   void getSpendableTxOutListForValue(uint64_t val,
+      const function<void(UnspentTxOut&&)>&);
    vector<UnspentTxOut> getSpendableTxOutListZC(void);
    vector<UnspentTxOut> getRBFTxOutList(void);
 
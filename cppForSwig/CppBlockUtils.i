@@ -67,6 +67,14 @@
 %typedef unsigned long long size_t;
 
 %ignore readVarInt(BinaryRefReader & brr);
+%ignore SwigClient::RequestChannel;
+%ignore SwigClient::pipelineCommand;
+%ignore SwigClient::BtcWallet::getBalancesAndCountAsync;
+%ignore SwigClient::BtcWallet::getHistoryPageAsync;
+%ignore SwigClient::streamCommand;
+%ignore SwigClient::BtcWallet::getSpendableTxOutListForValue(uint64_t, const function<void(vector<UTXO>&&)>&);
+%ignore SwigClient::BlockDataViewer::getUtxosForAddrVec(const vector<BinaryData>&, const function<void(vector<UTXO>&&)>&);
+%ignore SwigClient::BlockDataViewer::getHistoryForWalletSelection(const vector<string>&, const string&, const function<void(vector<LedgerEntryData>&&)>&);
 
 %allowexception;
 
@@ -79,6 +87,7 @@ namespace std
    %template(vector_LedgerEntryData) std::vector<LedgerEntryData>;
    %template(set_BinaryData) std::set<BinaryData>;
    %template(vector_UTXO) std::vector<UTXO>;
+   %template(vector_WalletState) std::vector<SwigClient::WalletState>;
    %template(vector_AddressBookEntry) std::vector<AddressBookEntry>;
    %template(vector_TxBatchRecipient) std::vector<Recipient>;
    %template(vector_TxBatchSpender) std::vector<Spender>;
@@ -269,6 +269,19 @@ BinaryData DBUtils::getFilterPoolKey(uint32_t filenum)
    return WRITE_UINT32_BE(bucketKey);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+BinaryData DBUtils::getTxHashIndexKey(
+   BinaryDataRef hashPrefix, uint32_t blockKey, uint16_t txIndex)
+{
+   BinaryWriter bw(11);
+   bw.put_uint8_t(DB_PREFIX_TXHINTS);
+   bw.put_BinaryDataRef(hashPrefix.getSliceRef(0, 4));
+   bw.put_uint32_t(blockKey, BE);
+   bw.put_uint16_t(txIndex, BE);
+
+   return bw.getData();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 BinaryData DBUtils::getMissingHashesKey(uint32_t id)
 {
@@ -134,6 +134,8 @@ public:
       bool rewindWhenDone = false);
 
    static BinaryData getFilterPoolKey(uint32_t filenum);
+   static BinaryData getTxHashIndexKey(
+      BinaryDataRef hashPrefix, uint32_t blockKey, uint16_t txIndex);
    static BinaryData getMissingHashesKey(uint32_t id);
 
    static bool fileExists(const string& path, int mode);
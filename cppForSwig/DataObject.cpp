@@ -34,43 +34,25 @@ ErrorType ErrorType::deserialize(BinaryRefReader& brr)
 ///////////////////////////////////////////////////////////////////////////////
 void LedgerEntryVector::serialize(BinaryWriter& bw) const
 {
-   bw.put_uint8_t(LEDGERENTRYVECTOR_CODE);
-   bw.put_var_int(leVec_.size());
+   serializeHeader(bw, leVec_.size());
 
    for (auto& le : leVec_)
    {
-      auto idSize = le.ID_.size();
-      size_t totalsize = idSize + 53;
-      bw.put_var_int(totalsize);
-
-      bw.put_var_int(idSize);
-      bw.put_BinaryData((uint8_t*)le.ID_.c_str(), idSize);
-      
-      bw.put_uint64_t(le.value_);
-      bw.put_uint32_t(le.blockNum_);
-      bw.put_BinaryData(le.txHash_);
-      bw.put_uint32_t(le.index_);
-      bw.put_uint32_t(le.txTime_);
-
-      BitPacker<uint8_t> bp;
-      bp.putBit(le.isCoinbase_);
-      bp.putBit(le.isSentToSelf_);
-      bp.putBit(le.isChangeBack_);
-      bp.putBit(le.optInRBF_);
-      bp.putBit(le.isChainedZC_);
-      bp.putBit(le.isWitness_);
-
-      bw.put_BitPacker(bp);
-
-      bw.put_var_int(le.scrAddrVec_.size());
-      for (auto& scrAddr : le.scrAddrVec_)
-      {
-         bw.put_var_int(scrAddr.getSize());
-         bw.put_BinaryData(scrAddr);
-      }
+      BinaryDataRef idRef((uint8_t*)le.ID_.c_str(), le.ID_.size());
+      serializeEntry(bw, idRef, le.value_, le.blockNum_, le.txHash_,
+         le.index_, le.txTime_, le.isCoinbase_, le.isSentToSelf_,
+         le.isChangeBack_, le.optInRBF_, le.isChainedZC_, le.isWitness_,
+         le.scrAddrVec_);
    }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void LedgerEntryVector::serializeHeader(BinaryWriter& bw, size_t count)
+{
+   bw.put_uint8_t(LEDGERENTRYVECTOR_CODE);
+   bw.put_var_int(count);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 LedgerEntryVector LedgerEntryVector::deserialize(BinaryRefReader& brr)
 {
@@ -139,6 +121,13 @@ void BinaryDataObject::serialize(BinaryWriter& bw) const
    bw.put_BinaryData(bd_);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void BinaryDataObject::serializeHeader(BinaryWriter& bw, size_t size)
+{
+   bw.put_uint8_t(BINARYDATAOBJECT_CODE);
+   bw.put_var_int(size);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 BinaryDataObject BinaryDataObject::deserialize(BinaryRefReader& brr)
 {
@@ -268,6 +257,79 @@ IntType IntType::deserialize(BinaryRefReader& brr)
 //
 // Arguments
 //
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+   struct WriterPool
+   {
+      vector<unique_ptr<BinaryWriter>> writers_;
+      bool alive_ = true;
+
+      ~WriterPool(void) { alive_ = false; }
+   };
+
+   thread_local WriterPool writerPool_;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+static void writeHex(const BinaryDataRef& bdr, string& out)
+{
+   //BinaryDataRef::toHexStr copies the data twice before building its string
+   static const char hexTable[] = "0123456789abcdef";
+
+   auto ptr = bdr.getPtr();
+   auto size = bdr.getSize();
+
+   out.resize(size * 2);
+   for (size_t i = 0; i < size; i++)
+   {
+      out[2 * i] = hexTable[ptr[i] >> 4];
+      out[2 * i + 1] = hexTable[ptr[i] & 0x0F];
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+unique_ptr<BinaryWriter> Arguments::acquireWriter()
+{
+   auto& pool = writerPool_;
+   if (!pool.alive_ || pool.writers_.size() == 0)
+      return unique_ptr<BinaryWriter>(new BinaryWriter(ARGS_WRITER_RESERVE));
+
+   auto writer = move(pool.writers_.back());
+   pool.writers_.pop_back();
+   return writer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Arguments::releaseWriter(unique_ptr<BinaryWriter> writer)
+{
+   if (writer == nullptr)
+      return;
+
+   //don't hang on to the buffers of exceptionally large replies
+   auto& pool = writerPool_;
+   if (!pool.alive_ || pool.writers_.size() >= ARGS_WRITER_POOL_SIZE ||
+      writer->getSize() > ARGS_WRITER_MAX_POOLED)
+      return;
+
+   writer->reset();
+   pool.writers_.push_back(move(writer));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BinaryWriter& Arguments::getWriter()
+{
+   if (writer_ != nullptr)
+      return *writer_;
+
+   writer_ = acquireWriter();
+   for (auto& arg : argData_)
+      arg->serialize(*writer_);
+   argData_.clear();
+
+   return *writer_;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Arguments::init()
 {
@@ -278,7 +340,7 @@ void Arguments::init()
    {
       setRawData();
    }
-   else if (argData_.size() != 0)
+   else if (argData_.size() != 0 || writer_ != nullptr)
    {
       serialize();
    }
@@ -291,25 +353,70 @@ void Arguments::init()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-const string& Arguments::serialize()
+const string& Arguments::serialize(WireEncoding encoding)
 {
-   if (argStr_.size() != 0)
+   if (argStr_.size() != 0 && encoding_ == encoding)
       return argStr_;
 
-   BinaryWriter bw;
-   for (auto& arg : argData_)
-      arg->serialize(bw);
+   //in place objects are already serialized, others go through a
+   //pooled writer
+   auto writer = writer_.get();
+   unique_ptr<BinaryWriter> scratch;
+   if (writer == nullptr)
+   {
+      scratch = acquireWriter();
+      writeRaw(*scratch);
+      writer = scratch.get();
+   }
+
+   if (encoding == WireEncoding_Binary)
+      argStr_ = move(WireFrame::frame(writer->getDataRef()));
+   else
+      writeHex(writer->getDataRef(), argStr_);
 
-   auto& bdser = bw.getData();
-   argStr_ = move(bdser.toHexStr());
+   releaseWriter(move(scratch));
 
+   encoding_ = encoding;
    return argStr_;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+void Arguments::writeRaw(BinaryWriter& bw) const
+{
+   if (writer_ != nullptr)
+   {
+      bw.put_BinaryDataRef(writer_->getDataRef());
+      return;
+   }
+
+   if (argData_.size() == 0)
+   {
+      bw.put_BinaryData(rawBinary_);
+      return;
+   }
+
+   for (auto& arg : argData_)
+      arg->serialize(bw);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Arguments::setRawData()
 {
-   rawBinary_ = READHEX(argStr_);
+   encoding_ = WireFrame::getEncoding(argStr_);
+   if (encoding_ == WireEncoding_Binary)
+      rawBinary_ = WireFrame::unframe(argStr_);
+   else
+      rawBinary_ = READHEX(argStr_);
+
+   rawRefReader_.setNewData(rawBinary_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void Arguments::setRawBinary(const BinaryDataRef& bdr)
+{
+   argStr_.clear();
+   encoding_ = WireEncoding_Binary;
+   rawBinary_ = bdr;
    rawRefReader_.setNewData(rawBinary_);
 }
 
@@ -317,9 +424,46 @@ void Arguments::setRawData()
 //
 // Command
 //
+///////////////////////////////////////////////////////////////////////////////
+static string readVarString(BinaryRefReader& brr)
+{
+   auto len = brr.get_var_int();
+   if (len > brr.getSizeRemaining())
+      throw runtime_error("invalid string length in command");
+
+   auto bdr = brr.get_BinaryDataRef(len);
+   return string((char*)bdr.getPtr(), len);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void Command::deserialize()
 {
+   encoding_ = WireFrame::getEncoding(command_);
+   if (encoding_ == WireEncoding_Binary)
+   {
+      /***
+      method | id count | ids | raw args
+      strings are var_int length prefixed
+      ***/
+
+      auto payload = WireFrame::unframe(command_);
+      BinaryRefReader brr(payload);
+
+      method_ = readVarString(brr);
+      if (method_.size() == 0)
+         throw runtime_error("empty command");
+
+      auto count = brr.get_var_int();
+      if (count > brr.getSizeRemaining())
+         throw runtime_error("invalid id count");
+
+      for (unsigned i = 0; i < count; i++)
+         ids_.push_back(readVarString(brr));
+
+      args_.setRawBinary(brr.get_BinaryDataRef(brr.getSizeRemaining()));
+      return;
+   }
+
    //sanity check
    if (command_.size() < 8)
       throw runtime_error("command is too short");
@@ -374,11 +518,31 @@ void Command::deserialize()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void Command::serialize()
+void Command::serialize(WireEncoding encoding)
 {
    if (method_.size() == 0)
       throw runtime_error("empty command");
 
+   encoding_ = encoding;
+   if (encoding == WireEncoding_Binary)
+   {
+      BinaryWriter bw;
+      bw.put_var_int(method_.size());
+      bw.put_BinaryData((uint8_t*)method_.c_str(), method_.size());
+
+      bw.put_var_int(ids_.size());
+      for (auto& id : ids_)
+      {
+         bw.put_var_int(id.size());
+         bw.put_BinaryData((uint8_t*)id.c_str(), id.size());
+      }
+
+      args_.writeRaw(bw);
+
+      command_ = move(WireFrame::frame(bw.getDataRef()));
+      return;
+   }
+
    stringstream ss;
 
    for (auto id : ids_)
@@ -389,7 +553,7 @@ void Command::serialize()
 
    ss << "&" << method_;
    ss << ".";
-   ss << args_.serialize();
+   ss << args_.serialize(WireEncoding_Hex);
 
    //hash the packet
    auto&& packet = ss.str();
@@ -400,6 +564,105 @@ void Command::serialize()
    command_.append(packet);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+string Command::peekMethod(const string& command)
+{
+   if (WireFrame::getEncoding(command) == WireEncoding_Binary)
+   {
+      if (command.size() <= WIRE_FRAME_HEADER_LEN)
+         return string();
+
+      BinaryRefReader brr(
+         (const uint8_t*)command.c_str() + WIRE_FRAME_HEADER_LEN,
+         command.size() - WIRE_FRAME_HEADER_LEN);
+
+      try
+      {
+         return readVarString(brr);
+      }
+      catch (exception&)
+      {
+         return string();
+      }
+   }
+
+   //hex packets: method name is the last & delimited id, before the args
+   auto dotPos = command.find('.');
+   if (dotPos == string::npos)
+      dotPos = command.size();
+
+   auto methodPos = command.rfind('&', dotPos);
+   if (methodPos == string::npos)
+      return string();
+
+   ++methodPos;
+   return command.substr(methodPos, dotPos - methodPos);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// WireFrame
+//
+///////////////////////////////////////////////////////////////////////////////
+WireEncoding WireFrame::getEncoding(const string& packet)
+{
+   if (packet.size() > 0 && (uint8_t)packet[0] == WIRE_BINARY_MAGIC)
+      return WireEncoding_Binary;
+
+   return WireEncoding_Hex;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+string WireFrame::frame(const BinaryDataRef& payload)
+{
+   auto crc = BtcUtils::getCRC32C(payload.getPtr(), payload.getSize());
+
+   //straight into the packet, payloads can be large
+   string packet;
+   packet.reserve(payload.getSize() + WIRE_FRAME_HEADER_LEN);
+   packet.push_back((char)WIRE_BINARY_MAGIC);
+   packet.append((char*)&crc, 4);
+   packet.append((char*)payload.getPtr(), payload.getSize());
+
+   return packet;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+BinaryDataRef WireFrame::unframe(const string& packet)
+{
+   if (packet.size() < WIRE_FRAME_HEADER_LEN ||
+      (uint8_t)packet[0] != WIRE_BINARY_MAGIC)
+      throw runtime_error("invalid binary packet");
+
+   BinaryDataRef payload(
+      (const uint8_t*)packet.c_str() + WIRE_FRAME_HEADER_LEN,
+      packet.size() - WIRE_FRAME_HEADER_LEN);
+
+   uint32_t crc;
+   memcpy(&crc, packet.c_str() + 1, 4);
+   if (crc != BtcUtils::getCRC32C(payload.getPtr(), payload.getSize()))
+   {
+      LOGERR << "binary packet checksum failure";
+      throw runtime_error("binary packet checksum failure");
+   }
+
+   return payload;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+string WireFrame::streamHeader(uint32_t len)
+{
+   return string((char*)&len, WIRE_STREAM_HEADER_LEN);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t WireFrame::streamLength(const uint8_t* ptr)
+{
+   uint32_t len;
+   memcpy(&len, ptr, WIRE_STREAM_HEADER_LEN);
+   return len;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Callback
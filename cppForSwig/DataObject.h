@@ -23,6 +23,7 @@
 #include "DbHeader.h"
 #include "BDM_seder.h"
 #include "ThreadSafeClasses.h"
+#include "bdmenums.h"
 
 #define ERRTYPE_CODE             1
 #define INTTYPE_CODE             2
@@ -32,6 +33,14 @@
 #define LEDGERENTRYVECTOR_CODE   6
 #define PROGRESSDATA_CODE        7
 
+#define WIRE_BINARY_MAGIC        0xFB
+#define WIRE_FRAME_HEADER_LEN    5
+#define WIRE_STREAM_HEADER_LEN   4
+
+#define ARGS_WRITER_POOL_SIZE    4
+#define ARGS_WRITER_RESERVE      4096
+#define ARGS_WRITER_MAX_POOLED   (16 * 1024 * 1024)
+
 using namespace std;
 
 enum OrderType
@@ -160,15 +169,54 @@ public:
    int64_t getSignedVal(void) const { return *(int64_t*)&val_; }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class WireFrame
+{
+   /***
+   Binary packets are framed as:
+      WIRE_BINARY_MAGIC (1) | crc32c of payload (4, LE) | payload
+
+   The magic byte is outside of the hex charset, which is how binary packets
+   are told apart from legacy hex ones on the same socket.
+
+   Stream replies carry several packets back to back, each prefixed with
+   its length (WIRE_STREAM_HEADER_LEN, LE), so that they can be split 
+   however the transport cuts the data. A 0 length ends the stream.
+   ***/
+
+public:
+   static WireEncoding getEncoding(const string&);
+   static string frame(const BinaryDataRef&);
+
+   //checks the crc, throws on failure
+   static BinaryDataRef unframe(const string&);
+
+   static string streamHeader(uint32_t len);
+   static uint32_t streamLength(const uint8_t*);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class Arguments
 {
+   /***
+   Outgoing objects are either held as DataObjects and serialized on demand,
+   or written in place with getWriter(). Once the writer is in use, pending
+   objects are flushed to it and later push_back calls serialize straight
+   into it, skipping the DataObject wrappers. getArgVector is then empty.
+
+   Writers come from a per thread pool and keep their capacity between
+   replies, so a large reply is serialized once into an already allocated
+   buffer.
+   ***/
+
 private:
    bool initialized_ = false;
+   WireEncoding encoding_ = WireEncoding_Hex;
    string argStr_;
    vector<shared_ptr<DataMeta>> argData_;
    BinaryData rawBinary_;
    BinaryRefReader rawRefReader_;
+   unique_ptr<BinaryWriter> writer_;
 
 private:
    void init(void);
@@ -176,27 +224,47 @@ private:
    void setFromRVal(Arguments&& arg)
    {
       initialized_ = arg.initialized_;
+      encoding_ = arg.encoding_;
       argStr_ = move(arg.argStr_);
       argData_ = move(arg.argData_);
       rawBinary_ = move(arg.rawBinary_);
       rawRefReader_.setNewData(rawBinary_);
       rawRefReader_.advance(arg.rawRefReader_.getPosition());
+
+      releaseWriter(move(writer_));
+      writer_ = move(arg.writer_);
    }
 
    void setFromRef(const Arguments& arg)
    {
       initialized_ = arg.initialized_;
+      encoding_ = arg.encoding_;
       argStr_ = arg.argStr_;
       argData_ = arg.argData_;
       rawBinary_ = arg.rawBinary_;
       rawRefReader_.setNewData(rawBinary_);
       rawRefReader_.advance(arg.rawRefReader_.getPosition());
+
+      releaseWriter(move(writer_));
+      if (arg.writer_ != nullptr)
+      {
+         writer_ = acquireWriter();
+         writer_->put_BinaryDataRef(arg.writer_->getDataRef());
+      }
    }
 
+   static unique_ptr<BinaryWriter> acquireWriter(void);
+   static void releaseWriter(unique_ptr<BinaryWriter>);
+
 public:
    Arguments(void)
    {}
 
+   ~Arguments(void)
+   {
+      releaseWriter(move(writer_));
+   }
+
    Arguments(const string& argAsString) :
       argStr_(argAsString)
    {
@@ -229,7 +297,7 @@ public:
       setFromRef(arg);
    }
 
-   Arguments operator=(Arguments&& arg)
+   Arguments& operator=(Arguments&& arg)
    {
       if (this == &arg)
          return *this;
@@ -238,7 +306,7 @@ public:
       return *this;
    }
 
-   Arguments operator=(const Arguments& arg)
+   Arguments& operator=(const Arguments& arg)
    {
       if (this == &arg)
          return *this;
@@ -248,11 +316,24 @@ public:
    }
 
    void setRawData();
-   const string& serialize();
+   void setRawBinary(const BinaryDataRef&);
+   const string& serialize(WireEncoding encoding = WireEncoding_Hex);
+   void writeRaw(BinaryWriter&) const;
+
+   WireEncoding getEncoding(void) const { return encoding_; }
+
+   //switches to in place serialization, see the class comment
+   BinaryWriter& getWriter(void);
 
    ///////////////////////////////////////////////////////////////////////////////
    void merge(const Arguments& argIn)
    {
+      if (writer_ != nullptr || argIn.writer_ != nullptr)
+      {
+         argIn.writeRaw(getWriter());
+         return;
+      }
+
       argData_.insert(argData_.end(),
          argIn.argData_.begin(), argIn.argData_.end());
    }
@@ -260,6 +341,12 @@ public:
    ///////////////////////////////////////////////////////////////////////////////
    template<typename T> void push_back(const T& obj)
    {
+      if (writer_ != nullptr)
+      {
+         obj.serialize(*writer_);
+         return;
+      }
+
       shared_ptr<DataMeta> data = make_shared<DataObject<T>>(obj);
       argData_.push_back(data);
    }
@@ -267,6 +354,12 @@ public:
    ///////////////////////////////////////////////////////////////////////////////
    template<typename T> void push_back(T&& obj)
    {
+      if (writer_ != nullptr)
+      {
+         obj.serialize(*writer_);
+         return;
+      }
+
       shared_ptr<DataMeta> data = make_shared<DataObject<T>>(move(obj));
       argData_.push_back(data);
    }
@@ -302,13 +395,16 @@ public:
 
    bool hasArgs(void) const
    {
-      return rawRefReader_.getSizeRemaining() != 0 || argData_.size() != 0;
+      return rawRefReader_.getSizeRemaining() != 0 || argData_.size() != 0 ||
+         (writer_ != nullptr && writer_->getSize() != 0);
    }
 
    void clear(void)
    {
       argStr_.clear();
       argData_.clear();
+      if (writer_ != nullptr)
+         writer_->reset();
    }
 };
 
@@ -321,6 +417,7 @@ struct Command
    Arguments args_;
 
    string command_;
+   WireEncoding encoding_ = WireEncoding_Hex;
 
    Command()
    {}
@@ -330,7 +427,10 @@ struct Command
    {}
 
    void deserialize(void);
-   void serialize(void);
+   void serialize(WireEncoding encoding = WireEncoding_Hex);
+
+   //method name without validating or deserializing the whole command
+   static string peekMethod(const string&);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -360,7 +460,7 @@ public:
       shutdown();
    };
 
-   void callback(Arguments&& cmd, OrderType type = OrderOther);
+   virtual void callback(Arguments&& cmd, OrderType type = OrderOther);
    bool isValid(void) const { return cbStack_.isValid(); }
 
    void shutdown(void)
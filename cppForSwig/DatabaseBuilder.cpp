@@ -21,7 +21,9 @@ DatabaseBuilder::DatabaseBuilder(BlockFiles& blockFiles,
    bdmConfig_(bdm.config()), blockchain_(bdm.blockchain()),
    scrAddrFilter_(bdm.getScrAddrFilter()),
    progress_(progress),
-   magicBytes_(db_->getMagicBytes()), topBlockOffset_(0, 0)
+   magicBytes_(db_->getMagicBytes()), 
+   blockIndex_(db_->getBlockIndexPath(), magicBytes_),
+   topBlockOffset_(0, 0)
 {}
 
 /////////////////////////////////////////////////////////////////////////////
@@ -194,9 +196,6 @@ void DatabaseBuilder::init()
 BlockOffset DatabaseBuilder::loadBlockHeadersFromDB(
    const ProgressCallback &progress)
 {
-   //TODO: preload the headers db file to speed process up
-
-   LOGINFO << "Reading headers from db";
    blockchain_->clear();
 
    unsigned counter = 0;
@@ -233,13 +232,65 @@ BlockOffset DatabaseBuilder::loadBlockHeadersFromDB(
          calc.fractionCompleted(), calc.remainingSeconds(), counter);
    };
 
-   db_->readAllHeaders(callback);
+   //try the block index file first, it has to cover the HEADERS db top
+   LOGINFO << "Reading headers from block index file";
+   bool fromIndex = blockIndex_.load(callback);
+   if (fromIndex)
+   {
+      auto&& sdbiH = db_->getStoredDBInfo(HEADERS, 0);
+      auto topHeader = blockchain_->allHeaders()->getByHash(
+         sdbiH.topScannedBlkHash_.getRef());
+      if (topHeader == nullptr ||
+         topHeader->getBlockHeight() != sdbiH.topBlkHgt_)
+      {
+         LOGWARN << "block index file is behind the HEADERS db";
+         fromIndex = false;
+      }
+   }
+
+   if (!fromIndex)
+   {
+      LOGINFO << "Reading headers from db";
+      blockchain_->clear();
+      counter = 0;
+      topBlockOffet = BlockOffset(0, 0);
+
+      db_->readAllHeaders(callback, bdmConfig_.threadCount_);
 
-   LOGINFO << "Found " << blockchain_->allHeaders().size() << " headers in db";
+      //rebuild the index for the next run
+      try
+      {
+         blockIndex_.rewrite(blockchain_->allHeaders()->headers());
+      }
+      catch (exception& e)
+      {
+         LOGWARN << "failed to write block index file: " << e.what();
+         blockIndex_.wipe();
+      }
+   }
+
+   LOGINFO << "Found " << blockchain_->allHeaders()->size() << " headers in db";
 
    return topBlockOffet;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void DatabaseBuilder::updateBlockIndex(
+   const vector<shared_ptr<BlockHeader>>& headers)
+{
+   //the index only saves time, the HEADERS db remains the reference. On
+   //failure, drop the index so that it gets rebuilt on the next run
+   try
+   {
+      blockIndex_.append(headers);
+   }
+   catch (exception& e)
+   {
+      LOGWARN << "failed to update block index file: " << e.what();
+      blockIndex_.wipe();
+   }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
    const ProgressCallback &progress, bool verbose, bool fullHints)
@@ -325,7 +376,8 @@ Blockchain::ReorganizationState DatabaseBuilder::updateBlocksInDB(
    if (verbose)
       progress_(BDMPhase_OrganizingChain, 0, UINT32_MAX, 0);
    auto&& reorgState = blockchain_->organize(verbose);
-   blockchain_->putNewBareHeaders(db_);
+   auto&& putHeaders = blockchain_->putNewBareHeaders(db_);
+   updateBlockIndex(putHeaders);
 
    return reorgState;
 }
@@ -441,6 +493,18 @@ bool DatabaseBuilder::addBlocksToDB(BlockDataLoader& bdl,
 
          //update db entry
          db_->putFilterPoolForFileNum(fileID, pool);
+
+         if (bdmConfig_.txHashIndex_)
+         {
+            //the index only covers this file if it was parsed from scratch
+            bool fileComplete = 
+               startOffset == 0 && insertedBlocks.size() == bdMap.size();
+            db_->putTxHashIndexForFileNum(fileID, allFilters, fileComplete);
+         }
+         else
+         {
+            db_->clearTxHashIndexForFileNum(fileID);
+         }
       }
    }
    else
@@ -695,7 +759,8 @@ bool DatabaseBuilder::reparseBlkFiles(unsigned fromID)
 
    blockchain_->forceAddBlocksInBulk(headerMap);
    blockchain_->forceOrganize();
-   blockchain_->putNewBareHeaders(db_);
+   auto&& putHeaders = blockchain_->putNewBareHeaders(db_);
+   updateBlockIndex(putHeaders);
 
    //TODO: edge case: all the new blocks found were orphans, nothing was added
    //to the db, will run into the same blocks next run
@@ -1234,6 +1299,8 @@ void DatabaseBuilder::verifyTxFilters()
    fileCounter.store(0, memory_order_relaxed);
 
    set<unsigned> damagedFilters;
+   set<unsigned> legacyFilters;
+   mutex resultMutex;
 
    auto&& file_id_map = blockchain_->mapIDsPerBlockFile();
 
@@ -1243,6 +1310,7 @@ void DatabaseBuilder::verifyTxFilters()
       db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadOnly);
 
       set<unsigned> mismatchedFilters;
+      set<unsigned> unsortedFilters;
 
       while (1)
       {
@@ -1258,12 +1326,11 @@ void DatabaseBuilder::verifyTxFilters()
                continue;
             }
 
-            if (mismatchedFilters.size() > 0)
-            {
-               unique_lock<mutex>(resultMutex);
-               damagedFilters.insert(
-                  mismatchedFilters.begin(), mismatchedFilters.end());
-            }
+            unique_lock<mutex> lock(resultMutex);
+            damagedFilters.insert(
+               mismatchedFilters.begin(), mismatchedFilters.end());
+            legacyFilters.insert(
+               unsortedFilters.begin(), unsortedFilters.end());
 
             return;
          }
@@ -1276,12 +1343,16 @@ void DatabaseBuilder::verifyTxFilters()
             auto&& filters = pool.getFilterPoolPtr();
 
             auto match_count = 0;
+            bool sorted = true;
             for (auto& filter : filters)
             {
                //check filter blockid is for this block file
                auto id_iter = idset.find(filter.getBlockKey());
                if (id_iter != idset.end())
                   ++match_count;
+
+               if (!filter.isSorted())
+                  sorted = false;
             }
 
             mismatchCount = idset.size() - match_count;
@@ -1291,6 +1362,10 @@ void DatabaseBuilder::verifyTxFilters()
                mismatchedFilters.insert(fileNum);
                LOGWARN << mismatchCount << " mismatches in txfilter for file #" << fileNum;
             }
+            else if (!sorted)
+            {
+               unsortedFilters.insert(fileNum);
+            }
          }
          catch (runtime_error&)
          {
@@ -1309,19 +1384,53 @@ void DatabaseBuilder::verifyTxFilters()
       if (thr.joinable())
          thr.join();
    
-   if (damagedFilters.size() == 0)
+   if (damagedFilters.size() == 0 && legacyFilters.size() == 0)
    {
       LOGINFO << "done checking txfilters";
       return;
    }
 
-   LOGWARN << damagedFilters.size() << " damaged filters, repairing";
-   repairTxFilters(damagedFilters);
+   if (damagedFilters.size() > 0)
+      LOGWARN << damagedFilters.size() << " damaged filters, repairing";
+   if (legacyFilters.size() > 0)
+      LOGINFO << legacyFilters.size() << " filters in legacy format, upgrading";
+
+   repairTxFilters(damagedFilters, legacyFilters);
 }
 
 /////////////////////////////////////////////////////////////////////////////
-void DatabaseBuilder::repairTxFilters(const set<unsigned>& badFilters)
+void DatabaseBuilder::repairTxFilters(
+   const set<unsigned>& badFilters, const set<unsigned>& legacyFilters)
 {   
+   if (legacyFilters.size() > 0)
+   {
+      /***
+      Legacy filters are intact, they only lack the sorted layout. Their
+      content is deserialized and written back, which is cheap compared
+      to reparsing the block files.
+      ***/
+
+      LMDBEnv::Transaction tx;
+      db_->beginDBTransaction(&tx, TXFILTERS, LMDB::ReadWrite);
+
+      for (auto& fileID : legacyFilters)
+      {
+         auto&& pool = db_->getFilterPoolForFileNum<TxFilterType>(fileID);
+         if (!pool.isValid())
+         {
+            LOGWARN << "failed to upgrade txfilter for file #" << fileID;
+            continue;
+         }
+
+         db_->putFilterPoolForFileNum(fileID, pool);
+      }
+
+      LOGINFO << "upgraded " << legacyFilters.size() << " txfilters";
+   }
+
+   if (badFilters.size() == 0)
+      return;
+
    {
       LOGINFO << "clearing damaged filters";
 
@@ -28,6 +28,7 @@ private:
 
    const ProgressCallback progress_;
    const BinaryData magicBytes_;
+   BlockIndexFile blockIndex_;
    BlockOffset topBlockOffset_;
    const BlockDataManagerConfig bdmConfig_;
 
@@ -36,6 +37,7 @@ private:
 private:
    void findLastKnownBlockPos();
    BlockOffset loadBlockHeadersFromDB(const ProgressCallback &progress);
+   void updateBlockIndex(const vector<shared_ptr<BlockHeader>>&);
    
    bool addBlocksToDB(
       BlockDataLoader& bdl, uint16_t fileID, size_t startOffset,
@@ -62,7 +64,7 @@ private:
    void commitAllStxos(shared_ptr<BlockDataFileMap>, 
       const map<uint32_t, BlockData>&, const set<unsigned>&);
 
-   void repairTxFilters(const set<unsigned>&);
+   void repairTxFilters(const set<unsigned>&, const set<unsigned>&);
    void reprocessTxFilter(shared_ptr<BlockDataFileMap>, unsigned);
 
    void cycleDatabases(void);
@@ -139,7 +139,7 @@ FcgiPacket& FcgiMessage::getNewPacket(void)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-uint16_t FcgiMessage::beginRequest(void)
+uint16_t FcgiMessage::beginRequest(bool keepConn)
 {
    //randomize requestID
    requestID_ = 1 + rand() % 65534; //cannot be 0
@@ -154,6 +154,8 @@ uint16_t FcgiMessage::beginRequest(void)
 
    memset(msg, 0, 8);
    msg[1] = FCGI_RESPONDER; //request role B0
+   if (keepConn)
+      msg[2] = FCGI_KEEP_CONN; //flags
 
    packet.buildHeader(FCGI_BEGIN_REQUEST, requestID_);
 
@@ -161,12 +163,19 @@ uint16_t FcgiMessage::beginRequest(void)
 }
 ///////////////////////////////////////////////////////////////////////////////
 FcgiMessage FcgiMessage::makePacket(const char *msg)
+{
+   return makePacket(msg, strlen(msg));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+FcgiMessage FcgiMessage::makePacket(
+   const char *msg, size_t msglen, bool keepConn)
 {
    FcgiMessage fcgiMsg;
-   auto requestID = fcgiMsg.beginRequest();
+   auto requestID = fcgiMsg.beginRequest(keepConn);
 
    stringstream msglength;
-   msglength << strlen(msg);
+   msglength << msglen;
 
    //params
    auto& params = fcgiMsg.getNewPacket();
@@ -179,7 +188,6 @@ FcgiMessage FcgiMessage::makePacket(const char *msg)
    paramterminator.buildHeader(FCGI_PARAMS, requestID);
 
    //data
-   auto msglen = strlen(msg);
    size_t offset = 0;
    size_t uint16max = UINT16_MAX;
    while (msglen > offset)
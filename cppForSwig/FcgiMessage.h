@@ -56,6 +56,8 @@ private:
 
 public:
    static FcgiMessage makePacket(const char* msg);
+   static FcgiMessage makePacket(
+      const char* msg, size_t msglen, bool keepConn = false);
 
    uint8_t* serialize(void);
    size_t getSerializedDataLength(void) const { return serData_.size(); }
@@ -63,7 +65,7 @@ public:
    void clear(void);
 
    FcgiPacket& getNewPacket(void);
-   uint16_t beginRequest(void);
+   uint16_t beginRequest(bool keepConn);
    void endRequest(void) {}
    int id(void) const { return requestID_; }
 };
@@ -6,6 +6,7 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 #include "LedgerEntry.h"
+#include "BDM_seder.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -34,6 +35,17 @@ string LedgerEntry::getWalletID(void) const
    return string();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+void LedgerEntry::serialize(BinaryWriter& bw) const
+{
+   //scrAddr ledgers carry no wallet ID, as with getWalletID
+   auto idRef = ID_.getSize() != 21 ? ID_.getRef() : BinaryDataRef();
+
+   LedgerEntryVector::serializeEntry(bw, idRef, value_, blockNum_, txHash_,
+      index_, txTime_, isCoinbase_, isSentToSelf_, isChangeBack_, 
+      isOptInRBF_, isChainedZC_, usesWitness_, scrAddrSet_);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 void LedgerEntry::setScrAddr(BinaryData const & bd)
 { 
@@ -140,6 +140,9 @@ public:
    
    set<BinaryData> getScrAddrList(void) const
    { return scrAddrSet_; }
+
+   //in place LedgerEntryVector entry, see LedgerEntryVector::serializeEntry
+   void serialize(BinaryWriter&) const;
    
 public:
 
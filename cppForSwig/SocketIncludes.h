@@ -28,6 +28,12 @@ typedef int SOCKET;
 #define SOCK_MAX INT_MAX
 #endif
 
+//writing to a keep-alive connection the peer dropped should fail the 
+//call, not raise SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 #include <string>
 
@@ -147,9 +147,9 @@ void BinarySocket::writeToSocket(SOCKET sockfd, void* data, size_t size)
       {
          if (!haveWritten)
          {
-            auto bytessent = send(
-               sockfd, (char*)data + total_send, size - total_send, 0);
-            if (bytessent == 0)
+            auto bytessent = send(sockfd, 
+               (char*)data + total_send, size - total_send, MSG_NOSIGNAL);
+            if (bytessent <= 0)
                throw SocketError("failed to send data");
 
             total_send += bytessent;
@@ -376,20 +376,153 @@ void BinarySocket::readFromSocketThread(SOCKET sockfd, ReadCallback callback)
       exceptptr = current_exception();
    }
 
+   //mark read as completed, before closing the socket so that the callback
+   //can let go of it while the descriptor is still ours
+   callback(vector<uint8_t>(), exceptptr);
+
+   //cleanup
+   closeSocket(sockfd);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BinarySocket::readIntoBuffer(
+   SOCKET sockfd, shared_ptr<SocketReadBuffer> buffer)
+{
+   auto readLambda = [sockfd, buffer, this](void)->void
+   {
+      try
+      {
+         readIntoBufferThread(sockfd, buffer);
+      }
+      catch (...)
+      {
+      }
+   };
+
+   thread readThr(readLambda);
+   if (readThr.joinable())
+      readThr.detach();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BinarySocket::readIntoBufferThread(
+   SOCKET sockfd, shared_ptr<SocketReadBuffer> buffer)
+{
+   size_t readIncrement = 8192;
+   stringstream errorss;
+
+   exception_ptr exceptptr = nullptr;
+
+   struct pollfd pfd;
+   pfd.fd = sockfd;
+   pfd.events = POLLIN;
+
+   try
+   {
+      bool stop = false;
+      while (!stop)
+      {
+#ifdef _WIN32
+         auto status = WSAPoll(&pfd, 1, 60000);
+#else
+         auto status = poll(&pfd, 1, 60000);
+#endif
+
+         if (status == 0)
+            continue;
+
+         if (status == -1)
+         {
+            //select error, process and exit loop
+#ifdef _WIN32
+            auto errornum = WSAGetLastError();
+#else
+            auto errornum = errno;
+#endif
+            errorss << "poll() error in readIntoBufferThread: " << errornum;
+            LOGERR << errorss.str();
+            throw SocketError(errorss.str());
+         }
+
+         if (pfd.revents & POLLNVAL)
+            throw SocketError("POLLNVAL in readIntoBufferThread");
+
+         //exceptions
+         if (pfd.revents & POLLERR)
+         {
+            errorss << "POLLERR error in readIntoBufferThread";
+            LOGERR << errorss.str();
+            throw SocketError(errorss.str());
+         }
+
+         if (pfd.revents & POLLIN)
+         {
+            //drain the socket into the buffer
+            while (1)
+            {
+               auto&& space = buffer->getWriteSpace(readIncrement);
+               int readAmt = recv(
+                  sockfd, (char*)space.first, space.second, 0);
+
+               if (readAmt == 0)
+               {
+                  LOGINFO << "POLLIN recv return 0";
+                  stop = true;
+                  break;
+               }
+
+               if (readAmt < 0)
+               {
+#ifdef _WIN32
+                  auto errornum = WSAGetLastError();
+                  if (errornum == WSAEWOULDBLOCK)
+                     break;
+#else
+                  auto errornum = errno;
+                  if (errornum == EAGAIN || errornum == EWOULDBLOCK)
+                     break;
+#endif
+
+                  errorss << "recv error: " << errornum;
+                  throw SocketError(errorss.str());
+               }
+
+               if (buffer->commit(readAmt))
+               {
+                  stop = true;
+                  break;
+               }
+
+               if ((size_t)readAmt < space.second)
+                  break;
+            }
+         }
+
+         //socket was closed
+         if (pfd.revents & POLLHUP)
+            break;
+      }
+   }
+   catch (...)
+   {
+      exceptptr = current_exception();
+   }
+
+   buffer->completed(exceptptr);
+
    //cleanup
    closeSocket(sockfd);
-   
-   //mark read as completed
-   callback(vector<uint8_t>(), exceptptr);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 void BinarySocket::writeAndRead(
-   SOCKET sockfd, uint8_t* data, size_t len, SequentialReadCallback callback)
+   SOCKET& sockfd, uint8_t* data, size_t len, 
+   SequentialReadCallback callback, bool keepAlive)
 {
    size_t readIncrement = 8192;
    stringstream errorss;
    bool haveWritten = false;
+   bool peerClosed = false;
 
    exception_ptr exceptptr = nullptr;
 
@@ -452,9 +585,9 @@ void BinarySocket::writeAndRead(
       {
          if (!haveWritten)
          {
-            auto bytessent = send(
-               sockfd, (char*)data + total_send, len - total_send, 0);
-            if (bytessent == 0)
+            auto bytessent = send(sockfd, 
+               (char*)data + total_send, len - total_send, MSG_NOSIGNAL);
+            if (bytessent <= 0)
                throw SocketError("failed to send data");
 
             total_send += bytessent;
@@ -527,6 +660,8 @@ void BinarySocket::writeAndRead(
 
          if (readAmt == 0)
          {
+            peerClosed = true;
+            readdata.resize(totalread);
             if (!callback(readdata))
             {
                if (verbose_)
@@ -548,15 +683,19 @@ void BinarySocket::writeAndRead(
 
       //socket was closed
       if (pfd.revents & POLLHUP)
+      {
+         peerClosed = true;
          break;
+      }
    }
 
    //cleanup
-   closeSocket(sockfd);
+   if (!keepAlive || peerClosed)
+      closeSocket(sockfd);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void BinarySocket::listen(AcceptCallback callback)
+SOCKET BinarySocket::openListenSocket()
 {
    SOCKET sockfd = SOCK_MAX;
    try
@@ -580,9 +719,20 @@ void BinarySocket::listen(AcceptCallback callback)
    catch (SocketError &)
    {
       closeSocket(sockfd);
-      return;
    }
 
+   return sockfd;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BinarySocket::listen(AcceptCallback callback, SOCKET& sockfd)
+{
+   if (sockfd == SOCK_MAX)
+      sockfd = openListenSocket();
+
+   if (sockfd == SOCK_MAX)
+      return;
+
    stringstream errorss;
    exception_ptr exceptptr = nullptr;
 
@@ -639,11 +789,20 @@ void BinarySocket::listen(AcceptCallback callback)
             throw SocketError(errorss.str());
          }
 
+         if (pfd.revents & POLLHUP)
+         {
+            //listening socket was shut down
+            break;
+         }
+
          if (pfd.revents & POLLIN)
          {
             //accept socket and trigger callback
             AcceptStruct astruct;
             astruct.sockfd_ = accept(sockfd, &astruct.saddr_, &astruct.addrlen_);
+            if (astruct.sockfd_ < 0)
+               break;
+
             callback(move(astruct));
          }
       }
@@ -667,7 +826,24 @@ ListenServer::ListenServer(const string& addr, const string& port)
 ///////////////////////////////////////////////////////////////////////////////
 void ListenServer::start(ReadCallback callback)
 {
-   auto listenlbd = [this](ReadCallback clbk)->void
+   auto connectlbd = [callback](
+      shared_ptr<DedicatedBinarySocket>)->ReadCallback
+   {
+      return callback;
+   };
+
+   start(ConnectCallback(connectlbd));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void ListenServer::start(ConnectCallback callback)
+{
+   //bind before returning, so that callers can connect right away
+   listenSocket_->sockfd_ = listenSocket_->openListenSocket();
+   if (listenSocket_->sockfd_ == SOCK_MAX)
+      throw SocketError("failed to bind listen socket");
+
+   auto listenlbd = [this](ConnectCallback clbk)->void
    {
       this->listenThread(clbk);
    };
@@ -683,27 +859,31 @@ void ListenServer::join()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ListenServer::listenThread(ReadCallback callback)
+void ListenServer::listenThread(ConnectCallback callback)
 {
    auto acceptldb = [callback, this](AcceptStruct astruct)->void
    {
-      astruct.readCallback_ = callback;
-      this->acceptProcess(move(astruct));
+      this->acceptProcess(move(astruct), callback);
    };
 
-   listenSocket_->listen(acceptldb);
+   listenSocket_->listen(acceptldb, listenSocket_->sockfd_);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-void ListenServer::acceptProcess(AcceptStruct aStruct)
+void ListenServer::acceptProcess(
+   AcceptStruct aStruct, ConnectCallback connectCallback)
 {
    unique_lock<mutex> lock(mu_);
 
    auto readldb = [this](
       shared_ptr<DedicatedBinarySocket> sock, ReadCallback callback)->void
    {
-      sock->readFromSocket(callback);
+      //read on this thread rather than a detached one, the socket object
+      //has to outlive the read loop. The loop closes the socket on exit.
       auto sockfd = sock->sockfd_;
+      sock->readFromSocketThread(sockfd, callback);
+      sock->sockfd_ = SOCK_MAX;
+
       this->cleanUpStack_.push_back(move(sockfd));
    };
 
@@ -714,7 +894,8 @@ void ListenServer::acceptProcess(AcceptStruct aStruct)
    ss->sock_->verbose_ = false;
 
    //start read lambda thread
-   ss->thr_ = thread(readldb, ss->sock_, aStruct.readCallback_);
+   auto readCallback = connectCallback(ss->sock_);
+   ss->thr_ = thread(readldb, ss->sock_, readCallback);
 
    //record thread id and socket ptr in socketStruct, add to acceptMap_
    acceptMap_.insert(make_pair(aStruct.sockfd_, move(ss)));
@@ -744,7 +925,8 @@ void ListenServer::acceptProcess(AcceptStruct aStruct)
 ///////////////////////////////////////////////////////////////////////////////
 void ListenServer::stop()
 {
-   listenSocket_->closeSocket();
+   //the accept loop closes the listening socket on its way out
+   listenSocket_->shutdown();
    if (listenThread_.joinable())
       listenThread_.join();
 
@@ -752,7 +934,8 @@ void ListenServer::stop()
    {
       auto& sockstruct = sockPair.second;
       
-      sockstruct->sock_->closeSocket();
+      //wake the read loop up, it closes the socket on its way out
+      sockstruct->sock_->shutdown();
       if (sockstruct->thr_.joinable())
          sockstruct->thr_.join();
    }
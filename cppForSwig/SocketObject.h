@@ -30,6 +30,27 @@ using namespace std;
    
 typedef function<bool(vector<uint8_t>, exception_ptr)>  ReadCallback;
 
+///////////////////////////////////////////////////////////////////////////////
+struct SocketReadBuffer
+{
+   /***
+   Lets a socket read straight into the consumer's memory, in place of 
+   handing it a new vector per read.
+   ***/
+
+   virtual ~SocketReadBuffer(void)
+   {}
+
+   //free space to recv into, at least minLen bytes
+   virtual pair<uint8_t*, size_t> getWriteSpace(size_t minLen) = 0;
+
+   //len bytes were written to the space, return true to stop reading
+   virtual bool commit(size_t len) = 0;
+
+   //reading stopped, ePtr is set if it failed
+   virtual void completed(exception_ptr ePtr) = 0;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 struct AcceptStruct
 {
@@ -64,18 +85,31 @@ protected:
 
    bool verbose_ = true;
 
+   //set once the server has agreed to binary packets, see WireFrame
+   WireEncoding wireEncoding_ = WireEncoding_Hex;
+
 private:
    void readFromSocketThread(SOCKET, ReadCallback);
+   void readIntoBufferThread(SOCKET, shared_ptr<SocketReadBuffer>);
 
 protected:   
    void writeToSocket(SOCKET, void*, size_t);
    void readFromSocket(SOCKET, ReadCallback);
+   void readIntoBuffer(SOCKET, shared_ptr<SocketReadBuffer>);
    void setBlocking(SOCKET, bool);
 
-   void writeAndRead(SOCKET, uint8_t*, size_t, 
-      SequentialReadCallback);
+   //closes the socket on exit unless keepAlive is set and the peer 
+   //did not hang up, sockfd is set to SOCK_MAX once closed
+   void writeAndRead(SOCKET& sockfd, uint8_t*, size_t, 
+      SequentialReadCallback, bool keepAlive = false);
+
+   //returns SOCK_MAX if the address can't be bound
+   SOCKET openListenSocket(void);
 
-   void listen(AcceptCallback);
+   //sockfd holds the listening socket while the accept loop runs, 
+   //shutting it down from another thread ends the loop. A listening
+   //socket is opened if sockfd is SOCK_MAX
+   void listen(AcceptCallback, SOCKET& sockfd);
 
    BinarySocket(void) :
       addr_(""), port_("")
@@ -94,7 +128,19 @@ public:
       throw SocketError("not implemented, use the protected method instead");
    }
 
+   //hands out the reply as its pieces come in, for streamed replies. 
+   //Sockets that can't tell pieces apart hand it out whole
+   virtual void writeAndReadStream(const string& msg,
+      const function<void(string&&)>& callback, SOCKET sock = SOCK_MAX)
+   {
+      callback(writeAndRead(msg, sock));
+   }
+
    virtual SocketType type(void) const { return SocketBinary; }
+   const string& getAddr(void) const { return addr_; }
+
+   WireEncoding getWireEncoding(void) const { return wireEncoding_; }
+   void setWireEncoding(WireEncoding encoding) { wireEncoding_ = encoding; }
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -122,6 +168,13 @@ public:
       BinarySocket::closeSocket(sockfd_);
    }
 
+   //wakes up threads polling the socket without releasing the descriptor
+   void shutdown(void)
+   {
+      if (isValid())
+         ::shutdown(sockfd_, 2);
+   }
+
    void writeToSocket(void* data, size_t len)
    {
       BinarySocket::writeToSocket(sockfd_, data, len);
@@ -132,6 +185,11 @@ public:
       BinarySocket::readFromSocket(sockfd_, callback);
    }
 
+   void readIntoBuffer(shared_ptr<SocketReadBuffer> buffer)
+   {
+      BinarySocket::readIntoBuffer(sockfd_, buffer);
+   }
+
    bool openSocket(bool blocking)
    {
       if (addr_.size() != 0 && port_.size() != 0)
@@ -168,6 +226,11 @@ public:
 ///////////////////////////////////////////////////////////////////////////////
 class ListenServer
 {
+public:
+   //called on each accepted connection, returns the read callback for it
+   typedef function<ReadCallback(shared_ptr<DedicatedBinarySocket>)> 
+      ConnectCallback;
+
 private:
    struct SocketStruct
    {
@@ -191,8 +254,8 @@ private:
    mutex mu_;
 
 private:
-   void listenThread(ReadCallback);
-   void acceptProcess(AcceptStruct);
+   void listenThread(ConnectCallback);
+   void acceptProcess(AcceptStruct, ConnectCallback);
    ListenServer(const ListenServer&) = delete;
 
 public:
@@ -203,6 +266,7 @@ public:
    }
 
    void start(ReadCallback);
+   void start(ConnectCallback);
    void stop(void);
    void join(void);
 };
@@ -49,6 +49,7 @@ enum DB_SELECT
    ZERO_CONF,
    TXFILTERS,
    SPENTNESS,
+   TXHASHINDEX,
    COUNT
 };
 
@@ -7,6 +7,83 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "StringSockets.h"
+#include "DataObject.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SocketPool
+//
+///////////////////////////////////////////////////////////////////////////////
+bool SocketPool::isStale(SOCKET sockfd)
+{
+   //an idle connection has nothing to read, anything pending is either
+   //the server closing it or garbage we can't make sense of
+   struct pollfd pfd;
+   pfd.fd = sockfd;
+   pfd.events = POLLIN;
+   pfd.revents = 0;
+
+#ifdef _WIN32
+   auto status = WSAPoll(&pfd, 1, 0);
+#else
+   auto status = poll(&pfd, 1, 0);
+#endif
+
+   return status != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+SOCKET SocketPool::get()
+{
+   while (1)
+   {
+      SOCKET sockfd;
+      try
+      {
+         sockfd = idle_.pop_back();
+      }
+      catch (IsEmpty&)
+      {
+         return SOCK_MAX;
+      }
+
+      if (!isStale(sockfd))
+         return sockfd;
+
+      BinarySocket::closeSocket(sockfd);
+   }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketPool::put(SOCKET& sockfd)
+{
+   if (sockfd == SOCK_MAX)
+      return;
+
+   if (idle_.count() >= maxIdle_)
+   {
+      BinarySocket::closeSocket(sockfd);
+      return;
+   }
+
+   idle_.push_back(sockfd);
+   sockfd = SOCK_MAX;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SocketPool::clear()
+{
+   try
+   {
+      while (1)
+      {
+         auto sockfd = idle_.pop_back();
+         BinarySocket::closeSocket(sockfd);
+      }
+   }
+   catch (IsEmpty&)
+   {}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -16,6 +93,7 @@
 HttpSocket::HttpSocket(const BinarySocket& obj) :
 BinarySocket(obj)
 {
+   pool_ = make_shared<SocketPool>(SOCKET_POOL_MAX_IDLE);
    resetHeaders();
 }
 
@@ -27,6 +105,7 @@ void HttpSocket::setupHeaders()
    addrHeader << "Host: " << addr_;
    addHeader(addrHeader.str());
    addHeader("Content-type: text/html; charset=UTF-8");
+   addHeader("Connection: keep-alive");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -45,21 +124,21 @@ void HttpSocket::resetHeaders()
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-int32_t HttpSocket::makePacket(char** packet, const char* msg)
+int32_t HttpSocket::makePacket(char** packet, const char* msg, size_t msglen)
 {
    if (packet == nullptr)
       return -1;
 
    stringstream ss;
    ss << "Content-Length: ";
-   ss << strlen(msg);
+   ss << msglen;
    ss << "\r\n\r\n";
 
    size_t httpHeaderSize = 0;
    for (auto& header : headers_)
       httpHeaderSize += header.size();
 
-   *packet = new char[strlen(msg) +
+   *packet = new char[msglen +
       ss.str().size() +
       httpHeaderSize +
       1];
@@ -74,55 +153,136 @@ int32_t HttpSocket::makePacket(char** packet, const char* msg)
    memcpy(*packet + pos, ss.str().c_str(), ss.str().size());
    pos += ss.str().size();
 
-   memcpy(*packet + pos, msg, strlen(msg));
-   pos += strlen(msg);
+   memcpy(*packet + pos, msg, msglen);
+   pos += msglen;
 
    memset(*packet + pos, 0, 1);
    return pos;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-string HttpSocket::getBody(vector<uint8_t> msg)
+bool HttpSocket::processHttpData(packetData& packet,
+   const uint8_t* data, size_t len, const function<void(string&&)>& callback)
 {
    /***
-   Always expect text data (null terminated)
+   Body is either hex text or a binary frame, so it may hold null bytes.
+   Headers end at the first double crlf.
    ***/
 
-   //look for double crlf http header end, return everything after that
-   typedef vector<uint8_t>::iterator vcIter;
+   auto& httpData = packet.httpData;
+   httpData.insert(httpData.end(), data, data + len);
+
+   if (packet.header_len == 0)
+   {
+      //look for double crlf http header end
+      for (unsigned i = 0; i + 3 < httpData.size(); i++)
+      {
+         if (httpData[i] == '\r' && httpData[i + 1] == '\n' &&
+            httpData[i + 2] == '\r' && httpData[i + 3] == '\n')
+         {
+            packet.header_len = i + 4;
+            break;
+         }
+      }
+
+      if (packet.header_len == 0)
+         return false;
+
+      string header_str((char*)&httpData[0], packet.header_len);
+      packet.get_content_len(header_str);
+      packet.get_connection(header_str);
 
-   //let's use a move iterator, enough copies already as it is
-   string htmlstr(
-      move_iterator<vcIter>(msg.begin()),
-      move_iterator<vcIter>(msg.end()));
+      //the server delimits streamed packets itself, the proxy has to pass
+      //them through as is
+      if (packet.has_transfer_encoding(header_str))
+         throw HttpError("unexpected transfer encoding in http reply");
+
+      if (!packet.has_content_length)
+      {
+         //nothing else can follow a reply without a length
+         packet.streamed = true;
+         packet.keep_alive = false;
+      }
+
+      httpData.erase(httpData.begin(), httpData.begin() + packet.header_len);
+   }
 
-   size_t pos = htmlstr.find("\r\n\r\n");
-   if (pos == string::npos)
+   if (!packet.streamed)
    {
-      //no html break, check for error marker
-      pos = htmlstr.find("error:");
-      if (pos != string::npos)
-         throw runtime_error(htmlstr);
+      //check the total amount of data read matches the advertised
+      //data in the http header
+      if (httpData.size() < packet.content_length)
+         return false;
 
-      throw runtime_error("unexpected return value");
+      httpData.resize(packet.content_length);
+
+      packet.delivered = true;
+      callback(string(httpData.begin(), httpData.end()));
+
+      packet.done = true;
+      return true;
    }
 
-   return htmlstr.substr(pos + 4);
+   size_t offset = 0;
+   while (offset + WIRE_STREAM_HEADER_LEN <= httpData.size())
+   {
+      size_t packetLen = WireFrame::streamLength(&httpData[offset]);
+      auto packetStart = offset + WIRE_STREAM_HEADER_LEN;
+      if (packetLen == 0)
+      {
+         packet.done = true;
+         return true;
+      }
+
+      if (httpData.size() < packetStart + packetLen)
+         break;
+
+      packet.delivered = true;
+      callback(string((char*)&httpData[packetStart], packetLen));
+      offset = packetStart + packetLen;
+   }
+
+   //only keep what wasn't handed out yet
+   httpData.erase(httpData.begin(), httpData.begin() + offset);
+   return false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 string HttpSocket::writeAndRead(const string& msg, SOCKET sockfd)
 {
+   //streamed replies are put back together
+   string body;
+   auto appendBody = [&body](string&& data)->void
+   {
+      if (body.size() == 0)
+         body = move(data);
+      else
+         body.append(data);
+   };
+
+   writeAndReadStream(msg, appendBody, sockfd);
+   return body;
+}
 
+///////////////////////////////////////////////////////////////////////////////
+void HttpSocket::writeAndReadStream(const string& msg,
+   const function<void(string&&)>& callback, SOCKET sockfd)
+{
    char* packet = nullptr;
-   auto packetSize = makePacket(&packet, msg.c_str());
-
-   typedef vector<char>::iterator vecIterType;
+   auto packetSize = makePacket(&packet, msg.c_str(), msg.size());
 
    packetData packetPtr;
 
    while (1)
    {
+      //reuse an idle connection if there is one
+      bool pooled = false;
+      if (sockfd == SOCK_MAX)
+      {
+         sockfd = pool_->get();
+         pooled = sockfd != SOCK_MAX;
+      }
+
       if (sockfd == SOCK_MAX)
          sockfd = openSocket(false);
 
@@ -138,86 +298,53 @@ string HttpSocket::writeAndRead(const string& msg, SOCKET sockfd)
 
       try
       {
-         auto processHttpPacket = [&packetPtr]
+         auto processHttpPacket = [&packetPtr, &callback]
             (const vector<uint8_t>& socketData)->bool
          {
-            auto& httpData = packetPtr.httpData;
-
             if (socketData.size() == 0)
                return true;
 
-            {
-               httpData.insert(
-                  httpData.end(), socketData.begin(), socketData.end());
-
-               if (packetPtr.content_length == -1)
-               {
-                  //if content_length is -1, we have not read the content-length in the
-                  //http header yet, let's find that
-                  for (unsigned i = 0; i < httpData.size(); i++)
-                  {
-                     if (httpData[i] == '\r')
-                     {
-                        if (httpData.size() - i < 3)
-                           break;
-
-                        if (httpData[i + 1] == '\n' &&
-                           httpData[i + 2] == '\r' &&
-                           httpData[i + 3] == '\n')
-                        {
-                           packetPtr.header_len = i + 4;
-                           break;
-                        }
-                     }
-                  }
-
-                  if (packetPtr.header_len == 0)
-                     throw HttpError("couldn't find http header in response");
-
-                  string header_str((char*)&httpData[0], packetPtr.header_len);
-                  packetPtr.get_content_len(header_str);
-               }
-
-               if (packetPtr.content_length == -1)
-                  throw HttpError("failed to find http header response packet");
-
-               //check the total amount of data read matches the advertised
-               //data in the http header
-            }
-
-            bool done = false;
-            if (httpData.size() >= packetPtr.content_length + packetPtr.header_len)
-            {
-               httpData.resize(packetPtr.content_length + packetPtr.header_len);
-               done = true;
-            }
-
-            return done;
+            return processHttpData(packetPtr, 
+               &socketData[0], socketData.size(), callback);
          };
 
          BinarySocket::writeAndRead(sockfd,
-            (uint8_t*)packet, packetSize, processHttpPacket);
+            (uint8_t*)packet, packetSize, processHttpPacket, true);
+
+         if (!packetPtr.complete())
+            throw SocketError("connection closed before end of response");
 
          break;
       }
       catch (HttpError &e)
       {
          LOGERR << "HttpSocket::writeAndRead HttpError: " << e.what();
-         continue;
       }
       catch (exception &e)
       {
-         LOGERR << e.what();
-         continue;
+         //the server may have dropped an idle connection, not worth 
+         //reporting, retry on a fresh one
+         if (!pooled)
+            LOGERR << e.what();
+      }
+
+      closeSocket(sockfd);
+
+      //can't start over once part of the reply was handed out
+      if (packetPtr.delivered)
+      {
+         delete[] packet;
+         throw SocketError("connection dropped in the middle of a reply");
       }
    }
 
-   closeSocket(sockfd);
-   auto&& retmsg = getBody(move(packetPtr.httpData));
+   if (packetPtr.keep_alive)
+      pool_->put(sockfd);
+   else
+      closeSocket(sockfd);
+
    if(packet != nullptr)
       delete[] packet;
-
-   return retmsg;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -230,9 +357,11 @@ HttpSocket(obj)
 {}
 
 ///////////////////////////////////////////////////////////////////////////////
-string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
+void FcgiSocket::writeAndReadStream(const string& msg,
+   const function<void(string&&)>& callback, SOCKET sockfd)
 {
-   auto&& fcgiMsg = FcgiMessage::makePacket(msg.c_str());
+   //ask the server to keep the connection open past this request
+   auto&& fcgiMsg = FcgiMessage::makePacket(msg.c_str(), msg.size(), true);
    auto serdata = fcgiMsg.serialize();
    auto serdatalength = fcgiMsg.getSerializedDataLength();
 
@@ -243,6 +372,13 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
    {
       packetPtr.clear();
       
+      bool pooled = false;
+      if (sockfd == SOCK_MAX)
+      {
+         sockfd = pool_->get();
+         pooled = sockfd != SOCK_MAX;
+      }
+
       if (sockfd == SOCK_MAX)
          sockfd = openSocket(false);
 
@@ -253,7 +389,7 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
       {
 
          auto processFcgiPacket =
-            [&packetPtr](
+            [&packetPtr, &callback](
             const vector<uint8_t>& socketData)->bool
          {
             if (socketData.size() == 0)
@@ -285,6 +421,22 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
                {
                case FCGI_END_REQUEST:
                {
+                  //consume the record body as well, the connection may be
+                  //reused and has to be left clean for the next request
+                  uint16_t bodysize = 0, padding;
+                  bodysize |= (uint8_t)fcgiheader[5];
+                  bodysize |= (uint16_t)(fcgiheader[4] << 8);
+                  padding = (uint8_t)fcgiheader[6];
+
+                  if (bodysize + padding + packetPtr.ptroffset >
+                     packetPtr.fcgidata.size())
+                  {
+                     packetPtr.ptroffset -= FCGI_HEADER_LEN;
+                     abortParse = true;
+                     break;
+                  }
+
+                  packetPtr.ptroffset += bodysize + padding;
                   packetPtr.endpacket++;
                   break;
                }
@@ -311,9 +463,9 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
                      }
 
                      //extract http data
-                     packetPtr.httpData.insert(packetPtr.httpData.end(),
-                        packetPtr.fcgidata.begin() + packetPtr.ptroffset,
-                        packetPtr.fcgidata.begin() + packetPtr.ptroffset + packetsize);
+                     HttpSocket::processHttpData(packetPtr.httpData,
+                        &packetPtr.fcgidata[packetPtr.ptroffset], 
+                        packetsize, callback);
 
                      //advance index to next header
                      packetPtr.ptroffset += packetsize + padding;
@@ -341,8 +493,14 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
          };
 
          BinarySocket::writeAndRead(sockfd, 
-            serdata, serdatalength, processFcgiPacket);
+            serdata, serdatalength, processFcgiPacket, true);
          
+         if (packetPtr.endpacket == 0)
+            throw SocketError("connection closed before end of response");
+
+         if (!packetPtr.httpData.complete())
+            throw HttpError("incomplete http reply");
+
          //if we got this far we're all good
          break;
       }
@@ -356,14 +514,20 @@ string FcgiSocket::writeAndRead(const string& msg, SOCKET sockfd)
       }
       catch (exception &e)
       {
-         LOGERR << e.what();
+         //see HttpSocket::writeAndRead
+         if (!pooled)
+            LOGERR << e.what();
       }
 
       closeSocket(sockfd);
+
+      //can't start over once part of the reply was handed out
+      if (packetPtr.httpData.delivered)
+         throw SocketError("connection dropped in the middle of a reply");
    }
 
-   closeSocket(sockfd);
+   //the server closes its end if it doesn't honor FCGI_KEEP_CONN, the pool
+   //weeds these out when they are picked up again
+   pool_->put(sockfd);
    fcgiMsg.clear();
-
-   return HttpSocket::getBody(move(packetPtr.httpData));
 }
@@ -13,6 +13,8 @@
 #include "SocketObject.h"
 #include "FcgiMessage.h"
 
+#define SOCKET_POOL_MAX_IDLE 8
+
 ///////////////////////////////////////////////////////////////////////////////
 struct HttpError : public SocketError
 {
@@ -29,25 +31,97 @@ public:
    {}
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class SocketPool
+{
+   /***
+   Idle keep-alive connections, shared by copies of a socket object.
+   Most recently used connections are handed out first since they are the
+   least likely to have been timed out by the server.
+   ***/
+
+private:
+   Pile<SOCKET> idle_;
+   const unsigned maxIdle_;
+
+private:
+   SocketPool(const SocketPool&) = delete;
+   static bool isStale(SOCKET);
+
+public:
+   SocketPool(unsigned maxIdle) :
+      maxIdle_(maxIdle)
+   {}
+
+   ~SocketPool(void)
+   {
+      clear();
+   }
+
+   //returns SOCK_MAX if there is no usable idle connection
+   SOCKET get(void);
+   void put(SOCKET&);
+   void clear(void);
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class HttpSocket : public BinarySocket
 {
    friend class FcgiSocket;
 
    vector<string> headers_;
+   shared_ptr<SocketPool> pool_;
 
 private:
    struct packetData
    {
+      /***
+      Reply data is consumed as it comes in. Once the header is parsed, 
+      httpData only holds body bytes that were not handed out yet. 
+      ***/
+
       vector<uint8_t> httpData;
-      int content_length = -1;
+      size_t content_length = 0;
+      bool has_content_length = false;
       size_t header_len = 0;
+      bool keep_alive = true;
+
+      //replies without a length are streams, handed out packet by packet
+      //(see WireFrame)
+      bool streamed = false;
+
+      bool done = false;
+      bool delivered = false;
 
       void clear(void)
       {
          httpData.clear();
-         content_length = -1;
+         content_length = 0;
+         has_content_length = false;
          header_len = 0;
+         keep_alive = true;
+         streamed = false;
+         done = false;
+         delivered = false;
+      }
+
+      bool complete(void) const
+      {
+         return done;
+      }
+
+      bool has_transfer_encoding(const string& header_str) const
+      {
+         return header_str.find("Transfer-Encoding: ") != string::npos ||
+            header_str.find("transfer-encoding: ") != string::npos;
+      }
+
+      void get_connection(const string& header_str)
+      {
+         //http/1.1 connections persist unless the server says otherwise
+         if (header_str.find("Connection: close") != string::npos ||
+            header_str.find("connection: close") != string::npos)
+            keep_alive = false;
       }
 
       void get_content_len(const string& header_str)
@@ -60,8 +134,9 @@ private:
          auto tokpos = header_str.find(search_tok_caps);
          if (tokpos != string::npos)
          {
-            content_length = atoi(header_str.c_str() +
-               tokpos + search_tok_caps.size());
+            content_length = strtoul(header_str.c_str() +
+               tokpos + search_tok_caps.size(), nullptr, 10);
+            has_content_length = true;
             return;
          }
 
@@ -69,25 +144,32 @@ private:
          tokpos = header_str.find(search_tok);
          if (tokpos != string::npos)
          {
-            content_length = atoi(header_str.c_str() +
-               tokpos + search_tok.size());
+            content_length = strtoul(header_str.c_str() +
+               tokpos + search_tok.size(), nullptr, 10);
+            has_content_length = true;
             return;
          }
       }
    };
 
 private:
-   int32_t makePacket(char** packet, const char* msg);
-   string getBody(vector<uint8_t>);
+   int32_t makePacket(char** packet, const char* msg, size_t msglen);
    void setupHeaders(void);
 
+   //returns true once the reply is complete
+   static bool processHttpData(packetData&, 
+      const uint8_t*, size_t, const function<void(string&&)>&);
+
 public:
    HttpSocket(const BinarySocket&);
 
    void resetHeaders(void);
    void addHeader(string);
+   void closeIdleConnections(void) { pool_->clear(); }
 
    virtual string writeAndRead(const string&, SOCKET sockfd = SOCK_MAX);
+   virtual void writeAndReadStream(const string&,
+      const function<void(string&&)>&, SOCKET sockfd = SOCK_MAX);
    virtual SocketType type(void) const { return SocketHttp; }
 };
 
@@ -100,7 +182,7 @@ private:
    struct packetStruct
    {
       vector<uint8_t> fcgidata;
-      vector<uint8_t> httpData;
+      packetData httpData;
 
       int endpacket = 0;
       size_t ptroffset = 0;
@@ -118,7 +200,8 @@ private:
 
 public:
    FcgiSocket(const HttpSocket&);
-   string writeAndRead(const string&, SOCKET sfd = SOCK_MAX);
+   void writeAndReadStream(const string&,
+      const function<void(string&&)>&, SOCKET sfd = SOCK_MAX);
    SocketType type(void) const { return SocketFcgi; }
 };
 
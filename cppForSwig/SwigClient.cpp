@@ -10,6 +10,22 @@
 
 using namespace SwigClient;
 
+///////////////////////////////////////////////////////////////////////////////
+static vector<UTXO> readUtxoBatch(Arguments& arg, unsigned count)
+{
+   vector<UTXO> utxovec;
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto&& bdo = arg.get<BinaryDataObject>();
+      UTXO utxo;
+      utxo.unserialize(bdo.get());
+
+      utxovec.push_back(move(utxo));
+   }
+
+   return utxovec;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // BlockDataViewer
@@ -49,12 +65,40 @@ void BlockDataViewer::registerWithDB(BinaryData magic_word)
       cmd.method_ = "registerBDV";
       BinaryDataObject bdo(move(magic_word));
       cmd.args_.push_back(move(bdo));
-      cmd.serialize();
+
+      //offer binary packets first. Servers that predate them fail to parse
+      //the command and answer in hex, fall back to hex in that case
+      cmd.serialize(WireEncoding_Binary);
 
       auto&& result = sock_->writeAndRead(cmd.command_);
       Arguments args(move(result));
+
+      if (args.getEncoding() == WireEncoding_Binary)
+      {
+         sock_->setWireEncoding(WireEncoding_Binary);
+      }
+      else
+      {
+         cmd.serialize(WireEncoding_Hex);
+         auto&& hexResult = sock_->writeAndRead(cmd.command_);
+         args = move(Arguments(move(hexResult)));
+      }
+
       auto&& bdoID = args.get<BinaryDataObject>();
       bdvID_ = bdoID.toStr();
+
+      if (args.hasArgs())
+         notifyPort_ = args.get<IntType>().getVal();
+
+      //the notification port is only reachable on direct connections to 
+      //the DB, http clients sit behind a proxy
+      if (notifyPort_ != 0 && sock_->type() == SocketFcgi)
+      {
+         stringstream portss;
+         portss << notifyPort_;
+         channel_ = RequestChannel::connect(
+            sock_->getAddr(), portss.str(), bdvID_);
+      }
    }
    catch (runtime_error &e)
    {
@@ -69,8 +113,11 @@ void BlockDataViewer::unregisterFromDB()
    Command cmd;
    cmd.method_ = "unregisterBDV";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
+
+   if (channel_ != nullptr)
+      channel_->shutdown();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -79,7 +126,7 @@ void BlockDataViewer::goOnline()
    Command cmd;
    cmd.method_ = "goOnline";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
 
@@ -116,7 +163,7 @@ void BlockDataViewer::shutdown(const string& cookie)
       cmd.args_.push_back(move(bdo));
    }
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
 
@@ -132,7 +179,7 @@ void BlockDataViewer::shutdownNode(const string& cookie)
       cmd.args_.push_back(move(bdo));
    }
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    sock_->writeAndRead(cmd.command_);
 }
 
@@ -149,7 +196,7 @@ SwigClient::BtcWallet BlockDataViewer::registerWallet(
 
    cmd.method_ = "registerWallet";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    //check result
@@ -174,7 +221,7 @@ Lockbox BlockDataViewer::registerLockbox(
 
    cmd.method_ = "registerLockbox";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    //check result
@@ -193,7 +240,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForWallets()
 
    cmd.method_ = "getLedgerDelegateForWallets";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -211,7 +258,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForLockboxes()
 
    cmd.method_ = "getLedgerDelegateForLockboxes";
    cmd.ids_.push_back(bdvID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -241,7 +288,7 @@ void BlockDataViewer::broadcastZC(const BinaryData& rawTx)
    cmd.method_ = "broadcastZC";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(rawTx));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    sock_->writeAndRead(cmd.command_);
 }
@@ -271,7 +318,7 @@ Tx BlockDataViewer::getTxByHash(const BinaryData& txHash)
    cmd.method_ = "getTxByHash";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(bdRef));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -310,7 +357,7 @@ BinaryData BlockDataViewer::getRawHeaderForTxHash(const BinaryData& txHash)
    cmd.method_ = "getRawHeaderForTxHash";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(BinaryDataObject(bdRef));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -334,7 +381,7 @@ LedgerDelegate BlockDataViewer::getLedgerDelegateForScrAddr(
    BinaryDataObject bdo(scrAddr);
    cmd.args_.push_back(move(bdo));
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -359,7 +406,7 @@ void BlockDataViewer::updateWalletsLedgerFilter(
       bdVec.push_back(move(bd));
 
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
@@ -372,7 +419,7 @@ NodeStatusStruct BlockDataViewer::getNodeStatus()
    cmd.method_ = "getNodeStatus";
    cmd.ids_.push_back(bdvID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
    auto&& result = sock_->writeAndRead(cmd.command_);
 
    Arguments retval(result);
@@ -398,7 +445,7 @@ FeeEstimateStruct BlockDataViewer::estimateFee(
 
    cmd.args_.push_back(move(inttype));
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -424,9 +471,25 @@ FeeEstimateStruct BlockDataViewer::estimateFee(
 ///////////////////////////////////////////////////////////////////////////////
 vector<LedgerEntryData> BlockDataViewer::getHistoryForWalletSelection(
    const vector<string>& wldIDs, const string& orderingStr)
+{
+   vector<LedgerEntryData> leVec;
+   auto appendPage = [&leVec](vector<LedgerEntryData>&& page)->void
+   {
+      leVec.insert(leVec.end(), 
+         make_move_iterator(page.begin()), make_move_iterator(page.end()));
+   };
+
+   getHistoryForWalletSelection(wldIDs, orderingStr, appendPage);
+   return leVec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BlockDataViewer::getHistoryForWalletSelection(
+   const vector<string>& wldIDs, const string& orderingStr,
+   const function<void(vector<LedgerEntryData>&&)>& callback)
 {
    Command cmd;
-   cmd.method_ = "getHistoryForWalletSelection";
+   cmd.method_ = "streamHistoryForWalletSelection";
    cmd.ids_.push_back(bdvID_);
 
    BinaryDataVector bdVec;
@@ -440,13 +503,19 @@ vector<LedgerEntryData> BlockDataViewer::getHistoryForWalletSelection(
 
    cmd.args_.push_back(move(bdVec));
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
 
-   auto&& result = sock_->writeAndRead(cmd.command_);
-   Arguments args(result);
+   //one LedgerEntryVector per history page
+   auto processBatch = [&callback](Arguments& args, unsigned count)->void
+   {
+      for (unsigned i = 0; i < count; i++)
+      {
+         auto&& lev = args.get<LedgerEntryVector>();
+         auto page = lev.toVector();
+         callback(move(page));
+      }
+   };
 
-   auto&& lev = args.get<LedgerEntryVector>();
-   return lev.toVector();
+   streamCommand(sock_, cmd, processBatch);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -462,7 +531,7 @@ uint64_t BlockDataViewer::getValueForTxOut(
 
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(it_inputid));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -481,7 +550,7 @@ string BlockDataViewer::broadcastThroughRPC(const BinaryData& rawTx)
    BinaryDataObject bdo(rawTx);
 
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments args(result);
@@ -510,7 +579,7 @@ void BlockDataViewer::registerAddrList(
 
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 }
@@ -518,10 +587,25 @@ void BlockDataViewer::registerAddrList(
 ///////////////////////////////////////////////////////////////////////////////
 vector<UTXO> BlockDataViewer::getUtxosForAddrVec(
    const vector<BinaryData>& addrVec)
+{
+   vector<UTXO> utxovec;
+   auto appendBatch = [&utxovec](vector<UTXO>&& batch)->void
+   {
+      utxovec.insert(utxovec.end(),
+         make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+   };
+
+   getUtxosForAddrVec(addrVec, appendBatch);
+   return utxovec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void BlockDataViewer::getUtxosForAddrVec(const vector<BinaryData>& addrVec,
+   const function<void(vector<UTXO>&&)>& callback)
 {
    Command cmd;
 
-   cmd.method_ = "getUTXOsForAddrList";
+   cmd.method_ = "streamUTXOsForAddrList";
    cmd.ids_.push_back(bdvID_);
 
    BinaryDataVector bdVec;
@@ -529,23 +613,89 @@ vector<UTXO> BlockDataViewer::getUtxosForAddrVec(
       bdVec.push_back(move(addr));
 
    cmd.args_.push_back(move(bdVec));
-   cmd.serialize();
+
+   auto processBatch = [&callback](Arguments& arg, unsigned count)->void
+   {
+      callback(readUtxoBatch(arg, count));
+   };
+
+   streamCommand(sock_, cmd, processBatch);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+vector<WalletState> BlockDataViewer::getCombinedWalletState(
+   const vector<string>& walletIDs, uint32_t height,
+   bool withAddrData, bool withUtxos)
+{
+   Command cmd;
+
+   cmd.method_ = "getCombinedWalletState";
+   cmd.ids_.push_back(bdvID_);
+
+   BinaryDataVector bdVec;
+   for (auto& id : walletIDs)
+      bdVec.push_back(BinaryData((uint8_t*)id.c_str(), id.size()));
+
+   cmd.args_.push_back(move(bdVec));
+   cmd.args_.push_back(move(IntType(height)));
+   cmd.args_.push_back(move(IntType(withAddrData)));
+   cmd.args_.push_back(move(IntType(withUtxos)));
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(result));
    auto count = arg.get<IntType>().getVal();
 
-   vector<UTXO> utxovec;
+   vector<WalletState> stateVec;
    for (unsigned i = 0; i < count; i++)
    {
-      auto&& bdo = arg.get<BinaryDataObject>();
-      UTXO utxo;
-      utxo.unserialize(bdo.get());
+      WalletState state;
 
-      utxovec.push_back(move(utxo));
+      auto&& idBdo = arg.get<BinaryDataObject>();
+      state.id_ = string(idBdo.get().getCharPtr(), idBdo.get().getSize());
+      state.fullBalance_ = arg.get<IntType>().getVal();
+      state.spendableBalance_ = arg.get<IntType>().getVal();
+      state.unconfirmedBalance_ = arg.get<IntType>().getVal();
+      state.txnCount_ = arg.get<IntType>().getVal();
+
+      if (withAddrData)
+      {
+         auto countSize = arg.get<IntType>().getVal();
+         for (unsigned y = 0; y < countSize; y++)
+         {
+            auto&& addr = arg.get<BinaryDataObject>();
+            state.addrTxnCounts_[addr.get()] = arg.get<IntType>().getVal();
+         }
+
+         auto balanceSize = arg.get<IntType>().getVal();
+         for (unsigned y = 0; y < balanceSize; y++)
+         {
+            auto&& addr = arg.get<BinaryDataObject>();
+            auto& balanceVec = state.addrBalances_[addr.get()];
+
+            balanceVec.push_back(arg.get<IntType>().getVal());
+            balanceVec.push_back(arg.get<IntType>().getVal());
+            balanceVec.push_back(arg.get<IntType>().getVal());
+         }
+      }
+
+      if (withUtxos)
+      {
+         auto utxoCount = arg.get<IntType>().getVal();
+         for (unsigned y = 0; y < utxoCount; y++)
+         {
+            auto&& bdo = arg.get<BinaryDataObject>();
+            UTXO utxo;
+            utxo.unserialize(bdo.get());
+
+            state.utxos_.push_back(move(utxo));
+         }
+      }
+
+      stateVec.push_back(move(state));
    }
 
-   return utxovec;
+   return stateVec;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -568,7 +718,7 @@ vector<LedgerEntryData> LedgerDelegate::getHistoryPage(uint32_t id)
 
    cmd.args_.push_back(move(IntType(id)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -584,12 +734,20 @@ vector<LedgerEntryData> LedgerDelegate::getHistoryPage(uint32_t id)
 //
 ///////////////////////////////////////////////////////////////////////////////
 SwigClient::BtcWallet::BtcWallet(const BlockDataViewer& bdv, const string& id) :
-   sock_(bdv.sock_), walletID_(id), bdvID_(bdv.bdvID_)
+   sock_(bdv.sock_), walletID_(id), bdvID_(bdv.bdvID_), 
+   channel_(bdv.channel_)
 {}
 
 ///////////////////////////////////////////////////////////////////////////////
 vector<uint64_t> SwigClient::BtcWallet::getBalancesAndCount(
    uint32_t blockheight, bool IGNOREZC)
+{
+   return getBalancesAndCountAsync(blockheight, IGNOREZC).get();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+future<vector<uint64_t>> SwigClient::BtcWallet::getBalancesAndCountAsync(
+   uint32_t blockheight, bool IGNOREZC)
 {
    Command cmd;
    cmd.method_ = "getBalancesAndCount";
@@ -599,52 +757,59 @@ vector<uint64_t> SwigClient::BtcWallet::getBalancesAndCount(
    unsigned int ignorezc = IGNOREZC;
    cmd.args_.push_back(move(IntType(blockheight)));
 
-   cmd.serialize();
+   auto getBalances = [](future<string> reply)->vector<uint64_t>
+   {
+      Arguments arg(reply.get());
 
-   auto&& retval = sock_->writeAndRead(cmd.command_);
-   Arguments arg(retval);
-   
-   auto&& balance_full = arg.get<IntType>().getVal();
-   auto&& balance_spen = arg.get<IntType>().getVal();
-   auto&& balance_unco = arg.get<IntType>().getVal();
-   auto&& count = arg.get<IntType>().getVal();
+      auto&& balance_full = arg.get<IntType>().getVal();
+      auto&& balance_spen = arg.get<IntType>().getVal();
+      auto&& balance_unco = arg.get<IntType>().getVal();
+      auto&& count = arg.get<IntType>().getVal();
 
-   vector<uint64_t> balanceVec;
-   balanceVec.push_back(balance_full);
-   balanceVec.push_back(balance_spen);
-   balanceVec.push_back(balance_unco);
-   balanceVec.push_back(count);
+      vector<uint64_t> balanceVec;
+      balanceVec.push_back(balance_full);
+      balanceVec.push_back(balance_spen);
+      balanceVec.push_back(balance_unco);
+      balanceVec.push_back(count);
+
+      return balanceVec;
+   };
 
-   return balanceVec;
+   return async(launch::deferred, getBalances, 
+      pipelineCommand(channel_, sock_, cmd));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 vector<UTXO> SwigClient::BtcWallet::getSpendableTxOutListForValue(uint64_t val)
+{
+   vector<UTXO> utxovec;
+   auto appendBatch = [&utxovec](vector<UTXO>&& batch)->void
+   {
+      utxovec.insert(utxovec.end(),
+         make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+   };
+
+   getSpendableTxOutListForValue(val, appendBatch);
+   return utxovec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SwigClient::BtcWallet::getSpendableTxOutListForValue(uint64_t val,
+   const function<void(vector<UTXO>&&)>& callback)
 {
    Command cmd;
-   cmd.method_ = "getSpendableTxOutListForValue";
+   cmd.method_ = "streamSpendableTxOutListForValue";
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
    cmd.args_.push_back(move(IntType(val)));
 
-   cmd.serialize();
-
-   auto&& retval = sock_->writeAndRead(cmd.command_);
-   Arguments arg(move(retval));
-   auto count = arg.get<IntType>().getVal();
-
-   vector<UTXO> utxovec;
-   for (unsigned i = 0; i < count; i++)
+   auto processBatch = [&callback](Arguments& arg, unsigned count)->void
    {
-      auto&& bdo = arg.get<BinaryDataObject>();
-      UTXO utxo;
-      utxo.unserialize(bdo.get());
-
-      utxovec.push_back(move(utxo));
-   }
+      callback(readUtxoBatch(arg, count));
+   };
 
-   return utxovec;
+   streamCommand(sock_, cmd, processBatch);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -655,7 +820,7 @@ vector<UTXO> SwigClient::BtcWallet::getSpendableZCList()
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -681,7 +846,7 @@ vector<UTXO> SwigClient::BtcWallet::getRBFTxOutList()
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -706,7 +871,7 @@ map<BinaryData, uint32_t> SwigClient::BtcWallet::getAddrTxnCountsFromDB()
    cmd.method_ = "getAddrTxnCounts";
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -733,7 +898,7 @@ SwigClient::BtcWallet::getAddrBalancesFromDB(void)
    cmd.method_ = "getAddrBalances";
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -757,6 +922,13 @@ SwigClient::BtcWallet::getAddrBalancesFromDB(void)
 
 ///////////////////////////////////////////////////////////////////////////////
 vector<LedgerEntryData> SwigClient::BtcWallet::getHistoryPage(uint32_t id)
+{
+   return getHistoryPageAsync(id).get();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+future<vector<LedgerEntryData>> SwigClient::BtcWallet::getHistoryPageAsync(
+   uint32_t id)
 {
    Command cmd;
    cmd.method_ = "getHistoryPage";
@@ -765,14 +937,17 @@ vector<LedgerEntryData> SwigClient::BtcWallet::getHistoryPage(uint32_t id)
 
    cmd.args_.push_back(move(IntType(id)));
 
-   cmd.serialize();
+   auto getPage = [](future<string> reply)->vector<LedgerEntryData>
+   {
+      Arguments arg(reply.get());
+      auto&& lev = arg.get<LedgerEntryVector>();
 
-   auto&& retval = sock_->writeAndRead(cmd.command_);
-   Arguments arg(retval);
-   auto&& lev = arg.get<LedgerEntryVector>();
+      auto& levData = lev.toVector();
+      return levData;
+   };
 
-   auto& levData = lev.toVector();
-   return levData;
+   return async(launch::deferred, getPage,
+      pipelineCommand(channel_, sock_, cmd));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -788,7 +963,7 @@ LedgerEntryData SwigClient::BtcWallet::getLedgerEntryForTxHash(
    //the ledger entry for the tx instead of a page
    cmd.args_.push_back(move(BinaryDataObject(txhash)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -814,7 +989,7 @@ vector<AddressBookEntry> SwigClient::BtcWallet::createAddressBook(void) const
    cmd.ids_.push_back(bdvID_);
    cmd.ids_.push_back(walletID_);
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -891,7 +1066,7 @@ vector<UTXO> ScrAddrObj::getSpendableTxOutList(bool ignoreZC)
    cmd.args_.push_back(move(bdo));
    cmd.args_.push_back(move(IntType(ignoreZC)));
 
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(move(retval));
@@ -929,7 +1104,7 @@ bool Blockchain::hasHeaderWithHash(const BinaryData& hash)
 
    BinaryDataObject bdo(hash);
    cmd.args_.push_back(move(bdo));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& retval = sock_->writeAndRead(cmd.command_);
    Arguments arg(retval);
@@ -946,7 +1121,7 @@ BlockHeader Blockchain::getHeaderByHeight(unsigned height)
    cmd.method_ = "getHeaderByHeight";
    cmd.ids_.push_back(bdvID_);
    cmd.args_.push_back(move(IntType(height)));
-   cmd.serialize();
+   cmd.serialize(sock_->getWireEncoding());
 
    auto&& result = sock_->writeAndRead(cmd.command_);
 
@@ -981,13 +1156,301 @@ void BlockHeader::unserialize(uint8_t const * ptr, uint32_t size)
    blockHeight_ = UINT32_MAX;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//
+// RequestChannel
+//
+///////////////////////////////////////////////////////////////////////////////
+shared_ptr<RequestChannel> RequestChannel::connect(
+   const string& addr, const string& port, const string& bdvID)
+{
+   SOCKET sockfd = SOCK_MAX;
+   try
+   {
+      BinarySocket sock(addr, port);
+      sockfd = sock.openSocket(true);
+   }
+   catch (runtime_error&)
+   {}
+
+   if (sockfd == SOCK_MAX)
+      return nullptr;
+
+   shared_ptr<RequestChannel> channel(new RequestChannel(sockfd));
+
+   //subscribe
+   BinaryWriter bw;
+   bw.put_var_int(bdvID.size());
+   bw.put_BinaryData((uint8_t*)bdvID.c_str(), bdvID.size());
+   auto subRef = bw.getDataRef();
+   if (!channel->writeAll(subRef.getPtr(), subRef.getSize()))
+      return nullptr;
+
+   auto readLbd = [](RequestChannel* ptr)->void
+   {
+      ptr->readLoop();
+   };
+
+   channel->readThr_ = thread(readLbd, channel.get());
+   return channel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+RequestChannel::~RequestChannel()
+{
+   shutdown();
+   BinarySocket::closeSocket(sockfd_);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RequestChannel::shutdown()
+{
+   //wakes up the read loop
+   if (sockfd_ != SOCK_MAX)
+      ::shutdown(sockfd_, 2);
+
+   if (readThr_.joinable())
+      readThr_.join();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+bool RequestChannel::writeAll(const uint8_t* data, size_t len)
+{
+   unique_lock<mutex> lock(writeMu_);
+
+   size_t total = 0;
+   while (total < len)
+   {
+      auto sent = ::send(sockfd_, (char*)data + total, len - total, 
+         MSG_NOSIGNAL);
+      if (sent <= 0)
+         return false;
+
+      total += sent;
+   }
+
+   return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+future<string> RequestChannel::send(Command& cmd)
+{
+   cmd.serialize(WireEncoding_Binary);
+
+   auto replyPromise = make_shared<promise<string>>();
+   auto replyFuture = replyPromise->get_future();
+
+   uint32_t id;
+   {
+      unique_lock<mutex> lock(replyMu_);
+      if (!alive_)
+         throw SocketError("request channel is down");
+
+      //0 is reserved for notifications
+      id = ++counter_;
+      if (id == 0)
+         id = ++counter_;
+
+      replies_.insert(make_pair(id, replyPromise));
+   }
+
+   BinaryWriter bw(cmd.command_.size() + 8);
+   bw.put_uint32_t(cmd.command_.size() + 4);
+   bw.put_uint32_t(id);
+   bw.put_BinaryData((uint8_t*)cmd.command_.c_str(), cmd.command_.size());
+   auto frame = bw.getDataRef();
+
+   if (!writeAll(frame.getPtr(), frame.getSize()))
+   {
+      unique_lock<mutex> lock(replyMu_);
+      replies_.erase(id);
+      throw SocketError("failed to write to request channel");
+   }
+
+   return replyFuture;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+string RequestChannel::popNotification(chrono::milliseconds timeout)
+{
+   return notifications_.pop_front(timeout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void RequestChannel::readLoop()
+{
+   string buffer;
+   vector<char> readBuf(8192);
+   bool valid = true;
+
+   while (valid)
+   {
+      auto readAmt = recv(sockfd_, &readBuf[0], readBuf.size(), 0);
+      if (readAmt <= 0)
+         break;
+
+      buffer.append(&readBuf[0], readAmt);
+
+      size_t offset = 0;
+      while (buffer.size() - offset >= 8)
+      {
+         BinaryRefReader brr((uint8_t*)buffer.c_str() + offset, 8);
+         auto len = brr.get_uint32_t();
+         auto id = brr.get_uint32_t();
+
+         if (len < 4)
+         {
+            LOGWARN << "malformed frame on request channel";
+            valid = false;
+            break;
+         }
+
+         if (buffer.size() - offset - 4 < len)
+            break;
+
+         auto&& packet = buffer.substr(offset + 8, len - 4);
+         offset += len + 4;
+
+         if (id == 0)
+         {
+            notifications_.push_back(move(packet));
+            continue;
+         }
+
+         shared_ptr<promise<string>> replyPromise;
+         {
+            unique_lock<mutex> lock(replyMu_);
+            auto iter = replies_.find(id);
+            if (iter == replies_.end())
+               continue;
+
+            replyPromise = iter->second;
+            replies_.erase(iter);
+         }
+
+         replyPromise->set_value(move(packet));
+      }
+
+      buffer.erase(0, offset);
+   }
+
+   //link is gone, fail whatever is still in flight
+   map<uint32_t, shared_ptr<promise<string>>> replies;
+   {
+      unique_lock<mutex> lock(replyMu_);
+      alive_ = false;
+      replies.swap(replies_);
+   }
+
+   for (auto& replyPair : replies)
+   {
+      replyPair.second->set_exception(make_exception_ptr(
+         SocketError("request channel dropped")));
+   }
+
+   notifications_.push_back(string());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+future<string> SwigClient::pipelineCommand(
+   const shared_ptr<RequestChannel>& channel, 
+   const shared_ptr<BinarySocket>& sock, Command& cmd)
+{
+   future<string> channelReply;
+   if (channel != nullptr)
+   {
+      try
+      {
+         channelReply = channel->send(cmd);
+      }
+      catch (SocketError&)
+      {}
+   }
+
+   cmd.serialize(sock->getWireEncoding());
+   auto cmdStr = cmd.command_;
+
+   //round trip on the regular socket if the channel is not there or drops
+   //before replying
+   auto getReply = [sock, cmdStr](future<string> reply)->string
+   {
+      if (reply.valid())
+      {
+         try
+         {
+            return reply.get();
+         }
+         catch (SocketError&)
+         {}
+      }
+
+      return sock->writeAndRead(cmdStr);
+   };
+
+   return async(launch::deferred, getReply, move(channelReply));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+void SwigClient::streamCommand(const shared_ptr<BinarySocket>& sock, 
+   Command& cmd, const function<void(Arguments&, unsigned)>& callback)
+{
+   /***
+   Stream replies are a sequence of batches ending with an empty one, see
+   ResponseStream in BDM_Server.h. Sockets that put the reply back together
+   hand out several batches at once.
+
+   Errors are held until the reply is over, so that the socket is left 
+   clean.
+   ***/
+
+   cmd.serialize(sock->getWireEncoding());
+
+   exception_ptr eptr = nullptr;
+   bool done = false;
+
+   auto processChunk = [&](string&& chunk)->void
+   {
+      if (done || eptr != nullptr)
+         return;
+
+      try
+      {
+         Arguments arg(move(chunk));
+         while (arg.hasArgs())
+         {
+            auto count = arg.get<IntType>().getVal();
+            if (count == 0)
+            {
+               done = true;
+               return;
+            }
+
+            callback(arg, count);
+         }
+      }
+      catch (...)
+      {
+         eptr = current_exception();
+      }
+   };
+
+   sock->writeAndReadStream(cmd.command_, processChunk);
+
+   if (eptr != nullptr)
+      rethrow_exception(eptr);
+
+   if (!done)
+      throw runtime_error("stream reply ended early");
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // PythonCallback
 //
 ///////////////////////////////////////////////////////////////////////////////
 PythonCallback::PythonCallback(const BlockDataViewer& bdv) :
-   sock_(bdv.sock_), bdvID_(bdv.getID()), bdvPtr_(&bdv)
+   sock_(bdv.sock_), bdvID_(bdv.getID()), channel_(bdv.channel_),
+   bdvPtr_(&bdv)
 {
    orderMap_["continue"]         = CBO_continue;
    orderMap_["NewBlock"]         = CBO_NewBlock;
@@ -1026,6 +1489,44 @@ void PythonCallback::shutdown()
       thr_.join();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+bool PythonCallback::pushLoop(
+   const function<bool(Arguments)>& processCallback)
+{
+   if (channel_ == nullptr)
+      return false;
+
+   while (run_)
+   {
+      string packet;
+      try
+      {
+         packet = channel_->popNotification(chrono::milliseconds(1000));
+      }
+      catch (StackTimedOutException&)
+      {
+         continue;
+      }
+
+      //poll from here on if the channel dropped under us
+      if (packet.size() == 0)
+         return false;
+
+      try
+      {
+         Arguments args(move(packet));
+         if (!processCallback(move(args)))
+            return true;
+      }
+      catch (runtime_error&)
+      {
+         continue;
+      }
+   }
+
+   return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 void PythonCallback::remoteLoop(void)
 {
@@ -1034,7 +1535,7 @@ void PythonCallback::remoteLoop(void)
    sendCmd.ids_.push_back(bdvID_);
    BinaryDataObject bdo("waitOnBDV");
    sendCmd.args_.push_back(move(bdo));
-   sendCmd.serialize();
+   sendCmd.serialize(sock_->getWireEncoding());
 
    bool isReady = false;
 
@@ -1104,7 +1605,7 @@ void PythonCallback::remoteLoop(void)
                sendCmd.args_.clear();
                BinaryDataObject status("getStatus");
                sendCmd.args_.push_back(move(status));
-               sendCmd.serialize();
+               sendCmd.serialize(sock_->getWireEncoding());
 
                unsigned int topblock = args.get<IntType>().getVal();
                bdvPtr_->setTopBlock(topblock);
@@ -1157,6 +1658,9 @@ void PythonCallback::remoteLoop(void)
       return true;
    };
 
+   if (pushLoop(processCallback))
+      return;
+
    while (run_)
    {
       try
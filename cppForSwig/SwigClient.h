@@ -34,9 +34,70 @@ namespace SwigClient
    inline void DisableCppLogStdOut() { LOGDISABLESTDOUT(); }
 
 #include <thread>
+#include <future>
 
    class BlockDataViewer;
 
+   ///////////////////////////////////////////////////////////////////////////////
+   class RequestChannel
+   {
+      /***
+      Persistent connection to the DB's NotificationServer, bound to a BDV.
+
+      Commands sent through it are tagged with a request id, any number of 
+      them can be in flight. Replies come back in completion order and are
+      matched to their future on that id. Frames tagged 0 are the BDV's 
+      notifications, they are queued for PythonCallback.
+      ***/
+
+   private:
+      SOCKET sockfd_ = SOCK_MAX;
+      thread readThr_;
+
+      mutex writeMu_;
+      mutex replyMu_;
+      map<uint32_t, shared_ptr<promise<string>>> replies_;
+      uint32_t counter_ = 0;
+      bool alive_ = true;
+
+      //an empty packet signals the link is gone
+      TimedStack<string> notifications_;
+
+   private:
+      RequestChannel(SOCKET sockfd) :
+         sockfd_(sockfd)
+      {}
+
+      bool writeAll(const uint8_t*, size_t);
+      void readLoop(void);
+
+   public:
+      ~RequestChannel(void);
+
+      //returns nullptr if the channel can't be opened
+      static shared_ptr<RequestChannel> connect(
+         const string& addr, const string& port, const string& bdvID);
+
+      //throws SocketError if the channel is down. The future throws 
+      //SocketError if the channel drops before the reply comes in
+      future<string> send(Command&);
+
+      //throws StackTimedOutException if nothing comes in before timeout
+      string popNotification(chrono::milliseconds timeout);
+
+      void shutdown(void);
+   };
+
+   //sends the command through the channel if there is one. The future falls
+   //back to a round trip on the socket otherwise
+   future<string> pipelineCommand(const shared_ptr<RequestChannel>&,
+      const shared_ptr<BinarySocket>&, Command&);
+
+   //runs a stream method, the callback gets each batch of the reply as it 
+   //comes in, along with its entry count
+   void streamCommand(const shared_ptr<BinarySocket>&, Command&,
+      const function<void(Arguments&, unsigned)>&);
+
    ///////////////////////////////////////////////////////////////////////////////
    struct NoArmoryDBExcept : public runtime_error
    {
@@ -62,6 +123,28 @@ namespace SwigClient
       {}
    };
 
+   ///////////////////////////////////////////////////////////////////////////////
+   struct WalletState
+   {
+      string id_;
+      uint64_t fullBalance_ = 0;
+      uint64_t spendableBalance_ = 0;
+      uint64_t unconfirmedBalance_ = 0;
+      uint64_t txnCount_ = 0;
+
+      //only filled if requested, same semantics as getAddrTxnCountsFromDB
+      //and getAddrBalancesFromDB
+      map<BinaryData, uint32_t> addrTxnCounts_;
+      map<BinaryData, vector<uint64_t>> addrBalances_;
+      vector<UTXO> utxos_;
+
+      //map getters for the SWIG typemaps
+      const map<BinaryData, uint32_t>& getAddrTxnCounts(void) const
+      { return addrTxnCounts_; }
+      const map<BinaryData, vector<uint64_t>>& getAddrBalances(void) const
+      { return addrBalances_; }
+   };
+
    ///////////////////////////////////////////////////////////////////////////////
    class LedgerDelegate
    {
@@ -137,6 +220,7 @@ namespace SwigClient
       const string walletID_;
       const string bdvID_;
       const shared_ptr<BinarySocket> sock_;
+      const shared_ptr<RequestChannel> channel_;
 
    public:
       BtcWallet(const BlockDataViewer&, const string&);
@@ -144,6 +228,8 @@ namespace SwigClient
          uint32_t topBlockHeight, bool IGNOREZC);
 
       vector<UTXO> getSpendableTxOutListForValue(uint64_t val);
+      void getSpendableTxOutListForValue(uint64_t val,
+         const function<void(vector<UTXO>&&)>&);
       vector<UTXO> getSpendableZCList();
       vector<UTXO> getRBFTxOutList();
 
@@ -154,6 +240,13 @@ namespace SwigClient
       LedgerEntryData getLedgerEntryForTxHash(
          const BinaryData& txhash);
 
+      //pipelined versions, the request is sent right away and the future
+      //blocks on the reply. Without a RequestChannel the round trip happens
+      //when the future is read
+      future<vector<uint64_t>> getBalancesAndCountAsync(
+         uint32_t topBlockHeight, bool IGNOREZC);
+      future<vector<LedgerEntryData>> getHistoryPageAsync(uint32_t id);
+
       ScrAddrObj getScrAddrObjByKey(const BinaryData&,
          uint64_t, uint64_t, uint64_t, uint32_t);
 
@@ -287,11 +380,17 @@ namespace SwigClient
 
       const shared_ptr<BinarySocket> sock_;
       const string bdvID_;
-      SOCKET sockfd_;
+      const shared_ptr<RequestChannel> channel_;
+      SOCKET sockfd_ = SOCK_MAX;
 
       map<string, CallbackOrder> orderMap_;
       const BlockDataViewer* bdvPtr_;
 
+   private:
+      //returns false if the server can't push notifications, in which case
+      //the caller falls back to long polls
+      bool pushLoop(const function<bool(Arguments)>&);
+
    public:
       PythonCallback(const BlockDataViewer& bdv);
       virtual ~PythonCallback(void) = 0;
@@ -324,6 +423,10 @@ namespace SwigClient
       string bdvID_;
       shared_ptr<BinarySocket> sock_;
 
+      //notification push port advertised by the server, 0 if none
+      unsigned notifyPort_ = 0;
+      shared_ptr<RequestChannel> channel_;
+
       //save all tx we fetch by hash to reduce resource cost on redundant fetches
       shared_ptr<map<BinaryData, Tx> > txMap_;
       shared_ptr<map<BinaryData, BinaryData> > rawHeaderMap_;
@@ -339,6 +442,8 @@ namespace SwigClient
       {
          bdvID_ = rhs.bdvID_;
          sock_ = rhs.sock_;
+         notifyPort_ = rhs.notifyPort_;
+         channel_ = rhs.channel_;
          txMap_ = rhs.txMap_;
 
          return *this;
@@ -386,11 +491,19 @@ namespace SwigClient
 
       vector<LedgerEntryData> getHistoryForWalletSelection(
          const vector<string>& wldIDs, const string& orderingStr);
+      void getHistoryForWalletSelection(
+         const vector<string>& wldIDs, const string& orderingStr,
+         const function<void(vector<LedgerEntryData>&&)>&);
 
       uint64_t getValueForTxOut(const BinaryData& txHash, unsigned inputId);
       string broadcastThroughRPC(const BinaryData& rawTx);
 
       vector<UTXO> getUtxosForAddrVec(const vector<BinaryData>&);
+      void getUtxosForAddrVec(const vector<BinaryData>&,
+         const function<void(vector<UTXO>&&)>&);
+      vector<WalletState> getCombinedWalletState(
+         const vector<string>& walletIDs, uint32_t height,
+         bool withAddrData, bool withUtxos);
 
       void registerAddrList(const BinaryData&, const vector<BinaryData>&);
    };
@@ -14,9 +14,13 @@
 #include <future>
 #include <vector>
 #include <map>
+#include <type_traits>
 #include <set>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include <exception>
 #include <iostream>
 
@@ -395,20 +399,54 @@ public:
 };
 
 ////////////////////////////////////////////////////////////////////////////////
-template<typename T, typename U> class TransactionalMap
+struct TransactionalMapNoIndex
+{
+   template<typename M> TransactionalMapNoIndex(const M&)
+   {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+template<typename T, typename U, typename I = TransactionalMapNoIndex> 
+class TransactionalMap
 {
    //locked writes, lockless reads
+
+   /***
+   I is an optional read only index over the map, constructed from the map 
+   snapshot on every write. It is swapped under the same lock as the map, 
+   so get_with_index always returns a consistent pair.
+   ***/
+
 private:
    mutable mutex mu_;
    shared_ptr<map<T, U>> map_;
+   shared_ptr<const I> index_;
    atomic<size_t> count_;
 
+private:
+   static shared_ptr<const I> buildIndex(const map<T, U>&, true_type)
+   {
+      return nullptr;
+   }
+
+   static shared_ptr<const I> buildIndex(const map<T, U>& theMap, false_type)
+   {
+      return make_shared<I>(theMap);
+   }
+
+   void setMap(shared_ptr<map<T, U>> newMap)
+   {
+      //has to be called under lock
+      index_ = buildIndex(*newMap, is_same<I, TransactionalMapNoIndex>());
+      map_ = newMap;
+      count_.store(map_->size(), memory_order_relaxed);
+   }
+
 public:
 
    TransactionalMap(void)
    {
-      count_.store(0, memory_order_relaxed);
-      map_ = make_shared<map<T, U>>();
+      setMap(make_shared<map<T, U>>());
    }
 
    void insert(pair<T, U>&& mv)
@@ -419,8 +457,7 @@ public:
       *newMap = *map_;
 
       newMap->insert(move(mv));
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
    }
 
    void insert(const pair<T, U>& obj)
@@ -431,8 +468,7 @@ public:
       *newMap = *map_;
 
       newMap->insert(obj);
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
    }
 
    void update(map<T, U> updatemap)
@@ -445,8 +481,7 @@ public:
       unique_lock<mutex> lock(mu_);
       newMap->insert(map_->begin(), map_->end());
 
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
    }
 
    void erase(const T& id)
@@ -461,8 +496,7 @@ public:
       *newMap = *map_;
 
       newMap->erase(id);
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
    }
 
    void erase(const vector<T>& idVec)
@@ -483,9 +517,7 @@ public:
       }
 
       if (erased)
-         map_ = newMap;
-
-      count_.store(map_->size(), memory_order_relaxed);
+         setMap(newMap);
    }
 
    shared_ptr<map<T, U>> pop_all(void)
@@ -494,8 +526,7 @@ public:
       unique_lock<mutex> lock(mu_);
       
       auto retMap = map_;
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
 
       return retMap;
    }
@@ -506,13 +537,18 @@ public:
       return map_;
    }
 
+   pair<shared_ptr<map<T, U>>, shared_ptr<const I>> get_with_index(void) const
+   {
+      unique_lock<mutex> lock(mu_);
+      return make_pair(map_, index_);
+   }
+
    void clear(void)
    {
       auto newMap = make_shared<map<T, U>>();
       unique_lock<mutex> lock(mu_);
 
-      map_ = newMap;
-      count_.store(map_->size(), memory_order_relaxed);
+      setMap(newMap);
    }
 
    size_t size(void) const
@@ -971,6 +1007,132 @@ public:
    }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class WorkerPool
+{
+   /***
+   Persistent threads for data parallel loops. run() hands a task over 
+   count items to the pool and returns once all of them are done. The 
+   calling thread takes items as well, a pool of 0 threads runs them 
+   serially on the caller. Concurrent run() calls are served one after the
+   other.
+
+   Items are independent, the task is called once per item index. The 
+   first exception thrown by the task is rethrown by run() once all items
+   are done.
+   ***/
+
+private:
+   mutex runMu_;
+
+   mutex mu_;
+   condition_variable workCv_;
+   condition_variable doneCv_;
+   vector<thread> threads_;
+   bool run_ = true;
+
+   //current job
+   const function<void(unsigned)>* task_ = nullptr;
+   unsigned count_ = 0;
+   unsigned next_ = 0;
+   unsigned pending_ = 0;
+   exception_ptr error_ = nullptr;
 
+private:
+   WorkerPool(const WorkerPool&) = delete;
+
+   //has to be called with mu_ locked, which it releases while running
+   void runItem(unique_lock<mutex>& lock)
+   {
+      auto task = task_;
+      auto id = next_++;
+
+      lock.unlock();
+      exception_ptr error = nullptr;
+      try
+      {
+         (*task)(id);
+      }
+      catch (...)
+      {
+         error = current_exception();
+      }
+      lock.lock();
+
+      if (error != nullptr && error_ == nullptr)
+         error_ = error;
+
+      if (--pending_ == 0)
+         doneCv_.notify_all();
+   }
+
+   void workerLoop(void)
+   {
+      unique_lock<mutex> lock(mu_);
+      while (1)
+      {
+         workCv_.wait(lock, [this](void)->bool
+            { return !run_ || next_ < count_; });
+
+         if (!run_)
+            return;
+
+         runItem(lock);
+      }
+   }
+
+public:
+   WorkerPool(unsigned threadCount)
+   {
+      for (unsigned i = 0; i < threadCount; i++)
+         threads_.push_back(thread([this](void)->void { workerLoop(); }));
+   }
+
+   ~WorkerPool(void)
+   {
+      {
+         unique_lock<mutex> lock(mu_);
+         run_ = false;
+      }
+
+      workCv_.notify_all();
+      for (auto& thr : threads_)
+      {
+         if (thr.joinable())
+            thr.join();
+      }
+   }
+
+   void run(unsigned count, const function<void(unsigned)>& task)
+   {
+      if (count == 0)
+         return;
+
+      unique_lock<mutex> runLock(runMu_);
+      unique_lock<mutex> lock(mu_);
+
+      task_ = &task;
+      count_ = count;
+      next_ = 0;
+      pending_ = count;
+      error_ = nullptr;
+      workCv_.notify_all();
+
+      while (next_ < count_)
+         runItem(lock);
+
+      doneCv_.wait(lock, [this](void)->bool { return pending_ == 0; });
+
+      task_ = nullptr;
+      count_ = next_ = 0;
+
+      auto error = error_;
+      error_ = nullptr;
+      if (error != nullptr)
+         rethrow_exception(error);
+   }
+
+   unsigned threadCount(void) const { return threads_.size(); }
+};
 
 #endif
@@ -730,8 +730,24 @@ void TxRef::setRef(BinaryDataRef bdr)
 BinaryData UTXO::serialize() const
 {
    BinaryWriter bw;
-   //8 + 4 + 2 + 2 + 32 + scriptsize
-   bw.reserve(18 + txHash_.getSize() + script_.getSize());
+   bw.reserve(getSerializedSize());
+   serialize(bw);
+
+   return move(bw.getData());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+size_t UTXO::getSerializedSize() const
+{
+   //8 + 4 + 2 + 2 + hash + script + 4
+   return 20 +
+      BtcUtils::calcVarIntSize(txHash_.getSize()) + txHash_.getSize() +
+      BtcUtils::calcVarIntSize(script_.getSize()) + script_.getSize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void UTXO::serialize(BinaryWriter& bw) const
+{
    bw.put_uint64_t(value_);
    bw.put_uint32_t(txHeight_);
    bw.put_uint16_t(txIndex_);
@@ -743,8 +759,6 @@ BinaryData UTXO::serialize() const
    bw.put_var_int(script_.getSize());
    bw.put_BinaryData(script_);
    bw.put_uint32_t(preferredSequence_);
-
-   return move(bw.getData());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -530,6 +530,8 @@ struct UTXO
    uint32_t getHeight(void) const { return txHeight_; }
 
    BinaryData serialize(void) const;
+   void serialize(BinaryWriter&) const;
+   size_t getSerializedSize(void) const;
    void unserialize(const BinaryData&);
    void unserializeRaw(const BinaryData&);
 
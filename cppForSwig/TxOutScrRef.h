@@ -88,4 +88,308 @@ struct TxOutScriptRef
    }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+class ScrAddrBloomFilter
+{
+   /***
+   Blocked Bloom filter over registered scrAddr. Each key maps to a single
+   64 byte block and sets one bit in each of its 8 words, so a negative
+   lookup costs one cache miss. Sized at 16 bits per key (~0.1% false
+   positives).
+
+   Read only once built. Meant as an index for the TransactionalMap holding
+   the registered scrAddr, so that a fresh filter is published along with 
+   every new snapshot of the map.
+   ***/
+
+private:
+   struct Block
+   {
+      uint64_t words_[8];
+   };
+
+   vector<Block> blocks_;
+   size_t mask_ = 0;
+
+private:
+   static uint64_t getHash(uint8_t prefix, const BinaryDataRef& script)
+   {
+      //scripts are mostly digests, mix in the leading 16 bytes
+      auto ptr = script.getPtr();
+      size_t len = script.getSize();
+      size_t end = len < 16 ? len : 16;
+
+      uint64_t hash = 0x84222325cbf29ce4ULL ^ ((uint64_t)prefix << 56) ^ len;
+      size_t i = 0;
+      for (; i + 8 <= end; i += 8)
+      {
+         uint64_t word;
+         memcpy(&word, ptr + i, 8);
+         hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+         hash ^= hash >> 29;
+      }
+
+      for (; i < end; i++)
+         hash = (hash ^ ptr[i]) * 0x100000001B3ULL;
+
+      return hash ^ (hash >> 32);
+   }
+
+   void add(uint8_t prefix, const BinaryDataRef& script)
+   {
+      auto hash = getHash(prefix, script);
+      auto& block = blocks_[(hash >> 40) & mask_];
+
+      auto bits = hash * 0xC2B2AE3D27D4EB4FULL;
+      for (unsigned i = 0; i < 8; i++)
+         block.words_[i] |= 1ULL << ((bits >> (i * 6)) & 63);
+   }
+
+public:
+   template<typename M> explicit ScrAddrBloomFilter(const M& scrAddrMap)
+   {
+      //M is a map keyed by objects carrying the scrAddr as scrAddr_
+      if (scrAddrMap.size() == 0)
+         return;
+
+      size_t blockCount = 1;
+      while (blockCount * 32 < scrAddrMap.size())
+         blockCount <<= 1;
+
+      Block empty;
+      memset(&empty, 0, sizeof(Block));
+      blocks_.resize(blockCount, empty);
+      mask_ = blockCount - 1;
+
+      for (auto& entry : scrAddrMap)
+      {
+         auto& scrAddr = entry.first.scrAddr_;
+         if (scrAddr.getSize() == 0)
+            continue;
+
+         add(scrAddr.getPtr()[0], 
+            scrAddr.getSliceRef(1, scrAddr.getSize() - 1));
+      }
+   }
+
+   bool mayContain(uint8_t prefix, const BinaryDataRef& script) const
+   {
+      if (blocks_.size() == 0)
+         return false;
+
+      auto hash = getHash(prefix, script);
+      auto& block = blocks_[(hash >> 40) & mask_];
+
+      auto bits = hash * 0xC2B2AE3D27D4EB4FULL;
+      for (unsigned i = 0; i < 8; i++)
+      {
+         if ((block.words_[i] & (1ULL << ((bits >> (i * 6)) & 63))) == 0)
+            return false;
+      }
+
+      return true;
+   }
+
+   bool mayContain(const TxOutScriptRef& scrRef) const
+   {
+      return mayContain(scrRef.type_, scrRef.scriptRef_);
+   }
+
+   bool mayContain(const BinaryDataRef& scrAddr) const
+   {
+      if (scrAddr.getSize() == 0)
+         return false;
+
+      return mayContain(scrAddr.getPtr()[0],
+         scrAddr.getSliceRef(1, scrAddr.getSize() - 1));
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+class TxOutScriptRefMap
+{
+   /***
+   Flat open addressing map of registered scripts, for the txout scanning
+   hot loop. Populated once, then only read from by the scanner threads.
+
+   Buckets are 64 bytes: 8 fingerprints followed by 8 entry ids. Most
+   lookups only touch one bucket and never dereference an entry unless the
+   fingerprint matches.
+   ***/
+
+private:
+   struct Bucket
+   {
+      uint32_t fingerprints_[8];
+      uint32_t ids_[8];
+   };
+
+   struct Entry
+   {
+      SCRIPT_PREFIX type_;
+      BinaryData script_;
+      int value_;
+   };
+
+   vector<Bucket> buckets_;
+   vector<Entry> entries_;
+   size_t mask_ = 0;
+
+   shared_ptr<const ScrAddrBloomFilter> prefilter_;
+
+private:
+   static uint64_t getHash(SCRIPT_PREFIX type, const BinaryDataRef& script)
+   {
+      //scripts are mostly hash160/sha256 digests, their leading 16 bytes
+      //are entropic enough
+      auto ptr = script.getPtr();
+      size_t len = script.getSize();
+      size_t end = len < 16 ? len : 16;
+
+      uint64_t hash = 0xcbf29ce484222325ULL ^ ((uint64_t)type << 56) ^ len;
+      size_t i = 0;
+      for (; i + 8 <= end; i += 8)
+      {
+         uint64_t word;
+         memcpy(&word, ptr + i, 8);
+         hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+      }
+
+      for (; i < end; i++)
+         hash = (hash ^ ptr[i]) * 0x100000001B3ULL;
+
+      return hash ^ (hash >> 32);
+   }
+
+   static uint32_t getFingerprint(uint64_t hash)
+   {
+      //0 flags empty slots
+      return (uint32_t)(hash >> 32) | 1;
+   }
+
+public:
+   TxOutScriptRefMap(size_t count)
+   {
+      size_t bucketCount = 1;
+      while (bucketCount * 6 < count + 1)
+         bucketCount <<= 1;
+
+      Bucket empty;
+      memset(&empty, 0, sizeof(Bucket));
+      buckets_.resize(bucketCount, empty);
+      mask_ = bucketCount - 1;
+      entries_.reserve(count);
+   }
+
+   void insert(const BinaryData& scrAddr, int value)
+   {
+      if (scrAddr.getSize() == 0)
+         return;
+
+      auto type = (SCRIPT_PREFIX)scrAddr.getPtr()[0];
+      auto script = scrAddr.getSliceRef(1, scrAddr.getSize() - 1);
+
+      //overwrite existing entry
+      auto valPtr = find(type, script);
+      if (valPtr != nullptr)
+      {
+         *const_cast<int*>(valPtr) = value;
+         return;
+      }
+
+      //grow past 75% load
+      if ((entries_.size() + 1) * 4 > buckets_.size() * 8 * 3)
+         rehash(buckets_.size() * 2);
+
+      Entry entry;
+      entry.type_ = type;
+      entry.script_ = script;
+      entry.value_ = value;
+      entries_.push_back(move(entry));
+
+      place(entries_.size() - 1);
+   }
+
+   const int* find(const TxOutScriptRef& scrRef) const
+   {
+      return find(scrRef.type_, scrRef.scriptRef_);
+   }
+
+   const int* find(SCRIPT_PREFIX type, const BinaryDataRef& script) const
+   {
+      if (entries_.size() == 0)
+         return nullptr;
+
+      if (prefilter_ != nullptr && !prefilter_->mayContain(type, script))
+         return nullptr;
+
+      auto hash = getHash(type, script);
+      auto fingerprint = getFingerprint(hash);
+      auto id = hash & mask_;
+
+      while (1)
+      {
+         auto& bucket = buckets_[id];
+         for (unsigned i = 0; i < 8; i++)
+         {
+            if (bucket.fingerprints_[i] == fingerprint)
+            {
+               auto& entry = entries_[bucket.ids_[i]];
+               if (entry.type_ == type && entry.script_.getRef() == script)
+                  return &entry.value_;
+            }
+            else if (bucket.fingerprints_[i] == 0)
+            {
+               return nullptr;
+            }
+         }
+
+         id = (id + 1) & mask_;
+      }
+   }
+
+   size_t size(void) const { return entries_.size(); }
+
+   void setPrefilter(shared_ptr<const ScrAddrBloomFilter> prefilter)
+   {
+      //prefilter has to cover every entry in this map
+      prefilter_ = prefilter;
+   }
+
+private:
+   void place(size_t entryId)
+   {
+      auto& entry = entries_[entryId];
+      auto hash = getHash(entry.type_, entry.script_.getRef());
+      auto id = hash & mask_;
+
+      while (1)
+      {
+         auto& bucket = buckets_[id];
+         for (unsigned i = 0; i < 8; i++)
+         {
+            if (bucket.fingerprints_[i] != 0)
+               continue;
+
+            bucket.fingerprints_[i] = getFingerprint(hash);
+            bucket.ids_[i] = entryId;
+            return;
+         }
+
+         id = (id + 1) & mask_;
+      }
+   }
+
+   void rehash(size_t bucketCount)
+   {
+      Bucket empty;
+      memset(&empty, 0, sizeof(Bucket));
+      buckets_.assign(bucketCount, empty);
+      mask_ = bucketCount - 1;
+
+      for (size_t i = 0; i < entries_.size(); i++)
+         place(i);
+   }
+};
+
 #endif
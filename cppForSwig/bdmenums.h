@@ -71,6 +71,12 @@ enum SocketType
    SocketFcgi
 };
 
+enum WireEncoding
+{
+   WireEncoding_Hex,
+   WireEncoding_Binary
+};
+
 enum NodeType
 {
    Node_BTC,
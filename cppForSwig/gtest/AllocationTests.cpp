@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Copyright (C) 2016, goatpig                                               //
+//  Distributed under the MIT license                                         //
+//  See LICENSE-MIT or https://opensource.org/licenses/MIT                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
+#include "gtest.h"
+
+#include "../BinaryData.h"
+#include "../BtcUtils.h"
+#include "../LedgerEntry.h"
+#include "../DataObject.h"
+#include "../BDM_seder.h"
+
+using namespace std;
+
+/***
+Heap allocation counts for the reply serialization paths. This binary
+replaces the global operator new so that allocations can be counted, which
+is why these tests don't live in CppBlockUtilsTests. Only allocations made
+by the current thread within an AllocationCounter scope are counted.
+***/
+
+////////////////////////////////////////////////////////////////////////////////
+static thread_local bool countAllocs_ = false;
+static thread_local uint64_t allocCount_ = 0;
+
+void* operator new(size_t size)
+{
+   if (countAllocs_)
+      ++allocCount_;
+
+   auto ptr = malloc(size == 0 ? 1 : size);
+   if (ptr == nullptr)
+      throw bad_alloc();
+
+   return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+   free(ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+class AllocationCounter
+{
+   //counts this thread's allocations for the lifetime of the object
+
+private:
+   const uint64_t start_;
+
+public:
+   AllocationCounter(void) :
+      start_(allocCount_)
+   {
+      countAllocs_ = true;
+   }
+
+   ~AllocationCounter(void)
+   {
+      countAllocs_ = false;
+   }
+
+   uint64_t count(void) const { return allocCount_ - start_; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+static vector<LedgerEntry> makeHistoryPage(unsigned count)
+{
+   vector<LedgerEntry> leVec;
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto&& txHash = BtcUtils::getHash256(WRITE_UINT32_LE(i));
+      leVec.push_back(LedgerEntry(BinaryData("wallet1"),
+         (int64_t)i * 1000 - 50000, 100 + i, txHash, i % 7, 1500000000 + i,
+         i == 0, i % 2 == 0, i % 3 == 0, i % 5 == 0, i % 4 == 0, false));
+   }
+
+   return leVec;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static string objectSerialize(
+   const vector<LedgerEntry>& leVec, WireEncoding encoding)
+{
+   //the page as LedgerEntryData copies in a LedgerEntryVector DataObject
+   LedgerEntryVector lev;
+   for (auto& le : leVec)
+   {
+      LedgerEntryData led(le.getWalletID(),
+         le.getValue(), le.getBlockNum(), le.getTxHash(),
+         le.getIndex(), le.getTxTime(), le.isCoinbase(),
+         le.isSentToSelf(), le.isChangeBack(),
+         le.isOptInRBF(), le.isChainedZC(), le.usesWitness(),
+         le.getScrAddrList());
+      lev.push_back(move(led));
+   }
+
+   Arguments args;
+   args.push_back(move(IntType(leVec.size())));
+   args.push_back(move(lev));
+   return args.serialize(encoding);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+static string directSerialize(
+   const vector<LedgerEntry>& leVec, WireEncoding encoding)
+{
+   //the page written in place, as getHistoryPage does
+   Arguments args;
+   auto& bw = args.getWriter();
+   args.push_back(move(IntType(leVec.size())));
+
+   LedgerEntryVector::serializeHeader(bw, leVec.size());
+   for (auto& le : leVec)
+      le.serialize(bw);
+
+   return args.serialize(encoding);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(AllocationTests, HistoryPage)
+{
+   auto&& page100 = makeHistoryPage(100);
+   auto&& page200 = makeHistoryPage(200);
+
+   vector<WireEncoding> encodings =
+      { WireEncoding_Hex, WireEncoding_Binary };
+   for (auto encoding : encodings)
+   {
+      //warm up the writer pool with the larger page
+      directSerialize(page200, encoding);
+      objectSerialize(page200, encoding);
+
+      auto countAllocs = [encoding](const vector<LedgerEntry>& leVec,
+         string (*serialize)(const vector<LedgerEntry>&, WireEncoding))
+         ->uint64_t
+      {
+         AllocationCounter counter;
+         serialize(leVec, encoding);
+         return counter.count();
+      };
+
+      auto direct100 = countAllocs(page100, directSerialize);
+      auto direct200 = countAllocs(page200, directSerialize);
+      auto object100 = countAllocs(page100, objectSerialize);
+      auto object200 = countAllocs(page200, objectSerialize);
+
+      //in place, a warm page costs the same whatever its entry count
+      EXPECT_EQ(direct100, direct200);
+
+      //the object path allocates at least once per entry
+      EXPECT_GE(object200 - object100, 100U);
+      EXPECT_LT(direct100, object100);
+
+      string suffix = encoding == WireEncoding_Hex ? "_hex" : "_binary";
+      RecordProperty(("directAllocs" + suffix).c_str(), (int)direct100);
+      RecordProperty(("objectAllocs" + suffix).c_str(), (int)object100);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+GTEST_API_ int main(int argc, char **argv)
+{
+   testing::InitGoogleTest(&argc, argv);
+   int exitCode = RUN_ALL_TESTS();
+
+   return exitCode;
+}
@@ -694,6 +694,60 @@ TEST_F(ContainerTests, TimedStackTest_Concurrent)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(ContainerTests, WorkerPool)
+{
+   unsigned itemCount = 10000;
+
+   auto checkPool = [itemCount](WorkerPool& pool)->void
+   {
+      vector<unsigned> hits(itemCount, 0);
+      auto task = [&hits](unsigned id)->void
+      {
+         ++hits[id];
+      };
+
+      //the pool is reused across runs
+      for (unsigned i = 0; i < 3; i++)
+         pool.run(itemCount, task);
+
+      for (auto& hit : hits)
+         EXPECT_EQ(hit, 3);
+
+      //the first exception is rethrown once all items are done
+      atomic<unsigned> done;
+      done.store(0, memory_order_relaxed);
+      auto throwingTask = [&done](unsigned id)->void
+      {
+         done.fetch_add(1, memory_order_relaxed);
+         if (id % 100 == 0)
+            throw runtime_error("task error");
+      };
+
+      EXPECT_THROW(pool.run(itemCount, throwingTask), runtime_error);
+      EXPECT_EQ(done.load(memory_order_relaxed), itemCount);
+   };
+
+   WorkerPool pool(threadCount_);
+   EXPECT_EQ(pool.threadCount(), threadCount_);
+   checkPool(pool);
+
+   //concurrent runs
+   vector<thread> threads;
+   for (unsigned i = 0; i < 4; i++)
+      threads.push_back(thread(checkPool, ref(pool)));
+
+   for (auto& thr : threads)
+   {
+      if (thr.joinable())
+         thr.join();
+   }
+
+   //no threads, runs on the caller
+   WorkerPool serialPool(0);
+   checkPool(serialPool);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 GTEST_API_ int main(int argc, char **argv)
 {
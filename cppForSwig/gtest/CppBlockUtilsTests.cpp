@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <thread>
+#include <chrono>
 #include "gtest.h"
 
 #include "../log.h"
@@ -325,13 +326,12 @@ vector<LedgerEntryData> getHistoryPage(Clients* clients, const string& bdvId,
 
    cmd.serialize();
 
+   //history pages are serialized in place, read them back from the wire
    auto&& result = clients->runCommand(cmd.command_);
-   auto& argVec = result.getArgVector();
-
-   auto lev = dynamic_pointer_cast<DataObject<LedgerEntryVector>>(argVec[0]);
+   Arguments args(result.serialize());
 
-   auto levData = lev->getObj().toVector();
-   return levData;
+   auto&& lev = args.get<LedgerEntryVector>();
+   return lev.toVector();
 }
 
 void waitOnSignal(Clients* clients, const string& bdvId, 
@@ -1978,6 +1978,725 @@ TEST(BinaryReadWriteTest, ReaderEndian)
    EXPECT_EQ(brrBE2.get_var_int(), 0x00ff00ff00ff00ffULL);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST(HttpSocketTest, KeepAlive)
+{
+   //bare http echo server, counts accepted connections. It drops the
+   //connection after a "close" (announced) or "drop" (unannounced) request
+   auto listenfd = socket(AF_INET, SOCK_STREAM, 0);
+   ASSERT_NE(listenfd, (SOCKET)-1);
+
+   sockaddr_in saddr;
+   memset(&saddr, 0, sizeof(saddr));
+   saddr.sin_family = AF_INET;
+   saddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   saddr.sin_port = 0;
+
+   ASSERT_EQ(::bind(listenfd, (sockaddr*)&saddr, sizeof(saddr)), 0);
+   ASSERT_EQ(::listen(listenfd, 10), 0);
+
+   socklen_t saddrLen = sizeof(saddr);
+   getsockname(listenfd, (sockaddr*)&saddr, &saddrLen);
+   auto port = to_string(ntohs(saddr.sin_port));
+
+   atomic<unsigned> acceptCount;
+   acceptCount.store(0);
+
+   auto serveConnection = [](SOCKET sockfd)->void
+   {
+      string buffer;
+      char readBuf[1024];
+
+      while (1)
+      {
+         auto headerEnd = buffer.find("\r\n\r\n");
+         if (headerEnd != string::npos)
+         {
+            string lenTok("Content-Length: ");
+            auto lenPos = buffer.find(lenTok);
+            size_t bodyLen = atoi(buffer.c_str() + lenPos + lenTok.size());
+
+            if (buffer.size() >= headerEnd + 4 + bodyLen)
+            {
+               auto body = buffer.substr(headerEnd + 4, bodyLen);
+               buffer.erase(0, headerEnd + 4 + bodyLen);
+
+               stringstream ss;
+               ss << "HTTP/1.1 200 OK\r\n";
+               if (body == "close")
+                  ss << "Connection: close\r\n";
+               ss << "Content-Length: " << body.size() << "\r\n\r\n";
+               ss << body;
+
+               auto&& reply = ss.str();
+               send(sockfd, reply.c_str(), reply.size(), 0);
+
+               if (body == "close" || body == "drop")
+                  break;
+               continue;
+            }
+         }
+
+         auto readAmt = recv(sockfd, readBuf, sizeof(readBuf), 0);
+         if (readAmt <= 0)
+            break;
+
+         buffer.append(readBuf, readAmt);
+      }
+
+      BinarySocket::closeSocket(sockfd);
+   };
+
+   auto listenLambda = [&](void)->void
+   {
+      vector<thread> connThreads;
+      while (1)
+      {
+         auto sockfd = accept(listenfd, nullptr, nullptr);
+         if (sockfd == (SOCKET)-1)
+            break;
+
+         acceptCount.fetch_add(1);
+         connThreads.push_back(thread(serveConnection, sockfd));
+      }
+
+      for (auto& thr : connThreads)
+         thr.join();
+   };
+
+   thread listenThr(listenLambda);
+
+   {
+      HttpSocket sock(BinarySocket("127.0.0.1", port));
+
+      //consecutive requests share a connection
+      EXPECT_EQ(sock.writeAndRead("abc"), "abc");
+      EXPECT_EQ(sock.writeAndRead("defg"), "defg");
+      EXPECT_EQ(acceptCount.load(), 1U);
+
+      //Connection: close is honored
+      EXPECT_EQ(sock.writeAndRead("close"), "close");
+      EXPECT_EQ(sock.writeAndRead("hij"), "hij");
+      EXPECT_EQ(acceptCount.load(), 2U);
+
+      //a pooled connection the server dropped is replaced transparently
+      EXPECT_EQ(sock.writeAndRead("drop"), "drop");
+      EXPECT_EQ(sock.writeAndRead("klmno"), "klmno");
+      EXPECT_EQ(sock.writeAndRead("pq"), "pq");
+      EXPECT_EQ(acceptCount.load(), 3U);
+
+      //copies share the pool
+      HttpSocket sockCopy(sock);
+      EXPECT_EQ(sockCopy.writeAndRead("rst"), "rst");
+      EXPECT_EQ(acceptCount.load(), 3U);
+
+      sock.closeIdleConnections();
+   }
+
+   //unblock accept
+   shutdown(listenfd, 2);
+   BinarySocket::closeSocket(listenfd);
+   listenThr.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(HttpSocketTest, StreamReply)
+{
+   //bare http server, streams the request body back in 3 packets and 
+   //closes the connection. The reply is sent a few bytes at a time, so 
+   //packets are split across reads. Replies to "drop" are cut short after
+   //the first packet
+   auto listenfd = socket(AF_INET, SOCK_STREAM, 0);
+   ASSERT_NE(listenfd, (SOCKET)-1);
+
+   sockaddr_in saddr;
+   memset(&saddr, 0, sizeof(saddr));
+   saddr.sin_family = AF_INET;
+   saddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   saddr.sin_port = 0;
+
+   ASSERT_EQ(::bind(listenfd, (sockaddr*)&saddr, sizeof(saddr)), 0);
+   ASSERT_EQ(::listen(listenfd, 10), 0);
+
+   socklen_t saddrLen = sizeof(saddr);
+   getsockname(listenfd, (sockaddr*)&saddr, &saddrLen);
+   auto port = to_string(ntohs(saddr.sin_port));
+
+   atomic<unsigned> acceptCount;
+   acceptCount.store(0);
+
+   auto serveConnection = [](SOCKET sockfd)->void
+   {
+      string buffer;
+      char readBuf[1024];
+
+      while (1)
+      {
+         auto headerEnd = buffer.find("\r\n\r\n");
+         if (headerEnd != string::npos)
+         {
+            string lenTok("Content-Length: ");
+            auto lenPos = buffer.find(lenTok);
+            size_t bodyLen = atoi(buffer.c_str() + lenPos + lenTok.size());
+
+            if (buffer.size() >= headerEnd + 4 + bodyLen)
+            {
+               auto body = buffer.substr(headerEnd + 4, bodyLen);
+
+               string reply("HTTP/1.1 200 OK\r\n\r\n");
+               auto third = body.size() / 3;
+               vector<string> packets;
+               packets.push_back(body.substr(0, third));
+               packets.push_back(body.substr(third, third));
+               packets.push_back(body.substr(third * 2));
+
+               for (auto& packet : packets)
+               {
+                  reply.append(WireFrame::streamHeader(packet.size()));
+                  reply.append(packet);
+
+                  if (body == "drop")
+                     break;
+               }
+
+               if (body != "drop")
+                  reply.append(WireFrame::streamHeader(0));
+
+               for (size_t i = 0; i < reply.size(); i += 3)
+               {
+                  auto sendLen = min(reply.size() - i, (size_t)3);
+                  send(sockfd, reply.c_str() + i, sendLen, 0);
+
+                  //let the client pick up the pieces one by one
+                  this_thread::sleep_for(chrono::milliseconds(1));
+               }
+
+               break;
+            }
+         }
+
+         auto readAmt = recv(sockfd, readBuf, sizeof(readBuf), 0);
+         if (readAmt <= 0)
+            break;
+
+         buffer.append(readBuf, readAmt);
+      }
+
+      BinarySocket::closeSocket(sockfd);
+   };
+
+   auto listenLambda = [&](void)->void
+   {
+      vector<thread> connThreads;
+      while (1)
+      {
+         auto sockfd = accept(listenfd, nullptr, nullptr);
+         if (sockfd == (SOCKET)-1)
+            break;
+
+         acceptCount.fetch_add(1);
+         connThreads.push_back(thread(serveConnection, sockfd));
+      }
+
+      for (auto& thr : connThreads)
+         thr.join();
+   };
+
+   thread listenThr(listenLambda);
+
+   {
+      HttpSocket sock(BinarySocket("127.0.0.1", port));
+
+      //packets are put back together
+      EXPECT_EQ(sock.writeAndRead("abcdefghi"), "abcdefghi");
+
+      //or handed out as they come in
+      vector<string> packets;
+      auto getPacket = [&packets](string&& packet)->void
+      {
+         packets.push_back(move(packet));
+      };
+
+      sock.writeAndReadStream("jklmnopqr", getPacket);
+      ASSERT_EQ(packets.size(), 3U);
+      EXPECT_EQ(packets[0], "jkl");
+      EXPECT_EQ(packets[1], "mno");
+      EXPECT_EQ(packets[2], "pqr");
+
+      //connections are not reused past a reply without a length
+      EXPECT_EQ(acceptCount.load(), 2U);
+
+      //a reply cut short after a packet was handed out is not retried
+      packets.clear();
+      EXPECT_THROW(sock.writeAndReadStream("drop", getPacket), SocketError);
+      EXPECT_EQ(packets.size(), 1U);
+
+      EXPECT_EQ(sock.writeAndRead("stuvwx"), "stuvwx");
+      EXPECT_EQ(acceptCount.load(), 4U);
+
+      sock.closeIdleConnections();
+   }
+
+   //unblock accept
+   shutdown(listenfd, 2);
+   BinarySocket::closeSocket(listenfd);
+   listenThr.join();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ServerStatsTest, LatencyHistogram)
+{
+   LatencyHistogram hist;
+   EXPECT_EQ(hist.percentile(0.5), 0);
+
+   //small values have a bucket each
+   hist.record(5);
+   EXPECT_EQ(hist.percentile(0.5), 5);
+   EXPECT_EQ(hist.percentile(1.0), 5);
+
+   LatencyHistogram hist2;
+   for (unsigned i = 1; i <= 1000; i++)
+      hist2.record(i);
+
+   EXPECT_EQ(hist2.count(), 1000);
+   EXPECT_EQ(hist2.sum(), 500500);
+   EXPECT_EQ(hist2.max(), 1000);
+
+   //within a sub bucket of the real value
+   auto p50 = hist2.percentile(0.5);
+   EXPECT_GE(p50, 500);
+   EXPECT_LE(p50, 500 + 500 / LATENCY_SUB_BUCKETS);
+
+   auto p99 = hist2.percentile(0.99);
+   EXPECT_GE(p99, 990);
+   EXPECT_LE(p99, 1000);
+   EXPECT_EQ(hist2.percentile(1.0), 1000);
+
+   //out of range values go in the last bucket
+   uint64_t huge = 1ULL << 50;
+   hist2.record(huge);
+   EXPECT_EQ(hist2.max(), huge);
+   EXPECT_EQ(hist2.percentile(1.0), huge);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(ServerStatsTest, UnknownMethods)
+{
+   set<string> methods = { "method0", "method1", "method2" };
+   ServerStats stats(methods);
+
+   //names that are not listed all go to the same entry
+   for (unsigned i = 0; i < 20; i++)
+      stats.recordExecution("method" + to_string(i), i, i % 2 == 1);
+   stats.recordQueueWait("method0", 10);
+   stats.recordQueueWait("method100", 10);
+
+   Arguments args(stats.getStats().serialize());
+   auto count = args.get<IntType>().getVal();
+   EXPECT_EQ(count, 4U);
+
+   map<string, pair<uint64_t, uint64_t>> results;
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto name = args.get<BinaryDataObject>().toStr();
+      auto calls = args.get<IntType>().getVal();
+      auto errors = args.get<IntType>().getVal();
+      results[name] = make_pair(calls, errors);
+
+      auto waitCount = args.get<IntType>().getVal();
+      EXPECT_EQ(waitCount, name == "method0" || name == "unknown" ? 1 : 0);
+      for (unsigned y = 0; y < 13; y++)
+         args.get<IntType>();
+   }
+
+   ASSERT_EQ(results.size(), 4U);
+   EXPECT_EQ(results["method0"], make_pair((uint64_t)1, (uint64_t)0));
+   EXPECT_EQ(results["method1"], make_pair((uint64_t)1, (uint64_t)1));
+   EXPECT_EQ(results["method2"], make_pair((uint64_t)1, (uint64_t)0));
+   EXPECT_EQ(results["unknown"], make_pair((uint64_t)17, (uint64_t)9));
+
+   //methods that were not called are left out
+   ServerStats idle(methods);
+   Arguments idleArgs(idle.getStats().serialize());
+   EXPECT_EQ(idleArgs.get<IntType>().getVal(), 0U);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(DataObjectTest, HistoryPageInPlace)
+{
+   //100 entry history page
+   vector<LedgerEntry> leVec;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      auto&& txHash = BtcUtils::getHash256(WRITE_UINT32_LE(i));
+      leVec.push_back(LedgerEntry(BinaryData("wallet1"), 
+         (int64_t)i * 1000 - 50000, 100 + i, txHash, i % 7, 1500000000 + i,
+         i == 0, i % 2 == 0, i % 3 == 0, i % 5 == 0, i % 4 == 0, false));
+   }
+
+   //the page as a LedgerEntryVector object
+   auto objectSerialize = [&leVec](WireEncoding encoding)->string
+   {
+      LedgerEntryVector lev;
+      for (auto& le : leVec)
+      {
+         LedgerEntryData led(le.getWalletID(),
+            le.getValue(), le.getBlockNum(), le.getTxHash(),
+            le.getIndex(), le.getTxTime(), le.isCoinbase(),
+            le.isSentToSelf(), le.isChangeBack(),
+            le.isOptInRBF(), le.isChainedZC(), le.usesWitness(),
+            le.getScrAddrList());
+         lev.push_back(move(led));
+      }
+
+      Arguments args;
+      args.push_back(move(IntType(leVec.size())));
+      args.push_back(move(lev));
+      return args.serialize(encoding);
+   };
+
+   //serialized in place, reports the writer it got
+   auto directSerialize = [&leVec]
+      (WireEncoding encoding, BinaryWriter** writerPtr)->string
+   {
+      Arguments args;
+      auto& bw = args.getWriter();
+      args.push_back(move(IntType(leVec.size())));
+
+      LedgerEntryVector::serializeHeader(bw, leVec.size());
+      for (auto& le : leVec)
+         le.serialize(bw);
+
+      if (writerPtr != nullptr)
+         *writerPtr = &bw;
+
+      return args.serialize(encoding);
+   };
+
+   vector<WireEncoding> encodings = 
+      { WireEncoding_Hex, WireEncoding_Binary };
+   for (auto encoding : encodings)
+   {
+      //same wire format
+      EXPECT_EQ(directSerialize(encoding, nullptr), objectSerialize(encoding));
+
+      //consecutive replies on a thread reuse the same pooled writer
+      BinaryWriter *writer1 = nullptr, *writer2 = nullptr;
+      directSerialize(encoding, &writer1);
+      directSerialize(encoding, &writer2);
+      EXPECT_EQ(writer1, writer2);
+   }
+
+   //the entries read back as a LedgerEntryVector
+   Arguments args(directSerialize(WireEncoding_Binary, nullptr));
+   EXPECT_EQ(args.get<IntType>().getVal(), 100);
+   auto&& lev = args.get<LedgerEntryVector>();
+   auto& ledVec = lev.toVector();
+   ASSERT_EQ(ledVec.size(), 100);
+   for (unsigned i = 0; i < 100; i++)
+   {
+      EXPECT_EQ(ledVec[i].getWalletID(), "wallet1");
+      EXPECT_EQ(ledVec[i].getValue(), leVec[i].getValue());
+      EXPECT_EQ(ledVec[i].getTxHash(), leVec[i].getTxHash());
+      EXPECT_EQ(ledVec[i].isSentToSelf(), leVec[i].isSentToSelf());
+      EXPECT_EQ(ledVec[i].isOptInRBF(), leVec[i].isOptInRBF());
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(DataObjectTest, InPlaceWriter)
+{
+   UTXO utxo(5000, 120, 3, 1, 
+      READHEX("00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff"),
+      READHEX("76a914000102030405060708090a0b0c0d0e0f1011121388ac"));
+
+   Arguments wrapped;
+   wrapped.push_back(move(IntType(1)));
+   wrapped.push_back(move(BinaryDataObject(utxo.serialize())));
+
+   //objects pushed before the writer is requested are flushed to it
+   Arguments direct;
+   direct.push_back(move(IntType(1)));
+   auto& bw = direct.getWriter();
+   BinaryDataObject::serializeHeader(bw, utxo.getSerializedSize());
+   utxo.serialize(bw);
+   EXPECT_EQ(direct.getArgVector().size(), 0);
+   EXPECT_TRUE(direct.hasArgs());
+
+   EXPECT_EQ(wrapped.serialize(), direct.serialize());
+
+   //merges go both ways, copies carry the written data
+   Arguments merged;
+   merged.push_back(move(IntType(2)));
+   merged.merge(direct);
+   Arguments mergedCopy(merged);
+   direct.clear();
+   EXPECT_FALSE(direct.hasArgs());
+
+   Arguments readBack(mergedCopy.serialize(WireEncoding_Binary));
+   EXPECT_EQ(readBack.get<IntType>().getVal(), 2);
+   EXPECT_EQ(readBack.get<IntType>().getVal(), 1);
+
+   UTXO utxo2;
+   utxo2.unserialize(readBack.get<BinaryDataObject>().get());
+   EXPECT_EQ(utxo2.getValue(), 5000);
+   EXPECT_EQ(utxo2.getScript(), utxo.getScript());
+   EXPECT_FALSE(readBack.hasArgs());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(AdmissionTest, TokenBudget)
+{
+   BlockDataManagerConfig config;
+   config.admissionRate_ = 100;
+   config.admissionBurst_ = 120;
+   AdmissionControl admission(config);
+
+   EXPECT_EQ(AdmissionControl::getMethodCost("getTopBlockHeight"), 
+      MethodCost_Cheap);
+   EXPECT_EQ(AdmissionControl::getMethodCost("getHistoryForWalletSelection"),
+      MethodCost_Heavy);
+
+   //2 heavy commands and a moderate one drain the bucket
+   EXPECT_TRUE(admission.admit("client1", "getCombinedWalletState"));
+   admission.done();
+   EXPECT_TRUE(admission.admit("client1", "getCombinedWalletState"));
+   admission.done();
+   EXPECT_FALSE(admission.admit("client1", "getHistoryPage"));
+
+   EXPECT_THROW(admission.admit("client1", "getCombinedWalletState"), 
+      ServerBusy);
+   EXPECT_EQ(admission.getRejectedCount(), 1);
+
+   //the busy reply is what clients see
+   try
+   {
+      admission.admit("client1", "getCombinedWalletState");
+      FAIL();
+   }
+   catch (runtime_error& e)
+   {
+      EXPECT_EQ(string(e.what()), SERVER_BUSY_ERROR);
+   }
+
+   //budgets are per client, callbacks are free
+   EXPECT_TRUE(admission.admit("client2", "getCombinedWalletState"));
+   admission.done();
+   for (unsigned i = 0; i < 1000; i++)
+      admission.admit("client1", "registerCallback");
+
+   //refills over time
+   this_thread::sleep_for(chrono::milliseconds(100));
+   EXPECT_FALSE(admission.admit("client1", "getTopBlockHeight"));
+
+   //forgotten clients start over with a full bucket
+   admission.forget("client1");
+   EXPECT_TRUE(admission.admit("client1", "getCombinedWalletState"));
+   admission.done();
+
+   //a rate of 0 disables the budget
+   config.admissionRate_ = 0;
+   AdmissionControl unlimited(config);
+   for (unsigned i = 0; i < 100; i++)
+   {
+      EXPECT_TRUE(unlimited.admit("client1", "getCombinedWalletState"));
+      unlimited.done();
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(AdmissionTest, FairScheduling)
+{
+   FairScheduler scheduler(1, 4, 3);
+   auto timeout = chrono::milliseconds(10000);
+
+   //client1 holds the only slot
+   ASSERT_TRUE(scheduler.acquire("client1", 50, timeout));
+
+   mutex mu;
+   vector<string> order;
+   auto run = [&](const string& id)->void
+   {
+      if (!scheduler.acquire(id, 50, timeout))
+         return;
+
+      {
+         unique_lock<mutex> lock(mu);
+         order.push_back(id);
+      }
+
+      scheduler.release();
+   };
+
+   auto waitForQueue = [&](unsigned count)->void
+   {
+      while (scheduler.waitingCount() < count)
+         this_thread::sleep_for(chrono::milliseconds(1));
+   };
+
+   //client1 queues 3 more before client2 shows up, client2 still goes next
+   vector<thread> thrVec;
+   for (unsigned i = 0; i < 3; i++)
+   {
+      thrVec.push_back(thread(run, "client1"));
+      waitForQueue(i + 1);
+   }
+
+   //client1 is at its own cap, turned down without waiting
+   auto start = chrono::steady_clock::now();
+   EXPECT_FALSE(scheduler.acquire("client1", 50, timeout));
+   EXPECT_LT(chrono::steady_clock::now() - start, timeout);
+   EXPECT_EQ(scheduler.waitingCount(), 3);
+
+   thrVec.push_back(thread(run, "client2"));
+   waitForQueue(4);
+
+   //the queue is full
+   start = chrono::steady_clock::now();
+   EXPECT_FALSE(scheduler.acquire("client3", 50, timeout));
+   EXPECT_LT(chrono::steady_clock::now() - start, timeout);
+
+   scheduler.release();
+   for (auto& thr : thrVec)
+      thr.join();
+
+   ASSERT_EQ(order.size(), 4);
+   EXPECT_EQ(order[0], "client2");
+   EXPECT_EQ(order[1], "client1");
+   EXPECT_EQ(order[2], "client1");
+   EXPECT_EQ(order[3], "client1");
+
+   //waits time out
+   ASSERT_TRUE(scheduler.acquire("client1", 50, timeout));
+   EXPECT_FALSE(scheduler.acquire("client2", 50, chrono::milliseconds(10)));
+   EXPECT_EQ(scheduler.waitingCount(), 0);
+   scheduler.release();
+
+   //without a queue, commands only run if a slot is free
+   FairScheduler noQueue(1, 0, 0);
+   ASSERT_TRUE(noQueue.acquire("client1", 50, timeout));
+   EXPECT_FALSE(noQueue.acquire("client2", 50, timeout));
+   noQueue.release();
+   EXPECT_TRUE(noQueue.acquire("client2", 50, timeout));
+   noQueue.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(RequestLanesTest, RoutingAndRejection)
+{
+   typedef RequestLanes<unsigned> Lanes;
+
+   auto makeCmd = [](const string& method)->string
+   {
+      Command cmd;
+      cmd.method_ = method;
+      cmd.ids_.push_back("bdvid");
+      cmd.serialize(WireEncoding_Binary);
+      return cmd.command_;
+   };
+
+   //request bodies by handle, handle 0 fails to read
+   map<unsigned, string> bodies;
+   for (unsigned i = 1; i < 10; i++)
+      bodies[i] = makeCmd(i < 5 ? "getTopBlockHeight" : "registerCallback");
+
+   mutex mu;
+   map<unsigned, FcgiLane> processed;
+   map<unsigned, pair<FcgiLane, bool>> rejected;
+   set<unsigned> dropped;
+   set<thread::id> readThreads;
+
+   promise<bool> startedProm, releaseProm;
+   auto releaseFut = releaseProm.get_future().share();
+
+   auto readBody = [&](unsigned handle, string& content)->bool
+   {
+      unique_lock<mutex> lock(mu);
+      readThreads.insert(this_thread::get_id());
+      if (handle == 0)
+         return false;
+
+      content = bodies[handle];
+      return true;
+   };
+
+   auto process = [&](Lanes::Request& req)->void
+   {
+      //the first rpc request holds the only rpc worker
+      if (req.handle_ == 1)
+      {
+         startedProm.set_value(true);
+         releaseFut.wait();
+      }
+
+      unique_lock<mutex> lock(mu);
+      processed[req.handle_] = req.lane_;
+   };
+
+   auto reject = [&](unsigned handle, FcgiLane laneID, 
+      const string& content)->void
+   {
+      unique_lock<mutex> lock(mu);
+      rejected[handle] = make_pair(laneID, content.size() == 0);
+   };
+
+   auto drop = [&](unsigned handle)->void
+   {
+      unique_lock<mutex> lock(mu);
+      dropped.insert(handle);
+   };
+
+   EXPECT_EQ(Lanes::getLane(bodies[1]), FcgiLane_RPC);
+   EXPECT_EQ(Lanes::getLane(bodies[5]), FcgiLane_Callback);
+
+   Lanes lanes(readBody, process, reject, drop);
+   lanes.setLane(FcgiLane_RPC, 1, 1);
+   lanes.setLane(FcgiLane_Callback, 2, 2);
+   lanes.start();
+
+   //block the rpc worker, then fill its queue
+   EXPECT_TRUE(lanes.push(1));
+   startedProm.get_future().wait();
+   EXPECT_TRUE(lanes.push(2));
+
+   //the queue is full, rejected without reading the body
+   EXPECT_FALSE(lanes.push(3));
+   EXPECT_EQ(lanes.getRejectedCount(FcgiLane_RPC), 1);
+   EXPECT_EQ(lanes.liveCount(), 2);
+
+   {
+      unique_lock<mutex> lock(mu);
+      ASSERT_EQ(rejected.size(), 1);
+      EXPECT_EQ(rejected[3].first, FcgiLane_RPC);
+      EXPECT_TRUE(rejected[3].second);
+   }
+
+   releaseProm.set_value(true);
+   while (lanes.liveCount() != 0)
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   //callbacks are handed over to their lane once read, bodies that fail
+   //to read are dropped
+   EXPECT_TRUE(lanes.push(5));
+   while (lanes.liveCount() != 0)
+      this_thread::sleep_for(chrono::milliseconds(1));
+   EXPECT_TRUE(lanes.push(0));
+   while (lanes.liveCount() != 0)
+      this_thread::sleep_for(chrono::milliseconds(1));
+
+   lanes.stop();
+
+   unique_lock<mutex> lock(mu);
+   ASSERT_EQ(processed.size(), 3);
+   EXPECT_EQ(processed[1], FcgiLane_RPC);
+   EXPECT_EQ(processed[2], FcgiLane_RPC);
+   EXPECT_EQ(processed[5], FcgiLane_Callback);
+   EXPECT_EQ(dropped, set<unsigned>({ 0 }));
+
+   //bodies are only ever read on the worker
+   EXPECT_EQ(readThreads.size(), 1);
+   EXPECT_EQ(readThreads.count(this_thread::get_id()), 0);
+}
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class BtcUtilsTest : public ::testing::Test
@@ -2394,25 +3113,151 @@ TEST_F(BtcUtilsTest, TxOutScriptID_MultiList)
 //}
  
 ////////////////////////////////////////////////////////////////////////////////
-TEST_F(BtcUtilsTest, TxInScriptID_StdUncompr)
+TEST_F(BtcUtilsTest, TxOutScriptRefMap)
 {
-   BinaryData script = READHEX(
-      "493046022100b9daf2733055be73ae00ee0c5d78ca639d554fe779f163396c1a"
-      "39b7913e7eac02210091f0deeb2e510c74354afb30cc7d8fbac81b1ca8b39406"
-      "13379adc41a6ffd226014104b1537fa5bc2242d25ebf54f31e76ebabe0b3de4a"
-      "4dccd9004f058d6c2caa5d31164252e1e04e5df627fae7adec27fa9d40c271fc"
-      "4d30ff375ef6b26eba192bac");
-   BinaryData a160 = READHEX("c42a8290196b2c5bcb35471b45aa0dc096baed5e");
-   BinaryData prevHash = prevHashReg_;
+   TxOutScriptRefMap scrRefMap(10);
+   vector<BinaryData> scrAddrs;
 
-   TXIN_SCRIPT_TYPE scrType = BtcUtils::getTxInScriptType( script, prevHash);
-   EXPECT_EQ(scrType,  TXIN_SCRIPT_STDUNCOMPR);
-   EXPECT_EQ(BtcUtils::getTxInAddr(script, prevHash), a160);
-   EXPECT_EQ(BtcUtils::getTxInAddr(script, prevHash, scrType), a160);
-   EXPECT_EQ(BtcUtils::getTxInAddrFromType(script,  scrType), a160);
-}
+   //enough entries to force a few rehashes
+   for (unsigned i = 0; i < 1000; i++)
+   {
+      BinaryData scrAddr;
+      if (i % 2)
+      {
+         scrAddr = WRITE_UINT8_LE(SCRIPT_PREFIX_HASH160);
+         scrAddr.append(BtcUtils::getHash160(WRITE_UINT32_LE(i)));
+      }
+      else
+      {
+         scrAddr = WRITE_UINT8_LE(SCRIPT_PREFIX_P2WSH);
+         scrAddr.append(BtcUtils::getSha256(WRITE_UINT32_LE(i)));
+      }
 
-////////////////////////////////////////////////////////////////////////////////
+      scrRefMap.insert(scrAddr, i);
+      scrAddrs.push_back(scrAddr);
+   }
+
+   EXPECT_EQ(scrRefMap.size(), 1000);
+
+   for (unsigned i = 0; i < scrAddrs.size(); i++)
+   {
+      TxOutScriptRef scrRef;
+      scrRef.setRef(scrAddrs[i]);
+
+      auto valPtr = scrRefMap.find(scrRef);
+      ASSERT_NE(valPtr, nullptr);
+      EXPECT_EQ(*valPtr, i);
+   }
+
+   //same hash, different prefix
+   BinaryData otherPrefix = scrAddrs[1];
+   otherPrefix.getPtr()[0] = SCRIPT_PREFIX_P2SH;
+   TxOutScriptRef otherRef;
+   otherRef.setRef(otherPrefix);
+   EXPECT_EQ(scrRefMap.find(otherRef), nullptr);
+
+   //script from a txout
+   auto script = READHEX("76a914c1b4695d53b6ee57a28647ce63e45665df6762c288ac");
+   auto&& txoutRef = BtcUtils::getTxOutScrAddrNoCopy(script);
+   EXPECT_EQ(scrRefMap.find(txoutRef), nullptr);
+
+   scrRefMap.insert(txoutRef.getScrAddr(), 12);
+   scrRefMap.insert(txoutRef.getScrAddr(), 13);
+   EXPECT_EQ(scrRefMap.size(), 1001);
+
+   auto valPtr = scrRefMap.find(txoutRef);
+   ASSERT_NE(valPtr, nullptr);
+   EXPECT_EQ(*valPtr, 13);
+
+   TxOutScriptRefMap emptyMap(0);
+   EXPECT_EQ(emptyMap.find(txoutRef), nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BtcUtilsTest, ScrAddrBloomFilter)
+{
+   ScrAddrFilter::ScrAddrTransactionalMap saMap;
+   EXPECT_FALSE(saMap.get_with_index().second->mayContain(
+      READHEX("00c1b4695d53b6ee57a28647ce63e45665df6762c2").getRef()));
+
+   map<ScrAddrFilter::AddrAndHash, int> updateMap;
+   for (unsigned i = 0; i < 2000; i++)
+   {
+      BinaryData scrAddr = WRITE_UINT8_LE(SCRIPT_PREFIX_HASH160);
+      scrAddr.append(BtcUtils::getHash160(WRITE_UINT32_LE(i)));
+      updateMap.insert(make_pair(ScrAddrFilter::AddrAndHash(scrAddr), i));
+   }
+
+   saMap.update(updateMap);
+
+   //no false negatives
+   auto&& mapAndFilter = saMap.get_with_index();
+   ASSERT_EQ(mapAndFilter.first->size(), 2000);
+   for (auto& entry : *mapAndFilter.first)
+   {
+      auto& scrAddr = entry.first.scrAddr_;
+      EXPECT_TRUE(mapAndFilter.second->mayContain(scrAddr.getRef()));
+
+      TxOutScriptRef scrRef;
+      scrRef.setRef(scrAddr);
+      EXPECT_TRUE(mapAndFilter.second->mayContain(scrRef));
+   }
+
+   //few false positives
+   unsigned falsePositives = 0;
+   for (unsigned i = 2000; i < 22000; i++)
+   {
+      BinaryData scrAddr = WRITE_UINT8_LE(SCRIPT_PREFIX_HASH160);
+      scrAddr.append(BtcUtils::getHash160(WRITE_UINT32_LE(i)));
+      if (mapAndFilter.second->mayContain(scrAddr.getRef()))
+         ++falsePositives;
+   }
+   EXPECT_LT(falsePositives, 100);
+
+   //filter is swapped along with the map
+   BinaryData newAddr = WRITE_UINT8_LE(SCRIPT_PREFIX_P2SH);
+   newAddr.append(BtcUtils::getHash160(WRITE_UINT32_LE(1)));
+   EXPECT_FALSE(mapAndFilter.second->mayContain(newAddr.getRef()));
+
+   saMap.insert(make_pair(ScrAddrFilter::AddrAndHash(newAddr), 0));
+   EXPECT_TRUE(saMap.get_with_index().second->mayContain(newAddr.getRef()));
+
+   //scanner map uses the filter as a prefilter
+   auto scrRefMap = make_shared<TxOutScriptRefMap>(updateMap.size());
+   for (auto& entry : updateMap)
+      scrRefMap->insert(entry.first.scrAddr_, entry.second);
+   scrRefMap->setPrefilter(mapAndFilter.second);
+
+   TxOutScriptRef scrRef;
+   scrRef.setRef(updateMap.begin()->first.scrAddr_);
+   auto valPtr = scrRefMap->find(scrRef);
+   ASSERT_NE(valPtr, nullptr);
+   EXPECT_EQ(*valPtr, updateMap.begin()->second);
+
+   saMap.clear();
+   EXPECT_FALSE(saMap.get_with_index().second->mayContain(newAddr.getRef()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BtcUtilsTest, TxInScriptID_StdUncompr)
+{
+   BinaryData script = READHEX(
+      "493046022100b9daf2733055be73ae00ee0c5d78ca639d554fe779f163396c1a"
+      "39b7913e7eac02210091f0deeb2e510c74354afb30cc7d8fbac81b1ca8b39406"
+      "13379adc41a6ffd226014104b1537fa5bc2242d25ebf54f31e76ebabe0b3de4a"
+      "4dccd9004f058d6c2caa5d31164252e1e04e5df627fae7adec27fa9d40c271fc"
+      "4d30ff375ef6b26eba192bac");
+   BinaryData a160 = READHEX("c42a8290196b2c5bcb35471b45aa0dc096baed5e");
+   BinaryData prevHash = prevHashReg_;
+
+   TXIN_SCRIPT_TYPE scrType = BtcUtils::getTxInScriptType( script, prevHash);
+   EXPECT_EQ(scrType,  TXIN_SCRIPT_STDUNCOMPR);
+   EXPECT_EQ(BtcUtils::getTxInAddr(script, prevHash), a160);
+   EXPECT_EQ(BtcUtils::getTxInAddr(script, prevHash, scrType), a160);
+   EXPECT_EQ(BtcUtils::getTxInAddrFromType(script,  scrType), a160);
+}
+
+////////////////////////////////////////////////////////////////////////////////
 TEST_F(BtcUtilsTest, TxInScriptID_StdCompr)
 {
    BinaryData script = READHEX(
@@ -2604,7 +3449,216 @@ TEST_F(BtcUtilsTest, ScriptToOpCodes)
       EXPECT_EQ(output[i], opstr[i]);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BtcUtilsTest, WireFrameCommand)
+{
+   //crc32c check value
+   string checkStr("123456789");
+   EXPECT_EQ(BtcUtils::getCRC32C(
+      (const uint8_t*)checkStr.c_str(), checkStr.size()), 0xE3069283);
+
+   auto buildCmd = [](void)->Command
+   {
+      Command cmd;
+      cmd.method_ = "getLedgerDelegateForScrAddr";
+      cmd.ids_.push_back("bdvid");
+      cmd.ids_.push_back("walletid");
+      cmd.args_.push_back(move(IntType(12)));
+      cmd.args_.push_back(move(BinaryDataObject(READHEX("00ff00fb"))));
+      return cmd;
+   };
+
+   auto checkCmd = [](Command& cmd)->void
+   {
+      EXPECT_EQ(cmd.method_, "getLedgerDelegateForScrAddr");
+      ASSERT_EQ(cmd.ids_.size(), 2U);
+      EXPECT_EQ(cmd.ids_[0], "bdvid");
+      EXPECT_EQ(cmd.ids_[1], "walletid");
+      EXPECT_EQ(cmd.args_.get<IntType>().getVal(), 12);
+      EXPECT_EQ(cmd.args_.get<BinaryDataObject>().get(), READHEX("00ff00fb"));
+      EXPECT_FALSE(cmd.args_.hasArgs());
+   };
+
+   //binary round trip
+   auto&& binCmd = buildCmd();
+   binCmd.serialize(WireEncoding_Binary);
+   EXPECT_EQ(WireFrame::getEncoding(binCmd.command_), WireEncoding_Binary);
+   EXPECT_EQ(Command::peekMethod(binCmd.command_),
+      "getLedgerDelegateForScrAddr");
+
+   Command binRead(binCmd.command_);
+   binRead.deserialize();
+   EXPECT_EQ(binRead.encoding_, WireEncoding_Binary);
+   checkCmd(binRead);
+
+   //legacy hex packets are still understood
+   auto&& hexCmd = buildCmd();
+   hexCmd.serialize();
+   EXPECT_EQ(WireFrame::getEncoding(hexCmd.command_), WireEncoding_Hex);
+   EXPECT_EQ(Command::peekMethod(hexCmd.command_),
+      "getLedgerDelegateForScrAddr");
+   EXPECT_LT(binCmd.command_.size(), hexCmd.command_.size());
+
+   Command hexRead(hexCmd.command_);
+   hexRead.deserialize();
+   EXPECT_EQ(hexRead.encoding_, WireEncoding_Hex);
+   checkCmd(hexRead);
+
+   //flipping a payload bit fails the checksum
+   string corrupted = binCmd.command_;
+   corrupted.back() ^= 0x01;
+   Command badCmd(corrupted);
+   EXPECT_THROW(badCmd.deserialize(), runtime_error);
+
+   //reply arguments, encoding is detected on the receiving end
+   Arguments args;
+   args.push_back(move(IntType(7)));
+   auto binArgs = args.serialize(WireEncoding_Binary);
+   auto hexArgs = args.serialize(WireEncoding_Hex);
+
+   Arguments binReply(move(binArgs));
+   EXPECT_EQ(binReply.getEncoding(), WireEncoding_Binary);
+   EXPECT_EQ(binReply.get<IntType>().getVal(), 7);
+
+   Arguments hexReply(move(hexArgs));
+   EXPECT_EQ(hexReply.getEncoding(), WireEncoding_Hex);
+   EXPECT_EQ(hexReply.get<IntType>().getVal(), 7);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+#define P2P_TEST_MAGIC_WORD 0xdab5bffa
+
+vector<uint8_t> makeInvPacket(unsigned count, unsigned seed)
+{
+   vector<InvEntry> invVec(count);
+   for (unsigned i = 0; i < count; i++)
+   {
+      auto& entry = invVec[i];
+      entry.invtype_ = Inv_Msg_Tx;
+      memset(entry.hash, 0, 32);
+      *(uint32_t*)entry.hash = seed;
+      *(uint32_t*)(entry.hash + 4) = i;
+   }
+
+   Payload_Inv payload;
+   payload.setInvVector(move(invVec));
+   return payload.serialize(P2P_TEST_MAGIC_WORD);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(P2PMessageBufferTest, Reassembly)
+{
+   Payload_Ping ping;
+   ping.nonce_ = 0x0123456789abcdef;
+   auto&& pingPacket = ping.serialize(P2P_TEST_MAGIC_WORD);
+   auto&& invPacket = makeInvPacket(300, 1);
+
+   //garbage ahead of and in between messages, with a partial magic word
+   vector<uint8_t> garbage = { 0x01, 0x02, 0xfa, 0xbf, 0xb5, 0x03 };
+
+   vector<uint8_t> stream;
+   stream.insert(stream.end(), garbage.begin(), garbage.end());
+   stream.insert(stream.end(), pingPacket.begin(), pingPacket.end());
+   stream.insert(stream.end(), garbage.begin(), garbage.end());
+   stream.insert(stream.end(), invPacket.begin(), invPacket.end());
+
+   //corrupted checksum, should be skipped
+   auto badPacket = pingPacket;
+   badPacket[CHECKSUM_OFFSET] ^= 0xff;
+   stream.insert(stream.end(), badPacket.begin(), badPacket.end());
+   stream.insert(stream.end(), pingPacket.begin(), pingPacket.end());
+
+   for (size_t chunkSize : { 1, 7, 100, 5000 })
+   {
+      //start small to force a grow on the inv message
+      P2PMessageBuffer buffer(P2P_TEST_MAGIC_WORD, 64);
+      vector<unique_ptr<Payload>> payloads;
+
+      size_t offset = 0;
+      while (offset < stream.size())
+      {
+         auto len = min(chunkSize, stream.size() - offset);
+         auto&& space = buffer.getWriteSpace(len);
+         ASSERT_GE(space.second, len);
+
+         memcpy(space.first, &stream[offset], len);
+         EXPECT_FALSE(buffer.commit(len));
+         offset += len;
+
+         auto&& batch = buffer.deserialize();
+         for (auto& payload : batch)
+            payloads.push_back(move(payload));
+      }
+
+      ASSERT_EQ(payloads.size(), 3);
+      EXPECT_EQ(buffer.pending(), 0);
+
+      ASSERT_EQ(payloads[0]->type(), Payload_ping);
+      EXPECT_EQ(((Payload_Ping*)payloads[0].get())->nonce_, ping.nonce_);
+
+      ASSERT_EQ(payloads[1]->type(), Payload_inv);
+      auto& invVec = ((Payload_Inv*)payloads[1].get())->invVector_;
+      ASSERT_EQ(invVec.size(), 300);
+      EXPECT_EQ(*(uint32_t*)(invVec[299].hash + 4), 299);
+
+      ASSERT_EQ(payloads[2]->type(), Payload_ping);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST(P2PMessageBufferTest, InvThroughput)
+{
+   //100k tx invs in 1000 entry messages, fed in MTU sized reads
+   vector<uint8_t> stream;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      auto&& packet = makeInvPacket(1000, i);
+      stream.insert(stream.end(), packet.begin(), packet.end());
+   }
+
+   //the buffer is recycled, it never needs to grow
+   P2PMessageBuffer buffer(P2P_TEST_MAGIC_WORD);
+   auto capacity = buffer.capacity();
+
+   NodeUnitTest node("localhost", "0", P2P_TEST_MAGIC_WORD);
+   size_t invCount = 0;
+   auto invLbd = [&invCount](vector<InvEntry> invVec)->void
+   {
+      invCount += invVec.size();
+   };
+   node.registerInvTxLambda(invLbd);
+
+   auto start = chrono::steady_clock::now();
+
+   size_t offset = 0, payloadCount = 0;
+   while (offset < stream.size())
+   {
+      auto len = min((size_t)1400, stream.size() - offset);
+      auto&& space = buffer.getWriteSpace(len);
+      memcpy(space.first, &stream[offset], len);
+      buffer.commit(len);
+      offset += len;
+
+      payloadCount += buffer.deserialize().size();
+   }
+
+   //same stream through the stand-in node, down to the inv tx callback
+   node.mockRawData(&stream[0], stream.size());
+
+   auto elapsed = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start).count();
+   double rate = double(invCount) * 1000000.0 /
+      double(max<int64_t>(elapsed, 1));
 
+   RecordProperty("invsPerSec", (int)rate);
+
+   EXPECT_EQ(payloadCount, 100);
+   EXPECT_EQ(invCount, 100000);
+   EXPECT_EQ(buffer.capacity(), capacity);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -2790,6 +3844,313 @@ TEST_F(BlockObjTest, HeaderProperties)
    EXPECT_EQ(BlockHeader(rawHead_).serialize(), rawHead_);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, OrganizeChain)
+{
+   auto&& genesisHash = READHEX(MAINNET_GENESIS_HASH_HEX);
+   Blockchain bc(genesisHash);
+
+   unsigned id = 1;
+   auto makeHeader = [&](const BinaryData& prevHash, uint32_t nonce)->
+      shared_ptr<BlockHeader>
+   {
+      BinaryData raw = rawHead_;
+      memcpy(raw.getPtr() + 4, prevHash.getPtr(), 32);
+      memcpy(raw.getPtr() + 76, &nonce, 4);
+
+      auto bh = make_shared<BlockHeader>(raw);
+      bh->setUniqueID(id);
+      ++id;
+      bc.addNewBlock(bh->getThisHash(), bh, true);
+      return bh;
+   };
+
+   //genesis <- h1 <- h2 <- h3 <- h4
+   //             \<- h2b
+   //orphan <- o2
+   auto h1 = makeHeader(genesisHash, 1);
+   auto h2 = makeHeader(h1->getThisHash(), 2);
+   auto h2b = makeHeader(h1->getThisHash(), 3);
+   auto h3 = makeHeader(h2->getThisHash(), 4);
+   auto h4 = makeHeader(h3->getThisHash(), 5);
+   auto o1 = makeHeader(READHEX(
+      "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff"), 6);
+   auto o2 = makeHeader(o1->getThisHash(), 7);
+
+   //the chain copies the headers it organizes, read them back from it
+   auto get = [&bc](const shared_ptr<BlockHeader>& bh)->shared_ptr<BlockHeader>
+   {
+      return bc.getHeaderByHash(bh->getThisHash());
+   };
+
+   bc.forceOrganize();
+
+   EXPECT_EQ(bc.top()->getThisHash(), h4->getThisHash());
+   EXPECT_EQ(get(h1)->getBlockHeight(), 1);
+   EXPECT_EQ(get(h2)->getBlockHeight(), 2);
+   EXPECT_EQ(get(h2b)->getBlockHeight(), 2);
+   EXPECT_EQ(get(h4)->getBlockHeight(), 4);
+   EXPECT_DOUBLE_EQ(get(h4)->getDifficultySum(),
+      1.0 + 4 * h1->getDifficulty());
+
+   EXPECT_TRUE(get(h2)->isMainBranch());
+   EXPECT_FALSE(get(h2b)->isMainBranch());
+   EXPECT_FALSE(get(h2b)->isOrphan());
+   EXPECT_TRUE(get(o1)->isOrphan());
+   EXPECT_TRUE(get(o2)->isOrphan());
+   EXPECT_EQ(bc.getHeaderByHeight(3)->getThisHash(), h3->getThisHash());
+   EXPECT_EQ(get(h3)->getNextHash(), h4->getThisHash());
+
+   //held across the reorg
+   auto oldH2 = bc.getHeaderByHeight(2);
+   auto oldTop = bc.top();
+
+   //extend the fork past the main branch
+   auto h3b = makeHeader(h2b->getThisHash(), 8);
+   auto h4b = makeHeader(h3b->getThisHash(), 9);
+   auto h5b = makeHeader(h4b->getThisHash(), 10);
+
+   auto&& reorgState = bc.organize(false);
+   EXPECT_FALSE(reorgState.prevTopStillValid_);
+   EXPECT_EQ(reorgState.reorgBranchPoint_->getThisHash(), h1->getThisHash());
+   EXPECT_EQ(reorgState.reorgBranchPoint_, get(h1));
+   EXPECT_EQ(reorgState.prevTop_->getThisHash(), h4->getThisHash());
+   EXPECT_EQ(bc.top()->getThisHash(), h5b->getThisHash());
+   EXPECT_EQ(get(h5b)->getBlockHeight(), 5);
+   EXPECT_TRUE(get(h2b)->isMainBranch());
+   EXPECT_FALSE(get(h2)->isMainBranch());
+   EXPECT_EQ(bc.getHeaderByHeight(2)->getThisHash(), h2b->getThisHash());
+   EXPECT_EQ(get(h1)->getNextHash(), h2b->getThisHash());
+
+   //headers handed out before the reorg keep the state they had
+   EXPECT_TRUE(oldH2->isMainBranch());
+   EXPECT_EQ(oldH2->getThisHash(), h2->getThisHash());
+   EXPECT_EQ(oldTop->getBlockHeight(), 4);
+   EXPECT_EQ(oldTop->getNextHash(), BinaryData(32));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, ChainViewReads)
+{
+   auto&& genesisHash = READHEX(MAINNET_GENESIS_HASH_HEX);
+   Blockchain bc(genesisHash);
+
+   BinaryData prevHash = genesisHash;
+   unsigned id = 0;
+   auto addHeader = [&](void)->shared_ptr<BlockHeader>
+   {
+      BinaryData raw = rawHead_;
+      memcpy(raw.getPtr() + 4, prevHash.getPtr(), 32);
+      memcpy(raw.getPtr() + 76, &id, 4);
+
+      auto bh = make_shared<BlockHeader>(raw);
+      bh->setUniqueID(id);
+      ++id;
+      bc.addNewBlock(bh->getThisHash(), bh, true);
+      prevHash = bh->getThisHash();
+      return bh;
+   };
+
+   addHeader();
+   bc.forceOrganize();
+
+   //readers check the published view is always self consistent while
+   //the chain grows under them
+   atomic<bool> done;
+   done.store(false, memory_order_relaxed);
+   atomic<unsigned> errors;
+   errors.store(0, memory_order_relaxed);
+
+   auto readLbd = [&](void)->void
+   {
+      while (!done.load(memory_order_relaxed))
+      {
+         auto view = bc.getView();
+         auto topHeight = view->top_->getBlockHeight();
+         if (view->headersByHeight_.size() != topHeight + 1 ||
+             view->store_->at(view->headersByHeight_[topHeight]) != view->top_)
+            errors.fetch_add(1, memory_order_relaxed);
+
+         //the organizer doesn't write to headers a view holds: the top 
+         //never gets a next hash and its parent's points to it
+         if (view->top_->getNextHashRef() != BinaryData(32) ||
+             !view->top_->isMainBranch())
+            errors.fetch_add(1, memory_order_relaxed);
+
+         if (topHeight > 0)
+         {
+            auto& parent = view->store_->at(
+               view->headersByHeight_[topHeight - 1]);
+            if (parent->getNextHashRef() != view->top_->getThisHashRef() ||
+                parent->getBlockHeight() != topHeight - 1)
+               errors.fetch_add(1, memory_order_relaxed);
+         }
+
+         auto header = bc.getHeaderByHeight(1);
+         if (bc.getHeaderByHash(header->getThisHash())->getThisHash() !=
+             header->getThisHash())
+            errors.fetch_add(1, memory_order_relaxed);
+      }
+   };
+
+   vector<thread> readers;
+   for (unsigned i = 0; i < 4; i++)
+      readers.push_back(thread(readLbd));
+
+   for (unsigned i = 0; i < 200; i++)
+   {
+      auto bh = addHeader();
+
+      //not organized yet, only the live store has it
+      EXPECT_EQ(bc.getHeaderByHash(bh->getThisHash()), bh);
+      EXPECT_EQ(bc.getHeaderById(bh->getThisID()), bh);
+      EXPECT_FALSE(bc.hasHeaderByHeight(i + 2));
+
+      bc.organize(false);
+      EXPECT_EQ(bc.top()->getThisHash(), bh->getThisHash());
+      EXPECT_EQ(bc.getHeaderByHeight(i + 2), bc.top());
+   }
+
+   done.store(true, memory_order_relaxed);
+   for (auto& thr : readers)
+      thr.join();
+
+   EXPECT_EQ(errors.load(memory_order_relaxed), 0);
+   EXPECT_EQ(bc.top()->getBlockHeight(), 201);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, BlockHeaderStore)
+{
+   BlockHeaderStore store;
+
+   //enough headers to grow the hash table a couple times
+   vector<shared_ptr<BlockHeader>> headers;
+   for (uint32_t i = 0; i < 2000; i++)
+   {
+      BinaryData raw = rawHead_;
+      memcpy(raw.getPtr() + 76, &i, 4);
+      auto bh = make_shared<BlockHeader>(raw);
+      auto id = i * 2;
+      bh->setUniqueID(id);
+
+      auto handle = store.put(bh->getThisHashRef(), bh);
+      EXPECT_EQ(handle, i);
+      EXPECT_TRUE(store.setIdHandle(id, handle, false));
+      headers.push_back(bh);
+   }
+
+   EXPECT_EQ(store.size(), 2000);
+   for (uint32_t i = 0; i < headers.size(); i++)
+   {
+      EXPECT_EQ(store.find(headers[i]->getThisHashRef()), i);
+      EXPECT_EQ(store.getByHash(headers[i]->getThisHashRef()), headers[i]);
+      EXPECT_EQ(store.at(store.findById(i * 2)), headers[i]);
+   }
+
+   EXPECT_EQ(store.find(READHEX(
+      "00112233445566778899aabbccddeeff00112233445566778899aabbccddeeff")),
+      BlockHeaderStore::INVALID_HANDLE);
+   EXPECT_EQ(store.findById(1), BlockHeaderStore::INVALID_HANDLE);
+   EXPECT_EQ(store.findById(10000), BlockHeaderStore::INVALID_HANDLE);
+
+   //putting under an existing hash replaces the header in place
+   auto replacement = make_shared<BlockHeader>(headers[5]->serialize());
+   EXPECT_EQ(store.put(headers[5]->getThisHashRef(), replacement), 5);
+   EXPECT_EQ(store.size(), 2000);
+   EXPECT_EQ(store.getByHash(headers[5]->getThisHashRef()), replacement);
+
+   //ids don't get overwritten unless asked to
+   EXPECT_FALSE(store.setIdHandle(10, 7, false));
+   EXPECT_EQ(store.findById(10), 5);
+   EXPECT_TRUE(store.setIdHandle(10, 7, true));
+   EXPECT_EQ(store.findById(10), 7);
+
+   store.clear();
+   EXPECT_EQ(store.size(), 0);
+   EXPECT_EQ(store.find(headers[0]->getThisHashRef()),
+      BlockHeaderStore::INVALID_HANDLE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, BlockIndexFile)
+{
+   string path("./blockindextest");
+   auto&& magic = READHEX(MAINNET_MAGIC_BYTES);
+
+   BlockIndexFile blockIndex(path, magic);
+   blockIndex.wipe();
+
+   map<BinaryData, shared_ptr<BlockHeader>> loaded;
+   map<BinaryData, pair<uint32_t, uint8_t>> heights;
+   auto callback = [&](shared_ptr<BlockHeader> bh, uint32_t height, uint8_t dup)
+   {
+      loaded[bh->getThisHash()] = bh;
+      heights[bh->getThisHash()] = make_pair(height, dup);
+   };
+
+   EXPECT_FALSE(blockIndex.load(callback));
+
+   Blockchain bc(READHEX(MAINNET_GENESIS_HASH_HEX));
+   auto header = make_shared<BlockHeader>(rawHead_);
+   header->setBlockFileNum(3);
+   header->setBlockFileOffset(123456789012ULL);
+   header->setBlockSize(1024);
+   header->setNumTx(2);
+   unsigned uniqueID = 7;
+   header->setUniqueID(uniqueID);
+   bc.addBlock(header->getThisHash(), header, 120000, 0);
+
+   //full rewrite skips the uninitialized genesis placeholder
+   blockIndex.rewrite(bc.allHeaders()->headers());
+   ASSERT_TRUE(blockIndex.load(callback));
+   ASSERT_EQ(loaded.size(), 1);
+
+   auto& bh = loaded.begin()->second;
+   EXPECT_EQ(bh->getThisHash(), headHashLE_);
+   EXPECT_EQ(bh->serialize(), rawHead_);
+   EXPECT_EQ(bh->getBlockFileNum(), 3);
+   EXPECT_EQ(bh->getOffset(), 123456789012ULL);
+   EXPECT_EQ(bh->getBlockSize(), 1024);
+   EXPECT_EQ(bh->getNumTx(), 2);
+   EXPECT_EQ(bh->getThisID(), 7);
+   EXPECT_DOUBLE_EQ(bh->getDifficulty(), 157416.40184364893);
+   EXPECT_EQ(heights.begin()->second.first, 120000);
+   EXPECT_EQ(heights.begin()->second.second, 0);
+
+   //later records supersede earlier ones
+   header->setDuplicateID(1);
+   blockIndex.append({ header });
+
+   loaded.clear();
+   heights.clear();
+   ASSERT_TRUE(blockIndex.load(callback));
+   ASSERT_EQ(loaded.size(), 1);
+   EXPECT_EQ(heights.begin()->second.second, 1);
+
+   //other network
+   BlockIndexFile testnetIndex(path, READHEX(TESTNET_MAGIC_BYTES));
+   EXPECT_FALSE(testnetIndex.load(callback));
+
+   //torn append
+   {
+      ofstream of(path, ios::binary | ios::app);
+      of.write((const char*)rawHead_.getPtr(), 40);
+   }
+   EXPECT_FALSE(blockIndex.load(callback));
+
+   //garbled record
+   {
+      ofstream of(path, ios::binary | ios::app);
+      of.write((const char*)rawHead_.getPtr(), 
+         BlockIndexFile::RECORD_LENGTH - 40);
+   }
+   EXPECT_FALSE(blockIndex.load(callback));
+
+   blockIndex.wipe();
+   EXPECT_FALSE(blockIndex.load(callback));
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -3038,6 +4399,79 @@ TEST_F(BlockObjTest, TxUnserialize)
    }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockObjTest, TxFilterLayouts)
+{
+   vector<BinaryData> hashes;
+   for (unsigned i = 0; i < 50; i++)
+      hashes.push_back(BtcUtils::getHash256(WRITE_UINT32_LE(i)));
+
+   //duplicate prefix
+   hashes.push_back(hashes[7]);
+
+   TxFilter<TxFilterType> filter(12, hashes.size());
+   filter.update(hashes);
+
+   BinaryWriter bw;
+   filter.serialize(bw);
+   auto sortedData = bw.getData();
+
+   //legacy layout: prefixes in tx order
+   BinaryWriter bwLegacy;
+   bwLegacy.put_uint32_t(12 + hashes.size() * sizeof(TxFilterType));
+   bwLegacy.put_uint32_t(12);
+   bwLegacy.put_uint32_t(hashes.size());
+   for (auto& hash : hashes)
+      bwLegacy.put_BinaryData(hash.getSliceRef(0, sizeof(TxFilterType)));
+   auto legacyData = bwLegacy.getData();
+
+   TxFilter<TxFilterType> sortedFilter(sortedData.getPtr());
+   TxFilter<TxFilterType> legacyFilter(legacyData.getPtr());
+
+   EXPECT_TRUE(sortedFilter.isSorted());
+   EXPECT_FALSE(legacyFilter.isSorted());
+   EXPECT_EQ(sortedFilter.getBlockKey(), 12);
+   EXPECT_EQ(legacyFilter.getBlockKey(), 12);
+
+   for (unsigned i = 0; i < 50; i++)
+   {
+      auto&& sortedHits = sortedFilter.compare(hashes[i]);
+      auto&& legacyHits = legacyFilter.compare(hashes[i]);
+
+      EXPECT_EQ(sortedHits, legacyHits);
+      EXPECT_EQ(sortedHits, filter.compare(hashes[i]));
+      EXPECT_EQ(sortedHits.count(i), 1);
+   }
+
+   auto&& dupHits = sortedFilter.compare(hashes[7]);
+   EXPECT_EQ(dupHits.size(), 2);
+   EXPECT_EQ(dupHits.count(50), 1);
+
+   auto&& missHits = sortedFilter.compare(BtcUtils::getHash256(READHEX("ff")));
+   EXPECT_EQ(missHits.size(), 0);
+
+   //legacy pools reserialize to the sorted layout
+   BinaryWriter bwPool;
+   bwPool.put_uint32_t(1);
+   bwPool.put_BinaryData(legacyData);
+   auto poolData = bwPool.getData();
+
+   TxFilterPool<TxFilterType> pool;
+   pool.deserialize(poolData.getPtr(), poolData.getSize());
+
+   BinaryWriter bwUpgraded;
+   pool.serialize(bwUpgraded);
+   auto upgradedData = bwUpgraded.getData();
+   EXPECT_EQ(upgradedData.getSliceRef(4, sortedData.getSize()), sortedData);
+
+   TxFilterPool<TxFilterType> poolRef(
+      upgradedData.getPtr(), upgradedData.getSize());
+   auto&& poolHits = poolRef.compare(hashes[7]);
+   ASSERT_EQ(poolHits.size(), 1);
+   EXPECT_EQ(poolHits.begin()->first, 12);
+   EXPECT_EQ(poolHits.begin()->second, dupHits);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockObjTest, DISABLED_FullBlock)
 {
@@ -5206,6 +6640,69 @@ TEST_F(LMDBTest, PutGetDelete)
    iface_->deleteValue(HISTORY, PREFIX + keyAB);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, TxHashIndexPutGet)
+{
+   ASSERT_TRUE(standardOpenDBs());
+
+   vector<BinaryData> hashes;
+   for (unsigned i = 0; i < 10; i++)
+      hashes.push_back(BtcUtils::getHash256(WRITE_UINT32_LE(i)));
+
+   //same prefix as hashes[3], different hash
+   auto collision = BtcUtils::getHash256(READHEX("ff"));
+   memcpy(collision.getPtr(), hashes[3].getPtr(), 4);
+
+   TxFilter<TxFilterType> filter0(7, 5);
+   filter0.update(vector<BinaryData>(hashes.begin(), hashes.begin() + 5));
+
+   vector<BinaryData> block1Hashes(hashes.begin() + 5, hashes.end());
+   block1Hashes.push_back(collision);
+   TxFilter<TxFilterType> filter1(8, block1Hashes.size());
+   filter1.update(block1Hashes);
+
+   set<TxFilter<TxFilterType>> filters;
+   filters.insert(filter0);
+   iface_->putTxHashIndexForFileNum(2, filters, true);
+
+   filters.clear();
+   filters.insert(filter1);
+   iface_->putTxHashIndexForFileNum(3, filters, false);
+
+   EXPECT_TRUE(iface_->isTxHashIndexed(2));
+   EXPECT_FALSE(iface_->isTxHashIndexed(3));
+   EXPECT_FALSE(iface_->isTxHashIndexed(4));
+
+   auto&& hits = iface_->getTxHashIndexHits(hashes[1]);
+   ASSERT_EQ(hits.size(), 1);
+   EXPECT_EQ(hits.begin()->first, 2);
+   ASSERT_EQ(hits.begin()->second.size(), 1);
+   EXPECT_EQ(hits.begin()->second.begin()->first, 7);
+   EXPECT_EQ(hits.begin()->second.begin()->second, set<uint32_t>({ 1 }));
+
+   hits = iface_->getTxHashIndexHits(hashes[6]);
+   ASSERT_EQ(hits.size(), 1);
+   EXPECT_EQ(hits[3][8], set<uint32_t>({ 1 }));
+
+   hits = iface_->getTxHashIndexHits(hashes[3]);
+   ASSERT_EQ(hits.size(), 2);
+   EXPECT_EQ(hits[2][7], set<uint32_t>({ 3 }));
+   EXPECT_EQ(hits[3][8], set<uint32_t>({ 5 }));
+
+   hits = iface_->getTxHashIndexHits(BtcUtils::getHash256(READHEX("fe")));
+   EXPECT_EQ(hits.size(), 0);
+
+   //appending to a complete file keeps it flagged
+   iface_->putTxHashIndexForFileNum(2, set<TxFilter<TxFilterType>>(), false);
+   EXPECT_TRUE(iface_->isTxHashIndexed(2));
+
+   //appending to it without indexing drops the flag
+   iface_->clearTxHashIndexForFileNum(2);
+   EXPECT_FALSE(iface_->isTxHashIndexed(2));
+   iface_->putTxHashIndexForFileNum(2, set<TxFilter<TxFilterType>>(), false);
+   EXPECT_FALSE(iface_->isTxHashIndexed(2));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(LMDBTest, STxOutPutGet)
 {
@@ -5270,6 +6767,109 @@ TEST_F(LMDBTest, STxOutPutGet)
 
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, GetManyStxos)
+{
+   ASSERT_TRUE(standardOpenDBs());
+
+   //16 txouts at txIndex 0..15, every third one is spent
+   vector<BinaryData> stxoKeys;
+   {
+      LMDBEnv::Transaction txH(iface_->dbEnv_[STXO].get(), LMDB::ReadWrite);
+      for (uint16_t i = 0; i < 16; i++)
+      {
+         StoredTxOut stxo;
+         stxo.txVersion_   = 1;
+         stxo.blockHeight_ = 123000;
+         stxo.duplicateID_ = 15;
+         stxo.txIndex_     = i;
+         stxo.txOutIndex_  = 1;
+         stxo.unserialize(rawTxOut0_);
+         if (i % 3 == 0)
+         {
+            stxo.spentness_ = TXOUT_SPENT;
+            stxo.spentByTxInKey_ = READHEX("01e0780f00080000");
+         }
+         else
+         {
+            stxo.spentness_ = TXOUT_UNSPENT;
+         }
+
+         iface_->putStoredTxOut(stxo);
+         stxoKeys.push_back(stxo.getDBKey(false));
+      }
+   }
+
+   BinaryData TXP = WRITE_UINT8_BE((uint8_t)DB_PREFIX_TXDATA);
+   BinaryData before = TXP + READHEX("01e0780e00010001");
+   BinaryData missing = TXP + READHEX("01e0780f00030002");
+   BinaryData after = TXP + READHEX("01e0780f00200001");
+
+   //unsorted, with a duplicate and misses before, within and after the range
+   vector<BinaryData> keys;
+   keys.push_back(after);
+   keys.push_back(TXP + stxoKeys[12]);
+   keys.push_back(TXP + stxoKeys[1]);
+   keys.push_back(missing);
+   keys.push_back(TXP + stxoKeys[2]);
+   keys.push_back(TXP + stxoKeys[12]);
+   keys.push_back(before);
+   keys.push_back(TXP + stxoKeys[15]);
+
+   vector<BinaryData> gotKeys;
+   vector<BinaryData> gotVals;
+   {
+      LMDBEnv::Transaction tx(iface_->dbEnv_[STXO].get(), LMDB::ReadOnly);
+      iface_->getMany(STXO, keys,
+         [&gotKeys, &gotVals](const BinaryData& key, BinaryDataRef val)->void
+      {
+         gotKeys.push_back(key);
+         gotVals.push_back(val.copy());
+      });
+   }
+
+   ASSERT_EQ(keys.size(), 7);
+   ASSERT_EQ(gotKeys, keys);
+   EXPECT_EQ(gotKeys[0], before);
+   EXPECT_EQ(gotVals[0].getSize(), 0);
+   EXPECT_EQ(gotKeys[3], missing);
+   EXPECT_EQ(gotVals[3].getSize(), 0);
+   EXPECT_EQ(gotKeys[6], after);
+   EXPECT_EQ(gotVals[6].getSize(), 0);
+
+   vector<unsigned> hits = { 1, 2, 12, 15 };
+   for (unsigned i = 0; i < hits.size(); i++)
+   {
+      StoredTxOut stxo;
+      iface_->getStoredTxOut(stxo, stxoKeys[hits[i]]);
+      EXPECT_EQ(gotVals[i + 1 + (i > 1)],
+         serializeDBValue(stxo, ARMORY_DB_FULL));
+   }
+
+   //flags resolved through the batch have to match the per key lookups
+   StoredSubHistory subssh;
+   for (auto& stxoKey : stxoKeys)
+   {
+      TxIOPair txio;
+      txio.setTxOut(stxoKey);
+      subssh.txioMap_[stxoKey] = txio;
+   }
+
+   TxIOPair orphan;
+   orphan.setTxOut(missing.getSliceCopy(1, 8));
+   subssh.txioMap_[orphan.getDBKeyOfOutput()] = orphan;
+
+   map<BinaryData, StoredSubHistory> subSshMap;
+   subSshMap[READHEX("01e078")] = subssh;
+   iface_->getUTXOflags(subSshMap);
+
+   auto& txioMap = subSshMap[READHEX("01e078")].txioMap_;
+   ASSERT_EQ(txioMap.size(), 17);
+   for (uint16_t i = 0; i < 16; i++)
+      EXPECT_EQ(txioMap[stxoKeys[i]].isUTXO(), i % 3 != 0);
+   EXPECT_FALSE(txioMap[orphan.getDBKeyOfOutput()].isUTXO());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(LMDBTest, PutGetBareHeader)
 {
@@ -5561,6 +7161,81 @@ TEST_F(LMDBTest, PutGetStoredScriptHistory)
    EXPECT_TRUE(txioptr->isMultisig());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(LMDBTest, ReadTxThroughput)
+{
+   //micro benchmark of the read path: every lookup opens and commits its
+   //own read only tx, the way the LMDBBlockDatabase getters do. Lookups per
+   //second are reported per thread count, these should scale with the 
+   //thread count up to the core count
+   LMDBEnv env(1);
+   env.open("ldbtestdir/readbench");
+
+   LMDB db;
+   db.open(&env, "bench");
+
+   const unsigned keyCount = 10000;
+   {
+      LMDBEnv::Transaction tx(&env, LMDB::ReadWrite);
+      for (unsigned i = 0; i < keyCount; i++)
+      {
+         BinaryWriter key, val;
+         key.put_uint32_t(i, BE);
+         val.put_uint64_t(i * 3);
+         db.insert(
+            CharacterArrayRef(key.getSize(), key.getData().getPtr()),
+            CharacterArrayRef(val.getSize(), val.getData().getPtr()));
+      }
+   }
+
+   const unsigned lookupsPerThread = 50000;
+   atomic<unsigned> misses;
+   misses.store(0, memory_order_relaxed);
+
+   auto readLbd = [&](unsigned seed)->void
+   {
+      for (unsigned i = 0; i < lookupsPerThread; i++)
+      {
+         auto id = (seed + i * 7919) % keyCount;
+         BinaryWriter key;
+         key.put_uint32_t(id, BE);
+
+         LMDBEnv::Transaction tx(&env, LMDB::ReadOnly);
+         auto val = db.get_NoCopy(
+            CharacterArrayRef(key.getSize(), key.getData().getPtr()));
+         if (val.len != 8 || 
+            READ_UINT64_LE((const uint8_t*)val.data) != id * 3)
+            misses.fetch_add(1, memory_order_relaxed);
+      }
+   };
+
+   for (unsigned threadCount = 1; threadCount <= 8; threadCount *= 2)
+   {
+      auto start = chrono::steady_clock::now();
+
+      vector<thread> threads;
+      for (unsigned i = 1; i < threadCount; i++)
+         threads.push_back(thread(readLbd, i));
+      readLbd(0);
+
+      for (auto& thr : threads)
+         thr.join();
+
+      auto elapsed = chrono::duration_cast<chrono::microseconds>(
+         chrono::steady_clock::now() - start).count();
+      double rate = double(lookupsPerThread * threadCount) * 1000000.0 /
+         double(max<int64_t>(elapsed, 1));
+
+      RecordProperty(("lookupsPerSec_" + to_string(threadCount)).c_str(),
+         (int)rate);
+   }
+
+   EXPECT_EQ(misses.load(memory_order_relaxed), 0);
+
+   db.close();
+   env.close();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 class TxRefTest : public ::testing::Test
@@ -5870,44 +7545,621 @@ public:
       catch (runtime_error&)
       {}
 
-      return feedPtr_->getByVal(val);
+      return feedPtr_->getByVal(val);
+   }
+
+   const SecureBinaryData& getPrivKeyForPubkey(const BinaryData& pubkey)
+   {
+      try
+      {
+         return testFeed_.getPrivKeyForPubkey(pubkey);
+      }
+      catch (runtime_error&)
+      { }
+
+      return feedPtr_->getPrivKeyForPubkey(pubkey);
+   }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(TransactionsTest, CheckChain_Test)
+{
+   //this test fails because the p2sh tx in our unit test chain are botched
+   //(the input script has opcode when it should only be push data)
+
+   config.threadCount_ = 1;
+   config.checkChain_ = true;
+
+   BlockDataManager bdm(config);
+
+   try
+   {
+      bdm.doInitialSyncOnLoad(nullProgress);
+   }
+   catch (exception&)
+   {
+      //signify the failure
+      EXPECT_TRUE(false);
+   }
+
+   EXPECT_EQ(bdm.getCheckedTxCount(), 20);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(TransactionsTest, NotificationChannel)
+{
+   initBDM();
+
+   //grab a free port for the notification server
+   auto probefd = socket(AF_INET, SOCK_STREAM, 0);
+   sockaddr_in saddr;
+   memset(&saddr, 0, sizeof(saddr));
+   saddr.sin_family = AF_INET;
+   saddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   saddr.sin_port = 0;
+   ASSERT_EQ(::bind(probefd, (sockaddr*)&saddr, sizeof(saddr)), 0);
+   socklen_t saddrLen = sizeof(saddr);
+   getsockname(probefd, (sockaddr*)&saddr, &saddrLen);
+   auto port = ntohs(saddr.sin_port);
+   BinarySocket::closeSocket(probefd);
+
+   clients_->startNotificationServer("127.0.0.1", to_string(port));
+   ASSERT_EQ(clients_->getNotificationPort(), port);
+
+   theBDMt_->start(config.initMode_);
+
+   //registerBDV advertises the push port
+   Command cmd;
+   cmd.method_ = "registerBDV";
+   BinaryDataObject bdo(magic_);
+   cmd.args_.push_back(move(bdo));
+   cmd.serialize();
+
+   auto&& result = clients_->runCommand(cmd.command_);
+   auto& argVec = result.getArgVector();
+   ASSERT_EQ(argVec.size(), 2);
+   auto bdvId = dynamic_pointer_cast<DataObject<BinaryDataObject>>(argVec[0]);
+   auto portArg = dynamic_pointer_cast<DataObject<IntType>>(argVec[1]);
+   ASSERT_NE(portArg, nullptr);
+   EXPECT_EQ(portArg->getObj().getVal(), port);
+   auto bdvID = bdvId->getObj().toStr();
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   //subscribe
+   auto channel = SwigClient::RequestChannel::connect(
+      "127.0.0.1", to_string(port), bdvID);
+   ASSERT_NE(channel, nullptr);
+
+   //BDM_Ready is pushed without a registerCallback request
+   goOnline(clients_, bdvID);
+
+   auto waitOnNotification = [&channel](const string& signal)->bool
+   {
+      while (1)
+      {
+         string packet;
+         try
+         {
+            packet = channel->popNotification(chrono::milliseconds(10000));
+         }
+         catch (StackTimedOutException&)
+         {
+            return false;
+         }
+
+         //channel dropped
+         if (packet.size() == 0)
+            return false;
+
+         Arguments args(move(packet));
+         EXPECT_EQ(args.getEncoding(), WireEncoding_Binary);
+
+         //notifications lead with their type
+         if (args.hasArgs() && 
+            args.get<BinaryDataObject>().toStr() == signal)
+            return true;
+      }
+   };
+
+   EXPECT_TRUE(waitOnNotification("BDM_Ready"));
+   EXPECT_TRUE(getBDV(clients_, bdvID)->getCallback()->isValid());
+
+   //pipelined commands, replies are matched on request id
+   auto&& balances = getBalanceAndCount(clients_, bdvID, "wallet1", 4);
+   auto&& page = getHistoryPage(clients_, bdvID, 
+      getLedgerDelegate(clients_, bdvID), 0);
+   ASSERT_NE(page.size(), 0);
+
+   vector<future<string>> balanceReplies, pageReplies;
+   for (unsigned i = 0; i < 10; i++)
+   {
+      Command balanceCmd;
+      balanceCmd.method_ = "getBalancesAndCount";
+      balanceCmd.ids_.push_back(bdvID);
+      balanceCmd.ids_.push_back("wallet1");
+      balanceCmd.args_.push_back(move(IntType(4)));
+      balanceReplies.push_back(channel->send(balanceCmd));
+
+      Command pageCmd;
+      pageCmd.method_ = "getHistoryPage";
+      pageCmd.ids_.push_back(bdvID);
+      pageCmd.ids_.push_back("wallet1");
+      pageCmd.args_.push_back(move(IntType(0)));
+      pageReplies.push_back(channel->send(pageCmd));
+   }
+
+   for (auto& reply : balanceReplies)
+   {
+      Arguments args(reply.get());
+      EXPECT_EQ(args.getEncoding(), WireEncoding_Binary);
+      for (auto& val : balances)
+         EXPECT_EQ(args.get<IntType>().getVal(), val);
+   }
+
+   for (auto& reply : pageReplies)
+   {
+      Arguments args(reply.get());
+      auto&& lev = args.get<LedgerEntryVector>();
+      EXPECT_EQ(lev.toVector().size(), page.size());
+   }
+
+   //long polls are refused
+   Command pollCmd;
+   pollCmd.method_ = "registerCallback";
+   pollCmd.ids_.push_back(bdvID);
+   BinaryDataObject pollArg("getStatus");
+   pollCmd.args_.push_back(move(pollArg));
+   Arguments pollReply(channel->send(pollCmd).get());
+   EXPECT_THROW(pollReply.get<BinaryDataObject>(), DbErrorMsg);
+
+   //bdv teardown pushes terminate, then drops the channel
+   clients_->unregisterBDV(bdvID);
+   EXPECT_TRUE(waitOnNotification("terminate"));
+   EXPECT_FALSE(waitOnNotification("terminate"));
+
+   Command lateCmd;
+   lateCmd.method_ = "getNodeStatus";
+   lateCmd.ids_.push_back(bdvID);
+   EXPECT_THROW(channel->send(lateCmd), SocketError);
+
+   //raw connections, for packets the client would never send
+   auto rawConnect = [&saddr](void)->SOCKET
+   {
+      auto sockfd = socket(AF_INET, SOCK_STREAM, 0);
+      if (connect(sockfd, (sockaddr*)&saddr, sizeof(saddr)) != 0)
+      {
+         BinarySocket::closeSocket(sockfd);
+         return SOCK_MAX;
+      }
+
+      timeval tv;
+      tv.tv_sec = 10;
+      tv.tv_usec = 0;
+      setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv, sizeof(tv));
+      return sockfd;
+   };
+
+   auto rawSend = [](SOCKET sockfd, const BinaryData& data)->void
+   {
+      ASSERT_EQ(send(sockfd, (char*)data.getPtr(), data.getSize(), 0), 
+         (ssize_t)data.getSize());
+   };
+
+   //true if the server closed the socket, skips pushed notifications
+   auto isClosedByServer = [](SOCKET sockfd)->bool
+   {
+      char buf[1024];
+      while (1)
+      {
+         auto readCount = recv(sockfd, buf, sizeof(buf), 0);
+         if (readCount <= 0)
+            return readCount == 0;
+      }
+   };
+
+   //bdv id lengths past BDV_ID_LENGTH are refused before buffering them
+   {
+      auto sockfd = rawConnect();
+      ASSERT_NE(sockfd, SOCK_MAX);
+
+      BinaryWriter bw;
+      bw.put_var_int(0x10000000);
+      bw.put_BinaryData(BinaryData(64));
+      rawSend(sockfd, bw.getData());
+
+      EXPECT_TRUE(isClosedByServer(sockfd));
+      BinarySocket::closeSocket(sockfd);
+   }
+
+   //so are pipelined frames past MAX_CONTENT_LENGTH
+   {
+      auto&& bdvID2 = registerBDV(clients_, magic_);
+      auto sockfd = rawConnect();
+      ASSERT_NE(sockfd, SOCK_MAX);
+
+      BinaryWriter bw;
+      bw.put_var_int(bdvID2.size());
+      bw.put_BinaryData(BinaryData(bdvID2));
+      bw.put_uint32_t(0xFFFFFFF0);
+      bw.put_uint32_t(1);
+      bw.put_BinaryData(BinaryData(64));
+      rawSend(sockfd, bw.getData());
+
+      EXPECT_TRUE(isClosedByServer(sockfd));
+      BinarySocket::closeSocket(sockfd);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(TransactionsTest, CombinedWalletState)
+{
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   vector<BinaryData> scrAddrVec2;
+   scrAddrVec2.push_back(TestChain::scrAddrD);
+   scrAddrVec2.push_back(TestChain::scrAddrE);
+   regWallet(clients_, bdvID, scrAddrVec2, "wallet2");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto height = bdvPtr->getTopBlockHeight();
+
+   auto getCombinedState = [&](const vector<BinaryData>& ids, 
+      bool withAddrData, bool withUtxos)->Arguments
+   {
+      Command cmd;
+      cmd.method_ = "getCombinedWalletState";
+      cmd.ids_.push_back(bdvID);
+      cmd.args_.push_back(move(BinaryDataVector(ids)));
+      cmd.args_.push_back(move(IntType(height)));
+      cmd.args_.push_back(move(IntType(withAddrData)));
+      cmd.args_.push_back(move(IntType(withUtxos)));
+      cmd.serialize();
+
+      auto&& result = clients_->runCommand(cmd.command_);
+      return Arguments(result.serialize());
+   };
+
+   //wallets are returned in request order, with the same values as the 
+   //per wallet methods
+   vector<BinaryData> wltIDs = { wallet2id, wallet1id };
+   auto&& args = getCombinedState(wltIDs, true, true);
+   ASSERT_EQ(args.get<IntType>().getVal(), 2);
+
+   for (auto& id : wltIDs)
+   {
+      EXPECT_EQ(args.get<BinaryDataObject>().get(), id);
+
+      auto&& balances = getBalanceAndCount(clients_, bdvID, id.toBinStr(), height);
+      for (auto& val : balances)
+         EXPECT_EQ(args.get<IntType>().getVal(), val);
+
+      auto wlt = bdvPtr->getWalletOrLockbox(id);
+
+      auto countSize = args.get<IntType>().getVal();
+      EXPECT_NE(countSize, 0);
+      for (unsigned i = 0; i < countSize; i++)
+      {
+         BinaryData addr = args.get<BinaryDataObject>().get();
+         auto scrAddrObj = wlt->getScrAddrObjByKey(addr);
+         ASSERT_NE(scrAddrObj, nullptr);
+         EXPECT_EQ(args.get<IntType>().getVal(),
+            scrAddrObj->getTxioCountFromSSH());
+      }
+
+      auto balanceSize = args.get<IntType>().getVal();
+      EXPECT_NE(balanceSize, 0);
+      for (unsigned i = 0; i < balanceSize; i++)
+      {
+         BinaryData addr = args.get<BinaryDataObject>().get();
+         auto scrAddrObj = wlt->getScrAddrObjByKey(addr);
+         ASSERT_NE(scrAddrObj, nullptr);
+         EXPECT_EQ(args.get<IntType>().getVal(), 
+            scrAddrObj->getFullBalance());
+         EXPECT_EQ(args.get<IntType>().getVal(), 
+            scrAddrObj->getSpendableBalance(height));
+         EXPECT_EQ(args.get<IntType>().getVal(), 
+            scrAddrObj->getUnconfirmedBalance(height));
+      }
+
+      auto&& utxoVec = wlt->getSpendableTxOutListForValue(UINT64_MAX);
+      ASSERT_EQ(args.get<IntType>().getVal(), utxoVec.size());
+      for (auto& utxo : utxoVec)
+      {
+         UTXO entry;
+         entry.unserialize(args.get<BinaryDataObject>().get());
+         EXPECT_EQ(entry.getTxHash(), utxo.getTxHash());
+         EXPECT_EQ(entry.getTxOutIndex(), utxo.getTxOutIndex());
+         EXPECT_EQ(entry.getValue(), utxo.getValue());
+      }
+   }
+
+   EXPECT_FALSE(args.hasArgs());
+
+   //txn counts are a delta, they were consumed by the previous call
+   auto&& deltaArgs = getCombinedState({ wallet1id }, true, false);
+   ASSERT_EQ(deltaArgs.get<IntType>().getVal(), 1);
+   EXPECT_EQ(deltaArgs.get<BinaryDataObject>().get(), wallet1id);
+   for (unsigned i = 0; i < 4; i++)
+      deltaArgs.get<IntType>();
+   EXPECT_EQ(deltaArgs.get<IntType>().getVal(), 0);
+
+   //unknown and duplicate ids fail the whole batch
+   EXPECT_THROW(getCombinedState(
+      { wallet1id, BinaryData("nope") }, false, false), runtime_error);
+   EXPECT_THROW(getCombinedState(
+      { wallet1id, wallet1id }, false, false), runtime_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(TransactionsTest, StreamMethods)
+{
+   initBDM();
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   scrAddrVec.push_back(TestChain::scrAddrD);
+   scrAddrVec.push_back(TestChain::scrAddrE);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   //records the batches as they would be sent
+   struct RecordingStream : public ResponseStream
+   {
+      vector<string> batches_;
+
+      void write(Arguments& batch)
+      {
+         batches_.push_back(batch.serialize(WireEncoding_Binary));
+      }
+   };
+
+   auto runStream = [&](Command& cmd)->vector<string>
+   {
+      cmd.serialize(WireEncoding_Binary);
+
+      RecordingStream stream;
+      clients_->runStreamCommand(cmd.command_, stream);
+      return stream.batches_;
+   };
+
+   auto readUtxos = [](const vector<string>& batches)->vector<UTXO>
+   {
+      vector<UTXO> utxoVec;
+      for (unsigned i = 0; i < batches.size(); i++)
+      {
+         Arguments args(batches[i]);
+         auto count = args.get<IntType>().getVal();
+
+         //only the last batch is empty
+         EXPECT_EQ(count == 0, i == batches.size() - 1);
+         for (unsigned y = 0; y < count; y++)
+         {
+            UTXO utxo;
+            utxo.unserialize(args.get<BinaryDataObject>().get());
+            utxoVec.push_back(move(utxo));
+         }
+
+         EXPECT_FALSE(args.hasArgs());
+      }
+
+      return utxoVec;
+   };
+
+   auto checkUtxos = [](Arguments& args, const vector<UTXO>& utxoVec)->void
+   {
+      ASSERT_EQ(args.get<IntType>().getVal(), utxoVec.size());
+      for (auto& utxo : utxoVec)
+      {
+         UTXO entry;
+         entry.unserialize(args.get<BinaryDataObject>().get());
+         EXPECT_EQ(entry.getTxHash(), utxo.getTxHash());
+         EXPECT_EQ(entry.getTxOutIndex(), utxo.getTxOutIndex());
+         EXPECT_EQ(entry.getValue(), utxo.getValue());
+      }
+   };
+
+   //utxos for address list, compare with the regular method
+   {
+      Command cmd;
+      cmd.method_ = "streamUTXOsForAddrList";
+      cmd.ids_.push_back(bdvID);
+      cmd.args_.push_back(move(BinaryDataVector(scrAddrVec)));
+
+      auto&& utxoVec = readUtxos(runStream(cmd));
+      EXPECT_NE(utxoVec.size(), 0);
+
+      Command regCmd;
+      regCmd.method_ = "getUTXOsForAddrList";
+      regCmd.ids_.push_back(bdvID);
+      regCmd.args_.push_back(move(BinaryDataVector(scrAddrVec)));
+      regCmd.serialize();
+
+      auto&& result = clients_->runCommand(regCmd.command_);
+      Arguments args(result.serialize());
+      checkUtxos(args, utxoVec);
+   }
+
+   //spendable utxos for wallet
+   {
+      Command cmd;
+      cmd.method_ = "streamSpendableTxOutListForValue";
+      cmd.ids_.push_back(bdvID);
+      cmd.ids_.push_back("wallet1");
+      cmd.args_.push_back(move(IntType(UINT64_MAX)));
+
+      auto&& utxoVec = readUtxos(runStream(cmd));
+      EXPECT_NE(utxoVec.size(), 0);
+
+      Command regCmd;
+      regCmd.method_ = "getSpendableTxOutListForValue";
+      regCmd.ids_.push_back(bdvID);
+      regCmd.ids_.push_back("wallet1");
+      regCmd.args_.push_back(move(IntType(UINT64_MAX)));
+      regCmd.serialize();
+
+      auto&& result = clients_->runCommand(regCmd.command_);
+      Arguments args(result.serialize());
+      checkUtxos(args, utxoVec);
+   }
+
+   //history, one batch entry per page. Through runCommand the batches are 
+   //gathered in a single reply
+   {
+      Command cmd;
+      cmd.method_ = "streamHistoryForWalletSelection";
+      cmd.ids_.push_back(bdvID);
+      cmd.args_.push_back(move(BinaryDataVector({ wallet1id })));
+      cmd.args_.push_back(move(BinaryDataObject("descending")));
+      cmd.serialize();
+
+      auto&& result = clients_->runCommand(cmd.command_);
+      Arguments args(result.serialize());
+
+      vector<LedgerEntryData> streamedVec;
+      while (1)
+      {
+         auto count = args.get<IntType>().getVal();
+         if (count == 0)
+            break;
+
+         for (unsigned i = 0; i < count; i++)
+         {
+            auto&& lev = args.get<LedgerEntryVector>();
+            auto& page = lev.toVector();
+            streamedVec.insert(streamedVec.end(), page.begin(), page.end());
+         }
+      }
+      EXPECT_FALSE(args.hasArgs());
+
+      Command regCmd;
+      regCmd.method_ = "getHistoryForWalletSelection";
+      regCmd.ids_.push_back(bdvID);
+      regCmd.args_.push_back(move(BinaryDataVector({ wallet1id })));
+      regCmd.args_.push_back(move(BinaryDataObject("descending")));
+      regCmd.serialize();
+
+      auto&& regResult = clients_->runCommand(regCmd.command_);
+      Arguments regArgs(regResult.serialize());
+      auto&& regLev = regArgs.get<LedgerEntryVector>();
+      auto& regVec = regLev.toVector();
+
+      ASSERT_NE(regVec.size(), 0);
+      ASSERT_EQ(streamedVec.size(), regVec.size());
+      for (unsigned i = 0; i < regVec.size(); i++)
+      {
+         EXPECT_EQ(streamedVec[i].getTxHash(), regVec[i].getTxHash());
+         EXPECT_EQ(streamedVec[i].getValue(), regVec[i].getValue());
+      }
    }
 
-   const SecureBinaryData& getPrivKeyForPubkey(const BinaryData& pubkey)
+   //errors are sent as a batch
    {
-      try
-      {
-         return testFeed_.getPrivKeyForPubkey(pubkey);
-      }
-      catch (runtime_error&)
-      { }
+      Command cmd;
+      cmd.method_ = "streamSpendableTxOutListForValue";
+      cmd.ids_.push_back(bdvID);
+      cmd.ids_.push_back("nope");
+      cmd.args_.push_back(move(IntType(UINT64_MAX)));
 
-      return feedPtr_->getPrivKeyForPubkey(pubkey);
+      auto&& batches = runStream(cmd);
+      ASSERT_EQ(batches.size(), 1);
+      Arguments args(batches[0]);
+      EXPECT_THROW(args.get<IntType>(), DbErrorMsg);
    }
-};
+}
 
 ////////////////////////////////////////////////////////////////////////////////
-TEST_F(TransactionsTest, CheckChain_Test)
+TEST_F(TransactionsTest, ServerStats)
 {
-   //this test fails because the p2sh tx in our unit test chain are botched
-   //(the input script has opcode when it should only be push data)
+   initBDM();
 
-   config.threadCount_ = 1;
-   config.checkChain_ = true;
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
 
-   BlockDataManager bdm(config);
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
 
-   try
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   for (unsigned i = 0; i < 3; i++)
+      getBalanceAndCount(clients_, bdvID, "wallet1", 5);
+
+   //a failing call
    {
-      bdm.doInitialSyncOnLoad(nullProgress);
+      Command cmd;
+      cmd.method_ = "hasHeaderWithHash";
+      cmd.ids_.push_back(bdvID);
+      cmd.ids_.push_back("extra");
+      cmd.args_.push_back(move(BinaryDataObject(READHEX(
+         "0000000000000000000000000000000000000000000000000000000000000000"))));
+      cmd.serialize();
+      EXPECT_THROW(clients_->runCommand(cmd.command_), runtime_error);
    }
-   catch (exception&)
+
+   Command cmd;
+   cmd.method_ = "getServerStats";
+   cmd.serialize();
+   auto&& result = clients_->runCommand(cmd.command_);
+   Arguments args(result.serialize());
+
+   map<string, vector<uint64_t>> statsMap;
+   auto count = args.get<IntType>().getVal();
+   for (unsigned i = 0; i < count; i++)
    {
-      //signify the failure
-      EXPECT_TRUE(false);
+      auto name = args.get<BinaryDataObject>().toStr();
+      auto& vals = statsMap[name];
+
+      //calls, errors, 2x (count, sum, max, p50, p90, p99, p999)
+      for (unsigned y = 0; y < 16; y++)
+         vals.push_back(args.get<IntType>().getVal());
    }
 
-   EXPECT_EQ(bdm.getCheckedTxCount(), 20);
+   auto iter = statsMap.find("getBalancesAndCount");
+   ASSERT_TRUE(iter != statsMap.end());
+   EXPECT_EQ(iter->second[0], 3);
+   EXPECT_EQ(iter->second[1], 0);
+   EXPECT_EQ(iter->second[9], 3);
+
+   //percentiles are ordered and capped by max
+   auto& exec = iter->second;
+   EXPECT_LE(exec[12], exec[13]);
+   EXPECT_LE(exec[13], exec[14]);
+   EXPECT_LE(exec[14], exec[15]);
+   EXPECT_LE(exec[15], exec[11]);
+
+   iter = statsMap.find("hasHeaderWithHash");
+   ASSERT_TRUE(iter != statsMap.end());
+   EXPECT_EQ(iter->second[0], 1);
+   EXPECT_EQ(iter->second[1], 1);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -10595,6 +12847,9 @@ TEST_F(BlockUtilsBare, Load3Blocks_ZC_Plus3_TestLedgers)
    EXPECT_EQ(le.getValue(),  3000000000);
    EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
 
+   //zc are persisted asynchronously, wait on the writer
+   theBDMt_->bdm()->zeroConfCont()->flushZCinDB();
+
    //pull ZC from DB, verify it's carrying the proper data
    LMDBEnv::Transaction *dbtx = 
       new LMDBEnv::Transaction(iface_->dbEnv_[ZERO_CONF].get(), LMDB::ReadOnly);
@@ -10944,6 +13199,309 @@ TEST_F(BlockUtilsBare, Load3Blocks_ZCchain)
    EXPECT_FALSE(le.isChainedZC());
 }
 
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load3Blocks_ZCchain_SingleBatch)
+{
+   //copy the first 3 blocks
+   setBlocks({ "0", "1", "2" }, blk0dat_);
+
+   //get ZCs
+   auto&& ZC1 = getTx(3, 4); //block 3, tx 4
+   auto&& ZC2 = getTx(5, 1); //block 5, tx 1
+
+   auto&& ZChash1 = BtcUtils::getHash256(ZC1);
+   auto&& ZChash2 = BtcUtils::getHash256(ZC2);
+
+   //the child comes first, it gets the lower zc key
+   ZcVector zcVec;
+   zcVec.push_back(move(ZC2), 1500000000);
+   zcVec.push_back(move(ZC1), 1400000000);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   //parent and child are parsed in one batch
+   pushNewZc(theBDMt_, zcVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrA);
+   EXPECT_EQ(scrObj->getFullBalance(), 50 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 20 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 10 * COIN);
+
+   EXPECT_EQ(wlt->getFullBalance(), 80 * COIN);
+
+   LedgerEntry le = wlt->getLedgerEntryForTx(ZChash1);
+   EXPECT_EQ(le.getValue(), -25 * COIN);
+   EXPECT_FALSE(le.isChainedZC());
+
+   le = wlt->getLedgerEntryForTx(ZChash2);
+   EXPECT_EQ(le.getValue(), 30 * COIN);
+   EXPECT_TRUE(le.isChainedZC());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load3Blocks_ZC_BatchedGetData)
+{
+   //copy the first 3 blocks
+   setBlocks({ "0", "1", "2" }, blk0dat_);
+
+   auto&& ZC1 = getTx(3, 4); //block 3, tx 4
+   auto&& ZC2 = getTx(5, 1); //block 5, tx 1
+
+   auto&& ZChash1 = BtcUtils::getHash256(ZC1);
+   auto&& ZChash2 = BtcUtils::getHash256(ZC2);
+   auto&& unknownHash = READHEX(
+      "000102030405060708090A0B0C0D0E0F000102030405060708090A0B0C0D0E0F");
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   //announce the zc, ZC1 twice
+   vector<InvEntry> invVec;
+   for (auto hashPtr : { &ZChash1, &ZChash2, &ZChash1, &unknownHash })
+   {
+      InvEntry entry;
+      entry.invtype_ = Inv_Msg_Tx;
+      memcpy(entry.hash, hashPtr->getPtr(), 32);
+      invVec.push_back(entry);
+   }
+
+   auto nodeUnitTest = 
+      (NodeUnitTest*)theBDMt_->bdm()->networkNode_.get();
+   nodeUnitTest->mockInvTx(invVec);
+
+   //all unique hashes are asked for in a single getdata
+   vector<vector<InvEntry>> getDataVec;
+   for (unsigned i = 0; i < 100; i++)
+   {
+      getDataVec = nodeUnitTest->getDataRequests();
+      if (getDataVec.size() > 0)
+         break;
+
+      this_thread::sleep_for(chrono::milliseconds(10));
+   }
+
+   ASSERT_GT(getDataVec.size(), 0);
+   ASSERT_EQ(getDataVec[0].size(), 3);
+   EXPECT_EQ(BinaryData(getDataVec[0][0].hash, 32), ZChash1);
+   EXPECT_EQ(BinaryData(getDataVec[0][1].hash, 32), ZChash2);
+   EXPECT_EQ(BinaryData(getDataVec[0][2].hash, 32), unknownHash);
+   EXPECT_EQ(getDataVec[0][0].invtype_, Inv_Msg_Witness_Tx);
+
+   //reply to the requests
+   nodeUnitTest->mockTx(ZC1);
+   waitOnNewZcSignal(clients_, bdvID);
+   nodeUnitTest->mockTx(ZC2);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 20 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 10 * COIN);
+
+   //known zc are not requested again
+   auto requestCount = nodeUnitTest->getDataRequests().size();
+   vector<InvEntry> knownVec;
+   knownVec.push_back(invVec[0]);
+   nodeUnitTest->mockInvTx(knownVec);
+   this_thread::sleep_for(chrono::milliseconds(50));
+
+   getDataVec = nodeUnitTest->getDataRequests();
+   for (unsigned i = requestCount; i < getDataVec.size(); i++)
+   {
+      for (auto& entry : getDataVec[i])
+         EXPECT_NE(BinaryData(entry.hash, 32), ZChash1);
+   }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load3Blocks_ZCchain_IncrementalPurge)
+{
+   //copy the first 3 blocks
+   setBlocks({ "0", "1", "2" }, blk0dat_);
+
+   //get ZCs
+   auto&& ZC1 = getTx(3, 4); //block 3, tx 4
+   auto&& ZC2 = getTx(5, 1); //block 5, tx 1
+
+   auto&& ZChash1 = BtcUtils::getHash256(ZC1);
+   auto&& ZChash2 = BtcUtils::getHash256(ZC2);
+
+   Tx zcTx2(ZC2);
+   auto&& op = zcTx2.getTxInCopy(0).getOutPoint();
+   EXPECT_EQ(op.getTxHash(), ZChash1);
+
+   ZcVector zcVec;
+   zcVec.push_back(move(ZC1), 1400000000);
+   zcVec.push_back(move(ZC2), 1500000000);
+
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   auto bdvPtr = getBDV(clients_, bdvID);
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+   auto wlt = bdvPtr->getWalletOrLockbox(wallet1id);
+
+   pushNewZc(theBDMt_, zcVec);
+   waitOnNewZcSignal(clients_, bdvID);
+
+   auto zcCont = theBDMt_->bdm()->zeroConfCont();
+   auto&& zcKey1 = zcCont->getTxByHash(ZChash1).getTxRef().getDBKey();
+   auto&& zcKey2 = zcCont->getTxByHash(ZChash2).getTxRef().getDBKey();
+   EXPECT_EQ(zcKey1.getSize(), 6);
+   EXPECT_EQ(zcKey2.getSize(), 6);
+
+   //ZC2 spends an output of ZC1
+   auto spentKey = zcKey1;
+   spentKey.append(WRITE_UINT16_BE(op.getTxOutIndex()));
+   EXPECT_TRUE(zcCont->isTxOutSpentByZC(spentKey));
+
+   //mine ZC1
+   setBlocks({ "0", "1", "2", "3" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   //ZC1 is gone, ZC2 keeps its key but no longer points at ZC1
+   EXPECT_FALSE(zcCont->hasTxByHash(ZChash1));
+   EXPECT_TRUE(zcCont->hasTxByHash(ZChash2));
+   EXPECT_FALSE(zcCont->isTxOutSpentByZC(spentKey));
+
+   auto&& zcTx = zcCont->getTxByHash(ZChash2);
+   EXPECT_EQ(zcTx.getTxRef().getDBKey(), zcKey2);
+   EXPECT_FALSE(zcTx.isChained());
+
+   auto txiomap = zcCont->getFullTxioMap();
+   for (auto& saPair : *txiomap)
+   {
+      for (auto& txioPair : *saPair.second)
+      {
+         EXPECT_FALSE(txioPair.first.startsWith(zcKey1));
+         if (txioPair.second.hasTxIn())
+         {
+            EXPECT_EQ(
+               txioPair.second.getDBKeyOfInput().getSliceCopy(0, 6), zcKey2);
+         }
+      }
+   }
+
+   auto le = wlt->getLedgerEntryForTx(ZChash2);
+   EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
+
+   //mine ZC2
+   setBlocks({ "0", "1", "2", "3", "4", "5" }, blk0dat_);
+   triggerNewBlockNotification(theBDMt_);
+   waitOnNewBlockSignal(clients_, bdvID);
+
+   EXPECT_FALSE(zcCont->hasTxByHash(ZChash2));
+   EXPECT_EQ(zcCont->getFullTxioMap()->size(), 0);
+
+   const ScrAddrObj* scrObj;
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrB);
+   EXPECT_EQ(scrObj->getFullBalance(), 70 * COIN);
+   scrObj = wlt->getScrAddrObjByKey(TestChain::scrAddrC);
+   EXPECT_EQ(scrObj->getFullBalance(), 20 * COIN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TEST_F(BlockUtilsBare, Load5Blocks_ZC_DropMinedOnLoad)
+{
+   theBDMt_->start(config.initMode_);
+   auto&& bdvID = registerBDV(clients_, magic_);
+
+   vector<BinaryData> scrAddrVec;
+   scrAddrVec.push_back(TestChain::scrAddrA);
+   scrAddrVec.push_back(TestChain::scrAddrB);
+   scrAddrVec.push_back(TestChain::scrAddrC);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   //wait on signals
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   //restart bdm
+   clients_->exitRequestLoop();
+   clients_->shutdown();
+
+   delete clients_;
+   delete theBDMt_;
+
+   initBDM();
+
+   //simulate a crash before the deletion of a mined zc was committed: 
+   //tx 5|1 is in the chain but still in the zc db
+   auto&& rawTx = getTx(5, 1);
+   auto&& txHash = BtcUtils::getHash256(rawTx);
+
+   BinaryData zcKey = WRITE_UINT16_BE(0xFFFF);
+   zcKey.append(WRITE_UINT32_LE(0));
+
+   {
+      LMDBEnv::Transaction dbtx(
+         iface_->dbEnv_[ZERO_CONF].get(), LMDB::ReadWrite);
+
+      Tx zctx(rawTx);
+      StoredTx zcStx;
+      zcStx.createFromTx(zctx, true, true);
+      iface_->putStoredZC(zcStx, zcKey);
+   }
+
+   theBDMt_->start(config.initMode_);
+   bdvID = registerBDV(clients_, magic_);
+   regWallet(clients_, bdvID, scrAddrVec, "wallet1");
+
+   goOnline(clients_, bdvID);
+   waitOnBDMReady(clients_, bdvID);
+
+   auto zcCont = theBDMt_->bdm()->zeroConfCont();
+   zcCont->flushZCinDB();
+   EXPECT_FALSE(zcCont->hasTxByHash(txHash));
+
+   LMDBEnv::Transaction dbtx(
+      iface_->dbEnv_[ZERO_CONF].get(), LMDB::ReadOnly);
+   StoredTx zcStx;
+   EXPECT_FALSE(iface_->getStoredZcTx(zcStx, zcKey));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 TEST_F(BlockUtilsBare, Load3Blocks_RBF)
 {
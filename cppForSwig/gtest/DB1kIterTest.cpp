@@ -618,6 +618,9 @@ TEST_F(DB1kIter, DbInit1kIter_WithSignals)
       EXPECT_EQ(le.getValue(), 3000000000);
       EXPECT_EQ(le.getBlockNum(), UINT32_MAX);
 
+      //zc are persisted asynchronously, wait on the writer
+      theBDMt_->bdm()->zeroConfCont()->flushZCinDB();
+
       //pull ZC from DB, verify it's carrying the proper data
       LMDBEnv::Transaction *dbtx =
          new LMDBEnv::Transaction(iface_->dbEnv_[ZERO_CONF].get(), LMDB::ReadOnly);
@@ -642,13 +642,12 @@ vector<LedgerEntryData> getHistoryPage(Clients* clients, const string& bdvId,
 
    cmd.serialize();
 
+   //history pages are serialized in place, read them back from the wire
    auto&& result = clients->runCommand(cmd.command_);
-   auto& argVec = result.getArgVector();
-
-   auto lev = dynamic_pointer_cast<DataObject<LedgerEntryVector>>(argVec[0]);
+   Arguments args(result.serialize());
 
-   auto levData = lev->getObj().toVector();
-   return levData;
+   auto&& lev = args.get<LedgerEntryVector>();
+   return lev.toVector();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
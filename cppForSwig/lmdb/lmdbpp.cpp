@@ -25,6 +25,56 @@ static std::string errorString(int rc)
    return mdb_strerror(rc);
 }
 
+namespace
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //per thread list of the tx infos this thread uses, one per env. There are
+   //only a handful of envs, a linear scan beats any map
+   struct ThreadTxCache
+   {
+      struct Entry
+      {
+         std::shared_ptr<LMDBTxRegistry> registry_;
+         std::shared_ptr<LMDBThreadTxInfo> info_;
+      };
+
+      std::vector<Entry> entries_;
+
+      static void release(Entry& entry)
+      {
+         auto& registry = *entry.registry_;
+         std::unique_lock<std::mutex> lock(registry.mu_);
+
+         //a closed env has already aborted the cached txns
+         if (registry.dbenv_ == nullptr)
+            return;
+
+         if (entry.info_->resetTxn_ != nullptr)
+         {
+            mdb_txn_abort(entry.info_->resetTxn_);
+            entry.info_->resetTxn_ = nullptr;
+         }
+
+         //leave a tx that is still running to the env
+         if (entry.info_->transactionLevel_ != 0)
+            return;
+
+         auto iter = std::find(
+            registry.infos_.begin(), registry.infos_.end(), entry.info_);
+         if (iter != registry.infos_.end())
+            registry.infos_.erase(iter);
+      }
+
+      ~ThreadTxCache()
+      {
+         for (auto& entry : entries_)
+            release(entry);
+      }
+   };
+
+   thread_local ThreadTxCache threadTxCache_;
+}
+
 inline void LMDB::Iterator::checkHasDb() const
 {
    if (!db_)
@@ -63,20 +113,12 @@ inline void LMDB::Iterator::checkOk() const
 
 void LMDB::Iterator::openCursor()
 {
-   auto tID = std::this_thread::get_id();
    LMDBEnv *const _env = db_->env;
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   
-   auto txnIter = _env->txForThreads_.find(tID);
-   if (txnIter == _env->txForThreads_.end())
-      throw std::runtime_error("Iterator must be created within Transaction");
-   
-   lock.unlock();
-   
-   if (txnIter->second.transactionLevel_ == 0)
+   auto thTx = _env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Iterator must be created within Transaction");
    
-   txnPtr_ = &txnIter->second;
+   txnPtr_ = thTx;
   
    int rc = mdb_cursor_open(txnPtr_->txn_, db_->dbi, &csr_);
    if (rc != MDB_SUCCESS)
@@ -332,8 +374,6 @@ void LMDBEnv::open(const char *filename)
 {
    if (dbenv)
       throw std::logic_error("Database environment already open (close it first)");
-
-   txForThreads_.clear();
    
    int rc;
 
@@ -345,20 +385,96 @@ void LMDBEnv::open(const char *filename)
    if (rc != MDB_SUCCESS)
       throw LMDBException("Failed to set max dbs (" + errorString(rc) + ")");
    
-   rc = mdb_env_open(dbenv, filename, MDB_NOSYNC|MDB_NOSUBDIR, 0600);
+   //NOTLS ties reader slots to txns rather than threads, so that reset
+   //read txns can be cached per thread and released from any thread
+   rc = mdb_env_open(dbenv, filename, MDB_NOSYNC|MDB_NOSUBDIR|MDB_NOTLS, 0600);
    if (rc != MDB_SUCCESS)
       throw LMDBException("Failed to open db " + std::string(filename) + " (" + errorString(rc) + ")");
+
+   txRegistry_ = std::make_shared<LMDBTxRegistry>();
+   txRegistry_->dbenv_ = dbenv;
 }
 
 void LMDBEnv::close()
 {
    if (dbenv)
    {
+      if (txRegistry_ != nullptr)
+      {
+         //release the cached read txns, threads that still reference this
+         //registry will find it closed
+         std::unique_lock<std::mutex> lock(txRegistry_->mu_);
+         for (auto& info : txRegistry_->infos_)
+         {
+            if (info->resetTxn_ != nullptr)
+            {
+               mdb_txn_abort(info->resetTxn_);
+               info->resetTxn_ = nullptr;
+            }
+         }
+
+         txRegistry_->infos_.clear();
+         txRegistry_->dbenv_ = nullptr;
+         lock.unlock();
+
+         txRegistry_.reset();
+      }
+
       mdb_env_close(dbenv);
       dbenv = nullptr;
    }
 }
 
+LMDBThreadTxInfo* LMDBEnv::getThreadTxInfo(bool create)
+{
+   auto registry = txRegistry_.get();
+   if (registry == nullptr)
+   {
+      if (!create)
+         return nullptr;
+
+      throw LMDBException("Cannot start transaction without db env");
+   }
+
+   auto& entries = threadTxCache_.entries_;
+   for (auto& entry : entries)
+   {
+      if (entry.registry_.get() == registry)
+         return entry.info_.get();
+   }
+
+   if (!create)
+      return nullptr;
+
+   //first txn of this thread on this env, drop the entries of closed envs
+   auto iter = entries.begin();
+   while (iter != entries.end())
+   {
+      bool closed;
+      {
+         std::unique_lock<std::mutex> lock(iter->registry_->mu_);
+         closed = (iter->registry_->dbenv_ == nullptr);
+      }
+
+      if (closed)
+         iter = entries.erase(iter);
+      else
+         ++iter;
+   }
+
+   ThreadTxCache::Entry entry;
+   entry.registry_ = txRegistry_;
+   entry.info_ = std::make_shared<LMDBThreadTxInfo>();
+
+   {
+      std::unique_lock<std::mutex> lock(registry->mu_);
+      registry->infos_.push_back(entry.info_);
+   }
+
+   entries.push_back(entry);
+   return entry.info_.get();
+}
+
 LMDBEnv::Transaction::Transaction(LMDBEnv *_env, LMDB::Mode mode)
    : env(_env), mode_(mode)
 {
@@ -391,36 +507,58 @@ void LMDBEnv::Transaction::begin()
    
    began = true;
 
-   auto tID = std::this_thread::get_id();
-   
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   LMDBThreadTxInfo& thTx = env->txForThreads_[tID];
-   lock.unlock();
+   LMDBThreadTxInfo* thTx;
+   try
+   {
+      thTx = env->getThreadTxInfo(true);
+   }
+   catch (...)
+   {
+      began = false;
+      throw;
+   }
    
-   if (thTx.transactionLevel_ != 0 && mode_ == LMDB::ReadWrite && thTx.mode_ == LMDB::ReadOnly)
+   if (thTx->transactionLevel_ != 0 && mode_ == LMDB::ReadWrite && thTx->mode_ == LMDB::ReadOnly)
+   {
+      began = false;
       throw LMDBException("Cannot access ReadOnly Transaction in ReadWrite mode");
+   }
    
-   if (thTx.transactionLevel_++ != 0)
+   if (thTx->transactionLevel_++ != 0)
       return;
       
-   if (!env->dbenv)
-      throw LMDBException("Cannot start transaction without db env");
-      
    int modef = MDB_RDONLY;
-   thTx.mode_ = LMDB::ReadOnly;
+   thTx->mode_ = LMDB::ReadOnly;
    
    if (mode_ == LMDB::ReadWrite)
    {
       modef = 0;
-      thTx.mode_ = LMDB::ReadWrite;
+      thTx->mode_ = LMDB::ReadWrite;
+   }
+
+   int rc;
+   if (mode_ == LMDB::ReadOnly && thTx->resetTxn_ != nullptr)
+   {
+      //renew the cached read txn, this skips the reader slot setup
+      thTx->txn_ = thTx->resetTxn_;
+      thTx->resetTxn_ = nullptr;
+
+      rc = mdb_txn_renew(thTx->txn_);
+      if (rc != MDB_SUCCESS)
+      {
+         mdb_txn_abort(thTx->txn_);
+         rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx->txn_);
+      }
+   }
+   else
+   {
+      rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx->txn_);
    }
 
-   int rc = mdb_txn_begin(env->dbenv, nullptr, modef, &thTx.txn_);
    if (rc != MDB_SUCCESS)
    {
-      lock.lock();
-      env->txForThreads_.erase(tID);
-      lock.unlock();
+      thTx->txn_ = nullptr;
+      thTx->transactionLevel_ = 0;
       
       began = false;
       throw LMDBException("Failed to create transaction (" + errorString(rc) +")");
@@ -446,33 +584,47 @@ void LMDBEnv::Transaction::commit()
    began=false;
 
    //look for an existing transaction in this thread
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Transaction bound to unknown thread");
-   lock.unlock();
 
-   LMDBThreadTxInfo& thTx = txnIter->second;
-
-   if (thTx.transactionLevel_-- == 1)
+   if (thTx->transactionLevel_-- == 1)
    {
-      int rc = mdb_txn_commit(thTx.txn_);
-      
-      for (LMDB::Iterator *i : thTx.iterators_)
+      int rc = MDB_SUCCESS;
+
+      if (thTx->mode_ == LMDB::ReadOnly)
       {
-         i->hasTx=false;
-         i->csr_=nullptr;
+         //cursors of read only txns aren't freed along with the txn
+         for (LMDB::Iterator *i : thTx->iterators_)
+         {
+            if (i->csr_ != nullptr)
+               mdb_cursor_close(i->csr_);
+            i->hasTx=false;
+            i->csr_=nullptr;
+         }
+
+         //keep the txn for the next read, renewing it is much cheaper
+         //than setting up a new one
+         mdb_txn_reset(thTx->txn_);
+         thTx->resetTxn_ = thTx->txn_;
       }
+      else
+      {
+         rc = mdb_txn_commit(thTx->txn_);
+      
+         for (LMDB::Iterator *i : thTx->iterators_)
+         {
+            i->hasTx=false;
+            i->csr_=nullptr;
+         }
+      }
+
+      thTx->txn_ = nullptr;
       
       if (rc != MDB_SUCCESS)
       {
          throw LMDBException("Failed to close env tx (" + errorString(rc) +")");
       }
-      
-      lock.lock();
-      env->txForThreads_.erase(txnIter);
    }
 }
 
@@ -499,10 +651,15 @@ void LMDB::close()
 {
    if (dbi != 0)
    {
+      auto registry = env->txRegistry_;
+      if (registry != nullptr)
       {
-         std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-         if (!env->txForThreads_.empty())
-            throw std::runtime_error("Tried to close database with open txes");
+         std::unique_lock<std::mutex> lock(registry->mu_);
+         for (auto& info : registry->infos_)
+         {
+            if (info->transactionLevel_ != 0)
+               throw std::runtime_error("Tried to close database with open txes");
+         }
       }
       mdb_dbi_close(env->dbenv, dbi);
       dbi=0;
@@ -520,15 +677,11 @@ void LMDB::open(LMDBEnv *_env, const std::string &name)
    this->env = _env;
    
    LMDBEnv::Transaction tx(_env);
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(_env->threadTxMutex_);
-   auto txnIter = _env->txForThreads_.find(tID);
-
-   if (txnIter == _env->txForThreads_.end())
+   auto thTx = _env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
-   int rc = mdb_open(txnIter->second.txn_, name.c_str(), MDB_CREATE, &dbi);
+   int rc = mdb_open(thTx->txn_, name.c_str(), MDB_CREATE, &dbi);
    if (rc != MDB_SUCCESS)
    {
       // cleanup here
@@ -544,17 +697,11 @@ void LMDB::insert(
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mval = { value.len, const_cast<char*>(value.data) };
    
-   auto tID = std::this_thread::get_id();
-
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
    
-   int rc = mdb_put(txnIter->second.txn_, dbi, &mkey, &mval, 0);
+   int rc = mdb_put(thTx->txn_, dbi, &mkey, &mval, 0);
    if (rc != MDB_SUCCESS)
    {
       std::cout << "failed to insert data, returned following error string: " << errorString(rc) << std::endl;
@@ -564,16 +711,12 @@ void LMDB::insert(
 
 void LMDB::erase(const CharacterArrayRef& key)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   auto txnIter = env->txForThreads_.find(tID);
-
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw LMDBException("Failed to insert: need transaction");
-   lock.unlock();
       
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
-   int rc = mdb_del(txnIter->second.txn_, dbi, &mkey, 0);
+   int rc = mdb_del(thTx->txn_, dbi, &mkey, 0);
    if (rc != MDB_SUCCESS && rc != MDB_NOTFOUND)
    {
       std::cout << "failed to erase data, returned following error string: " << errorString(rc) << std::endl;
@@ -594,19 +737,14 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 {
    //simple get without the use of iterators
 
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-   
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Need transaction to get data");
-   
-   lock.unlock();
 
    MDB_val mkey = { key.len, const_cast<char*>(key.data) };
    MDB_val mdata = { 0, 0 };
 
-   int rc = mdb_get(txnIter->second.txn_, dbi, &mkey, &mdata);
+   int rc = mdb_get(thTx->txn_, dbi, &mkey, &mdata);
    if (rc == MDB_NOTFOUND)
       return CharacterArrayRef(0, (char*)nullptr);
    
@@ -619,16 +757,11 @@ CharacterArrayRef LMDB::get_NoCopy(const CharacterArrayRef& key) const
 
 void LMDB::drop(void)
 {
-   auto tID = std::this_thread::get_id();
-   std::unique_lock<std::mutex> lock(env->threadTxMutex_);
-
-   auto txnIter = env->txForThreads_.find(tID);
-   if (txnIter == env->txForThreads_.end())
+   auto thTx = env->getThreadTxInfo(false);
+   if (thTx == nullptr || thTx->transactionLevel_ == 0)
       throw std::runtime_error("Need transaction to get data");
 
-   lock.unlock();
-
-   if (mdb_drop(txnIter->second.txn_, dbi, 0) != MDB_SUCCESS)
+   if (mdb_drop(thTx->txn_, dbi, 0) != MDB_SUCCESS)
       throw std::runtime_error("Failed to drop DB!");
 }
 
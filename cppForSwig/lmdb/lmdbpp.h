@@ -14,6 +14,7 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <memory>
 #include "lmdb.h"
 
 struct MDB_env;
@@ -63,6 +64,7 @@ class LMDBEnv;
 
 //one mother-txn per thread
 struct LMDBThreadTxInfo;
+struct LMDBTxRegistry;
 
 
 class LMDB
@@ -240,12 +242,27 @@ private:
 struct LMDBThreadTxInfo
 {
    MDB_txn *txn_=nullptr;
+   //read only txn kept in reset state once its owner committed, it is
+   //renewed by the next read only txn of this thread
+   MDB_txn *resetTxn_=nullptr;
 
    std::vector<LMDB::Iterator*> iterators_;
    unsigned transactionLevel_=0;
    LMDB::Mode mode_;
 };
 
+//Tracks the tx infos of all threads that used an env. Threads hold on to
+//the registry along with their own tx info, so that the cached read txn 
+//is released either on thread exit or on env close, whichever comes first.
+//The mutex is only taken on these 2 events and on the first txn a thread
+//opens on an env, never on the regular begin/commit path.
+struct LMDBTxRegistry
+{
+   std::mutex mu_;
+   MDB_env *dbenv_=nullptr;
+   std::vector<std::shared_ptr<LMDBThreadTxInfo>> infos_;
+};
+
 
 class LMDBEnv
 {
@@ -256,11 +273,14 @@ private:
    MDB_env *dbenv=nullptr;
    unsigned dbCount_ = 1;
 
-   std::mutex threadTxMutex_;
-   std::unordered_map<std::thread::id, LMDBThreadTxInfo> txForThreads_;
+   std::shared_ptr<LMDBTxRegistry> txRegistry_;
    
    friend class LMDB;
 
+   //returns this thread's tx info for this env, from a thread local cache.
+   //Returns nullptr if there is none and create is false
+   LMDBThreadTxInfo* getThreadTxInfo(bool create);
+
 public:
    class Transaction
    {
@@ -11,6 +11,7 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <map>
@@ -351,8 +352,9 @@ bool LDBIter::checkKeyStartsWith(DB_PREFIX prefix, BinaryDataRef key)
 ////////////////////////////////////////////////////////////////////////////////
 LMDBBlockDatabase::LMDBBlockDatabase(
    shared_ptr<Blockchain> bcPtr, const string& blkFolder,
-   ARMORY_DB_TYPE dbtype) :
-   blockchainPtr_(bcPtr), blkFolder_(blkFolder), armoryDbType_(dbtype)
+   ARMORY_DB_TYPE dbtype, bool txHashIndex) :
+   blockchainPtr_(bcPtr), blkFolder_(blkFolder), armoryDbType_(dbtype),
+   txHashIndex_(txHashIndex)
 {
    //for some reason the WRITE_UINT16 macros create 4 byte long BinaryData 
    //instead of 2, so I'm doing this the hard way instead
@@ -443,6 +445,7 @@ void LMDBBlockDatabase::nukeHeadersDB(void)
 {
    SCOPED_TIMER("nukeHeadersDB");
    LOGINFO << "Destroying headers DB, to be rebuilt.";
+   remove(getBlockIndexPath().c_str());
    
    LMDBEnv::Transaction tx;
    beginDBTransaction(&tx, HEADERS, LMDB::ReadWrite);
@@ -548,6 +551,7 @@ void LMDBBlockDatabase::destroyAndResetDatabases(void)
       closeDatabases();
       for (unsigned db = HEADERS; db != COUNT; db++)
          remove(getDbPath(static_cast<DB_SELECT>(db)).c_str());
+      remove(getBlockIndexPath().c_str());
    }
    
    // Reopen the databases with the exact same parameters as before
@@ -595,6 +599,49 @@ BinaryDataRef LMDBBlockDatabase::getValueNoCopy(DB_SELECT db,
       return BinaryDataRef();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::getMany(DB_SELECT db, vector<BinaryData>& keys,
+   const function<void(const BinaryData&, BinaryDataRef)>& callback) const
+{
+   /***
+   Keys are visited in db order so the cursor only ever moves forward. Nearby
+   keys tend to sit on the same leaf page, so a few MDB_NEXT steps are tried
+   before paying for a full MDB_SET_RANGE descent from the root.
+   ***/
+   static const unsigned maxSteps = 4;
+
+   sort(keys.begin(), keys.end());
+   keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+   if (keys.size() == 0)
+      return;
+
+   LDBIter ldbIter = getIterator(db);
+   bool valid = ldbIter.seekTo(keys.front());
+
+   for (auto& key : keys)
+   {
+      if (valid && ldbIter.getKeyRef() < key)
+      {
+         unsigned steps = 0;
+         do
+         {
+            valid = ldbIter.advanceAndRead();
+         }
+         while (valid && ldbIter.getKeyRef() < key && ++steps < maxSteps);
+
+         if (valid && ldbIter.getKeyRef() < key)
+            valid = ldbIter.seekTo(key);
+      }
+
+      //once the cursor runs past the last entry, remaining keys are misses
+      if (valid && ldbIter.getKeyRef() == key)
+         callback(key, ldbIter.getValueRef());
+      else
+         callback(key, BinaryDataRef());
+   }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // Get value using BinaryDataRef object.  The data from the get* call is 
 // actually copied to a member variable, and thus the refs are valid only 
@@ -1183,40 +1230,130 @@ bool LMDBBlockDatabase::getFullUTXOMapForSSH(
    //TODO: deprecate. replace with paged version once new coin control is
    //implemented
 
+   auto fillMap = [&mapToFill](const BinaryData& txoKey, UnspentTxOut&& utxo)
+   {
+      mapToFill[txoKey] = move(utxo);
+   };
+
+   return getFullUTXOsForSSH(ssh, fillMap);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+bool LMDBBlockDatabase::getFullUTXOsForSSH(
+   StoredScriptHistory & ssh,
+   const function<void(const BinaryData&, UnspentTxOut&&)>& callback)
+{
+   /***
+   Fullnode gathers the stxo and txhint keys of all utxos first and resolves
+   each set with a single getMany pass. Supernode stxos are read from the 
+   raw blocks, these carry their parent hash so there is no hint to fetch.
+   ***/
+
    if(!ssh.haveFullHistoryLoaded())
       return false;
 
-   LMDBEnv::Transaction stxotx, hinttx;
-   beginDBTransaction(&stxotx, STXO, LMDB::ReadOnly);
-   beginDBTransaction(&hinttx, TXHINTS, LMDB::ReadOnly);
-
+   vector<const TxIOPair*> utxos;
+   for (const auto& ssPair : ssh.subHistMap_)
    {
-      for (const auto& ssPair : ssh.subHistMap_)
+      for (const auto& txioPair : ssPair.second.txioMap_)
       {
-         const StoredSubHistory & subSSH = ssPair.second;
-         for (const auto& txioPair : subSSH.txioMap_)
-         {
-            const TxIOPair & txio = txioPair.second;
-            if (txio.isUTXO())
-            {
-               BinaryData txoKey = txio.getDBKeyOfOutput();
-               BinaryData txKey = txio.getTxRefOfOutput().getDBKey();
-               uint16_t txoIdx = txio.getIndexOfOutput();
+         if (txioPair.second.isUTXO())
+            utxos.push_back(&txioPair.second);
+      }
+   }
 
+   if (utxos.size() == 0)
+      return true;
 
-               StoredTxOut stxo;
-               getStoredTxOut(stxo, txoKey);
-               BinaryData txHash = getTxHashForLdbKey(txKey);
+   if (armoryDbType_ == ARMORY_DB_SUPER)
+   {
+      for (auto txio : utxos)
+      {
+         BinaryData txoKey = txio->getDBKeyOfOutput();
 
-               mapToFill[txoKey] = UnspentTxOut(
-                  txHash,
-                  txoIdx,
-                  stxo.blockHeight_,
-                  txio.getValue(),
-                  stxo.getScriptRef());
-            }
-         }
+         StoredTxOut stxo;
+         getStoredTxOut(stxo, txoKey);
+
+         callback(txoKey, UnspentTxOut(
+            stxo.parentHash_,
+            txio->getIndexOfOutput(),
+            stxo.blockHeight_,
+            txio->getValue(),
+            stxo.getScriptRef()));
       }
+
+      return true;
+   }
+
+   auto getPrefixedKey = [](const BinaryData& key)->BinaryData
+   {
+      BinaryWriter bw(key.getSize() + 1);
+      bw.put_uint8_t((uint8_t)DB_PREFIX_TXDATA);
+      bw.put_BinaryData(key);
+      return bw.getData();
+   };
+
+   vector<BinaryData> stxoKeys, hintKeys;
+   stxoKeys.reserve(utxos.size());
+   hintKeys.reserve(utxos.size());
+   for (auto txio : utxos)
+   {
+      stxoKeys.push_back(getPrefixedKey(txio->getDBKeyOfOutput()));
+      hintKeys.push_back(getPrefixedKey(txio->getTxRefOfOutput().getDBKey()));
+   }
+
+   map<BinaryData, StoredTxOut> stxoMap;
+   map<BinaryData, BinaryData> hashMap;
+
+   {
+      LMDBEnv::Transaction stxotx;
+      beginDBTransaction(&stxotx, STXO, LMDB::ReadOnly);
+
+      getMany(STXO, stxoKeys,
+         [&stxoMap](const BinaryData& key, BinaryDataRef value)->void
+      {
+         if (value.getSize() == 0)
+            return;
+
+         auto& stxo = stxoMap[key];
+         stxo.blockHeight_ = DBUtils::hgtxToHeight(key.getSliceRef(1, 4));
+         stxo.unserializeDBValue(value);
+      });
+   }
+
+   {
+      LMDBEnv::Transaction hinttx;
+      beginDBTransaction(&hinttx, TXHINTS, LMDB::ReadOnly);
+
+      getMany(TXHINTS, hintKeys,
+         [&hashMap](const BinaryData& key, BinaryDataRef value)->void
+      {
+         if (value.getSize() >= 36)
+            hashMap[key] = value.getSliceCopy(4, 32);
+      });
+   }
+
+   for (auto txio : utxos)
+   {
+      BinaryData txoKey = txio->getDBKeyOfOutput();
+
+      StoredTxOut stxo;
+      auto stxoIter = stxoMap.find(getPrefixedKey(txoKey));
+      if (stxoIter != stxoMap.end())
+         stxo = move(stxoIter->second);
+
+      BinaryData txHash;
+      auto hashIter = hashMap.find(
+         getPrefixedKey(txio->getTxRefOfOutput().getDBKey()));
+      if (hashIter != hashMap.end())
+         txHash = hashIter->second;
+
+      callback(txoKey, UnspentTxOut(
+         txHash,
+         txio->getIndexOfOutput(),
+         stxo.blockHeight_,
+         txio->getValue(),
+         stxo.getScriptRef()));
    }
 
    return true;
@@ -1228,9 +1365,16 @@ bool LMDBBlockDatabase::getFullUTXOMapForSSH(
 //       that would get us since we are reading all the headers and doing
 //       a fresh organize/sort anyway.
 void LMDBBlockDatabase::readAllHeaders(
-   const function<void(shared_ptr<BlockHeader>, uint32_t, uint8_t)> &callback
+   const function<void(shared_ptr<BlockHeader>, uint32_t, uint8_t)> &callback,
+   unsigned threadCount
 )
 {
+   /***
+   Gathers the raw entries first, then deserializes them in parallel into a
+   single arena. The headers handed to the callback are aliases into that
+   arena, which spares a heap allocation per header.
+   ***/
+
    LMDBEnv::Transaction tx;
    beginDBTransaction(&tx, HEADERS, LMDB::ReadOnly);
 
@@ -1242,6 +1386,9 @@ void LMDBBlockDatabase::readAllHeaders(
       return;
    }
    
+   //key and value refs point to the db mmap, they remain valid for the
+   //duration of the read transaction
+   vector<pair<BinaryDataRef, BinaryDataRef>> rawHeaders;
    do
    {
       ldbIter.resetReaders();
@@ -1253,30 +1400,94 @@ void LMDBBlockDatabase::readAllHeaders(
          continue;
       }
 
-      StoredHeader sbh;
-      ldbIter.getKeyReader().get_BinaryData(sbh.thisHash_, 32);
+      rawHeaders.push_back(make_pair(
+         ldbIter.getKeyReader().get_BinaryDataRef(32),
+         ldbIter.getValueRef()));
+
+   } while(ldbIter.advanceAndRead(DB_PREFIX_HEADHASH));
+
+   auto arena = make_shared<vector<BlockHeader>>(rawHeaders.size());
+   vector<uint32_t> heights(rawHeaders.size());
+   vector<uint8_t> dupIDs(rawHeaders.size());
+   vector<uint8_t> valid(rawHeaders.size(), 0);
+
+   auto deserLambda = [&](size_t start, size_t end)->void
+   {
+      for (size_t i = start; i < end; i++)
+      {
+         StoredHeader sbh;
+         try
+         {
+            sbh.unserializeDBValue(HEADERS, rawHeaders[i].second);
+         }
+         catch (BlockDeserializingException&)
+         {
+            continue;
+         }
+
+         auto& regHead = (*arena)[i];
+
+         //sbh already hashed the header
+         regHead.unserialize(
+            sbh.dataCopy_.getPtr(), HEADER_SIZE, sbh.thisHash_.getRef());
+         regHead.setBlockSize(sbh.numBytes_);
+         regHead.setNumTx(sbh.numTx_);
+
+         regHead.setBlockFileNum(sbh.fileID_);
+         regHead.setBlockFileOffset(sbh.offset_);
+         regHead.setUniqueID(sbh.uniqueID_);
+
+         heights[i] = sbh.blockHeight_;
+         dupIDs[i] = sbh.duplicateID_;
+         valid[i] = 1;
+      }
+   };
+
+   if (threadCount == 0)
+      threadCount = 1;
 
-      sbh.unserializeDBValue(HEADERS, ldbIter.getValueRef());
+   size_t chunkSize = rawHeaders.size() / threadCount + 1;
+   vector<thread> tIDs;
+   for (unsigned i = 1; i < threadCount; i++)
+   {
+      auto start = chunkSize * i;
+      if (start >= rawHeaders.size())
+         break;
 
-      auto regHead = make_shared<BlockHeader>();
+      tIDs.push_back(thread(deserLambda, start,
+         min(start + chunkSize, rawHeaders.size())));
+   }
 
-      regHead->unserialize(sbh.dataCopy_);
-      regHead->setBlockSize(sbh.numBytes_);
-      regHead->setNumTx(sbh.numTx_);
+   deserLambda(0, min(chunkSize, rawHeaders.size()));
 
-      regHead->setBlockFileNum(sbh.fileID_);
-      regHead->setBlockFileOffset(sbh.offset_);
-      regHead->setUniqueID(sbh.uniqueID_);
+   for (auto& tID : tIDs)
+   {
+      if (tID.joinable())
+         tID.join();
+   }
+
+   for (size_t i = 0; i < rawHeaders.size(); i++)
+   {
+      if (!valid[i])
+      {
+         stringstream ss;
+         ss << "failed to deserialize header " <<
+            BinaryData(rawHeaders[i].first).copySwapEndian().toHexStr();
+         LOGERR << ss.str();
+         throw BlockDeserializingException(ss.str());
+      }
 
-      if (sbh.thisHash_ != regHead->getThisHash())
+      shared_ptr<BlockHeader> regHead(arena, &(*arena)[i]);
+      if (rawHeaders[i].first != regHead->getThisHashRef())
       {
          LOGWARN << "Corruption detected: block header hash " <<
-            sbh.thisHash_.copySwapEndian().toHexStr() << " does not match "
-            << regHead->getThisHash().copySwapEndian().toHexStr();
+            BinaryData(rawHeaders[i].first).copySwapEndian().toHexStr() << 
+            " does not match " << 
+            regHead->getThisHash().copySwapEndian().toHexStr();
       }
-      callback(regHead, sbh.blockHeight_, sbh.duplicateID_);
 
-   } while(ldbIter.advanceAndRead(DB_PREFIX_HEADHASH));
+      callback(regHead, heights[i], dupIDs[i]);
+   }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2143,8 +2354,12 @@ bool LMDBBlockDatabase::getStoredTx_byHash(const BinaryData& txHash,
       return false;
 
    auto&& dbKey = getDBKeyForHash(txHash);
-   if (dbKey.getSize() == 0)
-      return false;
+   if (dbKey.getSize() == 0 && txHashIndex_)
+   {
+      dbKey = getDBKeyFromTxHashIndex(txHash);
+      if (dbKey.getSize() == 0)
+         return false;
+   }
 
    LMDBEnv::Transaction tx;
    beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
@@ -2366,45 +2581,98 @@ bool LMDBBlockDatabase::getStoredTxOut(
 void LMDBBlockDatabase::getUTXOflags(map<BinaryData, StoredSubHistory>&
    subSshMap) const
 {
-   LMDBEnv::Transaction tx;
-   if (armoryDbType_ != ARMORY_DB_SUPER)
-      beginDBTransaction(&tx, STXO, LMDB::ReadOnly);
-   else
-      beginDBTransaction(&tx, SPENTNESS, LMDB::ReadOnly);
-
+   vector<StoredSubHistory*> subSshVec;
+   subSshVec.reserve(subSshMap.size());
    for (auto& subssh : subSshMap)
-      getUTXOflags(subssh.second);
+      subSshVec.push_back(&subssh.second);
+
+   getUTXOflags(subSshVec);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 void LMDBBlockDatabase::getUTXOflags(StoredSubHistory& subssh) const
 {
-   for (auto& txioPair : subssh.txioMap_)
-   {
-      auto& txio = txioPair.second;
+   vector<StoredSubHistory*> subSshVec(1, &subssh);
+   getUTXOflags(subSshVec);
+}
 
-      txio.setUTXO(false);
-      if (txio.hasTxIn())
-         continue;
+////////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::getUTXOflags(
+   const vector<StoredSubHistory*>& subSshVec) const
+{
+   /***
+   Gather the txout keys of all txios first and resolve them with a single
+   getMany pass. Fullnode checks the spentness of the stxo entry, supernode
+   has a SPENTNESS entry only for spent outputs.
+   ***/
 
-      auto&& stxoKey = txio.getDBKeyOfOutput();
-      
-      if (armoryDbType_ != ARMORY_DB_SUPER)
+   DB_SELECT db = STXO;
+   if (armoryDbType_ == ARMORY_DB_SUPER)
+      db = SPENTNESS;
+
+   map<BinaryData, vector<TxIOPair*>> txioMap;
+   for (auto subssh : subSshVec)
+   {
+      for (auto& txioPair : subssh->txioMap_)
       {
-         StoredTxOut stxo;
-         if (!getStoredTxOut(stxo, stxoKey))
+         auto& txio = txioPair.second;
+
+         txio.setUTXO(false);
+         if (txio.hasTxIn())
             continue;
 
-         if (stxo.spentness_ == TXOUT_UNSPENT)
-            txio.setUTXO(true);
+         auto&& stxoKey = txio.getDBKeyOfOutput();
+         if (db == STXO)
+         {
+            BinaryWriter bw(stxoKey.getSize() + 1);
+            bw.put_uint8_t((uint8_t)DB_PREFIX_TXDATA);
+            bw.put_BinaryData(stxoKey);
+            txioMap[bw.getData()].push_back(&txio);
+         }
+         else
+         {
+            txioMap[stxoKey].push_back(&txio);
+         }
       }
-      else
+   }
+
+   if (txioMap.size() == 0)
+      return;
+
+   vector<BinaryData> keys;
+   keys.reserve(txioMap.size());
+   for (auto& txioPair : txioMap)
+      keys.push_back(txioPair.first);
+
+   //keys come out of the map sorted, so txioMap can be walked in lockstep
+   auto txioIter = txioMap.begin();
+   auto setUTXOflags = [&txioIter, db]
+      (const BinaryData& key, BinaryDataRef value)->void
+   {
+      auto& txios = (txioIter++)->second;
+
+      bool isUTXO;
+      if (db == STXO)
       {
-         auto value = getValueNoCopy(SPENTNESS, stxoKey);
          if (value.getSize() == 0)
-            txio.setUTXO(true);
+            return;
+
+         StoredTxOut stxo;
+         stxo.unserializeDBValue(value);
+         isUTXO = stxo.spentness_ == TXOUT_UNSPENT;
       }
-   }
+      else
+      {
+         isUTXO = value.getSize() == 0;
+      }
+
+      for (auto txio : txios)
+         txio->setUTXO(isUTXO);
+   };
+
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, db, LMDB::ReadOnly);
+   getMany(db, keys, setUTXOflags);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2963,6 +3231,9 @@ string LMDBBlockDatabase::getDbName(DB_SELECT db) const
       case SPENTNESS:
          return "spentness";
 
+      case TXHASHINDEX:
+         return "txhashindex";
+
       default: 
          throw runtime_error("unknown db");
    }
@@ -3065,4 +3336,158 @@ set<BinaryData> LMDBBlockDatabase::getMissingHashes(uint32_t id) const
       missingHashesSet.insert(move(brr.get_BinaryData(32)));
 
    return missingHashesSet;
-}
\ No newline at end of file
+}
+////////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::putTxHashIndexForFileNum(uint32_t fileNum,
+   const set<TxFilter<TxFilterType>>& filters, bool fileComplete)
+{
+   /***
+   One entry per tx, keyed by hash prefix | block key | tx index, with the
+   blk file number as value. LMDB keeps the keys sorted, resolving a hash
+   is a single seek followed by a short walk over the matching prefixes.
+
+   The file key marks blk files that have been indexed from their first
+   block. Files without it have to be resolved through their filter pool.
+   ***/
+
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXHASHINDEX, LMDB::ReadWrite);
+
+   auto&& fileNumVal = WRITE_UINT32_LE(fileNum);
+
+   for (auto& filter : filters)
+   {
+      auto& prefixes = filter.getFilterVector();
+      if (prefixes.size() > UINT16_MAX)
+      {
+         LOGWARN << "too many txns to index block " << filter.getBlockKey();
+         continue;
+      }
+
+      for (unsigned i = 0; i < prefixes.size(); i++)
+      {
+         BinaryDataRef prefixRef(
+            (const uint8_t*)&prefixes[i], sizeof(TxFilterType));
+         auto&& key = DBUtils::getTxHashIndexKey(
+            prefixRef, filter.getBlockKey(), i);
+
+         putValue(TXHASHINDEX, key.getRef(), fileNumVal.getRef());
+      }
+   }
+
+   auto&& fileKey = DBUtils::getFilterPoolKey(fileNum);
+   if (fileComplete || getValueNoCopy(TXHASHINDEX, fileKey).getSize() != 0)
+      putValue(TXHASHINDEX, fileKey.getRef(), fileNumVal.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LMDBBlockDatabase::clearTxHashIndexForFileNum(uint32_t fileNum)
+{
+   //blocks were added to this file without indexing them, the index no
+   //longer covers it
+   auto&& fileKey = DBUtils::getFilterPoolKey(fileNum);
+
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXHASHINDEX, LMDB::ReadWrite);
+
+   if (getValueNoCopy(TXHASHINDEX, fileKey).getSize() != 0)
+      deleteValue(TXHASHINDEX, fileKey.getRef());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LMDBBlockDatabase::isTxHashIndexed(uint32_t fileNum) const
+{
+   auto&& fileKey = DBUtils::getFilterPoolKey(fileNum);
+
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXHASHINDEX, LMDB::ReadOnly);
+
+   return getValueNoCopy(TXHASHINDEX, fileKey).getSize() != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+map<uint32_t, map<uint32_t, set<uint32_t>>> 
+   LMDBBlockDatabase::getTxHashIndexHits(const BinaryData& hash) const
+{
+   //returns tx indexes per block key per blk file
+   if (hash.getSize() != 32)
+      throw runtime_error("hash is 32 bytes long");
+
+   map<uint32_t, map<uint32_t, set<uint32_t>>> result;
+   auto prefix = hash.getSliceRef(0, 4);
+
+   LMDBEnv::Transaction tx;
+   beginDBTransaction(&tx, TXHASHINDEX, LMDB::ReadOnly);
+
+   auto dbIter = getIterator(TXHASHINDEX);
+   if (!dbIter.seekToStartsWith(DB_PREFIX_TXHINTS, prefix))
+      return result;
+
+   do
+   {
+      if (!dbIter.checkKeyStartsWith(DB_PREFIX_TXHINTS, prefix))
+         break;
+
+      auto keyRef = dbIter.getKeyRef();
+      auto valRef = dbIter.getValueRef();
+      if (keyRef.getSize() != 11 || valRef.getSize() != 4)
+         continue;
+
+      BinaryRefReader brr(keyRef);
+      brr.advance(5);
+      auto blockKey = brr.get_uint32_t(BE);
+      auto txIndex = brr.get_uint16_t(BE);
+      auto fileNum = READ_UINT32_LE(valRef.getPtr());
+
+      result[fileNum][blockKey].insert(txIndex);
+   } while (dbIter.advanceAndRead(DB_PREFIX_TXHINTS));
+
+   return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+BinaryData LMDBBlockDatabase::getDBKeyFromTxHashIndex(
+   const BinaryData& txhash) const
+{
+   if (armoryDbType_ != ARMORY_DB_FULL || txhash.getSize() != 32)
+      return BinaryData();
+
+   auto&& indexHits = getTxHashIndexHits(txhash);
+   for (auto& filePair : indexHits)
+   {
+      for (auto& blockPair : filePair.second)
+      {
+         shared_ptr<BlockHeader> header;
+         try
+         {
+            header = blockchainPtr_->getHeaderById(blockPair.first);
+         }
+         catch (exception&)
+         {
+            continue;
+         }
+
+         if (!header->isMainBranch())
+            continue;
+
+         for (auto& txid : blockPair.second)
+         {
+            try
+            {
+               auto&& tx = getFullTxCopy(txid, header);
+               if (tx.getThisHash() != txhash)
+                  continue;
+
+               return DBUtils::getBlkDataKeyNoPrefix(
+                  header->getBlockHeight(), header->getDuplicateID(), txid);
+            }
+            catch (exception&)
+            {
+               continue;
+            }
+         }
+      }
+   }
+
+   return BinaryData();
+}
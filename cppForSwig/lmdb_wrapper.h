@@ -359,7 +359,8 @@ class LMDBBlockDatabase
 public:
 
    /////////////////////////////////////////////////////////////////////////////
-   LMDBBlockDatabase(shared_ptr<Blockchain>, const string&, ARMORY_DB_TYPE);
+   LMDBBlockDatabase(shared_ptr<Blockchain>, const string&, ARMORY_DB_TYPE,
+      bool txHashIndex = false);
    ~LMDBBlockDatabase(void);
 
    /////////////////////////////////////////////////////////////////////////////
@@ -416,6 +417,14 @@ public:
    // BinaryData key(string(theStr));
    BinaryDataRef getValueNoCopy(DB_SELECT db, BinaryDataRef keyWithPrefix) const;
 
+   /////////////////////////////////////////////////////////////////////////////
+   // Batched lookup. Sorts and dedups keys in place, then walks a single
+   // cursor forward over them. callback is hit once per key in sorted order,
+   // with an empty ref for missing keys. Value refs point to the db mmap and
+   // are only valid within the read transaction the caller has to hold.
+   void getMany(DB_SELECT db, vector<BinaryData>& keys,
+      const function<void(const BinaryData&, BinaryDataRef)>& callback) const;
+
    /////////////////////////////////////////////////////////////////////////////
    // Get value using BinaryDataRef object.  The data from the get* call is 
    // actually stored in a member variable, and thus the refs are valid only 
@@ -471,7 +480,8 @@ public:
 
    /////////////////////////////////////////////////////////////////////////////
    void readAllHeaders(
-      const function<void(shared_ptr<BlockHeader>, uint32_t, uint8_t)> &callback
+      const function<void(shared_ptr<BlockHeader>, uint32_t, uint8_t)> &callback,
+      unsigned threadCount = 1
       );
 
    /////////////////////////////////////////////////////////////////////////////
@@ -588,6 +598,7 @@ public:
 
    void getUTXOflags(map<BinaryData, StoredSubHistory>&) const;
    void getUTXOflags(StoredSubHistory&) const;
+   void getUTXOflags(const vector<StoredSubHistory*>&) const;
 
    void putStoredScriptHistory(StoredScriptHistory & ssh);
    void putStoredScriptHistorySummary(StoredScriptHistory & ssh);
@@ -626,6 +637,10 @@ public:
       map<BinaryData, UnspentTxOut> & mapToFill,
       bool withMultisig = false);
 
+   //same as above, hands out utxos one at a time along with their dbkey
+   bool     getFullUTXOsForSSH(StoredScriptHistory & ssh,
+      const function<void(const BinaryData&, UnspentTxOut&&)>& callback);
+
    uint64_t getBalanceForScrAddr(BinaryDataRef scrAddr, bool withMulti = false);
 
    bool putStoredTxHints(StoredTxHints const & sths);
@@ -701,6 +716,7 @@ public:
    string getDbName(DB_SELECT) const;
    string getDbPath(DB_SELECT) const;
    string getDbPath(const string&) const;
+   string getBlockIndexPath(void) const { return getDbPath("headerindex"); }
 
    void closeDB(DB_SELECT db);
    StoredDBInfo openDB(DB_SELECT);
@@ -774,6 +790,17 @@ public:
    void putMissingHashes(const set<BinaryData>&, uint32_t);
    set<BinaryData> getMissingHashes(uint32_t) const;
 
+   /////////////////////////////////////////////////////////////////////////////
+   //global hash prefix index, complements the per file TxFilterPools
+   void putTxHashIndexForFileNum(uint32_t fileNum,
+      const set<TxFilter<TxFilterType>>&, bool fileComplete);
+   void clearTxHashIndexForFileNum(uint32_t fileNum);
+   bool isTxHashIndexed(uint32_t fileNum) const;
+   bool hasTxHashIndex(void) const { return txHashIndex_; }
+   map<uint32_t, map<uint32_t, set<uint32_t>>> getTxHashIndexHits(
+      const BinaryData& hash) const;
+   BinaryData getDBKeyFromTxHashIndex(const BinaryData& txhash) const;
+
 public:
 
    mutable map<DB_SELECT, shared_ptr<LMDBEnv> > dbEnv_;
@@ -787,6 +814,7 @@ private:
    BinaryData           magicBytes_;
 
    ARMORY_DB_TYPE armoryDbType_;
+   const bool txHashIndex_;
 
    bool                 dbIsOpen_;
    uint32_t             ldbBlockSize_;